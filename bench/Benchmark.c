@@ -0,0 +1,1021 @@
+/**
+ * \file Benchmark.c
+ * \brief Measures each stage of the pipeline (and the whole pipeline) on a reference corpus : throughput, ratio and peak memory
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+#if __linux__
+#include <sys/resource.h>
+#endif
+
+/**
+ * \def BENCH_MAX_CORPUS Maximum number of elements in the corpus
+ */
+
+#define BENCH_MAX_CORPUS 32
+
+/**
+ * \def BENCH_MAX_RUNS Maximum number of runs of a stage for one element of the corpus
+ */
+
+#define BENCH_MAX_RUNS 101
+
+/**
+ * \def BENCH_LOW_MEMORY Limit of the memory of the blocks (--max-memory) in the stage pipeline-lowmem, too small for the transforms and the tables of the blocks of BLOCK_SIZE bytes
+ */
+
+#define BENCH_LOW_MEMORY (2*1024*1024)
+
+
+/**
+ * \struct BenchInput Benchmark.c
+ * \brief Data prepared once for a stage and an element of the corpus, a copy of it is given to each run
+ */
+
+typedef struct BenchInput{
+    FileBuffer original; /*!< element of the corpus*/
+    FileBuffer buffer; /*!< data given to the stage*/
+    int indexBW; /*!< index of Burrows Wheeler if buffer was encoded with it, -1 otherwise*/
+}BenchInput;
+
+/**
+ * \struct BenchRunResult Benchmark.c
+ * \brief Result of one run of a stage
+ */
+
+typedef struct BenchRunResult{
+    double seconds; /*!< time spent in the measured part of the stage*/
+    long bytesOut; /*!< number of bytes produced by the stage*/
+    int valid; /*!< 0 if the output of the stage isn't the expected one*/
+    int skipped; /*!< 1 if the stage has nothing to run on this element (its input was skipped by the previous step), nothing is measured*/
+}BenchRunResult;
+
+typedef void (*BenchPrepareFunction)(BenchInput* input);
+typedef void (*BenchRunFunction)(BenchInput* input, BenchRunResult* result);
+
+/**
+ * \struct BenchStage Benchmark.c
+ * \brief Stage of the pipeline that can be measured
+ */
+
+typedef struct BenchStage{
+    const char* name; /*!< name displayed in the report*/
+    BenchPrepareFunction prepare; /*!< function called once before the runs, can be NULL*/
+    BenchRunFunction run; /*!< function running the stage once*/
+    int usesBW; /*!< 1 if the stage applies Burrows Wheeler or LZ77 (which work on one block), it's then limited by the option --bwt-max*/
+    int hasRatio; /*!< 1 if the stage produces a compressed output*/
+}BenchStage;
+
+/**
+ * \struct BenchCorpusItem Benchmark.c
+ * \brief Element of the corpus on which the stages are measured
+ */
+
+typedef struct BenchCorpusItem{
+    char name[64]; /*!< name displayed in the report*/
+    FileBuffer buffer; /*!< content of the element*/
+}BenchCorpusItem;
+
+
+static long bwtMax = BWT_MAX_BLOCK; // Same limit as the one used by compressBlock
+static PipelineContext context; // Arena and scratch buffers shared by all the runs, like in the program
+
+
+
+/**
+ * \fn static void resetPeakMemory()
+ * \brief Resets the peak resident memory of the process if the system allows it, so that the next value read only concerns the current stage
+ */
+
+static void resetPeakMemory()
+{
+    #if __linux__
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if(file!=NULL){
+        fputs("5", file);
+        fclose(file);
+    }
+    #endif
+}
+
+/**
+ * \fn static long readPeakMemory()
+ * \brief Gives the peak resident memory since the last call of resetPeakMemory (or since the beginning of the process if it couldn't be reset)
+ * \return Peak resident memory in KiB, or -1 if it's unknown
+ */
+
+static long readPeakMemory()
+{
+    long peak=-1;
+    #if __linux__
+    char line[256];
+    FILE* file = fopen("/proc/self/status", "r");
+    if(file!=NULL){
+        while(fgets(line, sizeof(line), file)!=NULL){
+            if(!strncmp(line, "VmHWM:", 6)){
+                peak = strtol(line+6, NULL, 10);
+                break;
+            }
+        }
+        fclose(file);
+    }
+    if(peak<0){
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage)==0)
+            peak = usage.ru_maxrss;
+    }
+    #endif
+    return peak;
+}
+
+/**
+ * \fn static FileBuffer copyBuffer(FileBuffer buffer)
+ * \brief Duplicates a buffer, this way the stages working in place don't modify the prepared data
+ * \param buffer Copied buffer
+ * \return New buffer containing the same characters
+ */
+
+static FileBuffer copyBuffer(FileBuffer buffer)
+{
+    FileBuffer copy;
+    copy.size = buffer.size;
+    copy.text = (unsigned char*) malloc(copy.size*sizeof(unsigned char));
+    TESTALLOC(copy.text);
+    memcpy(copy.text, buffer.text, copy.size);
+    return copy;
+}
+
+/**
+ * \fn static long long sizeOfNamedFile(const char* fileName)
+ * \brief Gives the size of a file of the working directory
+ * \param fileName Name of the file
+ * \return Size of the file
+ */
+
+static long long sizeOfNamedFile(const char* fileName)
+{
+    FILE* file = fopen(fileName, "rb");
+    TESTFOPEN(file);
+    long long size = seekSizeOfFile(file);
+    FCLOSE(file);
+    return size;
+}
+
+/**
+ * \fn static int sameAsFile(FileBuffer expected, FILE* file)
+ * \brief Checks that a file contains exactly the characters of a buffer
+ * \param expected Expected content
+ * \param file File checked
+ * \return 1 if the contents are the same, 0 otherwise
+ */
+
+static int sameAsFile(FileBuffer expected, FILE* file)
+{
+    if(seekSizeOfFile(file)!=expected.size)
+        return 0;
+    FileBuffer content = fileToBuffer(file);
+    int same = !memcmp(content.text, expected.text, expected.size);
+    free(content.text);
+    return same;
+}
+
+/**
+ * \fn static HuffmanTableCell* benchCreateTable(FileBuffer buffer, int* sizeHuffmanTable, long counts[N_ASCII], unsigned char* tree, int* sizeTree)
+ * \brief Counts the occurrences, creates the Huffman table of a buffer and saves its tree, like compressBlock. The table is allocated in the arena of the context
+ * \param buffer Buffer coded with the table
+ * \param sizeHuffmanTable Size of the returned table
+ * \param counts Number of occurrences of each character, filled here
+ * \param tree Memory in which the tree is saved (TREE_MAX_SIZE bytes)
+ * \param sizeTree Size of the saved tree
+ * \return Huffman table
+ */
+
+static HuffmanTableCell* benchCreateTable(FileBuffer buffer, int* sizeHuffmanTable, long counts[N_ASCII], unsigned char* tree, int* sizeTree)
+{
+    int sizeOccurrencesArray=0;
+    HuffmanTreePtr huffmanTree=NULL;
+    countOccurrences(buffer, counts);
+    OccurrencesArrayCell* occurrencesArray = createOccurrencesArray(&(context.arena), counts, &sizeOccurrencesArray);
+    HuffmanTableCell* huffmanTable = createHuffmanTable(&(context.arena), occurrencesArray, sizeOccurrencesArray, sizeHuffmanTable, &huffmanTree);
+    *sizeTree = saveTree(huffmanTree, *sizeHuffmanTable, tree);
+    return huffmanTable;
+}
+
+/**
+ * \fn static void writeNamedFile(const char* fileName, FileBuffer buffer)
+ * \brief Writes a buffer in a file of the working directory
+ * \param fileName Name of the file
+ * \param buffer Content of the file
+ */
+
+static void writeNamedFile(const char* fileName, FileBuffer buffer)
+{
+    FILE* file = fopen(fileName, "wb");
+    TESTFOPEN(file);
+    fwrite(buffer.text, sizeof(unsigned char), buffer.size, file);
+    FCLOSE(file);
+}
+
+/**
+ * \fn static void encodeWithPipeline(long long sizeFileIn)
+ * \brief Compresses original.raw in compressed.bin with compressStream, like compressMain
+ * \param sizeFileIn Size of original.raw, given to compressStream like compressMain does
+ */
+
+static void encodeWithPipeline(long long sizeFileIn)
+{
+    FILE* fileIn = fopen("original.raw", "rb");
+    TESTFOPEN(fileIn);
+    FILE* fileOut = fopen("compressed.bin", "wb");
+    TESTFOPEN(fileOut);
+    compressStream(fileIn, sizeFileIn, fileOut, &context);
+    FCLOSE(fileOut);
+    FCLOSE(fileIn);
+}
+
+/**
+ * \fn static void decodeWithPipeline(BenchInput* input, BenchRunResult* result)
+ * \brief Decompresses compressed.bin with decompressStream, like decompressMain, and checks that the original buffer is obtained
+ * \param input Prepared data
+ * \param result Result of the run
+ */
+
+static void decodeWithPipeline(BenchInput* input, BenchRunResult* result)
+{
+    FILE* fileIn = fopen("compressed.bin", "rb");
+    TESTFOPEN(fileIn);
+    FILE* fileOut = tmpfile();
+    TESTFOPEN(fileOut);
+
+    long long start = getTimeNs();
+    decompressStream(fileIn, -1, fileOut, &context);
+    fflush(fileOut);
+    result->seconds = (getTimeNs()-start)*1e-9;
+
+    result->bytesOut = seekSizeOfFile(fileOut);
+    result->valid = sameAsFile(input->original, fileOut);
+    FCLOSE(fileOut);
+    FCLOSE(fileIn);
+}
+
+
+
+// Preparation of the stages
+
+static void prepareHuffmanOnly(BenchInput* input)
+{
+    // input->buffer contains the saved tree followed by the Huffman coding of the original buffer
+    int sizeHuffmanTable=0;
+    int sizeTree=0;
+    long counts[N_ASCII];
+    unsigned char tree[TREE_MAX_SIZE];
+    HuffmanTableCell* huffmanTable = benchCreateTable(input->original, &sizeHuffmanTable, counts, tree, &sizeTree);
+    long long sizeCoded = (huffmanTableBits(huffmanTable, sizeHuffmanTable, counts)+7)/8;
+    input->buffer.text = (unsigned char*) malloc(sizeTree+sizeCoded+BIT_IO_SLACK);
+    TESTALLOC(input->buffer.text);
+    memcpy(input->buffer.text, tree, sizeTree);
+    input->buffer.size = sizeTree;
+    compress(input->original, &(input->buffer), huffmanTable, sizeHuffmanTable, &(context.scratch));
+    resetArena(&(context.arena));
+}
+
+static void prepareTansOnly(BenchInput* input)
+{
+    // input->buffer contains the normalized occurrences followed by the tANS coding of the original buffer
+    long counts[N_ASCII];
+    uint16_t normalized[N_ASCII];
+    TansTable* table = (TansTable*) arenaAlloc(&(context.arena), sizeof(TansTable));
+    countOccurrences(input->original, counts);
+    normalizeCounts(counts, normalized);
+    createTansTable(normalized, table);
+    input->buffer.text = (unsigned char*) malloc(TANS_COUNTS_MAX_SIZE+((size_t) input->original.size*TANS_TABLE_LOG+7)/8+2+BIT_IO_SLACK);
+    TESTALLOC(input->buffer.text);
+    input->buffer.size = saveTansCounts(normalized, input->buffer.text);
+    tansEncodeSymbols(input->original, &(input->buffer), table, (uint16_t*) scratchGet(&(context.scratch), SCRATCH_TANS_BITS, input->original.size*sizeof(uint16_t)), (size_t) -1);
+    resetArena(&(context.arena));
+}
+
+static void prepareOriginalFile(BenchInput* input)
+{
+    writeNamedFile("original.raw", input->original);
+}
+
+static void preparePipeline(BenchInput* input)
+{
+    prepareOriginalFile(input);
+    encodeWithPipeline(input->original.size);
+}
+
+static void prepareBurrowsWheelerDecode(BenchInput* input)
+{
+    input->buffer = copyBuffer(input->original);
+    input->indexBW = burrowsWheeler(&(input->buffer), &(context.scratch), context.nbThreads, 0);
+}
+
+static int benchLz77Encode(FileBuffer buffer, unsigned char* out)
+{
+    // LZ77 with the default parameters of --lz77, the pipeline stages keep compressing without it. Its lengths are coded for blocks only
+    if(buffer.size>BLOCK_SIZE)
+        return 0;
+    context.lz.window = LZ77_DEFAULT_WINDOW;
+    int size = lz77Encode(buffer, out, buffer.size, &context);
+    context.lz.window = 0;
+    return size;
+}
+
+static void prepareLz77Decode(BenchInput* input)
+{
+    input->buffer.text = (unsigned char*) malloc((size_t) input->original.size+BIT_IO_SLACK);
+    TESTALLOC(input->buffer.text);
+    input->buffer.size = benchLz77Encode(input->original, input->buffer.text);
+}
+
+static int benchBigramEncode(FileBuffer buffer, unsigned char* out)
+{
+    // The bigram mode is kept even when it isn't smaller, so that its decoding is always measured. Its codes are at most BIGRAM_TABLE_BITS bits per character
+    int size = bigramEncode(buffer, out, BIGRAM_HEADER_MAX_SIZE+(int) (((long long) buffer.size*BIGRAM_TABLE_BITS+7)/8), &context);
+    resetArena(&(context.arena));
+    return size;
+}
+
+static void prepareBigramDecode(BenchInput* input)
+{
+    input->buffer.text = (unsigned char*) malloc(BIGRAM_HEADER_MAX_SIZE+((size_t) input->original.size*BIGRAM_TABLE_BITS+7)/8+BIT_IO_SLACK);
+    TESTALLOC(input->buffer.text);
+    input->buffer.size = benchBigramEncode(input->original, input->buffer.text);
+}
+
+static void prepareRleDecode(BenchInput* input)
+{
+    // Run length encoding through the registry of the transforms, input->buffer is empty if it was skipped
+    unsigned char params[TRANSFORM_MAX_PARAMS];
+    FileBuffer encoded = input->original;
+    if(getTransformStage(TRANSFORM_RLE)->encode(&encoded, params, SCRATCH_TRANSFORM_A, 0, &context)==TRANSFORM_SKIPPED)
+        encoded.size = 0;
+    input->buffer = copyBuffer(encoded);
+}
+
+static void prepareMoveToFrontDecode(BenchInput* input)
+{
+    input->buffer = copyBuffer(input->original);
+    moveToFrontEncode(&(input->buffer));
+}
+
+
+
+// Stages
+
+static void runHistogram(BenchInput* input, BenchRunResult* result)
+{
+    long counts[N_ASCII];
+    long long start = getTimeNs();
+    countOccurrences(input->buffer, counts);
+    result->seconds = (getTimeNs()-start)*1e-9;
+}
+
+static void runAnalysis(BenchInput* input, BenchRunResult* result)
+{
+    BlockAnalysis analysis;
+    long long start = getTimeNs();
+    analyseBlock(&(context.arena), input->buffer, 1, context.lz.window, &analysis);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    resetArena(&(context.arena));
+}
+
+static void runTable(BenchInput* input, BenchRunResult* result)
+{
+    int sizeHuffmanTable=0;
+    int sizeTree=0;
+    long counts[N_ASCII];
+    unsigned char tree[TREE_MAX_SIZE];
+    long long start = getTimeNs();
+    benchCreateTable(input->buffer, &sizeHuffmanTable, counts, tree, &sizeTree);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    resetArena(&(context.arena));
+    result->bytesOut = sizeTree;
+}
+
+static void runCompress(BenchInput* input, BenchRunResult* result)
+{
+    int sizeHuffmanTable=0;
+    int sizeTree=0;
+    long counts[N_ASCII];
+    unsigned char tree[TREE_MAX_SIZE];
+    FileBuffer bufferOut;
+    HuffmanTableCell* huffmanTable = benchCreateTable(input->buffer, &sizeHuffmanTable, counts, tree, &sizeTree);
+    bufferOut.text = (unsigned char*) scratchGet(&(context.scratch), SCRATCH_CODED, (huffmanTableBits(huffmanTable, sizeHuffmanTable, counts)+7)/8+BIT_IO_SLACK);
+    bufferOut.size = 0;
+    long long start = getTimeNs();
+    compress(input->buffer, &bufferOut, huffmanTable, sizeHuffmanTable, &(context.scratch));
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = bufferOut.size + sizeTree;
+    resetArena(&(context.arena));
+}
+
+static void runDecompress(BenchInput* input, BenchRunResult* result)
+{
+    int sizeTree=0;
+    FileBuffer bufferCoded;
+    FileBuffer bufferText;
+    HuffmanTreePtr huffmanTree = loadTree(&(context.arena), input->buffer, &sizeTree);
+    bufferCoded.text = input->buffer.text+sizeTree;
+    bufferCoded.size = input->buffer.size-sizeTree;
+    bufferText.text = (unsigned char*) scratchGet(&(context.scratch), SCRATCH_OUTPUT, input->original.size);
+    long long start = getTimeNs();
+    decompress(bufferCoded, &bufferText, huffmanTree, input->original.size);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = bufferText.size;
+    result->valid = bufferText.size==input->original.size && !memcmp(bufferText.text, input->original.text, bufferText.size);
+    resetArena(&(context.arena));
+}
+
+static void runTans(BenchInput* input, BenchRunResult* result)
+{
+    long counts[N_ASCII];
+    uint16_t normalized[N_ASCII];
+    unsigned char savedCounts[TANS_COUNTS_MAX_SIZE];
+    FileBuffer bufferOut;
+    TansTable* table = (TansTable*) arenaAlloc(&(context.arena), sizeof(TansTable));
+    countOccurrences(input->buffer, counts);
+    normalizeCounts(counts, normalized);
+    createTansTable(normalized, table);
+    uint16_t* bits = (uint16_t*) scratchGet(&(context.scratch), SCRATCH_TANS_BITS, input->buffer.size*sizeof(uint16_t));
+    bufferOut.text = (unsigned char*) scratchGet(&(context.scratch), SCRATCH_CODED, ((size_t) input->buffer.size*TANS_TABLE_LOG+7)/8+2+BIT_IO_SLACK);
+    bufferOut.size = 0;
+    long long start = getTimeNs();
+    tansEncodeSymbols(input->buffer, &bufferOut, table, bits, (size_t) -1);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = bufferOut.size + saveTansCounts(normalized, savedCounts);
+    resetArena(&(context.arena));
+}
+
+static void runTansDecode(BenchInput* input, BenchRunResult* result)
+{
+    uint16_t normalized[N_ASCII];
+    FileBuffer bufferCoded;
+    FileBuffer bufferText;
+    TansTable* table = (TansTable*) arenaAlloc(&(context.arena), sizeof(TansTable));
+    int sizeCounts = loadTansCounts(input->buffer, normalized);
+    createTansTable(normalized, table);
+    bufferCoded.text = input->buffer.text+sizeCounts;
+    bufferCoded.size = input->buffer.size-sizeCounts;
+    bufferText.text = (unsigned char*) scratchGet(&(context.scratch), SCRATCH_OUTPUT, input->original.size);
+    long long start = getTimeNs();
+    tansDecodeSymbols(bufferCoded, &bufferText, table, input->original.size);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = bufferText.size;
+    result->valid = bufferText.size==input->original.size && !memcmp(bufferText.text, input->original.text, bufferText.size);
+    resetArena(&(context.arena));
+}
+
+static void runBurrowsWheeler(BenchInput* input, BenchRunResult* result)
+{
+    FileBuffer buffer = copyBuffer(input->buffer);
+    long long start = getTimeNs();
+    burrowsWheeler(&buffer, &(context.scratch), context.nbThreads, 0);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = buffer.size;
+    free(buffer.text);
+}
+
+static void runBurrowsWheelerDecode(BenchInput* input, BenchRunResult* result)
+{
+    FILE* fileOut = tmpfile();
+    AsyncFile asyncOut;
+    TESTFOPEN(fileOut);
+    long long start = getTimeNs();
+    asyncOpen(&asyncOut, fileOut, 1, 0, &(context.scratch));
+    burrowsWheelerDecode(input->indexBW, input->buffer, &asyncOut, &(context.scratch));
+    asyncClose(&asyncOut);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = seekSizeOfFile(fileOut);
+    result->valid = sameAsFile(input->original, fileOut);
+    FCLOSE(fileOut);
+}
+
+static void runLz77(BenchInput* input, BenchRunResult* result)
+{
+    unsigned char* out = (unsigned char*) scratchGet(&(context.scratch), SCRATCH_CODED, (size_t) input->buffer.size+BIT_IO_SLACK);
+    long long start = getTimeNs();
+    int size = benchLz77Encode(input->buffer, out);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = (size>0) ? size : input->buffer.size; // Not smaller : the block would be stored
+}
+
+static void runLz77Decode(BenchInput* input, BenchRunResult* result)
+{
+    FileBuffer bufferText;
+    if(input->buffer.size==0){ // The element isn't smaller with LZ77
+        result->skipped = 1;
+        return;
+    }
+    bufferText.text = (unsigned char*) scratchGet(&(context.scratch), SCRATCH_OUTPUT, input->original.size);
+    long long start = getTimeNs();
+    lz77Decode(input->buffer, &bufferText, input->original.size, &context);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = bufferText.size;
+    result->valid = bufferText.size==input->original.size && !memcmp(bufferText.text, input->original.text, bufferText.size);
+}
+
+static void runBigram(BenchInput* input, BenchRunResult* result)
+{
+    unsigned char* out = (unsigned char*) scratchGet(&(context.scratch), SCRATCH_CODED, BIGRAM_HEADER_MAX_SIZE+((size_t) input->buffer.size*BIGRAM_TABLE_BITS+7)/8+BIT_IO_SLACK);
+    long long start = getTimeNs();
+    int size = benchBigramEncode(input->buffer, out);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = (size>0) ? size : input->buffer.size; // No pair frequent enough : the block would be coded otherwise
+}
+
+static void runBigramDecode(BenchInput* input, BenchRunResult* result)
+{
+    FileBuffer bufferText;
+    if(input->buffer.size==0){ // The element has no pair frequent enough
+        result->skipped = 1;
+        return;
+    }
+    bufferText.text = (unsigned char*) scratchGet(&(context.scratch), SCRATCH_OUTPUT, input->original.size);
+    long long start = getTimeNs();
+    bigramDecode(input->buffer, &bufferText, input->original.size, &context);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = bufferText.size;
+    result->valid = bufferText.size==input->original.size && !memcmp(bufferText.text, input->original.text, bufferText.size);
+}
+
+static void runRle(BenchInput* input, BenchRunResult* result)
+{
+    unsigned char params[TRANSFORM_MAX_PARAMS];
+    FileBuffer buffer = input->buffer; // Written in SCRATCH_TRANSFORM_A, the input isn't modified
+    long long start = getTimeNs();
+    getTransformStage(TRANSFORM_RLE)->encode(&buffer, params, SCRATCH_TRANSFORM_A, 0, &context);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = buffer.size; // Skipped : the size doesn't change
+}
+
+static void runRleDecode(BenchInput* input, BenchRunResult* result)
+{
+    FileBuffer buffer = input->buffer;
+    if(buffer.size==0){ // The run length encoding was skipped
+        result->skipped = 1;
+        return;
+    }
+    long long start = getTimeNs();
+    getTransformStage(TRANSFORM_RLE)->decode(&buffer, input->original.size, NULL, 0, SCRATCH_TRANSFORM_B, NULL, &context);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = buffer.size;
+    result->valid = buffer.size==input->original.size && !memcmp(buffer.text, input->original.text, buffer.size);
+}
+
+static void runMoveToFrontEncode(BenchInput* input, BenchRunResult* result)
+{
+    FileBuffer buffer = copyBuffer(input->buffer);
+    long long start = getTimeNs();
+    moveToFrontEncode(&buffer);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = buffer.size;
+    free(buffer.text);
+}
+
+static void runMoveToFrontDecode(BenchInput* input, BenchRunResult* result)
+{
+    FileBuffer buffer = copyBuffer(input->buffer);
+    long long start = getTimeNs();
+    moveToFrontDecode(&buffer);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = buffer.size;
+    result->valid = buffer.size==input->original.size && !memcmp(buffer.text, input->original.text, buffer.size);
+    free(buffer.text);
+}
+
+static void runPipelineCompress(BenchInput* input, BenchRunResult* result)
+{
+    long long start = getTimeNs();
+    encodeWithPipeline(input->original.size);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = sizeOfNamedFile("compressed.bin");
+}
+
+static void runPipelineDecompress(BenchInput* input, BenchRunResult* result)
+{
+    decodeWithPipeline(input, result);
+}
+
+static void runPipelineLz77(BenchInput* input, BenchRunResult* result)
+{
+    // Same as pipeline-compress with --lz77, then the compressed file is decompressed to check it
+    BenchRunResult check;
+    context.lz.window = LZ77_DEFAULT_WINDOW;
+    long long start = getTimeNs();
+    encodeWithPipeline(input->original.size);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    context.lz.window = 0;
+    result->bytesOut = sizeOfNamedFile("compressed.bin");
+    decodeWithPipeline(input, &check);
+    result->valid = check.valid;
+}
+
+static void runPipelineLowMemory(BenchInput* input, BenchRunResult* result)
+{
+    // Same as pipeline-compress with --max-memory, then the compressed file is decompressed with the same limit to check it. The buffers are freed before each one, so that only its own buffers are counted like in a run of huffman
+    BenchRunResult check;
+    freeScratchPool(&(context.scratch));
+    setScratchLimit(&(context.scratch), BENCH_LOW_MEMORY);
+    long long start = getTimeNs();
+    encodeWithPipeline(input->original.size);
+    result->seconds = (getTimeNs()-start)*1e-9;
+    result->bytesOut = sizeOfNamedFile("compressed.bin");
+    freeScratchPool(&(context.scratch));
+    decodeWithPipeline(input, &check);
+    result->valid = check.valid;
+    setScratchLimit(&(context.scratch), 0);
+}
+
+
+static const BenchStage stages[] = {
+    {"histogram", NULL, runHistogram, 0, 0},
+    {"analysis", NULL, runAnalysis, 0, 0},
+    {"table", NULL, runTable, 0, 0},
+    {"compress", NULL, runCompress, 0, 1},
+    {"decompress", prepareHuffmanOnly, runDecompress, 0, 0},
+    {"tans", NULL, runTans, 0, 1},
+    {"tans-decode", prepareTansOnly, runTansDecode, 0, 0},
+    {"bigram", NULL, runBigram, 0, 1},
+    {"bigram-decode", prepareBigramDecode, runBigramDecode, 0, 0},
+    {"bwt", NULL, runBurrowsWheeler, 1, 0},
+    {"bwt-decode", prepareBurrowsWheelerDecode, runBurrowsWheelerDecode, 1, 0},
+    {"lz77", NULL, runLz77, 1, 1},
+    {"lz77-decode", prepareLz77Decode, runLz77Decode, 1, 0},
+    {"rle", NULL, runRle, 0, 1},
+    {"rle-decode", prepareRleDecode, runRleDecode, 0, 0},
+    {"mtf", NULL, runMoveToFrontEncode, 0, 0},
+    {"mtf-decode", prepareMoveToFrontDecode, runMoveToFrontDecode, 0, 0},
+    {"pipeline-compress", prepareOriginalFile, runPipelineCompress, 0, 1},
+    {"pipeline-decompress", preparePipeline, runPipelineDecompress, 0, 0},
+    {"pipeline-lz77", prepareOriginalFile, runPipelineLz77, 0, 1},
+    {"pipeline-lowmem", prepareOriginalFile, runPipelineLowMemory, 0, 1}
+};
+
+#define N_STAGES ((int)(sizeof(stages)/sizeof(stages[0])))
+
+
+
+// Corpus
+
+/**
+ * \fn static unsigned int nextRandom(unsigned int* state)
+ * \brief Pseudo random generator (xorshift), always gives the same sequence so that the generated corpus doesn't change between runs
+ * \param state State of the generator
+ * \return Next pseudo random value
+ */
+
+static unsigned int nextRandom(unsigned int* state)
+{
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * \fn static FileBuffer generateText(long size)
+ * \brief Generates a text made of words taken from a small vocabulary
+ * \param size Size of the generated buffer
+ * \return Generated buffer
+ */
+
+static FileBuffer generateText(long size)
+{
+    static const char* words[] = {"lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit", "sed", "do",
+        "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore", "magna", "aliqua", "enim", "ad", "minim", "veniam",
+        "quis", "nostrud", "exercitation", "ullamco", "laboris", "nisi", "aliquip", "ex", "ea", "commodo", "consequat"};
+    int nbWords = sizeof(words)/sizeof(words[0]);
+    unsigned int state = 0x12345678;
+    FileBuffer buffer;
+    buffer.size = size;
+    buffer.text = (unsigned char*) malloc(size*sizeof(unsigned char));
+    TESTALLOC(buffer.text);
+
+    long pos=0;
+    while(pos<size){
+        const char* word = words[nextRandom(&state)%nbWords];
+        while(*word!='\0' && pos<size)
+            buffer.text[pos++] = *(word++);
+        if(pos<size)
+            buffer.text[pos++] = (nextRandom(&state)%12==0) ? '\n' : ' ';
+    }
+    return buffer;
+}
+
+/**
+ * \fn static FileBuffer generateRandom(long size)
+ * \brief Generates uniformly distributed bytes (incompressible data)
+ * \param size Size of the generated buffer
+ * \return Generated buffer
+ */
+
+static FileBuffer generateRandom(long size)
+{
+    unsigned int state = 0x9E3779B9;
+    FileBuffer buffer;
+    buffer.size = size;
+    buffer.text = (unsigned char*) malloc(size*sizeof(unsigned char));
+    TESTALLOC(buffer.text);
+    for(long i=0; i<size; i++)
+        buffer.text[i] = nextRandom(&state)>>24;
+    return buffer;
+}
+
+/**
+ * \fn static FileBuffer generateRepetitive(long size)
+ * \brief Generates lines of log that are almost identical (only a counter and a few fields change)
+ * \param size Size of the generated buffer
+ * \return Generated buffer
+ */
+
+static FileBuffer generateRepetitive(long size)
+{
+    static const char* status[] = {"200", "200", "200", "304", "404"};
+    unsigned int state = 0xCAFEBABE;
+    char line[128];
+    FileBuffer buffer;
+    buffer.size = size;
+    buffer.text = (unsigned char*) malloc(size*sizeof(unsigned char));
+    TESTALLOC(buffer.text);
+
+    long pos=0;
+    long id=0;
+    while(pos<size){
+        int length = sprintf(line, "2021-06-01 12:%02ld:%02ld INFO GET /index.html id=%ld status=%s\n", (id/60)%60, id%60, id, status[nextRandom(&state)%5]);
+        for(int i=0; i<length && pos<size; i++)
+            buffer.text[pos++] = line[i];
+        id++;
+    }
+    return buffer;
+}
+
+/**
+ * \fn static FileBuffer generateRepeatedRandom(long size)
+ * \brief Generates a block of 1000 random bytes repeated : each part is incompressible, but the whole buffer is made of long repetitions
+ * \param size Size of the generated buffer
+ * \return Generated buffer
+ */
+
+static FileBuffer generateRepeatedRandom(long size)
+{
+    unsigned int state = 0x2545F491;
+    FileBuffer buffer;
+    buffer.size = size;
+    buffer.text = (unsigned char*) malloc(size*sizeof(unsigned char));
+    TESTALLOC(buffer.text);
+    for(long i=0; i<size; i++)
+        buffer.text[i] = (i<1000) ? nextRandom(&state)>>24 : buffer.text[i-1000];
+    return buffer;
+}
+
+/**
+ * \fn static long parseSize(const char* text)
+ * \brief Reads a size that can end with K or M (ex: 16K)
+ * \param text Text read
+ * \return Size in bytes, or -1 if the text isn't a size
+ */
+
+static long parseSize(const char* text)
+{
+    char* end = NULL;
+    long size = strtol(text, &end, 10);
+    if(end==text || size<=0)
+        return -1;
+    switch(*end){
+        case 'k': case 'K': size *= 1024; end++; break;
+        case 'm': case 'M': size *= 1024*1024; end++; break;
+        default: break;
+    }
+    if(*end!='\0' && *end!=',')
+        return -1;
+    return size;
+}
+
+/**
+ * \fn static int addCorpusFile(BenchCorpusItem* corpus, int sizeCorpus, const char* fileName)
+ * \brief Adds a file to the corpus if it can be read
+ * \param corpus Corpus filled
+ * \param sizeCorpus Number of elements in the corpus
+ * \param fileName Name of the file added
+ * \return New number of elements in the corpus
+ */
+
+static int addCorpusFile(BenchCorpusItem* corpus, int sizeCorpus, const char* fileName)
+{
+    FILE* file = fopen(fileName, "rb");
+    if(file==NULL){
+        fprintf(stderr, "WARNING : Cannot open %s, it's not included in the corpus\n", fileName);
+        return sizeCorpus;
+    }
+    const char* baseName = strrchr(fileName, '/');
+    baseName = (baseName==NULL) ? fileName : baseName+1;
+    snprintf(corpus[sizeCorpus].name, sizeof(corpus[sizeCorpus].name), "%s", baseName);
+    corpus[sizeCorpus].buffer = fileToBuffer(file);
+    FCLOSE(file);
+    return sizeCorpus+1;
+}
+
+/**
+ * \fn static int compareDouble(const void* a, const void* b)
+ * \brief Comparison function used by qsort to sort the durations
+ */
+
+static int compareDouble(const void* a, const void* b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x>y) - (x<y);
+}
+
+/**
+ * \fn static void benchStage(const BenchStage* stage, BenchCorpusItem* item, int nbRuns)
+ * \brief Runs a stage several times on an element of the corpus and writes a line of the report with the median time, or "skip" if the element isn't given to the stage (--bwt-max) or it has nothing to run on it
+ * \param stage Measured stage
+ * \param item Element of the corpus
+ * \param nbRuns Number of runs
+ */
+
+static void benchStage(const BenchStage* stage, BenchCorpusItem* item, int nbRuns)
+{
+    double durations[BENCH_MAX_RUNS];
+    BenchInput input;
+    BenchRunResult result;
+    int valid=1;
+    long bytesOut=0;
+    int skipped = stage->usesBW && item->buffer.size>bwtMax;
+
+    input.original = item->buffer;
+    input.buffer = item->buffer;
+    input.indexBW = -1;
+    resetPeakMemory();
+    if(!skipped && stage->prepare!=NULL)
+        stage->prepare(&input);
+
+    for(int i=0; i<nbRuns && !skipped; i++){
+        result.seconds = 0;
+        result.bytesOut = 0;
+        result.valid = 1;
+        result.skipped = 0;
+        stage->run(&input, &result);
+        durations[i] = result.seconds;
+        bytesOut = result.bytesOut;
+        valid = valid && result.valid;
+        skipped = result.skipped;
+    }
+    long peak = readPeakMemory();
+    if(input.buffer.text!=item->buffer.text)
+        free(input.buffer.text);
+    if(skipped){ // Larger than --bwt-max, or nothing to decode
+        printf("%-20s %10ld %-20s %5s %12s %10s %8s %12s %s\n", item->name, (long) item->buffer.size, stage->name, "-", "-", "-", "-", "-", "skip");
+        return;
+    }
+
+    qsort(durations, nbRuns, sizeof(double), compareDouble);
+    double median = (nbRuns%2) ? durations[nbRuns/2] : (durations[nbRuns/2-1]+durations[nbRuns/2])/2;
+    double throughput = (median>0) ? item->buffer.size/median/1e6 : 0;
+
+    printf("%-20s %10ld %-20s %5d %12.3f %10.2f ", item->name, (long) item->buffer.size, stage->name, nbRuns, median*1000, throughput);
+    if(stage->hasRatio && bytesOut>0)
+        printf("%8.3f ", ((double) item->buffer.size)/bytesOut);
+    else
+        printf("%8s ", "-");
+    printf("%12ld %s\n", peak, valid ? "ok" : "FAIL");
+    fflush(stdout);
+}
+
+/**
+ * \fn static void printBenchUsage()
+ * \brief Displays the options of the benchmark
+ */
+
+static void printBenchUsage()
+{
+    fprintf(stderr, "Usage : huffmanBench [--runs=N] [--sizes=16K,1M] [--bwt-max=N] [--corpus=DIR] [--stage=NAME] [--only=CORPUS] [--kernel=baseline|bmi2] [--threads=N]\n");
+    fprintf(stderr, "  --runs     Number of runs of each stage, the median is displayed (default 5)\n");
+    fprintf(stderr, "  --sizes    Sizes of the generated text, random, repetitive and repeated random data (default 16K,1M)\n");
+    fprintf(stderr, "  --bwt-max  Elements larger than this are not given to the Burrows Wheeler and LZ77 stages (default : the size of a block)\n");
+    fprintf(stderr, "  --corpus   Folder containing image.jpg and image2.jpg (default tests)\n");
+    fprintf(stderr, "  --stage    Only measures the given stage\n");
+    fprintf(stderr, "  --only     Only measures the elements of the corpus whose name starts with the given text\n");
+    fprintf(stderr, "  --kernel   Version of the Huffman coding and decoding loops (default : the fastest one supported by the processor)\n");
+    fprintf(stderr, "  --threads  Number of threads of the stages that can use several (default 1)\n");
+}
+
+
+/**
+ * \fn int main(int argc, char *argv[])
+ * \brief Builds the corpus, then measures each stage on each element of the corpus. The report contains one line per stage and element : median time, throughput (MB/s of input), ratio (original size / compressed size) and peak resident memory
+ */
+
+int main(int argc, char *argv[])
+{
+    BenchCorpusItem corpus[BENCH_MAX_CORPUS];
+    int sizeCorpus=0;
+    int nbRuns=5;
+    const char* sizes="16K,1M";
+    const char* corpusDir="tests";
+    const char* onlyStage=NULL;
+    const char* onlyCorpus=NULL;
+    char fileName[FILENAME_MAX];
+    char workDir[] = "/tmp/huffmanBench.XXXXXX";
+    int nbThreads=1;
+
+    for(int i=1; i<argc; i++){
+        if(!strncmp(argv[i], "--runs=", 7))
+            nbRuns = atoi(argv[i]+7);
+        else if(!strncmp(argv[i], "--sizes=", 8))
+            sizes = argv[i]+8;
+        else if(!strncmp(argv[i], "--bwt-max=", 10))
+            bwtMax = parseSize(argv[i]+10);
+        else if(!strncmp(argv[i], "--corpus=", 9))
+            corpusDir = argv[i]+9;
+        else if(!strncmp(argv[i], "--stage=", 8))
+            onlyStage = argv[i]+8;
+        else if(!strncmp(argv[i], "--only=", 7))
+            onlyCorpus = argv[i]+7;
+        else if(!strcmp(argv[i], "--kernel=baseline"))
+            selectBitKernel(BIT_KERNEL_BASELINE);
+        else if(!strcmp(argv[i], "--kernel=bmi2"))
+            selectBitKernel(BIT_KERNEL_BMI2);
+        else if(!strncmp(argv[i], "--threads=", 10))
+            nbThreads = atoi(argv[i]+10);
+        else{
+            printBenchUsage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(nbRuns<1 || nbRuns>BENCH_MAX_RUNS || bwtMax<0 || nbThreads<1){
+        printBenchUsage();
+        exit(EXIT_FAILURE);
+    }
+
+    // Corpus
+    snprintf(fileName, sizeof(fileName), "%s/image.jpg", corpusDir);
+    sizeCorpus = addCorpusFile(corpus, sizeCorpus, fileName);
+    snprintf(fileName, sizeof(fileName), "%s/image2.jpg", corpusDir);
+    sizeCorpus = addCorpusFile(corpus, sizeCorpus, fileName);
+
+    const char* posSizes = sizes;
+    while(*posSizes!='\0' && sizeCorpus+4<=BENCH_MAX_CORPUS){
+        long size = parseSize(posSizes);
+        if(size<0){
+            printBenchUsage();
+            exit(EXIT_FAILURE);
+        }
+        const char* label = posSizes;
+        int sizeLabel = strcspn(posSizes, ",");
+        snprintf(corpus[sizeCorpus].name, sizeof(corpus[sizeCorpus].name), "text-%.*s", sizeLabel, label);
+        corpus[sizeCorpus++].buffer = generateText(size);
+        snprintf(corpus[sizeCorpus].name, sizeof(corpus[sizeCorpus].name), "random-%.*s", sizeLabel, label);
+        corpus[sizeCorpus++].buffer = generateRandom(size);
+        snprintf(corpus[sizeCorpus].name, sizeof(corpus[sizeCorpus].name), "repetitive-%.*s", sizeLabel, label);
+        corpus[sizeCorpus++].buffer = generateRepetitive(size);
+        snprintf(corpus[sizeCorpus].name, sizeof(corpus[sizeCorpus].name), "repeated-random-%.*s", sizeLabel, label);
+        corpus[sizeCorpus++].buffer = generateRepeatedRandom(size);
+        posSizes += sizeLabel;
+        if(*posSizes==',')
+            posSizes++;
+    }
+
+    // The pipeline stages use files, they are created in a temporary folder
+    setVerbose(0);
+    initPipelineContext(&context, 0);
+    context.nbThreads = nbThreads;
+    #if __linux__
+    if(mkdtemp(workDir)==NULL || chdir(workDir)!=0){
+        fprintf(stderr, "ERROR : Cannot create the temporary folder\n");
+        exit(EXIT_FAILURE);
+    }
+    #endif
+
+    printf("Huffman loops : %s\n", bitKernelName());
+    printf("%-20s %10s %-20s %5s %12s %10s %8s %12s %s\n", "corpus", "bytes", "stage", "runs", "median_ms", "MB/s", "ratio", "peak_rss_kb", "check");
+    for(int i=0; i<sizeCorpus; i++){
+        if(onlyCorpus!=NULL && strncmp(corpus[i].name, onlyCorpus, strlen(onlyCorpus)))
+            continue;
+        for(int j=0; j<N_STAGES; j++){
+            if(onlyStage==NULL || !strcmp(onlyStage, stages[j].name))
+                benchStage(&stages[j], &corpus[i], nbRuns);
+        }
+    }
+
+    for(int i=0; i<sizeCorpus; i++)
+        free(corpus[i].buffer.text);
+    freePipelineContext(&context);
+    #if __linux__
+    remove("original.raw");
+    remove("compressed.bin");
+    if(chdir("/")==0)
+        rmdir(workDir);
+    #endif
+    return 0;
+}
@@ -15,49 +15,105 @@ void getFileName(char * fileName);
 void bufferToFile(FileBuffer buffer, FILE* file);
 FileBuffer getPortionOfFileToBuffer(FILE* file, int sizeBuff);
 FileBuffer fileToBuffer(FILE* file);
-long readNumberLine(FILE* file, long line);
+long long readNumberLine(FILE* file, long line);
 void wordWrapBuffer(FileBuffer buffer, int* posIn);
 void wordWrapFile(FILE* file);
-int seekSizeOfFile(FILE* file);
-HuffmanTreeNode* createNodeHuff(unsigned char c, HuffmanTreeNode* leftNode, HuffmanTreeNode* rightNode, HuffmanTreeNode* parentNode);
+int fileSeek(FILE* file, long long offset, int origin);
+long long fileTell(FILE* file);
+long long seekSizeOfFile(FILE* file);
+void setPartialOutput(const char* fileName, FILE* file);
+int numberOfProcessors();
+HuffmanTreeNode* createNodeHuff(Arena* arena, unsigned char c, HuffmanTreeNode* leftNode, HuffmanTreeNode* rightNode, HuffmanTreeNode* parentNode);
+void writeNumber(unsigned char* out, unsigned long long value, int nbBytes);
+unsigned long long readNumber(const unsigned char* in, int nbBytes);
 
 
 
 //HuffmanTableCreation.c
-OccurrencesArrayCell* fillOccurrencesArray(FileBuffer buffer, int* sizeOccurrencesArray);
-PtrlistCode createNode(unsigned char c);
+OccurrencesArrayCell* fillOccurrencesArray(Arena* arena, FileBuffer buffer, int* sizeOccurrencesArray);
+OccurrencesArrayCell* createOccurrencesArray(Arena* arena, long counts[N_ASCII], int* sizeOccurrencesArray);
+PtrlistCode createNode(Arena* arena, unsigned char c);
 void addStartList(PtrlistCode *liste, PtrlistCode node);
 void initializeCode(HuffmanTableCell* huffmanTable, int sizeHuffmanTable, OccurrencesArrayCell* occurrencesArray);
-OccurrencesArrayCell* fillOccurrencesArray(FileBuffer buffer, int* sizeOccurrencesArray);
 void seek2Min(int* i_min1, int* i_min2, OccurrencesArrayCell* occurrencesArray, int sizeOccurrencesArray);
 void merge(int i_min1, int i_min2, OccurrencesArrayCell* occurrencesArray, int* sizeOccurrencesArray);
-void fillHuffmanTableCode(HuffmanTableCell* huffmanTable, int sizeHuffmanTable, OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2);
-void fillHuffmanTree(OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2);
-void freeHuffmanTree(HuffmanTreeNode* huffmanNode);
-void freeOccurrencesArray(OccurrencesArrayCell* occurrencesArray, int sizeOccurrencesArray);
-void readNodeHuffmanAndWrite(FileBuffer* bufferChar, FileBuffer* bufferPos, HuffmanTreePtr huffmanNode, int* posBufferChar, int* posBufferPos, uint8_t *buffer, int* filling);
-void saveTree(int indexBW, HuffmanTreePtr huffmanTree, int sizeBufferChar, int fileSize);
-HuffmanTableCell* createHuffmanTable(int indexBW, FileBuffer bufferIn, int* sizeHuffmanTable);
+void fillHuffmanTableCode(Arena* arena, HuffmanTableCell* huffmanTable, int sizeHuffmanTable, OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2);
+void fillHuffmanTree(Arena* arena, OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2);
+void readNodeHuffmanAndWrite(FileBuffer* bufferChar, HuffmanTreePtr huffmanNode, int* posBufferChar, BitWriter* writerPos);
+int saveTree(HuffmanTreePtr huffmanTree, int sizeBufferChar, unsigned char* out);
+HuffmanTableCell* createHuffmanTable(Arena* arena, OccurrencesArrayCell* occurrencesArray, int sizeOccurrencesArray, int* sizeHuffmanTable, HuffmanTreePtr* huffmanTree);
+long long huffmanTableBits(HuffmanTableCell* huffmanTable, int sizeHuffmanTable, long counts[N_ASCII]);
+HuffmanTableCell* createTableFromTree(Arena* arena, HuffmanTreePtr huffmanTree, int* sizeHuffmanTable, int* maxCodeLength);
+
+
+//Analysis.c
+void countOccurrences(FileBuffer buffer, long counts[N_ASCII]);
+void fillCharacterMap(FileBuffer buffer, const long counts[N_ASCII], unsigned char map[BLOCK_MAP_SIZE]);
+double entropyOfCounts(long counts[N_ASCII]);
+long long huffmanSizeBits(long counts[N_ASCII], int lengths[N_ASCII]);
+long long order1SizeBits(Arena* arena, FileBuffer buffer);
+void analyseBlock(Arena* arena, FileBuffer block, int allowBW, int lzWindow, BlockAnalysis* analysis);
+
+
+//BitIO.c
+void initBitWriter(BitWriter* writer, unsigned char* out, size_t pos);
+void writeBits(BitWriter* writer, uint64_t value, int nbBits);
+size_t finishBitWriter(BitWriter* writer);
+void initBitReader(BitReader* reader, const unsigned char* in, size_t size);
+uint64_t readBits(BitReader* reader, int nbBits);
+long long bitsRead(BitReader* reader);
+void selectBitKernel(BitKernel kernel);
+const char* bitKernelName();
+void createPairCodes(const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII], uint32_t* pairCodes);
+void encodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII], const uint32_t* pairCodes);
+void createDecodeTable(HuffmanTreePtr huffmanTree, DecodeEntry decodeTable[1 << DECODE_TABLE_BITS]);
+void decodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const DecodeEntry* decodeTable, int sizeOut);
+
+/**
+ * \fn static inline int highBit(uint32_t value)
+ * \brief Gives the position of the most significant bit of a value (used by LZ77 and tANS)
+ * \param value Value, larger than 0
+ * \return Position of its most significant bit (0 for 1)
+ */
+
+static inline int highBit(uint32_t value)
+{
+    int position = 0;
+    while(value>>=1)
+        position++;
+    return position;
+}
+void encodeBigramSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const uint16_t* pairSymbols, const uint16_t codes[BIGRAM_SYMBOLS], const unsigned char lengths[BIGRAM_SYMBOLS]);
+void decodeBigramSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const BigramEntry* decodeTable, int sizeOut);
+int tansEncodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const TansTable* table, uint16_t* bits, size_t sizeMax);
+void tansDecodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const TansTable* table, int sizeOut);
 
 
 //Compression.c
-void freeHuffmanTable(HuffmanTableCell* huffmanTable, int sizeHuffmanTable);
-void compress(FileBuffer bufferBW, FILE* fileOut, HuffmanTableCell* huffmanTable, int sizeHuffmanTable);
-void compressMain(char* fileNameIn);
+void compress(FileBuffer bufferBW, FileBuffer* bufferOut, HuffmanTableCell* huffmanTable, int sizeHuffmanTable, ScratchPool* scratch);
+BlockMode compressBlock(FileBuffer block, uint64_t hash, AsyncFile* fileOut, PipelineContext* context);
+void compressStream(FILE* fileIn, long long sizeFileIn, FILE* fileOut, PipelineContext* context);
+void compressMain(char* fileNameIn, PipelineContext* context);
 
 
 //Decompression.c
-HuffmanTreePtr createTreeFromBuffers(FileBuffer bufferPos, FileBuffer bufferChar);
-int readTreeFromPos(HuffmanTreePtr* huffmanTreePos, uint8_t bit);
-void decompress(FILE* fileIn, FileBuffer* bufferOut, HuffmanTreePtr huffmanTreeHead, int sizeFileIn);
-void decompressMain();
+HuffmanTreePtr createTreeFromBuffers(Arena* arena, FileBuffer bufferPos, FileBuffer bufferChar);
+void decompress(FileBuffer bufferIn, FileBuffer* bufferOut, HuffmanTreePtr huffmanTreeHead, int sizeOut);
+HuffmanTreePtr loadTree(Arena* arena, FileBuffer bufferIn, int* sizeTree);
+HuffmanTreePtr loadTreeFromTable(Arena* arena, FILE* fileTable, int* indexBW, int* sizeFileIn);
+void writeOutput(FileBuffer buffer, AsyncFile* fileOut);
+void decompressBlock(BlockMode mode, FileBuffer bufferIn, int sizeOut, AsyncFile* fileOut, PipelineContext* context);
+int isCompressedStream(FILE* fileIn);
+long long decompressStream(FILE* fileIn, long long sizeFileIn, FILE* fileOut, PipelineContext* context);
+long long decompressLegacy(FILE* fileIn, FILE* fileOut, PipelineContext* context);
+void decompressMain(char* fileNameIn, PipelineContext* context);
 
 
 //BurrowsWheeler.c
-void rotationSort(unsigned char* tabChar,int* indexes, int size);
-void bubbleSortIndexes(unsigned char* tabChar, int* indexes, int size);
-int burrowsWheeler(FileBuffer* bufferIn);
-void burrowsWheelerDecode(int indexBW, FileBuffer bufferIn, FILE* fileBWDecode);
+int rotationSort(unsigned char* tabChar, uint32_t* indexes, int size, ScratchPool* scratch, int nbThreads, long long deadlineNs);
+void countingSortIndexes(unsigned char* tabChar, uint32_t* indexes, int size);
+int burrowsWheeler(FileBuffer* bufferIn, ScratchPool* scratch, int nbThreads, long long deadlineNs);
+void burrowsWheelerDecode(int indexBW, FileBuffer bufferIn, AsyncFile* fileBWDecode, ScratchPool* scratch);
 
 
 //MoveToFront.c
@@ -66,4 +122,146 @@ void shiftCharStart(unsigned char array[], int size, int index);
 void moveToFrontEncode(FileBuffer *buffer);
 void moveToFrontDecode(FileBuffer *buffer);
 
+
+//Stats.c
+long long getTimeNs();
+void setVerbose(int value);
+void printStatus(const char* format, ...);
+void setProgressCallback(ProgressCallback callback, void* userData);
+void printProgress(const char* task, long long done, long long total, void* userData);
+void progressStart(Progress* progress, const char* task, long long total);
+void progressReport(Progress* progress, long long done);
+long long progressChunkEnd(Progress* progress);
+void initStats(PipelineStats* stats, const char* operation);
+void stageStart(PipelineStats* stats, PipelineStage stage);
+void stageStop(PipelineStats* stats, PipelineStage stage, long long bytesIn, long long bytesOut);
+void finishStats(PipelineStats* stats, long long bytesIn, long long bytesOut);
+void printStats(const PipelineStats* stats, StatsFormat format, FILE* file);
+void printStatsJson(const PipelineStats* stats, FILE* file);
+void printStatsText(const PipelineStats* stats, FILE* file);
+const char* blockModeName(BlockMode mode);
+
+
+//PerfCounters.c
+const char* perfEventName(PerfEvent event);
+int openPerfCounters();
+void closePerfCounters();
+const char* perfCountersError();
+void readPerfCounters(long long values[N_PERF_EVENTS]);
+
+
+//Memory.c
+void initArena(Arena* arena, size_t chunkSize);
+void* arenaAlloc(Arena* arena, size_t size);
+void resetArena(Arena* arena);
+void freeArena(Arena* arena);
+void initScratchPool(ScratchPool* pool, int hugePages);
+void setScratchLimit(ScratchPool* pool, size_t limit);
+int scratchFits(ScratchPool* pool, ScratchSlot slot, size_t size);
+int scratchFitsAll(ScratchPool* pool, const size_t sizes[N_SCRATCH_SLOTS]);
+void* scratchGet(ScratchPool* pool, ScratchSlot slot, size_t size);
+void freeScratchPool(ScratchPool* pool);
+void initPipelineContext(PipelineContext* context, int hugePages);
+void freePipelineContext(PipelineContext* context);
+
+
+//AsyncFile.c
+void asyncOpen(AsyncFile* async, FILE* file, int writing, int threaded, ScratchPool* scratch);
+void asyncOpenMemory(AsyncFile* async, FileBuffer* buffer, size_t capacity);
+size_t asyncRead(AsyncFile* async, void* data, size_t size);
+size_t asyncWrite(AsyncFile* async, const void* data, size_t size);
+int asyncClose(AsyncFile* async);
+
+
+//Dictionary.c
+uint32_t trainDictionary(char** sampleNames, int nbSamples, char* dictionaryName);
+void loadDictionary(char* dictionaryName, Dictionary* dictionary);
+void freeDictionary(Dictionary* dictionary);
+
+
+//Tans.c
+void normalizeCounts(const long counts[N_ASCII], uint16_t normalized[N_ASCII]);
+long long tansSizeBits(const long counts[N_ASCII], const uint16_t normalized[N_ASCII]);
+int saveTansCounts(const uint16_t normalized[N_ASCII], unsigned char* out);
+int loadTansCounts(FileBuffer bufferIn, uint16_t normalized[N_ASCII]);
+void createTansTable(const uint16_t normalized[N_ASCII], TansTable* table);
+
+
+//Stream.c
+void initAdaptiveModel(AdaptiveModel* model);
+void freeAdaptiveModel(AdaptiveModel* model);
+int adaptiveEncode(AdaptiveModel* model, FileBuffer block, unsigned char* out);
+void adaptiveDecode(AdaptiveModel* model, FileBuffer bufferIn, FileBuffer* bufferOut, int sizeOut);
+void compressLive(FILE* fileIn, FILE* fileOut, int latency, PipelineContext* context);
+void decompressLive(FILE* fileIn, FILE* fileOut, PipelineContext* context);
+
+
+//Dedup.c
+uint64_t hashBlock(const unsigned char* data, size_t size);
+void initDedupTable(DedupTable* table, size_t limit);
+void freeDedupTable(DedupTable* table);
+int findCodedBlock(DedupTable* table, FileBuffer block, uint64_t hash, ScratchPool* scratch, unsigned char** coded);
+void addCodedBlock(DedupTable* table, FileBuffer block, uint64_t hash, const unsigned char* coded, int sizeCoded);
+long long findArchiveBlock(DedupTable* table, const unsigned char* coded, int sizeCoded, uint64_t hash, FILE* fileArchive, unsigned char* buffer);
+void addArchiveBlock(DedupTable* table, uint64_t hash, int sizeCoded, long long offset);
+void addBlockOffset(DedupTable* table, uint64_t hash, int size, long long offset, int sizeCoded);
+long long findBlockOffset(DedupTable* table, uint64_t hash, int size, int* sizeCoded);
+
+
+//Chunking.c
+int findChunkEnd(const unsigned char* data, int size, const ChunkSettings* settings);
+int splitChunk(const unsigned char* data, int size, const ChunkSettings* settings, int sizes[SPLIT_MAX_BLOCKS], ScratchPool* scratch);
+void writeChunkIndex(AsyncFile* fileOut, const uint64_t* hashes, int nbChunks);
+FILE* openPreviousFile(const char* fileName, DedupTable* chunks);
+
+
+//Archive.c
+void freeArchive(Archive* archive);
+void readArchive(FILE* fileArchive, Archive* archive);
+void createArchive(const char* archiveName, char** paths, int nbPaths, PipelineContext* context);
+void listArchive(const char* archiveName);
+void extractArchive(const char* archiveName, char** names, int nbNames, PipelineContext* context);
+
+
+//Search.c
+long long searchFiles(const char* pattern, char** fileNames, int nbFiles, PipelineContext* context);
+
+
+//Lz77.c
+void lz77ScratchSizes(int size, size_t sizes[N_SCRATCH_SLOTS]);
+int lz77Encode(FileBuffer block, unsigned char* out, int sizeMax, PipelineContext* context);
+void lz77Decode(FileBuffer bufferIn, FileBuffer* bufferOut, int sizeOut, PipelineContext* context);
+
+
+//Bigram.c
+int bigramEncode(FileBuffer block, unsigned char* out, int sizeMax, PipelineContext* context);
+void bigramDecode(FileBuffer bufferIn, FileBuffer* bufferOut, int sizeOut, PipelineContext* context);
+
+
+//Transform.c
+const TransformStage* getTransformStage(TransformId id);
+void setDefaultTransforms(TransformChain* chain);
+int parseTransforms(const char* list, TransformChain* chain);
+void transformsScratchSizes(const TransformChain* chain, int size, size_t sizes[N_SCRATCH_SLOTS]);
+int applyTransforms(FileBuffer* buffer, const TransformChain* chain, TransformChain* applied, long long deadlineNs, PipelineContext* context);
+int saveTransforms(const TransformChain* chain, unsigned char* out);
+int loadTransforms(FileBuffer bufferIn, TransformChain* chain);
+void reserveTransforms(const TransformChain* chain, int size, ScratchPool* scratch);
+void decodeTransforms(const TransformChain* chain, FileBuffer buffer, int sizeOut, AsyncFile* fileOut, PipelineContext* context);
+
+
+//Level.c
+void applyLevel(int level, ProgramOptions* options);
+void explainSettings(const ProgramOptions* options, FILE* file);
+
+
+//Daemon.c
+void runDaemon(const char* socketName, PipelineContext* context, int nbWorkers);
+void requestDaemon(const char* socketName, DaemonOperation operation, const char* fileName);
+
+
+//Options.c
+void printUsage();
+void parseOptions(int argc, char* argv[], ProgramOptions* options);
+
 #endif
\ No newline at end of file
@@ -9,35 +9,488 @@
 #ifndef StructuresDefine
 #define StructuresDefine
 
+//So that fseeko and ftello use 64-bit offsets on the 32-bit systems (files larger than 2 GB)
+#if __linux__
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-//For uint8_t in Compression.c and Decompression.c
-#include <inttypes.h>
+//For uint8_t in Compression.c and Decompression.c
+#include <inttypes.h>
+
+//For the threads of the Burrows Wheeler sort and of the asynchronous files
+#include <pthread.h>
+
+//For the access function used in DecompressionMain
+#if __linux__
+#include <unistd.h>
+#endif
+#if __WIN32__
+#include <io.h>
+#endif
+
+//Constants definitions
+
+/**
+ * \def N_ASCII Constant correponding to the number of possible values taken by a byte
+ */
+
+#define N_ASCII 256
+
+
+/**
+ * \def BUFFER_SIZE Constant correponding to the size of the buffer read from a file or written into it
+ */
+
+#define BUFFER_SIZE 8000
+
+
+/**
+ * \def BLOCK_SIZE Size of the blocks in which the input file is cut, each block is analysed and compressed independently
+ */
+
+#define BLOCK_SIZE (1024*1024)
+
+
+/**
+ * \def BWT_MAX_BLOCK Size of the largest block on which Burrows Wheeler can be applied. Its sort is in O(n log² n) at worst and shared between the threads, so it's applied to whole blocks
+ */
+
+#define BWT_MAX_BLOCK BLOCK_SIZE
+
+
+/**
+ * \def CONTAINER_MAGIC Characters written at the beginning of a compressed file, followed by CONTAINER_VERSION (1 byte)
+ */
+
+#define CONTAINER_MAGIC "HUFB"
+
+/**
+ * \def CONTAINER_VERSION Version of the format of the compressed files (the version 1 is the same without the maps of the characters of the blocks, and the files of the version 2 compressed block by block always end with the index of their chunks)
+ */
+
+#define CONTAINER_VERSION 3
+
+/**
+ * \def CONTAINER_INDEX_FLAG Bit of the byte of the version set when the compressed file ends with the index of its chunks (CHUNK_INDEX_MAGIC)
+ */
+
+#define CONTAINER_INDEX_FLAG 0x80
+
+/**
+ * \def ARCHIVE_MAGIC Characters written at the beginning and at the end of an archive, the beginning is followed by ARCHIVE_VERSION (1 byte)
+ */
+
+#define ARCHIVE_MAGIC "HUFA"
+
+/**
+ * \def ARCHIVE_VERSION Version of the format of the archives
+ */
+
+#define ARCHIVE_VERSION 3
+
+/**
+ * \def ARCHIVE_TRAILER_SIZE Size of the end of an archive : position of the central directory (8 bytes), number of files (4 bytes) and ARCHIVE_MAGIC
+ */
+
+#define ARCHIVE_TRAILER_SIZE 16
+
+/**
+ * \def BLOCK_HEADER_SIZE Size of the header of a block : its mode (1 byte), its size before and after compression (4 bytes each)
+ */
+
+#define BLOCK_HEADER_SIZE 9
+
+/**
+ * \def BLOCK_MAP_FLAG Bit added to the mode of a block whose header is followed by the map of the characters it contains (BLOCK_MAP_SIZE bytes, counted in its size after compression), read by the search to skip the blocks that can't contain the pattern
+ */
+
+#define BLOCK_MAP_FLAG 0x80
+
+/**
+ * \def BLOCK_MAP_SIZE Size of the map of the characters of a block : one bit per character
+ */
+
+#define BLOCK_MAP_SIZE (N_ASCII/8)
+
+/**
+ * \def BLOCK_MAP_MIN_SIZE Blocks smaller than this have no map of their characters (it would take more than 1 % of the block), they are always decoded by the search
+ */
+
+#define BLOCK_MAP_MIN_SIZE 4096
+
+/**
+ * \def TREE_MAX_SIZE Largest size of a saved Huffman tree : 2 sizes (2 bytes each), the characters and 4 bits per leaf to go through the tree
+ */
+
+#define TREE_MAX_SIZE (4+N_ASCII+N_ASCII/2+1)
+
+/**
+ * \def MAX_CODE_LENGTH Length of the longest Huffman code, the codes are kept in 64 bits integers
+ */
+
+#define MAX_CODE_LENGTH 64
+
+/**
+ * \def DECODE_TABLE_BITS Number of bits read at once by the Huffman decoder, the codes that aren't longer are decoded with one lookup
+ */
+
+#define DECODE_TABLE_BITS 11
+
+/**
+ * \def PAIR_MAX_LENGTH Length of the longest code of 2 characters written at once by the Huffman coder
+ */
+
+#define PAIR_MAX_LENGTH 24
+
+/**
+ * \def TANS_TABLE_LOG Number of bits of the states of the tANS coder, the occurrences are normalized so that their sum is 2^TANS_TABLE_LOG
+ */
+
+#define TANS_TABLE_LOG 12
+
+/**
+ * \def TANS_TABLE_SIZE Number of states of the tANS coder
+ */
+
+#define TANS_TABLE_SIZE (1<<TANS_TABLE_LOG)
+
+/**
+ * \def TANS_COUNTS_MAX_SIZE Largest size of the saved normalized occurrences of the tANS coder : 32 bytes for the characters used and 2 bytes for each one
+ */
+
+#define TANS_COUNTS_MAX_SIZE (N_ASCII/8+2*N_ASCII)
+
+/**
+ * \def PAIR_TABLE_MIN_SIZE Buffers at least this large are coded 2 characters at a time, the table of the pairs (N_ASCII*N_ASCII cells) isn't worth filling for smaller ones
+ */
+
+#define PAIR_TABLE_MIN_SIZE (128*1024)
+
+/**
+ * \def BIT_IO_SLACK Number of bytes that must be writable after the end of the bits written by a BitWriter, since it writes 8 bytes at once
+ */
+
+#define BIT_IO_SLACK 8
+
+/**
+ * \def BIGRAM_MAX_PAIRS Largest number of pairs of characters coded as one symbol by the bigram mode, the alphabet of the block is then the N_ASCII characters and these pairs
+ */
+
+#define BIGRAM_MAX_PAIRS 256
+
+/**
+ * \def BIGRAM_SYMBOLS Size of the alphabet of the bigram mode : the characters then the pairs
+ */
+
+#define BIGRAM_SYMBOLS (N_ASCII+BIGRAM_MAX_PAIRS)
+
+/**
+ * \def BIGRAM_MIN_COUNT A pair of characters is only kept by the bigram mode if it's found at least this number of times in the block, otherwise its place in the header costs more than it saves
+ */
+
+#define BIGRAM_MIN_COUNT 32
+
+/**
+ * \def BIGRAM_MIN_BLOCK Blocks smaller than this aren't coded with the bigram mode, its header (up to BIGRAM_HEADER_MAX_SIZE bytes) would take too much of them
+ */
+
+#define BIGRAM_MIN_BLOCK (16*1024)
+
+/**
+ * \def BIGRAM_TABLE_BITS Length of the longest code of the bigram mode, so that each symbol (1 or 2 characters) is decoded with one lookup in a table of 2^BIGRAM_TABLE_BITS cells
+ */
+
+#define BIGRAM_TABLE_BITS 12
+
+/**
+ * \def BIGRAM_HEADER_MAX_SIZE Largest size of the header of a block coded with the bigram mode : number of pairs (2 bytes), the pairs (2 bytes each) and the length of the code of each symbol (4 bits each)
+ */
+
+#define BIGRAM_HEADER_MAX_SIZE (2+2*BIGRAM_MAX_PAIRS+(BIGRAM_SYMBOLS+1)/2)
+
+
+/**
+ * \def DICTIONARY_MAGIC Characters written at the beginning of a dictionary file, followed by DICTIONARY_VERSION (1 byte), its ID (4 bytes) and its Huffman tree
+ */
+
+#define DICTIONARY_MAGIC "HUFD"
+
+/**
+ * \def DICTIONARY_VERSION Version of the format of the dictionaries
+ */
+
+#define DICTIONARY_VERSION 1
+
+/**
+ * \def DICTIONARY_MAX_BLOCK Blocks smaller than this are coded with the dictionary (if one is given) without being analysed
+ */
+
+#define DICTIONARY_MAX_BLOCK (64*1024)
+
+
+/**
+ * \def ARENA_CHUNK_SIZE Size of the blocks of memory allocated by an arena when it's full
+ */
+
+#define ARENA_CHUNK_SIZE (64*1024)
+
+
+/**
+ * \def ASYNC_CHUNK_SIZE Size of the chunks read or written by the thread of an asynchronous file
+ */
+
+#define ASYNC_CHUNK_SIZE BLOCK_SIZE
+
+
+/**
+ * \def ASYNC_NB_CHUNKS Number of chunks of an asynchronous file (3 : one used by the pipeline, one read or written by the thread, one ready)
+ */
+
+#define ASYNC_NB_CHUNKS 3
+
+/**
+ * \def STREAM_BLOCK_SIZE Largest size of a block of a live stream (--stream), a block is written when it's full even if the latency bound isn't reached
+ */
+
+#define STREAM_BLOCK_SIZE (64*1024)
+
+/**
+ * \def STREAM_DEFAULT_LATENCY Default latency bound of a live stream in milliseconds : time after which the characters read are coded and written
+ */
+
+#define STREAM_DEFAULT_LATENCY 100
+
+/**
+ * \def ADAPTIVE_FIRST_REBUILD Number of characters coded with the first codes of the adaptive coder (built from equal occurrences), the interval between 2 rebuilds then doubles up to ADAPTIVE_REBUILD_INTERVAL
+ */
+
+#define ADAPTIVE_FIRST_REBUILD 256
+
+/**
+ * \def ADAPTIVE_REBUILD_INTERVAL Largest number of characters between 2 rebuilds of the codes of the adaptive coder, the occurrences are halved at each rebuild
+ */
+
+#define ADAPTIVE_REBUILD_INTERVAL 8192
+
+/**
+ * \def ADAPTIVE_MAX_CODE_LENGTH Largest length of a code of the adaptive coder, the occurrences are halved again if a code is longer
+ */
+
+#define ADAPTIVE_MAX_CODE_LENGTH 32
+
+/**
+ * \def TRANSFORM_MAX_CHAIN Largest number of transforms applied to a block before its coding
+ */
+
+#define TRANSFORM_MAX_CHAIN 8
+
+/**
+ * \def TRANSFORM_MAX_PARAMS Largest size of the parameters saved by a transform for its inverse
+ */
+
+#define TRANSFORM_MAX_PARAMS 8
+
+/**
+ * \def TRANSFORM_CHAIN_MAX_SIZE Largest size of a saved chain of transforms : their number (1 byte), then for each one its ID and the size of its parameters (1 byte each), its parameters and the size of the data after it (4 bytes)
+ */
+
+#define TRANSFORM_CHAIN_MAX_SIZE (1+TRANSFORM_MAX_CHAIN*(2+TRANSFORM_MAX_PARAMS+4))
+
+/**
+ * \def TRANSFORM_SKIPPED Returned by the coding of a transform that isn't worth applying to a block (the block isn't modified and the transform isn't saved in the chain)
+ */
+
+#define TRANSFORM_SKIPPED -1
+
+/**
+ * \def TRANSFORM_STOPPED Returned by the coding of a transform stopped by the time budget of the block (--deadline), the block is then coded without its chain
+ */
+
+#define TRANSFORM_STOPPED -2
+
+/**
+ * \def RLE_MIN_RUN Number of identical characters after which the run length encoding writes the number of other repetitions (1 byte)
+ */
+
+#define RLE_MIN_RUN 4
+
+/**
+ * \def RLE_MIN_GAIN_DIVISOR The run length encoding is applied only if it saves at least 1/RLE_MIN_GAIN_DIVISOR of the block
+ */
+
+#define RLE_MIN_GAIN_DIVISOR 64
+
+/**
+ * \def LZ77_MIN_MATCH Length of the shortest match of LZ77, the positions are found by the hash of their first LZ77_MIN_MATCH characters
+ */
+
+#define LZ77_MIN_MATCH 4
+
+/**
+ * \def LZ77_HASH_BITS Number of bits of the hash of the positions, the table of the last position of each hash has 2^LZ77_HASH_BITS cells
+ */
+
+#define LZ77_HASH_BITS 16
+
+/**
+ * \def LZ77_NICE_LENGTH A match at least this long is taken without looking at the other positions of the chain, nor at the next position (lazy matching)
+ */
+
+#define LZ77_NICE_LENGTH 128
+
+/**
+ * \def LZ77_DEFAULT_WINDOW Default largest distance of a match (--lz-window)
+ */
+
+#define LZ77_DEFAULT_WINDOW (256*1024)
+
+/**
+ * \def LZ77_DEFAULT_DEPTH Default number of previous positions with the same hash compared to find a match (--lz-depth)
+ */
+
+#define LZ77_DEFAULT_DEPTH 16
+
+/**
+ * \def LZ77_DIRECT_VALUES The lengths and distances of LZ77 lower than this are coded by one symbol, the larger ones by the position of their most significant bit and the next bit, followed by the other bits
+ */
+
+#define LZ77_DIRECT_VALUES 16
+
+/**
+ * \def DEDUP_MIN_BLOCK Size from which a block is looked for among the blocks already compressed (smaller blocks are compressed quickly and a reference would save nothing)
+ */
+
+#define DEDUP_MIN_BLOCK 256
+
+/**
+ * \def DEDUP_CACHE_SIZE Largest size of the blocks and of their compressed data kept to be written again when the same block is found
+ */
+
+#define DEDUP_CACHE_SIZE (64*1024*1024)
+
+/**
+ * \def CHUNK_MIN_SIZE Smallest size of a chunk cut by its content, the end of a chunk is looked for after it (the last chunk of a file can be smaller)
+ */
+
+#define CHUNK_MIN_SIZE (128*1024)
+
+/**
+ * \def CHUNK_MASK_BITS A chunk ends after a byte when the CHUNK_MASK_BITS high bits of the rolling hash (which depends on the last 64 bytes) are 0, so the chunks are about CHUNK_MIN_SIZE + 2^CHUNK_MASK_BITS bytes long (at most BLOCK_SIZE)
+ */
+
+#define CHUNK_MASK_BITS 19
+
+/**
+ * \def LEVEL_MAX Largest compression level (--level), the levels go from 1 (fastest) to LEVEL_MAX (smallest)
+ */
+
+#define LEVEL_MAX 9
+
+/**
+ * \def LEVEL_DEFAULT Level used when --level isn't given : CHUNK_MIN_SIZE and CHUNK_MASK_BITS for the blocks, the default chain of transforms and the smallest coder
+ */
+
+#define LEVEL_DEFAULT 6
+
+/**
+ * \def CHUNK_INDEX_MAGIC Characters ending the index of the chunks written after the last block of a compressed file : the hash of each chunk (8 bytes each), then their number (4 bytes) and CHUNK_INDEX_MAGIC
+ */
+
+#define CHUNK_INDEX_MAGIC "HUFI"
+
+/**
+ * \def CHUNK_INDEX_MIN_SIZE Size of the smallest file whose compressed file has the index of its chunks : a smaller file has few blocks and is compressed entirely again by --update
+ */
+
+#define CHUNK_INDEX_MIN_SIZE CHUNK_MIN_SIZE
+
+/**
+ * \def SPLIT_STEP The chunks are split in blocks at multiples of SPLIT_STEP bytes : the occurrences of the characters are counted for each part of SPLIT_STEP bytes
+ */
+
+#define SPLIT_STEP (4*1024)
+
+/**
+ * \def SPLIT_MIN_SIZE Smallest size of the blocks a chunk is split into when the statistics of its parts are different (--split-min), except the last one of a file
+ */
+
+#define SPLIT_MIN_SIZE (32*1024)
+
+/**
+ * \def SPLIT_MAX_BLOCKS Largest number of blocks a chunk can be split into
+ */
+
+#define SPLIT_MAX_BLOCKS (BLOCK_SIZE/SPLIT_STEP)
+
+/**
+ * \def SPLIT_MIN_GAIN A chunk is split only if the estimated size of its blocks (headers and trees included) is smaller than its own by more than 1/SPLIT_MIN_GAIN of it, so that the blocks coded by Burrows Wheeler aren't cut for a small gain
+ */
+
+#define SPLIT_MIN_GAIN 64
+
+/**
+ * \def SPLIT_LOG_BITS Precision of the logarithms used to estimate the size of the blocks : log2 is read in a table of 2^SPLIT_LOG_BITS values
+ */
+
+#define SPLIT_LOG_BITS 12
+
+/**
+ * \def DEADLINE_BWT_NS_PER_BYTE Time of Burrows Wheeler and Move To Front for one byte (in ns) assumed before it's measured, used with --deadline
+ */
+
+#define DEADLINE_BWT_NS_PER_BYTE 200
+
+/**
+ * \def DEADLINE_CODING_NS_PER_BYTE Time of the creation of the tables and of the Huffman or tANS coding for one byte (in ns) assumed before it's measured, used with --deadline
+ */
 
-//For the access function used in DecompressionMain
-#if __linux__
-#include <unistd.h>
-#endif
-#if __WIN32__
-#include <io.h>
-#endif
+#define DEADLINE_CODING_NS_PER_BYTE 20
 
-//Constants definitions
+/**
+ * \def DEADLINE_LZ77_NS_PER_BYTE Time of LZ77 (search of the matches and coding of the sequences) for one byte (in ns) assumed before it's measured, used with --deadline
+ */
+
+#define DEADLINE_LZ77_NS_PER_BYTE 60
 
 /**
- * \def N_ASCII Constant correponding to the number of possible values taken by a byte
+ * \def SEARCH_BLOCKS_PER_THREAD Number of blocks decoded by each thread of the search before they are searched, so that at most nbThreads*SEARCH_BLOCKS_PER_THREAD blocks are kept in memory
  */
 
-#define N_ASCII 256
+#define SEARCH_BLOCKS_PER_THREAD 4
+
+/**
+ * \def SEARCH_MAX_LINE Size of the longest line written by the search, a longer line containing the pattern is replaced by a message. The buffer of the current line has this size
+ */
 
+#define SEARCH_MAX_LINE (1024*1024)
 
 /**
- * \def BUFFER_SIZE Constant correponding to the size of the buffer read from a file or written into it
+ * \def DAEMON_MAGIC Characters beginning a request sent to the daemon, followed by the operation (1 byte). The input file, the output file and the error output of the client are given with the request
  */
 
-#define BUFFER_SIZE 8000
+#define DAEMON_MAGIC "HUFD"
+
+/**
+ * \def DAEMON_REQUEST_SIZE Size of a request sent to the daemon : DAEMON_MAGIC and the operation
+ */
+
+#define DAEMON_REQUEST_SIZE 5
+
+/**
+ * \def DAEMON_REPLY_SIZE Size of the reply of the daemon once a request is done : 0 (1 byte), then the size of the input and the size of the output (8 bytes each)
+ */
+
+#define DAEMON_REPLY_SIZE 17
+
+/**
+ * \def DAEMON_BACKLOG Number of clients that can wait for a worker of the daemon
+ */
+
+#define DAEMON_BACKLOG 64
 
 
 /**
@@ -75,7 +528,7 @@
 
 /**
  * \struct FileBuffer Structures_Define.h
- * \brief Buffer containing a file or text
+ * \brief Buffer containing a block or a text. Its size is an int because a buffer never holds more than a block (BLOCK_SIZE) or a file of the previous format, the sizes of the files are long long
  */
 
 typedef struct FileBuffer{
@@ -120,9 +573,110 @@ typedef HuffmanTreeNode* HuffmanTreePtr;
 typedef struct HuffmanTableCell{
     unsigned char c; /*!< character to which we associate the code*/
     PtrlistCode code; /*!< linked list containing the binary code associated to the character c*/
+    uint64_t bits; /*!< same code as an integer, its first bit is the most significant one*/
+    int length; /*!< number of bits of the code*/
 }HuffmanTableCell;
 
 
+/**
+ * \struct DecodeEntry Structures_Define.h
+ * \brief Cell of the table used by the Huffman decoder, indexed by the next DECODE_TABLE_BITS bits
+ */
+
+typedef struct DecodeEntry{
+    HuffmanTreePtr node; /*!< node reached after DECODE_TABLE_BITS bits if the code is longer, NULL otherwise*/
+    unsigned char c; /*!< character decoded if the code isn't longer than DECODE_TABLE_BITS*/
+    unsigned char length; /*!< number of bits used by the character (or DECODE_TABLE_BITS if node isn't NULL), 0 if no code begins with these bits*/
+}DecodeEntry;
+
+
+/**
+ * \struct BigramEntry Structures_Define.h
+ * \brief Cell of the table used by the decoder of the bigram mode, indexed by the next BIGRAM_TABLE_BITS bits
+ */
+
+typedef struct BigramEntry{
+    unsigned char bytes[2]; /*!< characters of the symbol decoded (the second one is only used by a pair)*/
+    unsigned char nbBytes; /*!< 1 for a character, 2 for a pair*/
+    unsigned char length; /*!< number of bits used by the symbol, 0 if no code begins with these bits*/
+}BigramEntry;
+
+
+/**
+ * \struct TansSymbol Structures_Define.h
+ * \brief Values used by the tANS coder to code a character from any state without any test
+ */
+
+typedef struct TansSymbol{
+    int32_t deltaFindState; /*!< added to the state shifted by the number of bits written to get the position of the next state in TansTable.states*/
+    uint32_t deltaNbBits; /*!< added to the state, the 16 high bits of the result are the number of bits written*/
+}TansSymbol;
+
+
+/**
+ * \struct TansDecodeEntry Structures_Define.h
+ * \brief Cell of the table used by the tANS decoder, indexed by the state
+ */
+
+typedef struct TansDecodeEntry{
+    uint16_t newState; /*!< next state before the bits read are added*/
+    unsigned char c; /*!< character decoded*/
+    unsigned char nbBits; /*!< number of bits read to get the next state*/
+}TansDecodeEntry;
+
+
+/**
+ * \struct TansTable Structures_Define.h
+ * \brief Tables of the tANS coder and decoder, built from the normalized occurrences of the characters
+ */
+
+typedef struct TansTable{
+    uint16_t counts[N_ASCII]; /*!< normalized occurrences of each character, their sum is TANS_TABLE_SIZE*/
+    uint16_t states[TANS_TABLE_SIZE]; /*!< next states of the coder, grouped by character*/
+    TansSymbol symbols[N_ASCII]; /*!< values used by the coder for each character*/
+    TansDecodeEntry decode[TANS_TABLE_SIZE]; /*!< table of the decoder*/
+}TansTable;
+
+
+/**
+ * \struct BitWriter Structures_Define.h
+ * \brief Writes bits in memory, the first bit of each byte being the most significant one. The bits are gathered in a 64 bits integer and written 8 bytes at once
+ */
+
+typedef struct BitWriter{
+    unsigned char* out; /*!< memory in which the bits are written, BIT_IO_SLACK bytes must be writable after the last one*/
+    size_t pos; /*!< position in out of the first byte that isn't written yet*/
+    uint64_t bits; /*!< bits that aren't written yet, beginning with the most significant bit*/
+    int count; /*!< number of bits in bits*/
+}BitWriter;
+
+
+/**
+ * \struct BitReader Structures_Define.h
+ * \brief Reads bits written by a BitWriter. 8 bytes are loaded at once, and zeros are read after the end of the data
+ */
+
+typedef struct BitReader{
+    const unsigned char* in; /*!< data read*/
+    size_t size; /*!< size of in*/
+    size_t pos; /*!< position in in of the next byte loaded, it can go past the end*/
+    uint64_t bits; /*!< bits loaded, the next one is the most significant bit*/
+    int count; /*!< number of bits loaded that aren't read yet*/
+}BitReader;
+
+
+/**
+ * \enum BitKernel Structures_Define.h
+ * \brief Versions of the Huffman coding and decoding loops, chosen at startup depending on the processor
+ */
+
+typedef enum BitKernel{
+    BIT_KERNEL_AUTO, /*!< the fastest version supported by the processor*/
+    BIT_KERNEL_BASELINE, /*!< version compiled for every x86-64 (or other) processor*/
+    BIT_KERNEL_BMI2 /*!< version compiled with BMI2 (shifts without flags shlx/shrx, bzhi), x86 only*/
+}BitKernel;
+
+
 
 
 /**
@@ -139,4 +693,647 @@ typedef struct OccurrencesArrayCell{
 
 
 
+
+/**
+ * \enum PipelineStage Structures_Define.h
+ * \brief Stages of the compression and of the decompression whose time is measured
+ */
+
+typedef enum PipelineStage{
+    STAGE_READ, /*!< reading of the input file*/
+    STAGE_CHUNKING, /*!< search of the end of a chunk with the rolling hash, and hash of the chunk*/
+    STAGE_DEDUP, /*!< search of a block among the blocks already compressed and the chunks of the previous compressed file*/
+    STAGE_ANALYSIS, /*!< analysis of a block to choose how it's compressed*/
+    STAGE_BWT, /*!< Burrows Wheeler*/
+    STAGE_MTF, /*!< Move To Front*/
+    STAGE_RLE, /*!< run length encoding*/
+    STAGE_LZ77, /*!< search of the matches of LZ77*/
+    STAGE_BIGRAMS, /*!< counting of the pairs of characters, choice of the ones coded as one symbol and creation of their codes*/
+    STAGE_HISTOGRAM, /*!< counting of the occurrences of each character*/
+    STAGE_TREE, /*!< creation of the Huffman tree and table or of the tANS tables, and saving of the table*/
+    STAGE_HUFFMAN_ENCODE, /*!< Huffman coding*/
+    STAGE_TANS_ENCODE, /*!< tANS coding*/
+    STAGE_TABLE_READ, /*!< reading of the table and rebuilding of the Huffman tree or of the tANS tables*/
+    STAGE_HUFFMAN_DECODE, /*!< Huffman decoding*/
+    STAGE_TANS_DECODE, /*!< tANS decoding*/
+    STAGE_MTF_DECODE, /*!< inverse of Move To Front*/
+    STAGE_BWT_DECODE, /*!< inverse of Burrows Wheeler*/
+    STAGE_RLE_DECODE, /*!< inverse of the run length encoding*/
+    STAGE_LZ77_DECODE, /*!< copy of the literals and of the matches of LZ77*/
+    STAGE_WRITE, /*!< writing of the output file*/
+    N_STAGES /*!< number of stages*/
+}PipelineStage;
+
+
+/**
+ * \enum PerfEvent Structures_Define.h
+ * \brief Hardware events counted with the option --perf-counters
+ */
+
+typedef enum PerfEvent{
+    PERF_CYCLES, /*!< CPU cycles*/
+    PERF_INSTRUCTIONS, /*!< instructions executed*/
+    PERF_BRANCH_MISSES, /*!< mispredicted branches*/
+    PERF_L1D_MISSES, /*!< level 1 data cache read misses*/
+    PERF_LLC_MISSES, /*!< last level cache misses*/
+    PERF_DTLB_MISSES, /*!< data TLB read misses*/
+    N_PERF_EVENTS /*!< number of events*/
+}PerfEvent;
+
+
+/**
+ * \enum BlockMode Structures_Define.h
+ * \brief How a block is saved in the compressed file, it's the first byte of the header of the block
+ */
+
+typedef enum BlockMode{
+    BLOCK_END, /*!< end of the file, followed by the size of the decompressed file (8 bytes)*/
+    BLOCK_STORED, /*!< the block is copied without being compressed*/
+    BLOCK_HUFFMAN, /*!< Huffman tree followed by the Huffman coding of the block*/
+    BLOCK_BWT_HUFFMAN, /*!< index of Burrows Wheeler (4 bytes), Huffman tree and Huffman coding of the block after Burrows Wheeler and Move To Front*/
+    BLOCK_FILL, /*!< the block contains only one character, repeated, which is saved once*/
+    BLOCK_DICTIONARY, /*!< ID of the dictionary (4 bytes) followed by the Huffman coding of the block with the tree of the dictionary*/
+    BLOCK_TANS, /*!< normalized occurrences and tANS coding of the block*/
+    BLOCK_BWT_TANS, /*!< index of Burrows Wheeler (4 bytes), normalized occurrences and tANS coding of the block after Burrows Wheeler and Move To Front*/
+    BLOCK_ADAPTIVE, /*!< block of a live stream : 0 followed by the coding of the block with the adaptive Huffman codes, or 1 followed by the block itself. The codes continue from the previous block*/
+    BLOCK_REFERENCE, /*!< position in the archive (8 bytes) of a block with the same data, which is decoded instead (only in archives)*/
+    BLOCK_LZ77, /*!< number of sequences and of literals (4 bytes each), then the literals, the lengths of the runs of literals, the lengths and the distances of the matches (each one stored or coded with its own Huffman tree) and the extra bits of the lengths and distances*/
+    BLOCK_CHAIN_HUFFMAN, /*!< chain of transforms applied to the block (see TRANSFORM_CHAIN_MAX_SIZE), Huffman tree and Huffman coding of the transformed block*/
+    BLOCK_CHAIN_TANS, /*!< chain of transforms applied to the block, normalized occurrences and tANS coding of the transformed block*/
+    BLOCK_BIGRAM_HUFFMAN, /*!< pairs of characters coded as one symbol (see BIGRAM_HEADER_MAX_SIZE), length of the code of each symbol and Huffman coding of the block with these symbols*/
+    N_BLOCK_MODES /*!< number of modes*/
+}BlockMode;
+
+
+/**
+ * \struct BlockAnalysis Structures_Define.h
+ * \brief Estimations made on a block to choose its mode
+ */
+
+typedef struct BlockAnalysis{
+    BlockMode mode; /*!< mode chosen for the block*/
+    int sampled; /*!< 1 if the mode was chosen from a sample of the block, then counts isn't filled*/
+    int symbols; /*!< number of unique characters in the block*/
+    double entropy; /*!< entropy of the characters (order 0) in bits per byte*/
+    long long huffmanBits; /*!< exact size of the Huffman coding of the block (without its tree) in bits*/
+    long long order1Bits; /*!< estimated size in bits if each character was coded depending on the previous one, -1 if it wasn't computed*/
+    int repetitive; /*!< 1 if the probe found long repetitions in the block (only when Burrows Wheeler or LZ77 can be used)*/
+    long counts[N_ASCII]; /*!< number of occurrences of each character*/
+}BlockAnalysis;
+
+
+/**
+ * \struct StageStats Structures_Define.h
+ * \brief Measures of one stage of the pipeline
+ */
+
+typedef struct StageStats{
+    long long startNs; /*!< time at which the stage started the last time*/
+    long long timeNs; /*!< total time spent in the stage (in nanoseconds)*/
+    long long bytesIn; /*!< number of bytes given to the stage*/
+    long long bytesOut; /*!< number of bytes produced by the stage*/
+    int calls; /*!< number of times the stage was run*/
+    long long perfStart[N_PERF_EVENTS]; /*!< values of the hardware counters when the stage started the last time*/
+    long long perf[N_PERF_EVENTS]; /*!< number of hardware events counted during the stage, -1 if the event couldn't be counted*/
+}StageStats;
+
+
+/**
+ * \struct PipelineStats Structures_Define.h
+ * \brief Measures of a whole compression or decompression
+ */
+
+typedef struct PipelineStats{
+    const char* operation; /*!< "compress" or "decompress"*/
+    long long startNs; /*!< time at which the operation started*/
+    long long totalNs; /*!< duration of the operation*/
+    long long bytesIn; /*!< size of the input file*/
+    long long bytesOut; /*!< size of the output file*/
+    long long tableSize; /*!< size of the saved Huffman trees (of all the blocks)*/
+    int symbols; /*!< number of unique characters coded (size of the largest Huffman table)*/
+    int indexBW; /*!< index of Burrows Wheeler of the first block on which it was applied, -1 if it wasn't applied*/
+    int perfCounters; /*!< 1 if the hardware counters are read at the beginning and at the end of each stage*/
+    int blocks[N_BLOCK_MODES]; /*!< number of blocks compressed with each mode*/
+    long long memoryPeak; /*!< largest size of the scratch buffers allocated at the same time*/
+    long long memoryLimit; /*!< limit given with --max-memory, 0 if there isn't one*/
+    int flushes; /*!< number of blocks written by a live stream*/
+    long long latencyMaxNs; /*!< largest time between the reading of a character of a live stream and the writing of its code*/
+    long long latencyTotalNs; /*!< sum of the latencies of the oldest character of each block of a live stream*/
+    int duplicates; /*!< number of blocks found among the blocks already compressed, whose compressed data was written again*/
+    int reused; /*!< number of chunks that didn't change since the previous compressed file (--update), whose compressed data was copied*/
+    int degraded; /*!< number of blocks compressed with a cheaper mode than the one chosen by the analysis, so that the file is compressed in time (--deadline)*/
+    int splits; /*!< number of chunks split in several blocks because the statistics of their parts are different*/
+    int skipped; /*!< number of blocks that the search didn't decode, since they can't contain the pattern*/
+    StageStats stages[N_STAGES]; /*!< measures of each stage*/
+}PipelineStats;
+
+
+/**
+ * \struct ArenaChunk Structures_Define.h
+ * \brief Block of memory of an arena
+ */
+
+typedef struct ArenaChunk{
+    struct ArenaChunk* next; /*!< next block of the arena*/
+    size_t size; /*!< number of bytes that can be allocated in data*/
+    size_t used; /*!< number of bytes already allocated in data*/
+    _Alignas(16) unsigned char data[]; /*!< memory given by arenaAlloc*/
+}ArenaChunk;
+
+
+/**
+ * \struct Arena Structures_Define.h
+ * \brief Allocator in which many small elements (nodes of trees, codes...) are allocated one after the other and freed all at once
+ */
+
+typedef struct Arena{
+    ArenaChunk* head; /*!< first block of the arena*/
+    ArenaChunk* current; /*!< block in which the memory is currently allocated*/
+    size_t chunkSize; /*!< size of the blocks allocated when the arena is full*/
+}Arena;
+
+
+/**
+ * \enum ScratchSlot Structures_Define.h
+ * \brief Uses of the scratch buffers of a pool
+ */
+
+typedef enum ScratchSlot{
+    SCRATCH_INPUT, /*!< data read from the input file*/
+    SCRATCH_OUTPUT, /*!< decoded data*/
+    SCRATCH_CODED, /*!< data coded before being written in the output file*/
+    SCRATCH_BWT_TEXT, /*!< copy of the text made by Burrows Wheeler*/
+    SCRATCH_BWT_INDEXES, /*!< array of indexes sorted by Burrows Wheeler and its inverse*/
+    SCRATCH_BWT_RANKS, /*!< ranks of the rotations sorted by Burrows Wheeler*/
+    SCRATCH_BWT_KEYS, /*!< keys of the rotations sorted by Burrows Wheeler*/
+    SCRATCH_BWT_GROUPS, /*!< beginnings of the groups of rotations sorted by Burrows Wheeler*/
+    SCRATCH_PAIR_CODES, /*!< codes of the pairs of characters used by the Huffman coder*/
+    SCRATCH_TANS_BITS, /*!< bits written by the tANS coder for each character, gathered backwards before being written*/
+    SCRATCH_BIGRAMS, /*!< occurrences of the pairs of characters and symbol of each pair of the bigram mode*/
+    SCRATCH_SPLIT, /*!< occurrences of the characters in the first parts of a chunk, used to split it*/
+    SCRATCH_TRANSFORM_A, /*!< block written by a transform that doesn't work in place (it uses the slot A or B that doesn't contain its input)*/
+    SCRATCH_TRANSFORM_B, /*!< other block written by a transform that doesn't work in place*/
+    SCRATCH_LZ77_HEADS, /*!< last position of each hash of LZ77*/
+    SCRATCH_LZ77_CHAINS, /*!< previous position with the same hash of each position of LZ77*/
+    SCRATCH_LZ77_SEQUENCES, /*!< literals, symbols and extra bits of the sequences of LZ77*/
+    SCRATCH_READ_CHUNKS, /*!< chunks of the asynchronous input file*/
+    SCRATCH_WRITE_CHUNKS, /*!< chunks of the asynchronous output file*/
+    SCRATCH_SEARCH_LINE, /*!< current line of the search, which can begin in the previous blocks*/
+    SCRATCH_PREVIOUS_CHUNK, /*!< chunk of the previous compressed file (--update) decoded to compare it with the block*/
+    N_SCRATCH_SLOTS /*!< number of slots*/
+}ScratchSlot;
+
+
+/**
+ * \struct ScratchBuffer Structures_Define.h
+ * \brief Buffer of a pool, it's only reallocated when a larger one is needed
+ */
+
+typedef struct ScratchBuffer{
+    void* data; /*!< memory of the buffer*/
+    size_t capacity; /*!< size of data*/
+    int mapped; /*!< 1 if data was allocated with mmap (huge pages) instead of malloc*/
+}ScratchBuffer;
+
+
+/**
+ * \struct ScratchPool Structures_Define.h
+ * \brief Scratch buffers reused by the stages between the blocks and the files
+ */
+
+typedef struct ScratchPool{
+    ScratchBuffer slots[N_SCRATCH_SLOTS]; /*!< one buffer for each use*/
+    int hugePages; /*!< 1 if the large buffers are backed by huge pages*/
+    size_t used; /*!< sum of the capacities of the buffers*/
+    size_t peak; /*!< largest value of used*/
+    size_t limit; /*!< largest value allowed for used, 0 if there isn't any limit*/
+}ScratchPool;
+
+
+/**
+ * \struct RotationSort Structures_Define.h
+ * \brief State of the sort of the rotations of a block by Burrows Wheeler. The rotations are sorted on their first characters, then on twice as many at each round, until each group of equal rotations contains only one rotation
+ */
+
+typedef struct RotationSort{
+    uint32_t* indexes; /*!< beginnings of the rotations, sorted on their depth first characters*/
+    uint32_t* ranks; /*!< rank of each rotation : position in indexes of the first rotation of its group*/
+    uint64_t* keys; /*!< keys of a round : rank of the rotation depth characters later (32 high bits) and beginning of the rotation (32 low bits)*/
+    unsigned char* groups; /*!< 1 at the positions of indexes that begin a group*/
+    int size; /*!< number of rotations (size of the block)*/
+    int depth; /*!< number of characters on which the rotations are sorted*/
+}RotationSort;
+
+
+/**
+ * \struct RotationSortTask Structures_Define.h
+ * \brief Part of a round of the rotation sort done by one thread. Its range begins and ends at the beginning of a group, so that the threads never share a group
+ */
+
+typedef struct RotationSortTask{
+    RotationSort* sort; /*!< sort shared by all the threads*/
+    int begin; /*!< first position of indexes processed*/
+    int end; /*!< end of the range processed (excluded)*/
+    int unsorted; /*!< set to 1 if a group of the range still contains several rotations*/
+}RotationSortTask;
+
+
+/**
+ * \struct AsyncFile Structures_Define.h
+ * \brief File read or written by its own thread, so that the disk works while the blocks are coded. The chunks form a ring : the pipeline uses the chunk at head+count (writing) or head (reading), the thread the other ones. Without a thread, the calls go directly to the file
+ */
+
+typedef struct AsyncFile{
+    FILE* file; /*!< file read or written*/
+    int writing; /*!< 1 if the file is written, 0 if it's read*/
+    int threaded; /*!< 1 if a thread reads or writes the chunks*/
+    unsigned char* chunks[ASYNC_NB_CHUNKS]; /*!< ring of chunks*/
+    size_t sizes[ASYNC_NB_CHUNKS]; /*!< number of bytes of each chunk*/
+    int head; /*!< oldest chunk of the ring (next one read by the pipeline, or written by the thread)*/
+    int count; /*!< number of chunks ready (read by the thread, or filled by the pipeline)*/
+    size_t pos; /*!< position of the pipeline in its chunk*/
+    int end; /*!< 1 once the thread has read the whole file, or once the pipeline has written everything*/
+    int error; /*!< 1 if a read or a write failed*/
+    FileBuffer* memory; /*!< buffer in which the data is written instead of a file (asyncOpenMemory), NULL otherwise*/
+    size_t capacity; /*!< size allocated for memory->text*/
+    pthread_t thread; /*!< thread reading or writing the chunks*/
+    pthread_mutex_t mutex; /*!< protects head, count, end and error*/
+    pthread_cond_t changed; /*!< signaled each time a chunk is given to the other side*/
+}AsyncFile;
+
+
+/**
+ * \struct Dictionary Structures_Define.h
+ * \brief Huffman table and tree trained on a sample of files, used for the small blocks instead of a tree of their own
+ */
+
+typedef struct Dictionary{
+    uint32_t id; /*!< ID of the dictionary, saved in the blocks coded with it*/
+    Arena arena; /*!< memory of the table and of the tree, freed with the dictionary*/
+    HuffmanTableCell* huffmanTable; /*!< table used to code the blocks, it contains every character*/
+    int sizeHuffmanTable; /*!< size of huffmanTable*/
+    HuffmanTreePtr huffmanTree; /*!< tree used to decode the blocks*/
+    int maxCodeLength; /*!< length of the longest code of the table*/
+}Dictionary;
+
+
+/**
+ * \struct AdaptiveModel Structures_Define.h
+ * \brief Huffman codes of a live stream, rebuilt regularly from the occurrences of the characters already coded. The coder and the decoder update it in the same way so that they always have the same codes
+ */
+
+typedef struct AdaptiveModel{
+    long counts[N_ASCII]; /*!< occurrences of each character (at least 1), halved at each rebuild so that the recent characters weigh more*/
+    uint64_t codes[N_ASCII]; /*!< current code of each character*/
+    unsigned char lengths[N_ASCII]; /*!< length of the current code of each character*/
+    int maxLength; /*!< length of the longest current code*/
+    int untilRebuild; /*!< number of characters coded before the next rebuild, 0 if the codes weren't built yet*/
+    int interval; /*!< number of characters between the last rebuild and the next one*/
+    HuffmanTreePtr huffmanTree; /*!< current tree, used by the decoder for the long codes*/
+    DecodeEntry decodeTable[1 << DECODE_TABLE_BITS]; /*!< table of the decoder for the current codes*/
+    Arena arena; /*!< memory of the current tree, reset at each rebuild*/
+}AdaptiveModel;
+
+
+/**
+ * \struct DedupEntry Structures_Define.h
+ * \brief Block already compressed, found by the hash of its data
+ */
+
+typedef struct DedupEntry{
+    uint64_t hash; /*!< hash of the data*/
+    int size; /*!< size of the data, 0 if the entry is empty*/
+    unsigned char* block; /*!< copy of the block, compared with a block of the same hash (NULL for the blocks of an archive)*/
+    unsigned char* coded; /*!< header and data of the compressed block, written again for the same block (NULL for the blocks of an archive)*/
+    int sizeCoded; /*!< size of coded*/
+    long long offset; /*!< position of the compressed block in the archive, -1 if it's not in an archive*/
+}DedupEntry;
+
+/**
+ * \struct DedupTable Structures_Define.h
+ * \brief Hash table of the blocks already compressed (open addressing), shared by the files of a same run and by the threads creating an archive
+ */
+
+typedef struct DedupTable{
+    DedupEntry* entries; /*!< entries, their number is a power of 2*/
+    int capacity; /*!< number of entries allocated*/
+    int nbEntries; /*!< number of entries used*/
+    size_t memory; /*!< size of the copies of the blocks and of their compressed data*/
+    size_t limit; /*!< largest size of the copies, the blocks aren't kept beyond it (0 to keep none)*/
+    int hits; /*!< number of blocks found*/
+    pthread_mutex_t mutex; /*!< protects the table*/
+}DedupTable;
+
+
+/**
+ * \struct DeadlineBudget Structures_Define.h
+ * \brief Time allowed to compress a file and measured cost of the modes, used to choose cheaper modes for the next blocks when the time left is short
+ */
+
+typedef struct DeadlineBudget{
+    long long budgetNs; /*!< time allowed to compress each file, 0 if there isn't any limit*/
+    long long endNs; /*!< time at which the compression of the current file has to be finished*/
+    long long bytesLeft; /*!< size of the data of the current file not compressed yet (current block included), -1 if it's not known*/
+    double bwtNsPerByte; /*!< time of the chain of transforms for one byte, measured on the previous blocks*/
+    double codingNsPerByte; /*!< time of the creation of the tables and of the coding for one byte, measured on the previous blocks*/
+    double lz77NsPerByte; /*!< time of LZ77 for one byte, measured on the previous blocks*/
+}DeadlineBudget;
+
+
+/**
+ * \enum TransformId Structures_Define.h
+ * \brief Transforms that can be applied to a block before its coding, the ID is saved in the chain of the block
+ */
+
+typedef enum TransformId{
+    TRANSFORM_BWT, /*!< Burrows Wheeler, its parameter is its index (4 bytes)*/
+    TRANSFORM_MTF, /*!< Move To Front*/
+    TRANSFORM_RLE, /*!< run length encoding : after RLE_MIN_RUN identical characters, the number of other repetitions (1 byte)*/
+    N_TRANSFORMS /*!< number of transforms*/
+}TransformId;
+
+
+/**
+ * \struct TransformChain Structures_Define.h
+ * \brief Transforms applied to a block, in their order, with what their inverses need
+ */
+
+typedef struct TransformChain{
+    int nbTransforms; /*!< number of transforms*/
+    TransformId ids[TRANSFORM_MAX_CHAIN]; /*!< ID of each transform*/
+    unsigned char params[TRANSFORM_MAX_CHAIN][TRANSFORM_MAX_PARAMS]; /*!< parameters saved by each transform*/
+    int sizeParams[TRANSFORM_MAX_CHAIN]; /*!< size of the parameters of each transform*/
+    int sizes[TRANSFORM_MAX_CHAIN]; /*!< size of the block after each transform*/
+}TransformChain;
+
+
+/**
+ * \struct ChunkSettings Structures_Define.h
+ * \brief Sizes of the blocks cut by their content (findChunkEnd) and split by their statistics (splitChunk), set by the compression level
+ */
+
+typedef struct ChunkSettings{
+    int minSize; /*!< smallest size of a chunk, the end of a chunk is looked for after it (CHUNK_MIN_SIZE by default)*/
+    int maskBits; /*!< a chunk ends after a byte when the maskBits high bits of the rolling hash are 0 (CHUNK_MASK_BITS by default), so the chunks are about minSize + 2^maskBits bytes long*/
+    int maxSize; /*!< largest size of a chunk, at most BLOCK_SIZE*/
+    int splitMinSize; /*!< smallest size of the blocks a chunk is split into when the statistics of its parts are different (SPLIT_MIN_SIZE by default), 0 if the chunks aren't split*/
+}ChunkSettings;
+
+
+/**
+ * \enum CoderChoice Structures_Define.h
+ * \brief Coders that can be chosen for the blocks that aren't stored (--coder)
+ */
+
+typedef enum CoderChoice{
+    CODER_AUTO, /*!< Huffman or tANS, the one whose estimated size is the smallest*/
+    CODER_HUFFMAN, /*!< Huffman only, faster to code*/
+    CODER_TANS, /*!< tANS when its buffers fit in the memory, even if Huffman would be smaller*/
+    CODER_BIGRAM /*!< Huffman codes of the characters and of the most frequent pairs of characters (bigram mode) when the block is large enough, even if Huffman would be smaller*/
+}CoderChoice;
+
+
+/**
+ * \enum DaemonOperation Structures_Define.h
+ * \brief Operations that can be asked to the daemon
+ */
+
+typedef enum DaemonOperation{
+    DAEMON_COMPRESS, /*!< compression of the input file in the output file*/
+    DAEMON_DECOMPRESS, /*!< decompression of the input file (compressed block by block) in the output file*/
+    N_DAEMON_OPERATIONS /*!< number of operations*/
+}DaemonOperation;
+
+
+/**
+ * \struct CompressionLevel Structures_Define.h
+ * \brief Settings of a compression level (--level), the other options can change each of them
+ */
+
+typedef struct CompressionLevel{
+    const char* description; /*!< use of the level, displayed by --explain*/
+    ChunkSettings chunks; /*!< sizes of the blocks*/
+    const char* transforms; /*!< chain of transforms (as in --transforms)*/
+    int lzWindow; /*!< window of LZ77, which replaces the transforms, 0 if LZ77 isn't used*/
+    int lzDepth; /*!< depth of LZ77*/
+    CoderChoice coder; /*!< coder of the blocks*/
+}CompressionLevel;
+
+
+/**
+ * \struct LzSettings Structures_Define.h
+ * \brief Parameters of the search of the matches of LZ77
+ */
+
+typedef struct LzSettings{
+    int window; /*!< largest distance of a match, 0 if LZ77 isn't used*/
+    int depth; /*!< number of previous positions with the same hash compared at each position*/
+}LzSettings;
+
+
+/**
+ * \struct PipelineContext Structures_Define.h
+ * \brief State shared by the stages of the compressions and decompressions made by a same user of the functions
+ */
+
+typedef struct PipelineContext{
+    PipelineStats* stats; /*!< measures of the current operation, NULL if nothing is measured*/
+    Arena arena; /*!< memory of the Huffman trees and tables, reset after each file*/
+    ScratchPool scratch; /*!< scratch buffers of the stages*/
+    Dictionary* dictionary; /*!< dictionary used for the small blocks, NULL if there isn't one*/
+    int nbThreads; /*!< number of threads that a stage can use*/
+    int live; /*!< 1 if the data comes from a live stream : the input isn't read in advance and each block is written as soon as it's decoded*/
+    AdaptiveModel* adaptive; /*!< codes of the blocks of a live stream while one is decompressed, NULL otherwise*/
+    DedupTable* dedup; /*!< blocks already compressed, written again without being compressed when they are found, NULL to compress every block*/
+    FILE* archive; /*!< archive in which the references to other blocks are read while a file of an archive is extracted, NULL otherwise*/
+    FILE* previous; /*!< previous compressed file of the file compressed, whose chunks are copied when they didn't change (--update), NULL otherwise*/
+    DedupTable* chunks; /*!< chunks of previous, found by their hash and size*/
+    DeadlineBudget deadline; /*!< time allowed to compress each file (deadline.budgetNs, 0 if there isn't any limit) and measured cost of the modes*/
+    LzSettings lz; /*!< parameters of LZ77, used instead of Burrows Wheeler if lz.window isn't 0 (--lz77)*/
+    TransformChain transforms; /*!< transforms applied to the blocks for which the analysis chooses Burrows Wheeler (--transforms), only their IDs are used. Burrows Wheeler isn't considered if it's empty*/
+    ChunkSettings chunking; /*!< sizes of the blocks cut by their content*/
+    CoderChoice coder; /*!< coder of the blocks (--coder)*/
+}PipelineContext;
+
+
+/**
+ * \struct TransformStage Structures_Define.h
+ * \brief Functions of a transform, found in the registry by its ID. The driver (applyTransforms, decodeTransforms) chains them, gives them their buffers and measures them
+ */
+
+typedef struct TransformStage{
+    const char* name; /*!< name of the transform in --transforms and in the measures*/
+    int inPlace; /*!< 1 if the transform writes its result in its input, 0 if it writes it in the spare scratch slot*/
+    PipelineStage stage; /*!< stage measuring the transform*/
+    PipelineStage decodeStage; /*!< stage measuring its inverse*/
+    int (*encode)(FileBuffer* buffer, unsigned char* params, ScratchSlot spare, long long deadlineNs, PipelineContext* context); /*!< applies the transform to buffer (buffer->text points to the spare slot after it if it isn't in place) and saves its parameters in params. Returns the size of the parameters, TRANSFORM_SKIPPED or TRANSFORM_STOPPED*/
+    int (*decode)(FileBuffer* buffer, int sizeOut, const unsigned char* params, int sizeParams, ScratchSlot spare, AsyncFile* fileOut, PipelineContext* context); /*!< applies the inverse to buffer (buffer->text can point to the spare slot after it), whose size must become sizeOut. If fileOut isn't NULL, the result can be written in it instead. Returns 1 if it was written in fileOut. The program is stopped if the data or the parameters are incorrect*/
+    void (*scratchSizes)(int size, ScratchSlot spare, size_t sizes[N_SCRATCH_SLOTS]); /*!< adds the size of the scratch buffers used by the transform for a block of size bytes*/
+}TransformStage;
+
+
+/**
+ * \struct ArchiveEntry Structures_Define.h
+ * \brief File of an archive, as described by the central directory
+ */
+
+typedef struct ArchiveEntry{
+    char* name; /*!< name of the file in the archive, its folders are separated by '/'*/
+    long long size; /*!< size of the file*/
+    long long offset; /*!< position in the archive of the compressed file (written like the files compressed alone, except for the references to the blocks of the previous files)*/
+    long long compressedSize; /*!< size of the compressed file*/
+}ArchiveEntry;
+
+/**
+ * \struct Archive Structures_Define.h
+ * \brief Central directory of an archive
+ */
+
+typedef struct Archive{
+    ArchiveEntry* entries; /*!< files of the archive, in the order of their data*/
+    int nbEntries; /*!< number of files*/
+    int capacity; /*!< number of entries allocated*/
+}Archive;
+
+/**
+ * \struct ArchiveJob Structures_Define.h
+ * \brief Work shared by the threads creating or extracting an archive, each thread takes the next file and has its own context
+ */
+
+typedef struct ArchiveJob{
+    Archive* archive; /*!< files of the archive*/
+    const char* archiveName; /*!< name of the archive, opened by each thread when it's extracted*/
+    FILE* fileOut; /*!< archive written when it's created*/
+    char** selected; /*!< names of the files (or folders) extracted*/
+    int nbSelected; /*!< number of names in selected, 0 to extract all the files*/
+    int next; /*!< index of the next file taken by a thread*/
+    int turn; /*!< index of the next file written in the archive, so that the files are in the same order whatever the number of threads*/
+    long long offset; /*!< position in the archive of the next file written*/
+    DedupTable* references; /*!< compressed blocks already written in the archive, a block written again is replaced by a reference to it*/
+    int nbReferences; /*!< number of blocks replaced by a reference*/
+    PipelineContext* context; /*!< context of the caller : dictionary, number of threads, memory limit and huge pages shared by the threads*/
+    int nbWorkers; /*!< number of threads*/
+    pthread_mutex_t mutex; /*!< protects next, turn, offset, references and nbReferences*/
+    pthread_cond_t turnChanged; /*!< signaled when a file was written in the archive*/
+}ArchiveJob;
+
+
+/**
+ * \struct SearchBlock Structures_Define.h
+ * \brief Block of a compressed file searched, as described by its header
+ */
+
+typedef struct SearchBlock{
+    long long offset; /*!< position of the header of the block in the file*/
+    BlockMode mode; /*!< mode of the block (without BLOCK_MAP_FLAG)*/
+    int sizeOut; /*!< size of the block once decompressed*/
+    int sizeCoded; /*!< size of the data of the block after its header (map included)*/
+    int hasMap; /*!< 1 if the header of the block is followed by the map of its characters*/
+    unsigned char map[BLOCK_MAP_SIZE]; /*!< map of the characters of the block, a bit per character*/
+    int selected; /*!< 1 if the block may contain the pattern (or a part of it at one of its ends), so it's decoded*/
+    FileBuffer text; /*!< decompressed block, NULL if it isn't decoded*/
+}SearchBlock;
+
+/**
+ * \struct SearchJob Structures_Define.h
+ * \brief Search of a pattern in a compressed file (alone or in an archive) : the selected blocks of a window are decoded in parallel, each thread with its own context, then the main thread looks for the pattern in them in order
+ */
+
+typedef struct SearchJob{
+    const unsigned char* pattern; /*!< pattern looked for*/
+    int sizePattern; /*!< size of the pattern*/
+    const char* label; /*!< name written before the lines found, NULL to write only the lines*/
+    SearchBlock* blocks; /*!< blocks of the compressed file*/
+    int nbBlocks; /*!< number of blocks*/
+    int next; /*!< next block of the window taken by a thread*/
+    int end; /*!< block after the window*/
+    PipelineContext* contexts; /*!< context of each thread, the first one is also used by the main thread*/
+    FILE** files; /*!< compressed file (or archive) opened by each thread*/
+    int nbWorkers; /*!< number of threads*/
+    int nextWorker; /*!< thread started next, it uses the context and the file of this index*/
+    FileBuffer line; /*!< end of the blocks already searched after their last line break (beginning of the current line), SEARCH_MAX_LINE bytes are allocated*/
+    int lineKnown; /*!< 1 if line begins at the beginning of its line, 0 if the block before wasn't decoded*/
+    int lineTooLong; /*!< 1 if the current line is longer than SEARCH_MAX_LINE bytes, line only contains its end then*/
+    int lineFound; /*!< 1 if line contains the pattern*/
+    long long nbFound; /*!< number of lines found*/
+    PipelineStats* stats; /*!< measures of the caller (blocks decoded and skipped), can be NULL*/
+    pthread_mutex_t mutex; /*!< protects next and nextWorker*/
+}SearchJob;
+
+
+/**
+ * \enum ProgramMode Structures_Define.h
+ * \brief Action chosen by the user
+ */
+
+typedef enum ProgramMode{
+    MODE_MENU, /*!< the action is chosen in the menu*/
+    MODE_COMPRESS, /*!< compression of a file*/
+    MODE_DECOMPRESS, /*!< decompression of a file*/
+    MODE_TRAIN, /*!< creation of a dictionary from sample files*/
+    MODE_ARCHIVE, /*!< creation of an archive from files and folders*/
+    MODE_LIST, /*!< list of the files of an archive*/
+    MODE_EXTRACT, /*!< extraction of files from an archive*/
+    MODE_SEARCH, /*!< search of a pattern in compressed files or archives*/
+    MODE_DAEMON, /*!< daemon compressing and decompressing the files of its clients*/
+    MODE_CLIENT /*!< compression or decompression of files by a daemon*/
+}ProgramMode;
+
+
+/**
+ * \enum StatsFormat Structures_Define.h
+ * \brief Format in which the measures of the stages are displayed at the end
+ */
+
+typedef enum StatsFormat{
+    STATS_NONE, /*!< nothing is displayed*/
+    STATS_TEXT, /*!< table that can be read by the user*/
+    STATS_JSON /*!< one JSON object, the status messages and the progress aren't displayed*/
+}StatsFormat;
+
+
+/**
+ * \struct ProgramOptions Structures_Define.h
+ * \brief Options given in the command line
+ */
+
+typedef struct ProgramOptions{
+    ProgramMode mode; /*!< action chosen*/
+    StatsFormat statsFormat; /*!< format of the measures displayed at the end*/
+    int quiet; /*!< if 1 then the status messages and the progress aren't displayed*/
+    int perfCounters; /*!< if 1 then the hardware counters of each stage are added to the measures*/
+    int hugePages; /*!< if 1 then the large scratch buffers are backed by huge pages*/
+    long long maxMemory; /*!< largest size of the scratch buffers given with --max-memory, 0 if there isn't any limit*/
+    char* dictionary; /*!< name of the dictionary file given with --dict, NULL if there isn't one*/
+    int nbThreads; /*!< number of threads given with --threads, 0 to use one thread per processor*/
+    int stream; /*!< if 1 then the standard input is compressed or decompressed live in the standard output (--stream)*/
+    int latency; /*!< latency bound of a live stream in milliseconds, given with --latency*/
+    char* update; /*!< name of the previous compressed file given with --update, NULL if there isn't one*/
+    int deadline; /*!< time allowed to compress each file in milliseconds (--deadline), 0 if there isn't any limit*/
+    int lzWindow; /*!< largest distance of a match of LZ77 (--lz77, --lz-window), 0 if LZ77 isn't used*/
+    int lzDepth; /*!< number of positions compared by LZ77 to find a match (--lz-depth)*/
+    TransformChain transforms; /*!< transforms given with --transforms (their IDs), the ones of the level otherwise*/
+    int level; /*!< compression level given with --level, LEVEL_DEFAULT otherwise. Its settings are the default values of the other options*/
+    ChunkSettings chunking; /*!< sizes of the blocks, set by the level*/
+    CoderChoice coder; /*!< coder given with --coder, the one of the level otherwise*/
+    int explain; /*!< if 1 then the effective settings are displayed before the compression (--explain)*/
+    char** fileNames; /*!< names of the files given in the command line (for train : the dictionary then the samples, for archive, list and extract : the archive then the files, for search : the pattern then the files, for daemon : the socket, for client : the socket, the operation then the files)*/
+    int nbFiles; /*!< number of names in fileNames*/
+}ProgramOptions;
+
+
+typedef void (*ProgressCallback)(const char* task, long long done, long long total, void* userData);
+
+/**
+ * \struct Progress Structures_Define.h
+ * \brief Progress of a long task. The task reports its progress only when it reaches the position next, so that it doesn't have to test anything else in its loops
+ */
+
+typedef struct Progress{
+    const char* task; /*!< name of the task*/
+    long long total; /*!< number of elements processed by the task*/
+    long long next; /*!< position at which the progress is reported*/
+    long long step; /*!< number of elements between 2 reports*/
+}Progress;
+
 #endif
@@ -0,0 +1,386 @@
+/**
+ * \file Analysis.c
+ * \brief Fast analysis of a block (entropy, exact size of its Huffman coding, gain expected from Burrows Wheeler) used to choose how it's compressed
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+#include <math.h>
+
+
+/**
+ * \def SAMPLE_MIN_SIZE Blocks at least this large are first analysed on a sample, so that the incompressible ones are detected without reading them entirely
+ */
+
+#define SAMPLE_MIN_SIZE (64*1024)
+
+/**
+ * \def SAMPLE_WINDOWS Number of windows, spread over the block, read for the sample
+ */
+
+#define SAMPLE_WINDOWS 16
+
+/**
+ * \def SAMPLE_WINDOW_SIZE Number of bytes read in each window of the sample
+ */
+
+#define SAMPLE_WINDOW_SIZE 1024
+
+/**
+ * \def SAMPLE_STORED_ENTROPY If the entropy of the sample (in bits per byte) is at least this value then the block is stored
+ */
+
+#define SAMPLE_STORED_ENTROPY 7.9
+
+/**
+ * \def MIN_GAIN_DIVISOR A block is coded only if it saves at least 1/MIN_GAIN_DIVISOR of its size, otherwise it's stored
+ */
+
+#define MIN_GAIN_DIVISOR 32
+
+/**
+ * \def ORDER1_PAIR_COST Cost in bits added for each different pair of consecutive characters, so that the order 1 estimation of small blocks isn't too optimistic
+ */
+
+#define ORDER1_PAIR_COST 6
+
+/**
+ * \def BWT_MIN_GAIN Burrows Wheeler is applied if the order 1 estimation is lower than this fraction of the Huffman coding
+ */
+
+#define BWT_MIN_GAIN 0.9
+
+/**
+ * \def PROBE_HASH_BITS Number of bits of the hash of the positions inserted in the table of the probe of the repetitions
+ */
+
+#define PROBE_HASH_BITS 14
+
+/**
+ * \def PROBE_STEP The probe of the repetitions inserts one position of the block every PROBE_STEP bytes in its table
+ */
+
+#define PROBE_STEP 16
+
+/**
+ * \def PROBE_MATCH_LENGTH Number of characters that must be the same at 2 positions for the probe to count a repetition
+ */
+
+#define PROBE_MATCH_LENGTH 8
+
+/**
+ * \def PROBE_MIN_RATIO The block has repetitions if at least 1/PROBE_MIN_RATIO of the positions of the sample are estimated to be repeated
+ */
+
+#define PROBE_MIN_RATIO 4
+
+
+
+/**
+ * \fn void countOccurrences(FileBuffer buffer, long counts[N_ASCII])
+ * \brief Counts the occurrences of each character of the buffer. 4 arrays are filled alternately so that consecutive identical characters don't wait for each other
+ * \param buffer Buffer read
+ * \param counts Number of occurrences of each character, filled here
+ */
+
+void countOccurrences(FileBuffer buffer, long counts[N_ASCII])
+{
+    long partialCounts[4][N_ASCII];
+    int pos=0;
+    memset(partialCounts, 0, sizeof(partialCounts));
+    for(; pos+4<=buffer.size; pos+=4){
+        partialCounts[0][buffer.text[pos]]++;
+        partialCounts[1][buffer.text[pos+1]]++;
+        partialCounts[2][buffer.text[pos+2]]++;
+        partialCounts[3][buffer.text[pos+3]]++;
+    }
+    for(; pos<buffer.size; pos++)
+        partialCounts[0][buffer.text[pos]]++;
+    for(int c=0; c<N_ASCII; c++)
+        counts[c] = partialCounts[0][c]+partialCounts[1][c]+partialCounts[2][c]+partialCounts[3][c];
+}
+
+/**
+ * \fn void fillCharacterMap(FileBuffer buffer, const long counts[N_ASCII], unsigned char map[BLOCK_MAP_SIZE])
+ * \brief Fills the map of the characters of a buffer (bit c%8 of the byte c/8 is 1 if the character c is in it), from its occurrences if they are already counted
+ * \param buffer Buffer read if counts is NULL
+ * \param counts Number of occurrences of each character of the buffer, NULL if they aren't counted
+ * \param map Map filled
+ */
+
+void fillCharacterMap(FileBuffer buffer, const long counts[N_ASCII], unsigned char map[BLOCK_MAP_SIZE])
+{
+    memset(map, 0, BLOCK_MAP_SIZE);
+    if(counts!=NULL){
+        for(int c=0; c<N_ASCII; c++){
+            if(counts[c]>0)
+                map[c/8] |= 1 << (c%8);
+        }
+    }
+    else{
+        for(int pos=0; pos<buffer.size; pos++)
+            map[buffer.text[pos]/8] |= 1 << (buffer.text[pos]%8);
+    }
+}
+
+/**
+ * \fn double entropyOfCounts(long counts[N_ASCII])
+ * \brief Computes the entropy (order 0) of the characters counted
+ * \param counts Number of occurrences of each character
+ * \return Entropy in bits per byte, between 0 and 8
+ */
+
+double entropyOfCounts(long counts[N_ASCII])
+{
+    long total=0;
+    double bits=0;
+    for(int c=0; c<N_ASCII; c++)
+        total += counts[c];
+    if(total==0)
+        return 0;
+    for(int c=0; c<N_ASCII; c++){
+        if(counts[c]>0)
+            bits -= counts[c]*log2((double) counts[c]/total);
+    }
+    return bits/total;
+}
+
+/**
+ * \fn static int compareCounts(const void* a, const void* b)
+ * \brief Compares 2 cells (count, character) of an array sorted by huffmanSizeBits, used by qsort
+ */
+
+static int compareCounts(const void* a, const void* b)
+{
+    const long* cellA = (const long*) a;
+    const long* cellB = (const long*) b;
+    if(cellA[0]!=cellB[0])
+        return (cellA[0]<cellB[0]) ? -1 : 1;
+    return (cellA[1]<cellB[1]) ? -1 : (cellA[1]>cellB[1]);
+}
+
+/**
+ * \fn long long huffmanSizeBits(long counts[N_ASCII], int lengths[N_ASCII])
+ * \brief Computes the length of the Huffman code of each character without building the tree : the leaves are sorted, then the merged nodes are created in increasing order so that 2 queues are enough to find the minimums
+ * \param counts Number of occurrences of each character
+ * \param lengths Length of the code of each character, filled here (0 for the characters that aren't present). Can be NULL
+ * \return Size in bits of the Huffman coding of all the characters counted. Every Huffman tree of these counts gives this size
+ */
+
+long long huffmanSizeBits(long counts[N_ASCII], int lengths[N_ASCII])
+{
+    long leaves[N_ASCII][2]; // count, character
+    long weights[2*N_ASCII];
+    int parents[2*N_ASCII];
+    int depths[2*N_ASCII];
+    int nbLeaves=0;
+    long long bits=0;
+
+    for(int c=0; c<N_ASCII; c++){
+        if(lengths!=NULL)
+            lengths[c]=0;
+        if(counts[c]>0){
+            leaves[nbLeaves][0] = counts[c];
+            leaves[nbLeaves][1] = c;
+            nbLeaves++;
+        }
+    }
+    if(nbLeaves<2){ // Only one character : 1 bit per character
+        for(int c=0; c<N_ASCII && nbLeaves==1; c++){
+            if(counts[c]>0){
+                if(lengths!=NULL)
+                    lengths[c]=1;
+                bits = counts[c];
+            }
+        }
+        return bits;
+    }
+
+    qsort(leaves, nbLeaves, sizeof(leaves[0]), compareCounts);
+    for(int i=0; i<nbLeaves; i++)
+        weights[i] = leaves[i][0];
+
+    // Nodes 0 to nbLeaves-1 are the leaves, the next ones are the merged nodes, in the order of their creation
+    int nextLeaf=0;
+    int nextMerged=nbLeaves;
+    for(int node=nbLeaves; node<2*nbLeaves-1; node++){
+        int children[2];
+        for(int k=0; k<2; k++){
+            if(nextLeaf<nbLeaves && (nextMerged>=node || weights[nextLeaf]<=weights[nextMerged]))
+                children[k] = nextLeaf++;
+            else
+                children[k] = nextMerged++;
+        }
+        weights[node] = weights[children[0]]+weights[children[1]];
+        parents[children[0]] = node;
+        parents[children[1]] = node;
+    }
+
+    depths[2*nbLeaves-2] = 0;
+    for(int node=2*nbLeaves-3; node>=0; node--)
+        depths[node] = depths[parents[node]]+1;
+    for(int i=0; i<nbLeaves; i++){
+        if(lengths!=NULL)
+            lengths[leaves[i][1]] = depths[i];
+        bits += (long long) leaves[i][0]*depths[i];
+    }
+    return bits;
+}
+
+/**
+ * \fn long long order1SizeBits(Arena* arena, FileBuffer buffer)
+ * \brief Estimates the size of the buffer if each character was coded depending on the previous one. It's close to what Burrows Wheeler and Move To Front followed by Huffman give
+ * \param arena Arena in which the array of the pairs is allocated, it has to be reset by the caller
+ * \param buffer Buffer analysed, its size must be lower than 65536
+ * \return Estimated size in bits
+ */
+
+long long order1SizeBits(Arena* arena, FileBuffer buffer)
+{
+    uint16_t* pairs = (uint16_t*) arenaAlloc(arena, sizeof(uint16_t)*N_ASCII*N_ASCII); // pairs[previous*N_ASCII+c]
+    long contexts[N_ASCII]={0};
+    double bits=0;
+    long distinctPairs=0;
+
+    memset(pairs, 0, sizeof(uint16_t)*N_ASCII*N_ASCII);
+    for(int pos=1; pos<buffer.size; pos++){
+        pairs[buffer.text[pos-1]*N_ASCII+buffer.text[pos]]++;
+        contexts[buffer.text[pos-1]]++;
+    }
+    for(int previous=0; previous<N_ASCII; previous++){
+        if(contexts[previous]==0)
+            continue;
+        for(int c=0; c<N_ASCII; c++){
+            long n = pairs[previous*N_ASCII+c];
+            if(n>0){
+                bits -= n*log2((double) n/contexts[previous]);
+                distinctPairs++;
+            }
+        }
+    }
+    return (long long) bits + distinctPairs*ORDER1_PAIR_COST + 8;
+}
+
+/**
+ * \fn static uint32_t hashProbe(const unsigned char* text)
+ * \brief Hash of the PROBE_MATCH_LENGTH characters at a position, used by the probe of the repetitions
+ * \param text Position
+ * \return Hash on PROBE_HASH_BITS bits
+ */
+
+static uint32_t hashProbe(const unsigned char* text)
+{
+    uint64_t value;
+    memcpy(&value, text, sizeof(value));
+    return (uint32_t) ((value*0x9E3779B97F4A7C15ULL) >> (64-PROBE_HASH_BITS));
+}
+
+/**
+ * \fn static int probeRepetitions(Arena* arena, FileBuffer block, int window)
+ * \brief Checks quickly if a block has long repetitions, even if its characters look random (copies of compressed data). The positions of the sample (the windows of the entropy sample, or the whole small blocks) are looked for in a table of the previous positions, in which only one position every PROBE_STEP bytes is put : a repeated part gives one match every PROBE_STEP positions
+ * \param arena Arena in which the table is allocated, it has to be reset by the caller
+ * \param block Block analysed
+ * \param window Largest distance of a repetition
+ * \return 1 if at least 1/PROBE_MIN_RATIO of the positions of the sample are estimated to be repeated, 0 otherwise
+ */
+
+static int probeRepetitions(Arena* arena, FileBuffer block, int window)
+{
+    if(block.size<2*PROBE_MATCH_LENGTH)
+        return 0;
+    int* table = (int*) arenaAlloc(arena, sizeof(int) << PROBE_HASH_BITS);
+    memset(table, -1, sizeof(int) << PROBE_HASH_BITS);
+    int inserted=0; // Next position put in the table
+
+    int nbWindows = (block.size>=SAMPLE_MIN_SIZE) ? SAMPLE_WINDOWS : 1;
+    int sizeWindow = (block.size>=SAMPLE_MIN_SIZE) ? SAMPLE_WINDOW_SIZE : block.size-PROBE_MATCH_LENGTH+1;
+    long sampled=0;
+    long repeated=0;
+    for(int i=0; i<nbWindows; i++){
+        int start = (nbWindows>1) ? (int) ((long) i*(block.size-SAMPLE_WINDOW_SIZE)/(SAMPLE_WINDOWS-1)) : 0;
+        int end = (start+sizeWindow<=block.size-PROBE_MATCH_LENGTH+1) ? start+sizeWindow : block.size-PROBE_MATCH_LENGTH+1;
+        for(int pos=start; pos<end; pos++){
+            for(; inserted<pos; inserted+=PROBE_STEP)
+                table[hashProbe(block.text+inserted)] = inserted;
+            int other = table[hashProbe(block.text+pos)];
+            sampled++;
+            if(other>=0 && pos-other<=window && !memcmp(block.text+other, block.text+pos, PROBE_MATCH_LENGTH))
+                repeated++;
+        }
+    }
+    return (long long) repeated*PROBE_STEP*PROBE_MIN_RATIO>=sampled;
+}
+
+/**
+ * \fn void analyseBlock(Arena* arena, FileBuffer block, int allowBW, int lzWindow, BlockAnalysis* analysis)
+ * \brief Chooses how a block is compressed
+ * \details Large blocks whose sample is almost random are stored without reading them entirely, unless the probe finds long repetitions in them. Then the exact size of the Huffman coding (with the size of its tree) decides between storing and coding the block, and the order 1 estimation decides if Burrows Wheeler and Move To Front are worth their cost. The blocks with repetitions that look incompressible are given to Burrows Wheeler. With LZ77, they are given to LZ77 instead, like the ones for which Burrows Wheeler would be chosen, and it's kept only if it's smaller than the Huffman coding and than the block itself
+ * \param arena Arena used for the temporary arrays, it has to be reset by the caller
+ * \param block Block analysed
+ * \param allowBW If 1 then Burrows Wheeler can be chosen
+ * \param lzWindow Largest distance of a match of LZ77, 0 if LZ77 isn't used
+ * \param analysis Result of the analysis, filled here
+ */
+
+void analyseBlock(Arena* arena, FileBuffer block, int allowBW, int lzWindow, BlockAnalysis* analysis)
+{
+    analysis->sampled = 0;
+    analysis->order1Bits = -1;
+    analysis->huffmanBits = -1;
+    analysis->repetitive = (allowBW || lzWindow>0) && probeRepetitions(arena, block, (lzWindow>0) ? lzWindow : block.size);
+
+    if(block.size>=SAMPLE_MIN_SIZE){
+        FileBuffer window;
+        long sampleCounts[N_ASCII]={0};
+        long windowCounts[N_ASCII];
+        window.size = SAMPLE_WINDOW_SIZE;
+        for(int i=0; i<SAMPLE_WINDOWS; i++){
+            window.text = block.text + (long) i*(block.size-SAMPLE_WINDOW_SIZE)/(SAMPLE_WINDOWS-1);
+            countOccurrences(window, windowCounts);
+            for(int c=0; c<N_ASCII; c++)
+                sampleCounts[c] += windowCounts[c];
+        }
+        analysis->entropy = entropyOfCounts(sampleCounts);
+        if(analysis->entropy>=SAMPLE_STORED_ENTROPY && !analysis->repetitive){
+            analysis->sampled = 1;
+            analysis->symbols = 0;
+            for(int c=0; c<N_ASCII; c++)
+                analysis->symbols += (sampleCounts[c]>0);
+            analysis->mode = BLOCK_STORED;
+            return;
+        }
+    }
+
+    countOccurrences(block, analysis->counts);
+    analysis->symbols = 0;
+    for(int c=0; c<N_ASCII; c++)
+        analysis->symbols += (analysis->counts[c]>0);
+    analysis->entropy = entropyOfCounts(analysis->counts);
+    if(analysis->symbols<=1){
+        analysis->mode = (block.size>0) ? BLOCK_FILL : BLOCK_STORED;
+        return;
+    }
+
+    analysis->huffmanBits = huffmanSizeBits(analysis->counts, NULL);
+    long long huffmanBytes = (analysis->huffmanBits+7)/8 + 4 + analysis->symbols + (4*analysis->symbols)/8 + 1;
+    if(huffmanBytes > block.size-block.size/MIN_GAIN_DIVISOR){
+        analysis->mode = BLOCK_STORED;
+        if(analysis->repetitive && lzWindow>0) // The block is stored if LZ77 isn't smaller
+            analysis->mode = BLOCK_LZ77;
+        else if(analysis->repetitive && allowBW && block.size<=BWT_MAX_BLOCK) // Same for Burrows Wheeler
+            analysis->mode = BLOCK_BWT_HUFFMAN;
+        return;
+    }
+
+    analysis->mode = BLOCK_HUFFMAN;
+    if(allowBW && block.size<=BWT_MAX_BLOCK){
+        analysis->order1Bits = order1SizeBits(arena, block);
+        if(analysis->order1Bits < BWT_MIN_GAIN*analysis->huffmanBits)
+            analysis->mode = BLOCK_BWT_HUFFMAN;
+    }
+    if(lzWindow>0 && (analysis->mode==BLOCK_BWT_HUFFMAN || analysis->repetitive)) // The repetitions are coded by LZ77, much faster than Burrows Wheeler
+        analysis->mode = BLOCK_LZ77;
+}
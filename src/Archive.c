@@ -0,0 +1,636 @@
+/**
+ * \file Archive.c
+ * \brief Archives containing many files : each file is compressed like a file compressed alone, by a pool of threads, and a central directory at the end of the archive gives the name, size and position of each one so that a file can be listed or extracted without reading the others
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#if __WIN32__
+#include <direct.h>
+#endif
+
+
+/**
+ * \fn static void addArchiveEntry(Archive* archive, const char* name)
+ * \brief Adds a file at the end of the central directory. Its name is kept with '/' between its folders and without "./" or '/' at its beginning
+ * \param archive Central directory
+ * \param name Name of the file
+ */
+
+static void addArchiveEntry(Archive* archive, const char* name)
+{
+    if(archive->nbEntries==archive->capacity){
+        archive->capacity = (archive->capacity>0) ? 2*archive->capacity : 64;
+        archive->entries = (ArchiveEntry*) realloc(archive->entries, archive->capacity*sizeof(ArchiveEntry));
+        TESTALLOC(archive->entries);
+    }
+    while(!strncmp(name, "./", 2) || name[0]=='/' || name[0]=='\\')
+        name += (name[0]=='.') ? 2 : 1;
+
+    ArchiveEntry* entry = &(archive->entries[archive->nbEntries++]);
+    entry->name = (char*) malloc(strlen(name)+1);
+    TESTALLOC(entry->name);
+    strcpy(entry->name, name);
+    for(char* c=entry->name; *c!='\0'; c++){
+        if(*c=='\\')
+            *c = '/';
+    }
+    entry->size = 0;
+    entry->offset = 0;
+    entry->compressedSize = 0;
+}
+
+/**
+ * \fn static int compareNames(const void* a, const void* b)
+ * \brief Compares two names of files, used to sort the files of a folder
+ * \param a Pointer to the first name
+ * \param b Pointer to the second name
+ * \return Result of strcmp
+ */
+
+static int compareNames(const void* a, const void* b)
+{
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+/**
+ * \fn static void addArchivePath(Archive* archive, const char* path, const char* archiveName)
+ * \brief Adds a file to the central directory, or all the files of a folder and of its subfolders (the archive itself is skipped)
+ * \param archive Central directory
+ * \param path Name of the file or of the folder
+ * \param archiveName Name of the archive being created
+ */
+
+static void addArchivePath(Archive* archive, const char* path, const char* archiveName)
+{
+    struct stat info;
+    if(stat(path, &info)!=0){
+        fprintf(stderr, "\nERROR : Cannot open %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    if(!S_ISDIR(info.st_mode)){
+        if(strcmp(path, archiveName))
+            addArchiveEntry(archive, path);
+        return;
+    }
+
+    DIR* folder = opendir(path);
+    if(folder==NULL){
+        fprintf(stderr, "\nERROR : Cannot open the folder %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    // The files of the folder are sorted so that the archive doesn't depend on the order of the file system
+    struct dirent* file;
+    char** names = NULL;
+    int nbNames = 0;
+    while((file=readdir(folder))!=NULL){
+        if(!strcmp(file->d_name, ".") || !strcmp(file->d_name, ".."))
+            continue;
+        size_t sizePath = strlen(path);
+        names = (char**) realloc(names, (nbNames+1)*sizeof(char*));
+        TESTALLOC(names);
+        names[nbNames] = (char*) malloc(sizePath+strlen(file->d_name)+2);
+        TESTALLOC(names[nbNames]);
+        if(sizePath>0 && (path[sizePath-1]=='/' || path[sizePath-1]=='\\'))
+            sprintf(names[nbNames], "%s%s", path, file->d_name);
+        else
+            sprintf(names[nbNames], "%s/%s", path, file->d_name);
+        nbNames++;
+    }
+    closedir(folder);
+
+    if(nbNames>0)
+        qsort(names, nbNames, sizeof(char*), compareNames);
+    for(int i=0; i<nbNames; i++){
+        addArchivePath(archive, names[i], archiveName);
+        free(names[i]);
+    }
+    free(names);
+}
+
+/**
+ * \fn void freeArchive(Archive* archive)
+ * \brief Frees the central directory
+ * \param archive Central directory freed
+ */
+
+void freeArchive(Archive* archive)
+{
+    for(int i=0; i<archive->nbEntries; i++)
+        free(archive->entries[i].name);
+    free(archive->entries);
+    archive->entries = NULL;
+    archive->nbEntries = 0;
+    archive->capacity = 0;
+}
+
+/**
+ * \fn static void initWorkerContext(PipelineContext* context, ArchiveJob* job)
+ * \brief Initializes the context of a thread of the pool : it shares the dictionary, the table of the blocks already compressed, the time budget of each file and the parameters of LZ77 of the caller, and its threads and memory limit are divided between the threads of the pool
+ * \param context Context initialized
+ * \param job Work of the pool
+ */
+
+static void initWorkerContext(PipelineContext* context, ArchiveJob* job)
+{
+    initPipelineContext(context, job->context->scratch.hugePages);
+    setScratchLimit(&(context->scratch), job->context->scratch.limit/job->nbWorkers);
+    context->nbThreads = (job->context->nbThreads>job->nbWorkers) ? job->context->nbThreads/job->nbWorkers : 1;
+    context->dictionary = job->context->dictionary;
+    context->dedup = job->context->dedup;
+    context->deadline.budgetNs = job->context->deadline.budgetNs;
+    context->lz = job->context->lz;
+    context->transforms = job->context->transforms;
+    context->chunking = job->context->chunking;
+    context->coder = job->context->coder;
+}
+
+/**
+ * \fn static int takeNextFile(ArchiveJob* job)
+ * \brief Gives to a thread the next file that isn't taken
+ * \param job Work of the pool
+ * \return Index of the file, -1 if they are all taken
+ */
+
+static int takeNextFile(ArchiveJob* job)
+{
+    pthread_mutex_lock(&(job->mutex));
+    int index = (job->next<job->archive->nbEntries) ? job->next++ : -1;
+    pthread_mutex_unlock(&(job->mutex));
+    return index;
+}
+
+/**
+ * \fn static long long copyCompressedFile(ArchiveJob* job, FILE* fileTemp, PipelineContext* context)
+ * \brief Copies a compressed file at the end of the archive block by block. A block already written in the archive by a previous file (or earlier in the same file) is replaced by a reference to it. The mutex of the job has to be locked
+ * \param job Work of the pool, its archive is written
+ * \param fileTemp Compressed file, read from its beginning
+ * \param context Context of the thread, whose scratch buffers are used
+ * \return Size written in the archive
+ */
+
+static long long copyCompressedFile(ArchiveJob* job, FILE* fileTemp, PipelineContext* context)
+{
+    unsigned char header[BLOCK_HEADER_SIZE+BLOCK_MAP_SIZE+8];
+    long long written=5;
+
+    fileSeek(fileTemp, 0, SEEK_SET);
+    if(fread(header, sizeof(unsigned char), 5, fileTemp)!=5 || fwrite(header, sizeof(unsigned char), 5, job->fileOut)!=5){
+        fprintf(stderr, "\nERROR : Cannot write the archive\n");
+        exit(EXIT_FAILURE);
+    }
+    while(1){
+        if(fread(header, sizeof(unsigned char), 1, fileTemp)!=1){
+            fprintf(stderr, "\nERROR : Cannot read the compressed file\n");
+            exit(EXIT_FAILURE);
+        }
+        if(header[0]==BLOCK_END){
+            if(fread(header+1, sizeof(unsigned char), 8, fileTemp)!=8 || fwrite(header, sizeof(unsigned char), 9, job->fileOut)!=9){
+                fprintf(stderr, "\nERROR : Cannot write the archive\n");
+                exit(EXIT_FAILURE);
+            }
+            return written+9;
+        }
+        if(fread(header+1, sizeof(unsigned char), BLOCK_HEADER_SIZE-1, fileTemp)!=BLOCK_HEADER_SIZE-1){
+            fprintf(stderr, "\nERROR : Cannot read the compressed file\n");
+            exit(EXIT_FAILURE);
+        }
+        int sizeCoded = BLOCK_HEADER_SIZE+readNumber(header+5, 4);
+        unsigned char* coded = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_OUTPUT, sizeCoded);
+        memcpy(coded, header, BLOCK_HEADER_SIZE);
+        if(fread(coded+BLOCK_HEADER_SIZE, sizeof(unsigned char), sizeCoded-BLOCK_HEADER_SIZE, fileTemp)!=(size_t) (sizeCoded-BLOCK_HEADER_SIZE)){
+            fprintf(stderr, "\nERROR : Cannot read the compressed file\n");
+            exit(EXIT_FAILURE);
+        }
+
+        long long offset=-1;
+        uint64_t hash=0;
+        if(sizeCoded-BLOCK_HEADER_SIZE>=DEDUP_MIN_BLOCK){
+            hash = hashBlock(coded, sizeCoded);
+            offset = findArchiveBlock(job->references, coded, sizeCoded, hash, job->fileOut, (unsigned char*) scratchGet(&(context->scratch), SCRATCH_INPUT, sizeCoded));
+        }
+        if(offset>=0){ // The reference keeps the map of the characters of the block, so that the search can skip it
+            int sizeMap = (header[0] & BLOCK_MAP_FLAG) ? BLOCK_MAP_SIZE : 0;
+            header[0] = BLOCK_REFERENCE | (header[0] & BLOCK_MAP_FLAG);
+            writeNumber(header+5, sizeMap+8, 4);
+            memcpy(header+BLOCK_HEADER_SIZE, coded+BLOCK_HEADER_SIZE, sizeMap);
+            writeNumber(header+BLOCK_HEADER_SIZE+sizeMap, offset, 8);
+            coded = header;
+            sizeCoded = BLOCK_HEADER_SIZE+sizeMap+8;
+            job->nbReferences++;
+        }
+        else if(sizeCoded-BLOCK_HEADER_SIZE>=DEDUP_MIN_BLOCK)
+            addArchiveBlock(job->references, hash, sizeCoded, job->offset+written);
+        if(fwrite(coded, sizeof(unsigned char), sizeCoded, job->fileOut)!=(size_t) sizeCoded){
+            fprintf(stderr, "\nERROR : Cannot write the archive\n");
+            exit(EXIT_FAILURE);
+        }
+        written += sizeCoded;
+    }
+}
+
+/**
+ * \fn static void* compressFiles(void* argument)
+ * \brief Thread of the pool creating an archive : compresses the next file in a temporary file, then copies it in the archive when the previous files are written
+ * \param argument ArchiveJob
+ * \return NULL
+ */
+
+static void* compressFiles(void* argument)
+{
+    ArchiveJob* job = (ArchiveJob*) argument;
+    PipelineContext context;
+    FILE* fileTemp = NULL;
+    int index;
+
+    initWorkerContext(&context, job);
+    while((index=takeNextFile(job))>=0){
+        ArchiveEntry* entry = &(job->archive->entries[index]);
+        FILE* fileIn = fopen(entry->name, "rb");
+        if(fileIn==NULL){
+            fprintf(stderr, "\nERROR : Cannot open %s\n", entry->name);
+            exit(EXIT_FAILURE);
+        }
+        if(fileTemp==NULL){ // The same temporary file is reused for all the files of the thread
+            fileTemp = tmpfile();
+            TESTFOPEN(fileTemp);
+        }
+        entry->size = seekSizeOfFile(fileIn);
+        rewind(fileTemp);
+        compressStream(fileIn, entry->size, fileTemp, &context);
+        FCLOSE(fileIn);
+
+        pthread_mutex_lock(&(job->mutex));
+        while(job->turn!=index)
+            pthread_cond_wait(&(job->turnChanged), &(job->mutex));
+        entry->offset = job->offset;
+        entry->compressedSize = copyCompressedFile(job, fileTemp, &context);
+        job->offset += entry->compressedSize;
+        job->turn++;
+        pthread_cond_broadcast(&(job->turnChanged));
+        pthread_mutex_unlock(&(job->mutex));
+    }
+    if(fileTemp!=NULL)
+        FCLOSE(fileTemp);
+    freePipelineContext(&context);
+    return NULL;
+}
+
+/**
+ * \fn static int isSelected(ArchiveJob* job, const char* name)
+ * \brief Checks if a file of the archive has to be extracted : its name or one of its folders was given
+ * \param job Work of the pool
+ * \param name Name of the file in the archive
+ * \return 1 if the file is extracted, 0 otherwise
+ */
+
+static int isSelected(ArchiveJob* job, const char* name)
+{
+    if(job->nbSelected==0)
+        return 1;
+    for(int i=0; i<job->nbSelected; i++){
+        size_t size = strlen(job->selected[i]);
+        if(!strncmp(name, job->selected[i], size) && (name[size]=='\0' || name[size]=='/'))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * \fn static int isSafeName(const char* name)
+ * \brief Checks that a file of an archive is extracted in the current folder : its name isn't absolute and none of its folders is ".."
+ * \param name Name of the file in the archive
+ * \return 1 if the name is safe, 0 otherwise
+ */
+
+static int isSafeName(const char* name)
+{
+    if(name[0]=='/' || strchr(name, ':')!=NULL) // Absolute name, or drive on Windows
+        return 0;
+    for(const char* part=name; part!=NULL; part=strchr(part, '/')){
+        if(*part=='/')
+            part++;
+        if(!strncmp(part, "..", 2) && (part[2]=='/' || part[2]=='\0'))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * \fn static void createFolders(const char* name)
+ * \brief Creates the folders of a file extracted if they don't exist
+ * \param name Name of the file, its folders are separated by '/'
+ */
+
+static void createFolders(const char* name)
+{
+    char path[FILENAME_MAX];
+    for(int i=0; name[i]!='\0' && i<FILENAME_MAX-1; i++){
+        if(name[i]=='/' && i>0){
+            memcpy(path, name, i);
+            path[i] = '\0';
+            #if __WIN32__
+            int failed = _mkdir(path)!=0;
+            #else
+            int failed = mkdir(path, 0777)!=0;
+            #endif
+            if(failed && errno!=EEXIST){
+                fprintf(stderr, "\nERROR : Cannot create the folder %s\n", path);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+}
+
+/**
+ * \fn static void* extractFiles(void* argument)
+ * \brief Thread of the pool extracting files : opens the archive on its own (twice, to read the blocks referred to by the references), then decompresses the next selected file from its position given by the central directory
+ * \param argument ArchiveJob
+ * \return NULL
+ */
+
+static void* extractFiles(void* argument)
+{
+    ArchiveJob* job = (ArchiveJob*) argument;
+    PipelineContext context;
+    FILE* fileArchive = fopen(job->archiveName, "rb");
+    TESTFOPEN(fileArchive);
+    int index;
+
+    initWorkerContext(&context, job);
+    context.archive = fopen(job->archiveName, "rb");
+    TESTFOPEN(context.archive);
+    while((index=takeNextFile(job))>=0){
+        ArchiveEntry* entry = &(job->archive->entries[index]);
+        if(!isSelected(job, entry->name))
+            continue;
+        createFolders(entry->name);
+        FILE* fileOut = fopen(entry->name, "wb");
+        if(fileOut==NULL){
+            fprintf(stderr, "\nERROR : Cannot create %s\n", entry->name);
+            exit(EXIT_FAILURE);
+        }
+        fileSeek(fileArchive, entry->offset, SEEK_SET);
+        if(decompressStream(fileArchive, entry->compressedSize, fileOut, &context)!=entry->size){
+            fprintf(stderr, "\nERROR : The size of %s isn't the one of the directory\n", entry->name);
+            exit(EXIT_FAILURE);
+        }
+        FCLOSE(fileOut);
+    }
+    FCLOSE(fileArchive);
+    FCLOSE(context.archive);
+    freePipelineContext(&context);
+    return NULL;
+}
+
+/**
+ * \fn static void runArchiveJob(ArchiveJob* job, void* (*function)(void*))
+ * \brief Runs the threads of the pool on the files of the archive and waits for them. The calling thread is one of them, and if a thread can't be created the others do its work
+ * \param job Work of the pool, its number of threads is computed from the context
+ * \param function Function run by each thread
+ */
+
+static void runArchiveJob(ArchiveJob* job, void* (*function)(void*))
+{
+    job->nbWorkers = (job->context->nbThreads<job->archive->nbEntries) ? job->context->nbThreads : job->archive->nbEntries;
+    if(job->nbWorkers<1)
+        job->nbWorkers = 1;
+    job->next = 0;
+    job->turn = 0;
+    pthread_mutex_init(&(job->mutex), NULL);
+    pthread_cond_init(&(job->turnChanged), NULL);
+
+    pthread_t threads[job->nbWorkers];
+    int created[job->nbWorkers];
+    for(int t=1; t<job->nbWorkers; t++)
+        created[t] = pthread_create(&threads[t], NULL, function, job)==0;
+    function(job);
+    for(int t=1; t<job->nbWorkers; t++){
+        if(created[t])
+            pthread_join(threads[t], NULL);
+    }
+    pthread_mutex_destroy(&(job->mutex));
+    pthread_cond_destroy(&(job->turnChanged));
+}
+
+/**
+ * \fn void readArchive(FILE* fileArchive, Archive* archive)
+ * \brief Reads the central directory at the end of an archive. The program is stopped if it's incorrect
+ * \param fileArchive Archive
+ * \param archive Central directory filled
+ */
+
+void readArchive(FILE* fileArchive, Archive* archive)
+{
+    unsigned char header[ARCHIVE_TRAILER_SIZE];
+    archive->entries = NULL;
+    archive->nbEntries = 0;
+    archive->capacity = 0;
+
+    long long sizeArchive = seekSizeOfFile(fileArchive);
+    if(sizeArchive<5+ARCHIVE_TRAILER_SIZE || fread(header, sizeof(unsigned char), 5, fileArchive)!=5 || memcmp(header, ARCHIVE_MAGIC, 4)){
+        fprintf(stderr, "\nERROR : The file isn't an archive\n");
+        exit(EXIT_FAILURE);
+    }
+    if(header[4]<1 || header[4]>ARCHIVE_VERSION){ // The version 1 is the same without references, and the version 2 without the maps of the characters
+        fprintf(stderr, "\nERROR : Version %d of the archives isn't supported\n", header[4]);
+        exit(EXIT_FAILURE);
+    }
+    fileSeek(fileArchive, sizeArchive-ARCHIVE_TRAILER_SIZE, SEEK_SET);
+    if(fread(header, sizeof(unsigned char), ARCHIVE_TRAILER_SIZE, fileArchive)!=ARCHIVE_TRAILER_SIZE || memcmp(header+12, ARCHIVE_MAGIC, 4)){
+        fprintf(stderr, "\nERROR : The archive is truncated\n");
+        exit(EXIT_FAILURE);
+    }
+    long long offsetDirectory = readNumber(header, 8);
+    int nbEntries = readNumber(header+8, 4);
+    if(offsetDirectory<5 || offsetDirectory>sizeArchive-ARCHIVE_TRAILER_SIZE || nbEntries<0){
+        fprintf(stderr, "\nERROR : Incorrect central directory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fileSeek(fileArchive, offsetDirectory, SEEK_SET);
+    for(int i=0; i<nbEntries; i++){
+        char name[FILENAME_MAX];
+        unsigned char numbers[24];
+        int sizeName = (fread(numbers, sizeof(unsigned char), 2, fileArchive)==2) ? (int) readNumber(numbers, 2) : -1;
+        if(sizeName<=0 || sizeName>=FILENAME_MAX || fread(name, sizeof(char), sizeName, fileArchive)!=(size_t) sizeName || fread(numbers, sizeof(unsigned char), 24, fileArchive)!=24){
+            fprintf(stderr, "\nERROR : Incorrect central directory\n");
+            exit(EXIT_FAILURE);
+        }
+        name[sizeName] = '\0';
+        addArchiveEntry(archive, name);
+        ArchiveEntry* entry = &(archive->entries[archive->nbEntries-1]);
+        entry->size = readNumber(numbers, 8);
+        entry->offset = readNumber(numbers+8, 8);
+        entry->compressedSize = readNumber(numbers+16, 8);
+        if(entry->size<0 || entry->offset<5 || entry->compressedSize<0 || entry->offset+entry->compressedSize>offsetDirectory){
+            fprintf(stderr, "\nERROR : Incorrect central directory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+ * \fn void createArchive(const char* archiveName, char** paths, int nbPaths, PipelineContext* context)
+ * \brief Creates an archive from files and folders. The files are compressed in parallel by context->nbThreads threads, each one with its own memory, and written in the order of the central directory. The blocks found again are written as references to the first one
+ * \param archiveName Name of the archive created
+ * \param paths Names of the files and folders archived (the folders with all their files)
+ * \param nbPaths Number of names
+ * \param context Dictionary, number of threads and memory limit used, and measures (if context->stats isn't NULL)
+ */
+
+void createArchive(const char* archiveName, char** paths, int nbPaths, PipelineContext* context)
+{
+    Archive archive = {NULL, 0, 0};
+    ArchiveJob job;
+    DedupTable references;
+    unsigned char numbers[ARCHIVE_TRAILER_SIZE];
+    long long sizeIn=0;
+
+    for(int i=0; i<nbPaths; i++)
+        addArchivePath(&archive, paths[i], archiveName);
+
+    job.fileOut = fopen(archiveName, "wb+"); // The blocks already written are read again to be compared
+    TESTFOPEN(job.fileOut);
+    memcpy(numbers, ARCHIVE_MAGIC, 4);
+    numbers[4] = ARCHIVE_VERSION;
+    fwrite(numbers, sizeof(unsigned char), 5, job.fileOut);
+
+    printStatus("\nCompression of %d files with %d threads...\n", archive.nbEntries, (context->nbThreads<archive.nbEntries) ? context->nbThreads : archive.nbEntries);
+    job.archive = &archive;
+    job.archiveName = archiveName;
+    job.selected = NULL;
+    job.nbSelected = 0;
+    job.offset = 5;
+    job.context = context;
+    initDedupTable(&references, 0);
+    job.references = &references;
+    job.nbReferences = 0;
+    int hits = (context->dedup!=NULL) ? context->dedup->hits : 0;
+    runArchiveJob(&job, compressFiles);
+    if(context->stats!=NULL){
+        context->stats->blocks[BLOCK_REFERENCE] = job.nbReferences;
+        if(context->dedup!=NULL)
+            context->stats->duplicates = context->dedup->hits-hits;
+    }
+    freeDedupTable(&references);
+
+    // Central directory
+    for(int i=0; i<archive.nbEntries; i++){
+        ArchiveEntry* entry = &(archive.entries[i]);
+        size_t sizeName = strlen(entry->name);
+        writeNumber(numbers, sizeName, 2);
+        fwrite(numbers, sizeof(unsigned char), 2, job.fileOut);
+        fwrite(entry->name, sizeof(char), sizeName, job.fileOut);
+        writeNumber(numbers, entry->size, 8);
+        writeNumber(numbers+8, entry->offset, 8);
+        fwrite(numbers, sizeof(unsigned char), 16, job.fileOut);
+        writeNumber(numbers, entry->compressedSize, 8);
+        fwrite(numbers, sizeof(unsigned char), 8, job.fileOut);
+        sizeIn += entry->size;
+    }
+    writeNumber(numbers, job.offset, 8);
+    writeNumber(numbers+8, archive.nbEntries, 4);
+    memcpy(numbers+12, ARCHIVE_MAGIC, 4);
+    fwrite(numbers, sizeof(unsigned char), ARCHIVE_TRAILER_SIZE, job.fileOut);
+    if(ferror(job.fileOut)){
+        fprintf(stderr, "\nERROR : Cannot write the archive\n");
+        exit(EXIT_FAILURE);
+    }
+    long long sizeOut = fileTell(job.fileOut);
+    FCLOSE(job.fileOut);
+
+    printStatus("\nArchive %s : %d files, %lld bytes -> %lld bytes (%d blocks found again)\n\n", archiveName, archive.nbEntries, sizeIn, sizeOut, job.nbReferences);
+    if(context->stats!=NULL)
+        finishStats(context->stats, sizeIn, sizeOut);
+    freeArchive(&archive);
+}
+
+/**
+ * \fn void listArchive(const char* archiveName)
+ * \brief Displays the files of an archive (size, compressed size and name) from its central directory
+ * \param archiveName Name of the archive
+ */
+
+void listArchive(const char* archiveName)
+{
+    Archive archive;
+    FILE* fileArchive = fopen(archiveName, "rb");
+    TESTFOPEN(fileArchive);
+    readArchive(fileArchive, &archive);
+    FCLOSE(fileArchive);
+
+    printf("%14s %14s  %s\n", "size", "compressed", "name");
+    for(int i=0; i<archive.nbEntries; i++)
+        printf("%14lld %14lld  %s\n", archive.entries[i].size, archive.entries[i].compressedSize, archive.entries[i].name);
+    freeArchive(&archive);
+}
+
+/**
+ * \fn void extractArchive(const char* archiveName, char** names, int nbNames, PipelineContext* context)
+ * \brief Extracts files of an archive in the current folder (with their folders). Each file is read directly from the position given by the central directory, and the files are decompressed in parallel by context->nbThreads threads
+ * \param archiveName Name of the archive
+ * \param names Names of the files (or folders) extracted
+ * \param nbNames Number of names, 0 to extract all the files
+ * \param context Dictionary, number of threads and memory limit used, and measures (if context->stats isn't NULL)
+ */
+
+void extractArchive(const char* archiveName, char** names, int nbNames, PipelineContext* context)
+{
+    Archive archive;
+    ArchiveJob job;
+    long long sizeIn=0;
+    long long sizeOut=0;
+    int nbExtracted=0;
+
+    FILE* fileArchive = fopen(archiveName, "rb");
+    TESTFOPEN(fileArchive);
+    readArchive(fileArchive, &archive);
+    sizeIn = seekSizeOfFile(fileArchive);
+    FCLOSE(fileArchive);
+
+    job.archive = &archive;
+    job.archiveName = archiveName;
+    job.fileOut = NULL;
+    job.selected = names;
+    job.nbSelected = nbNames;
+    job.context = context;
+    for(int i=0; i<archive.nbEntries; i++){
+        const char* name = archive.entries[i].name;
+        if(!isSafeName(name)){
+            fprintf(stderr, "\nERROR : The file %s would be extracted outside of the current folder\n", name);
+            exit(EXIT_FAILURE);
+        }
+        if(isSelected(&job, name)){
+            nbExtracted++;
+            sizeOut += archive.entries[i].size;
+        }
+    }
+    for(int i=0; i<nbNames; i++){
+        job.selected = names+i;
+        job.nbSelected = 1;
+        int found=0;
+        for(int j=0; j<archive.nbEntries && !found; j++)
+            found = isSelected(&job, archive.entries[j].name);
+        if(!found){
+            fprintf(stderr, "\nERROR : %s isn't in the archive\n", names[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    job.selected = names;
+    job.nbSelected = nbNames;
+
+    printStatus("\nExtraction of %d files...\n", nbExtracted);
+    runArchiveJob(&job, extractFiles);
+    printStatus("\nEnd of extraction\n\n");
+    if(context->stats!=NULL)
+        finishStats(context->stats, sizeIn, sizeOut);
+    freeArchive(&archive);
+}
@@ -0,0 +1,273 @@
+/**
+ * \file AsyncFile.c
+ * \brief Files read or written by a thread of their own with a ring of chunks, so that the reads and the writes overlap the coding of the blocks
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+
+/**
+ * \fn static void* readChunks(void* argument)
+ * \brief Thread of an input file : reads the chunks as long as one of them is free, until the end of the file
+ * \param argument AsyncFile read
+ * \return NULL
+ */
+
+static void* readChunks(void* argument)
+{
+    AsyncFile* async = (AsyncFile*) argument;
+    pthread_mutex_lock(&(async->mutex));
+    while(!async->end){
+        while(async->count==ASYNC_NB_CHUNKS && !async->end)
+            pthread_cond_wait(&(async->changed), &(async->mutex));
+        if(async->end) // Closed by the pipeline before the end of the file
+            break;
+        int tail = (async->head+async->count)%ASYNC_NB_CHUNKS;
+        pthread_mutex_unlock(&(async->mutex));
+
+        size_t size = fread(async->chunks[tail], sizeof(unsigned char), ASYNC_CHUNK_SIZE, async->file);
+
+        pthread_mutex_lock(&(async->mutex));
+        async->sizes[tail] = size;
+        if(size>0)
+            async->count++;
+        if(size<ASYNC_CHUNK_SIZE){
+            async->end = 1;
+            async->error = ferror(async->file)!=0;
+        }
+        pthread_cond_signal(&(async->changed));
+    }
+    pthread_mutex_unlock(&(async->mutex));
+    return NULL;
+}
+
+/**
+ * \fn static void* writeChunks(void* argument)
+ * \brief Thread of an output file : writes the chunks filled by the pipeline, until it closes the file
+ * \param argument AsyncFile written
+ * \return NULL
+ */
+
+static void* writeChunks(void* argument)
+{
+    AsyncFile* async = (AsyncFile*) argument;
+    pthread_mutex_lock(&(async->mutex));
+    while(1){
+        while(async->count==0 && !async->end)
+            pthread_cond_wait(&(async->changed), &(async->mutex));
+        if(async->count==0) // Everything is written
+            break;
+        int head = async->head;
+        pthread_mutex_unlock(&(async->mutex));
+
+        int failed = fwrite(async->chunks[head], sizeof(unsigned char), async->sizes[head], async->file)!=async->sizes[head];
+
+        pthread_mutex_lock(&(async->mutex));
+        async->error |= failed;
+        async->head = (head+1)%ASYNC_NB_CHUNKS;
+        async->count--;
+        pthread_cond_signal(&(async->changed));
+    }
+    pthread_mutex_unlock(&(async->mutex));
+    return NULL;
+}
+
+/**
+ * \fn void asyncOpen(AsyncFile* async, FILE* file, int writing, int threaded, ScratchPool* scratch)
+ * \brief Starts to read or to write a file from its current position. If threaded is 1, a thread reads (or writes) the chunks while the pipeline works on the previous (or next) ones
+ * \param async AsyncFile initialized, it has to be closed with asyncClose
+ * \param file File read or written
+ * \param writing 1 if the file is written, 0 if it's read
+ * \param threaded 1 to read or write the file in a thread, 0 to call fread and fwrite directly (also done if the memory of the pool is limited)
+ * \param scratch Pool in which the chunks are taken
+ */
+
+void asyncOpen(AsyncFile* async, FILE* file, int writing, int threaded, ScratchPool* scratch)
+{
+    async->file = file;
+    async->writing = writing;
+    async->threaded = threaded;
+    async->head = 0;
+    async->count = 0;
+    async->pos = 0;
+    async->end = 0;
+    async->error = 0;
+    async->memory = NULL;
+    if(scratch->limit>0)
+        async->threaded = 0; // The memory is limited, it's kept for the blocks rather than for chunks read in advance
+    if(!async->threaded)
+        return;
+
+    unsigned char* chunks = (unsigned char*) scratchGet(scratch, writing ? SCRATCH_WRITE_CHUNKS : SCRATCH_READ_CHUNKS, (size_t) ASYNC_NB_CHUNKS*ASYNC_CHUNK_SIZE);
+    for(int i=0; i<ASYNC_NB_CHUNKS; i++){
+        async->chunks[i] = chunks+(size_t) i*ASYNC_CHUNK_SIZE;
+        async->sizes[i] = 0;
+    }
+    pthread_mutex_init(&(async->mutex), NULL);
+    pthread_cond_init(&(async->changed), NULL);
+    if(pthread_create(&(async->thread), NULL, writing ? writeChunks : readChunks, async)!=0){
+        pthread_mutex_destroy(&(async->mutex));
+        pthread_cond_destroy(&(async->changed));
+        async->threaded = 0; // The file is still usable without a thread
+    }
+}
+
+/**
+ * \fn void asyncOpenMemory(AsyncFile* async, FileBuffer* buffer, size_t capacity)
+ * \brief Starts to write in a buffer instead of a file, so that a block can be decompressed in memory (by the search). Writing more than capacity bytes is an error
+ * \param async AsyncFile initialized, it has to be closed with asyncClose
+ * \param buffer Buffer written from its beginning, its size is the number of bytes written
+ * \param capacity Size allocated for buffer->text
+ */
+
+void asyncOpenMemory(AsyncFile* async, FileBuffer* buffer, size_t capacity)
+{
+    async->file = NULL;
+    async->writing = 1;
+    async->threaded = 0;
+    async->end = 0;
+    async->error = 0;
+    async->memory = buffer;
+    async->capacity = capacity;
+    buffer->size = 0;
+}
+
+/**
+ * \fn size_t asyncRead(AsyncFile* async, void* data, size_t size)
+ * \brief Reads the next bytes of a file opened by asyncOpen, like fread
+ * \param async File read
+ * \param data Buffer filled
+ * \param size Number of bytes wanted
+ * \return Number of bytes read, smaller than size only at the end of the file or if it can't be read
+ */
+
+size_t asyncRead(AsyncFile* async, void* data, size_t size)
+{
+    if(!async->threaded)
+        return fread(data, sizeof(unsigned char), size, async->file);
+
+    size_t done=0;
+    while(done<size){
+        pthread_mutex_lock(&(async->mutex));
+        while(async->count==0 && !async->end)
+            pthread_cond_wait(&(async->changed), &(async->mutex));
+        int empty = async->count==0;
+        pthread_mutex_unlock(&(async->mutex));
+        if(empty) // End of the file
+            break;
+
+        size_t sizeChunk = async->sizes[async->head]-async->pos;
+        if(sizeChunk>size-done)
+            sizeChunk = size-done;
+        memcpy((unsigned char*) data+done, async->chunks[async->head]+async->pos, sizeChunk);
+        done += sizeChunk;
+        async->pos += sizeChunk;
+
+        if(async->pos==async->sizes[async->head]){ // The chunk is given back to the thread
+            pthread_mutex_lock(&(async->mutex));
+            async->head = (async->head+1)%ASYNC_NB_CHUNKS;
+            async->count--;
+            async->pos = 0;
+            pthread_cond_signal(&(async->changed));
+            pthread_mutex_unlock(&(async->mutex));
+        }
+    }
+    return done;
+}
+
+/**
+ * \fn size_t asyncWrite(AsyncFile* async, const void* data, size_t size)
+ * \brief Writes bytes at the end of a file opened by asyncOpen, like fwrite. With a thread, an error can only be known after some time, asyncClose reports it
+ * \param async File written
+ * \param data Bytes written
+ * \param size Number of bytes
+ * \return Number of bytes written (or given to the thread), smaller than size if there was an error
+ */
+
+size_t asyncWrite(AsyncFile* async, const void* data, size_t size)
+{
+    if(async->memory!=NULL){
+        if(async->memory->size+size>async->capacity){
+            async->error = 1;
+            size = async->capacity-async->memory->size;
+        }
+        memcpy(async->memory->text+async->memory->size, data, size);
+        async->memory->size += size;
+        return size;
+    }
+    if(!async->threaded)
+        return fwrite(data, sizeof(unsigned char), size, async->file);
+
+    size_t done=0;
+    while(done<size){
+        pthread_mutex_lock(&(async->mutex));
+        while(async->count==ASYNC_NB_CHUNKS) // The chunk at head+count is still being written
+            pthread_cond_wait(&(async->changed), &(async->mutex));
+        int tail = (async->head+async->count)%ASYNC_NB_CHUNKS;
+        int error = async->error;
+        pthread_mutex_unlock(&(async->mutex));
+        if(error)
+            break;
+
+        size_t sizeChunk = ASYNC_CHUNK_SIZE-async->pos;
+        if(sizeChunk>size-done)
+            sizeChunk = size-done;
+        memcpy(async->chunks[tail]+async->pos, (const unsigned char*) data+done, sizeChunk);
+        done += sizeChunk;
+        async->pos += sizeChunk;
+
+        if(async->pos==ASYNC_CHUNK_SIZE){ // The chunk is given to the thread
+            pthread_mutex_lock(&(async->mutex));
+            async->sizes[tail] = async->pos;
+            async->count++;
+            async->pos = 0;
+            pthread_cond_signal(&(async->changed));
+            pthread_mutex_unlock(&(async->mutex));
+        }
+    }
+    return done;
+}
+
+/**
+ * \fn int asyncClose(AsyncFile* async)
+ * \brief Stops the thread of a file opened by asyncOpen. The rest of the data is written before (the file itself isn't closed)
+ * \param async File closed
+ * \return 1 if all the reads or writes succeeded, 0 otherwise
+ */
+
+int asyncClose(AsyncFile* async)
+{
+    if(async->memory!=NULL)
+        return !async->error;
+    if(!async->threaded){
+        if(async->writing)
+            return fflush(async->file)==0 && !ferror(async->file);
+        return !ferror(async->file);
+    }
+
+    pthread_mutex_lock(&(async->mutex));
+    if(async->writing){
+        while(async->count==ASYNC_NB_CHUNKS)
+            pthread_cond_wait(&(async->changed), &(async->mutex));
+        if(async->pos>0){ // Last chunk, partly filled
+            int tail = (async->head+async->count)%ASYNC_NB_CHUNKS;
+            async->sizes[tail] = async->pos;
+            async->count++;
+            async->pos = 0;
+        }
+    }
+    async->end = 1;
+    pthread_cond_signal(&(async->changed));
+    pthread_mutex_unlock(&(async->mutex));
+
+    pthread_join(async->thread, NULL);
+    pthread_mutex_destroy(&(async->mutex));
+    pthread_cond_destroy(&(async->changed));
+    async->threaded = 0;
+    if(async->writing && fflush(async->file)!=0)
+        async->error = 1;
+    return !async->error;
+}
@@ -0,0 +1,290 @@
+/**
+ * \file Bigram.c
+ * \brief Bigram mode : the most frequent pairs of characters of a block become symbols of their own, added to the N_ASCII characters, and the block is coded with the Huffman codes of this larger alphabet. Text gets smaller, and the decoder writes the 2 characters of a pair with one lookup
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+
+/**
+ * \fn static int compareCandidates(const void* a, const void* b)
+ * \brief Compares 2 cells (count, pair) of the pairs that can be kept, the most frequent first, used by qsort
+ */
+
+static int compareCandidates(const void* a, const void* b)
+{
+    const long* cellA = (const long*) a;
+    const long* cellB = (const long*) b;
+    if(cellA[0]!=cellB[0])
+        return (cellA[0]>cellB[0]) ? -1 : 1;
+    return (cellA[1]<cellB[1]) ? -1 : (cellA[1]>cellB[1]);
+}
+
+/**
+ * \fn static int compareLeaves(const void* a, const void* b)
+ * \brief Compares 2 cells (count, symbol) of the leaves of the Huffman tree, the rarest first, used by qsort
+ */
+
+static int compareLeaves(const void* a, const void* b)
+{
+    return -compareCandidates(a, b);
+}
+
+/**
+ * \fn static long long bigramCodeLengths(const long counts[BIGRAM_SYMBOLS], unsigned char lengths[BIGRAM_SYMBOLS])
+ * \brief Computes the length of the code of each symbol like huffmanSizeBits, then limits them to BIGRAM_TABLE_BITS : the longer codes are shortened, and the codes of the rarest symbols are made longer until the codes fit (Kraft inequality). The space left is then given back to the most frequent symbols
+ * \param counts Number of occurrences of each symbol
+ * \param lengths Length of the code of each symbol, filled here (0 for the symbols that aren't present)
+ * \return Size in bits of the coding of all the symbols counted, -1 if there are less than 2 symbols
+ */
+
+static long long bigramCodeLengths(const long counts[BIGRAM_SYMBOLS], unsigned char lengths[BIGRAM_SYMBOLS])
+{
+    long leaves[BIGRAM_SYMBOLS][2]; // count, symbol
+    long weights[2*BIGRAM_SYMBOLS];
+    int parents[2*BIGRAM_SYMBOLS];
+    int depths[2*BIGRAM_SYMBOLS];
+    int nbLeaves=0;
+    long long bits=0;
+
+    for(int s=0; s<BIGRAM_SYMBOLS; s++){
+        lengths[s] = 0;
+        if(counts[s]>0){
+            leaves[nbLeaves][0] = counts[s];
+            leaves[nbLeaves][1] = s;
+            nbLeaves++;
+        }
+    }
+    if(nbLeaves<2)
+        return -1;
+
+    qsort(leaves, nbLeaves, sizeof(leaves[0]), compareLeaves);
+    for(int i=0; i<nbLeaves; i++)
+        weights[i] = leaves[i][0];
+    int nextLeaf=0;
+    int nextMerged=nbLeaves;
+    for(int node=nbLeaves; node<2*nbLeaves-1; node++){
+        int children[2];
+        for(int k=0; k<2; k++){
+            if(nextLeaf<nbLeaves && (nextMerged>=node || weights[nextLeaf]<=weights[nextMerged]))
+                children[k] = nextLeaf++;
+            else
+                children[k] = nextMerged++;
+        }
+        weights[node] = weights[children[0]]+weights[children[1]];
+        parents[children[0]] = node;
+        parents[children[1]] = node;
+    }
+    depths[2*nbLeaves-2] = 0;
+    for(int node=2*nbLeaves-3; node>=0; node--)
+        depths[node] = depths[parents[node]]+1;
+
+    long kraft=0; // Sum of 2^(BIGRAM_TABLE_BITS-length), at most 2^BIGRAM_TABLE_BITS when the codes fit
+    for(int i=0; i<nbLeaves; i++){
+        if(depths[i]>BIGRAM_TABLE_BITS)
+            depths[i] = BIGRAM_TABLE_BITS;
+        kraft += 1L << (BIGRAM_TABLE_BITS-depths[i]);
+    }
+    for(int i=0; i<nbLeaves && kraft>(1L << BIGRAM_TABLE_BITS); i++){
+        while(depths[i]<BIGRAM_TABLE_BITS && kraft>(1L << BIGRAM_TABLE_BITS)){
+            depths[i]++;
+            kraft -= 1L << (BIGRAM_TABLE_BITS-depths[i]);
+        }
+    }
+    for(int i=nbLeaves-1; i>=0; i--){
+        while(depths[i]>1 && kraft+(1L << (BIGRAM_TABLE_BITS-depths[i]))<=(1L << BIGRAM_TABLE_BITS)){
+            kraft += 1L << (BIGRAM_TABLE_BITS-depths[i]);
+            depths[i]--;
+        }
+    }
+
+    for(int i=0; i<nbLeaves; i++){
+        lengths[leaves[i][1]] = depths[i];
+        bits += (long long) leaves[i][0]*depths[i];
+    }
+    return bits;
+}
+
+/**
+ * \fn static void createCanonicalCodes(const unsigned char lengths[BIGRAM_SYMBOLS], uint16_t codes[BIGRAM_SYMBOLS])
+ * \brief Gives the canonical code of each symbol from the lengths : the codes of the same length follow each other in the order of the symbols, so only the lengths are saved
+ * \param lengths Length of the code of each symbol, 0 if it has none
+ * \param codes Code of each symbol, filled here (its first bit is the most significant one)
+ */
+
+static void createCanonicalCodes(const unsigned char lengths[BIGRAM_SYMBOLS], uint16_t codes[BIGRAM_SYMBOLS])
+{
+    int nbCodes[BIGRAM_TABLE_BITS+1]={0};
+    uint16_t nextCode[BIGRAM_TABLE_BITS+1];
+    for(int s=0; s<BIGRAM_SYMBOLS; s++)
+        nbCodes[lengths[s]]++;
+    nbCodes[0] = 0;
+    uint16_t code=0;
+    for(int length=1; length<=BIGRAM_TABLE_BITS; length++){
+        code = (code+nbCodes[length-1]) << 1;
+        nextCode[length] = code;
+    }
+    for(int s=0; s<BIGRAM_SYMBOLS; s++)
+        codes[s] = (lengths[s]>0) ? nextCode[lengths[s]]++ : 0;
+}
+
+/**
+ * \fn int bigramEncode(FileBuffer block, unsigned char* out, int sizeMax, PipelineContext* context)
+ * \brief Codes a block with the bigram mode. The pairs of characters found at least BIGRAM_MIN_COUNT times are counted, and the BIGRAM_MAX_PAIRS most frequent ones become symbols. The block is read from its beginning, each position giving the symbol of its pair if it has one (and the next position is skipped), its character otherwise. The codes of these symbols are limited to BIGRAM_TABLE_BITS bits. The data is the number of pairs (2 bytes), the pairs (2 bytes each), the length of the code of each symbol (4 bits each) and the codes
+ * \param block Block coded, it isn't modified
+ * \param out Memory in which the data of the block is written, BIT_IO_SLACK bytes must be writable after sizeMax
+ * \param sizeMax Largest size of the data
+ * \param context Memory and measures of the compression, the pairs sorted are allocated in its arena and freed by the caller
+ * \return Size of the data written, 0 if it would be larger than sizeMax (nothing is coded then)
+ */
+
+int bigramEncode(FileBuffer block, unsigned char* out, int sizeMax, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    const unsigned char* text = block.text;
+    long counts[BIGRAM_SYMBOLS]={0};
+    unsigned char lengths[BIGRAM_SYMBOLS];
+    uint16_t codes[BIGRAM_SYMBOLS];
+    int nbCandidates=0;
+
+    stageStart(stats, STAGE_BIGRAMS);
+    uint32_t* pairCounts = (uint32_t*) scratchGet(&(context->scratch), SCRATCH_BIGRAMS, N_ASCII*N_ASCII*(sizeof(uint32_t)+sizeof(uint16_t)));
+    uint16_t* pairSymbols = (uint16_t*) (pairCounts+N_ASCII*N_ASCII);
+    memset(pairCounts, 0, N_ASCII*N_ASCII*sizeof(uint32_t));
+    for(int i=0; i+1<block.size; i++)
+        pairCounts[(text[i] << 8) | text[i+1]]++;
+    for(int pair=0; pair<N_ASCII*N_ASCII; pair++)
+        nbCandidates += (pairCounts[pair]>=BIGRAM_MIN_COUNT);
+    if(nbCandidates==0){
+        stageStop(stats, STAGE_BIGRAMS, block.size, 0);
+        return 0;
+    }
+
+    long (*candidates)[2] = arenaAlloc(&(context->arena), nbCandidates*sizeof(candidates[0])); // count, pair
+    nbCandidates = 0;
+    for(int pair=0; pair<N_ASCII*N_ASCII; pair++){
+        if(pairCounts[pair]>=BIGRAM_MIN_COUNT){
+            candidates[nbCandidates][0] = pairCounts[pair];
+            candidates[nbCandidates][1] = pair;
+            nbCandidates++;
+        }
+    }
+    qsort(candidates, nbCandidates, sizeof(candidates[0]), compareCandidates);
+    int nbPairs = (nbCandidates<BIGRAM_MAX_PAIRS) ? nbCandidates : BIGRAM_MAX_PAIRS;
+    memset(pairSymbols, 0, N_ASCII*N_ASCII*sizeof(uint16_t));
+    writeNumber(out, nbPairs, 2);
+    for(int k=0; k<nbPairs; k++){
+        pairSymbols[candidates[k][1]] = N_ASCII+k;
+        writeNumber(out+2+2*k, candidates[k][1], 2);
+    }
+
+    // The occurrences of the symbols are the ones of the parsing made by the coder
+    int pos=0;
+    while(pos+1<block.size){
+        int symbol = pairSymbols[(text[pos] << 8) | text[pos+1]];
+        if(symbol==0)
+            symbol = text[pos++];
+        else
+            pos += 2;
+        counts[symbol]++;
+    }
+    if(pos<block.size)
+        counts[text[pos]]++;
+    long long bits = bigramCodeLengths(counts, lengths);
+    int nbSymbols = N_ASCII+nbPairs;
+    int sizeHeader = 2+2*nbPairs+(nbSymbols+1)/2;
+    if(bits<0 || sizeHeader+(bits+7)/8>sizeMax){
+        stageStop(stats, STAGE_BIGRAMS, block.size, 0);
+        return 0;
+    }
+    unsigned char* packed = out+2+2*nbPairs;
+    memset(packed, 0, (nbSymbols+1)/2);
+    for(int s=0; s<nbSymbols; s++)
+        packed[s/2] |= (s%2==0) ? lengths[s] << 4 : lengths[s];
+    createCanonicalCodes(lengths, codes);
+    stageStop(stats, STAGE_BIGRAMS, block.size, sizeHeader);
+
+    stageStart(stats, STAGE_HUFFMAN_ENCODE);
+    FileBuffer bufferOut = {out, sizeHeader};
+    encodeBigramSymbols(block, &bufferOut, pairSymbols, codes, lengths);
+    stageStop(stats, STAGE_HUFFMAN_ENCODE, block.size, bufferOut.size-sizeHeader);
+    if(stats!=NULL)
+        stats->tableSize += sizeHeader;
+    return bufferOut.size;
+}
+
+/**
+ * \fn void bigramDecode(FileBuffer bufferIn, FileBuffer* bufferOut, int sizeOut, PipelineContext* context)
+ * \brief Decodes a block coded by bigramEncode. The program is stopped if the data is incorrect
+ * \param bufferIn Data of the block
+ * \param bufferOut Buffer filled with the block, its field text must be allocated by the caller
+ * \param sizeOut Size of the block
+ * \param context Memory and measures of the decompression
+ */
+
+void bigramDecode(FileBuffer bufferIn, FileBuffer* bufferOut, int sizeOut, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    unsigned char lengths[BIGRAM_SYMBOLS]={0};
+    uint16_t codes[BIGRAM_SYMBOLS];
+    long kraft=0;
+
+    stageStart(stats, STAGE_TABLE_READ);
+    int nbPairs = (bufferIn.size>=2) ? (int) readNumber(bufferIn.text, 2) : -1;
+    int nbSymbols = N_ASCII+nbPairs;
+    int sizeHeader = 2+2*nbPairs+(nbSymbols+1)/2;
+    if(nbPairs<0 || nbPairs>BIGRAM_MAX_PAIRS || bufferIn.size<sizeHeader){
+        fprintf(stderr, "\nERROR : Incorrect bigram block\n");
+        exit(EXIT_FAILURE);
+    }
+    const unsigned char* packed = bufferIn.text+2+2*nbPairs;
+    for(int s=0; s<nbSymbols; s++){
+        lengths[s] = (s%2==0) ? packed[s/2] >> 4 : packed[s/2] & 15;
+        if(lengths[s]>BIGRAM_TABLE_BITS){
+            fprintf(stderr, "\nERROR : Incorrect bigram block\n");
+            exit(EXIT_FAILURE);
+        }
+        if(lengths[s]>0)
+            kraft += 1L << (BIGRAM_TABLE_BITS-lengths[s]);
+    }
+    if(kraft>(1L << BIGRAM_TABLE_BITS)){ // The codes would overlap
+        fprintf(stderr, "\nERROR : Incorrect bigram block\n");
+        exit(EXIT_FAILURE);
+    }
+
+    createCanonicalCodes(lengths, codes);
+    BigramEntry* decodeTable = (BigramEntry*) arenaAlloc(&(context->arena), sizeof(BigramEntry) << BIGRAM_TABLE_BITS);
+    memset(decodeTable, 0, sizeof(BigramEntry) << BIGRAM_TABLE_BITS);
+    for(int s=0; s<nbSymbols; s++){
+        if(lengths[s]==0)
+            continue;
+        BigramEntry entry;
+        entry.length = lengths[s];
+        if(s<N_ASCII){
+            entry.bytes[0] = s;
+            entry.bytes[1] = 0;
+            entry.nbBytes = 1;
+        }
+        else{
+            int pair = readNumber(bufferIn.text+2+2*(s-N_ASCII), 2);
+            entry.bytes[0] = pair >> 8;
+            entry.bytes[1] = pair & 255;
+            entry.nbBytes = 2;
+        }
+        int shift = BIGRAM_TABLE_BITS-lengths[s];
+        for(int i=codes[s] << shift; i<(codes[s]+1) << shift; i++)
+            decodeTable[i] = entry;
+    }
+    stageStop(stats, STAGE_TABLE_READ, sizeHeader, 0);
+
+    stageStart(stats, STAGE_HUFFMAN_DECODE);
+    FileBuffer bufferCoded = {bufferIn.text+sizeHeader, bufferIn.size-sizeHeader};
+    decodeBigramSymbols(bufferCoded, bufferOut, decodeTable, sizeOut);
+    stageStop(stats, STAGE_HUFFMAN_DECODE, bufferCoded.size, sizeOut);
+    if(stats!=NULL)
+        stats->tableSize += sizeHeader;
+    resetArena(&(context->arena));
+}
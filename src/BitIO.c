@@ -0,0 +1,717 @@
+/**
+ * \file BitIO.c
+ * \brief Reads and writes bits 64 at a time, and Huffman coding and decoding loops built on them. The loops are compiled twice (for every processor and with BMI2) and the version used is chosen at startup
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BIT_IO_DISPATCH 1
+#else
+#define BIT_IO_DISPATCH 0
+#endif
+
+#if defined(__GNUC__)
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+#define UNLIKELY(X) __builtin_expect(!!(X), 0)
+#else
+#define ALWAYS_INLINE static inline
+#define UNLIKELY(X) (X)
+#endif
+
+/**
+ * \def BIT_IO_REFILL_BITS Number of bits (at least) in a BitReader after refillBits, and largest number of bits given to putBits
+ */
+
+#define BIT_IO_REFILL_BITS 56
+
+/**
+ * \def DECODE_PER_REFILL Number of characters decoded with the table between 2 refills
+ */
+
+#define DECODE_PER_REFILL (BIT_IO_REFILL_BITS/DECODE_TABLE_BITS)
+
+
+typedef void (*EncodeKernel)(FileBuffer bufferIn, FileBuffer* bufferOut, const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII], const uint32_t* pairCodes);
+typedef void (*DecodeKernel)(FileBuffer bufferIn, FileBuffer* bufferOut, const DecodeEntry* decodeTable, int sizeOut);
+
+static EncodeKernel encodeKernel = NULL; // Version of the coding loop used, chosen by selectBitKernel
+static DecodeKernel decodeKernel = NULL; // Version of the decoding loop used
+static BitKernel currentKernel = BIT_KERNEL_AUTO; // Version chosen
+
+
+
+/**
+ * \fn static inline uint64_t load64(const unsigned char* in)
+ * \brief Reads 8 bytes, the first one being the most significant
+ * \param in Bytes read
+ * \return Value read
+ */
+
+ALWAYS_INLINE uint64_t load64(const unsigned char* in)
+{
+    uint64_t value;
+    memcpy(&value, in, sizeof(value));
+    #if defined(__GNUC__) && __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+    value = __builtin_bswap64(value);
+    #elif !defined(__GNUC__)
+    value = 0;
+    for(int i=0; i<8; i++)
+        value = (value << 8) | in[i];
+    #endif
+    return value;
+}
+
+/**
+ * \fn static inline void store64(unsigned char* out, uint64_t value)
+ * \brief Writes 8 bytes, the first one being the most significant
+ * \param out Memory in which the bytes are written
+ * \param value Value written
+ */
+
+ALWAYS_INLINE void store64(unsigned char* out, uint64_t value)
+{
+    #if defined(__GNUC__) && __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+    value = __builtin_bswap64(value);
+    memcpy(out, &value, sizeof(value));
+    #elif defined(__GNUC__)
+    memcpy(out, &value, sizeof(value));
+    #else
+    for(int i=0; i<8; i++)
+        out[i] = value >> (56-8*i);
+    #endif
+}
+
+/**
+ * \fn static inline void putBits(BitWriter* writer, uint64_t value, int nbBits)
+ * \brief Adds bits to the writer, flushBits has to be called before more than 64 bits are gathered
+ * \param writer Writer
+ * \param value Bits added (the nbBits least significant bits, the others are 0)
+ * \param nbBits Number of bits added, between 1 and BIT_IO_REFILL_BITS
+ */
+
+ALWAYS_INLINE void putBits(BitWriter* writer, uint64_t value, int nbBits)
+{
+    writer->bits |= value << (64-writer->count-nbBits);
+    writer->count += nbBits;
+}
+
+/**
+ * \fn static inline void flushBits(BitWriter* writer)
+ * \brief Writes the complete bytes gathered by the writer without any test : 8 bytes are always written and the position moves by the number of complete bytes
+ * \param writer Writer
+ */
+
+ALWAYS_INLINE void flushBits(BitWriter* writer)
+{
+    store64(writer->out+writer->pos, writer->bits);
+    writer->pos += writer->count >> 3;
+    writer->bits <<= writer->count & ~7;
+    writer->count &= 7;
+}
+
+/**
+ * \fn static inline void refillBits(BitReader* reader)
+ * \brief Loads bytes so that the reader contains at least BIT_IO_REFILL_BITS bits. Far from the end 8 bytes are loaded without any loop, the bits after the last complete byte are loaded again by the next refill
+ * \param reader Reader
+ */
+
+ALWAYS_INLINE void refillBits(BitReader* reader)
+{
+    if(reader->pos+8 <= reader->size){
+        reader->bits |= load64(reader->in+reader->pos) >> reader->count;
+        reader->pos += (63-reader->count) >> 3;
+        reader->count |= BIT_IO_REFILL_BITS;
+    }
+    else{
+        while(reader->count<BIT_IO_REFILL_BITS){
+            uint64_t byte = (reader->pos<reader->size) ? reader->in[reader->pos] : 0;
+            reader->bits |= byte << (BIT_IO_REFILL_BITS-reader->count);
+            reader->pos++;
+            reader->count += 8;
+        }
+    }
+}
+
+/**
+ * \fn static inline uint64_t peekBits(BitReader* reader, int nbBits)
+ * \brief Gives the next bits of the reader without reading them
+ * \param reader Reader, it must contain at least nbBits bits
+ * \param nbBits Number of bits, between 1 and 64
+ * \return Bits, the first one being the most significant
+ */
+
+ALWAYS_INLINE uint64_t peekBits(BitReader* reader, int nbBits)
+{
+    return reader->bits >> (64-nbBits);
+}
+
+/**
+ * \fn static inline void consumeBits(BitReader* reader, int nbBits)
+ * \brief Reads bits that were given by peekBits
+ * \param reader Reader
+ * \param nbBits Number of bits read, at most the number of bits of the reader
+ */
+
+ALWAYS_INLINE void consumeBits(BitReader* reader, int nbBits)
+{
+    reader->bits <<= nbBits;
+    reader->count -= nbBits;
+}
+
+
+
+/**
+ * \fn void initBitWriter(BitWriter* writer, unsigned char* out, size_t pos)
+ * \brief Initializes a writer
+ * \param writer Writer initialized
+ * \param out Memory in which the bits are written
+ * \param pos Position in out of the first byte written
+ */
+
+void initBitWriter(BitWriter* writer, unsigned char* out, size_t pos)
+{
+    writer->out = out;
+    writer->pos = pos;
+    writer->bits = 0;
+    writer->count = 0;
+}
+
+/**
+ * \fn void writeBits(BitWriter* writer, uint64_t value, int nbBits)
+ * \brief Writes bits
+ * \param writer Writer
+ * \param value Bits written (the nbBits least significant bits)
+ * \param nbBits Number of bits written, between 0 and 64
+ */
+
+void writeBits(BitWriter* writer, uint64_t value, int nbBits)
+{
+    if(nbBits>32){
+        writeBits(writer, value >> 32, nbBits-32);
+        nbBits = 32;
+    }
+    if(nbBits>0){
+        putBits(writer, value & (((uint64_t) 1 << nbBits)-1), nbBits);
+        flushBits(writer);
+    }
+}
+
+/**
+ * \fn size_t finishBitWriter(BitWriter* writer)
+ * \brief Writes the last bits, the last byte is completed with zeros
+ * \param writer Writer
+ * \return Position in out after the last byte written
+ */
+
+size_t finishBitWriter(BitWriter* writer)
+{
+    if(writer->count>0){
+        writer->out[writer->pos] = writer->bits >> 56;
+        writer->pos++;
+    }
+    writer->bits = 0;
+    writer->count = 0;
+    return writer->pos;
+}
+
+/**
+ * \fn void initBitReader(BitReader* reader, const unsigned char* in, size_t size)
+ * \brief Initializes a reader
+ * \param reader Reader initialized
+ * \param in Data read
+ * \param size Size of the data
+ */
+
+void initBitReader(BitReader* reader, const unsigned char* in, size_t size)
+{
+    reader->in = in;
+    reader->size = size;
+    reader->pos = 0;
+    reader->bits = 0;
+    reader->count = 0;
+}
+
+/**
+ * \fn uint64_t readBits(BitReader* reader, int nbBits)
+ * \brief Reads bits
+ * \param reader Reader
+ * \param nbBits Number of bits read, between 1 and BIT_IO_REFILL_BITS
+ * \return Bits read, the first one being the most significant
+ */
+
+uint64_t readBits(BitReader* reader, int nbBits)
+{
+    if(reader->count<nbBits)
+        refillBits(reader);
+    uint64_t value = peekBits(reader, nbBits);
+    consumeBits(reader, nbBits);
+    return value;
+}
+
+/**
+ * \fn long long bitsRead(BitReader* reader)
+ * \brief Gives the number of bits read, it's larger than 8 times the size of the data if zeros were read after its end
+ * \param reader Reader
+ * \return Number of bits read
+ */
+
+long long bitsRead(BitReader* reader)
+{
+    return (long long) reader->pos*8 - reader->count;
+}
+
+
+
+/**
+ * \fn static void encodeLongCode(BitWriter* writer, uint64_t code, int length, unsigned char c)
+ * \brief Writes a code that the coding loop can't write at once : longer than BIT_IO_REFILL_BITS or empty (the character isn't in the table)
+ */
+
+static void encodeLongCode(BitWriter* writer, uint64_t code, int length, unsigned char c)
+{
+    if(length==0){
+        fprintf(stderr, "ERROR : Character not found in the table : %c|%d", c, c);
+        exit(EXIT_FAILURE);
+    }
+    writeBits(writer, code, length);
+}
+
+/**
+ * \fn static inline void encodeOne(BitWriter* writer, unsigned char c, const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII])
+ * \brief Writes the code of one character
+ */
+
+ALWAYS_INLINE void encodeOne(BitWriter* writer, unsigned char c, const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII])
+{
+    int length = lengths[c];
+    if(UNLIKELY(length==0 || length>BIT_IO_REFILL_BITS)){
+        encodeLongCode(writer, codes[c], length, c);
+        return;
+    }
+    putBits(writer, codes[c], length);
+    flushBits(writer);
+}
+
+/**
+ * \fn static inline void encodeLoop(FileBuffer bufferIn, FileBuffer* bufferOut, const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII], const uint32_t* pairCodes)
+ * \brief Coding loop, compiled in each version of encodeSymbols. With the table of the pairs, 2 characters are written with one lookup and one update of the writer, the pairs that aren't in the table are written one character at a time
+ */
+
+ALWAYS_INLINE void encodeLoop(FileBuffer bufferIn, FileBuffer* bufferOut, const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII], const uint32_t* pairCodes)
+{
+    BitWriter writer;
+    int posIn=0;
+    initBitWriter(&writer, bufferOut->text, bufferOut->size);
+    if(pairCodes!=NULL){
+        for(; posIn+2<=bufferIn.size; posIn+=2){
+            uint32_t pair = pairCodes[(bufferIn.text[posIn] << 8) | bufferIn.text[posIn+1]];
+            if(UNLIKELY(pair==0)){
+                encodeOne(&writer, bufferIn.text[posIn], codes, lengths);
+                encodeOne(&writer, bufferIn.text[posIn+1], codes, lengths);
+                continue;
+            }
+            putBits(&writer, pair >> 5, pair & 31);
+            flushBits(&writer);
+        }
+    }
+    for(; posIn<bufferIn.size; posIn++)
+        encodeOne(&writer, bufferIn.text[posIn], codes, lengths);
+    bufferOut->size = finishBitWriter(&writer);
+}
+
+/**
+ * \fn static void decodeError(const char* message)
+ * \brief Stops the program because the coded data is incorrect
+ */
+
+static void decodeError(const char* message)
+{
+    fprintf(stderr, "\nERROR : %s\n", message);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * \fn static inline unsigned char decodeLongCode(BitReader* reader, DecodeEntry entry)
+ * \brief Decodes a character whose code is longer than DECODE_TABLE_BITS by going through the tree from the node of the entry. The reader is refilled at the end
+ */
+
+ALWAYS_INLINE unsigned char decodeLongCode(BitReader* reader, DecodeEntry entry)
+{
+    if(entry.length==0)
+        decodeError("Incorrect bit value");
+    consumeBits(reader, DECODE_TABLE_BITS);
+    HuffmanTreePtr node = entry.node;
+    while(node->left!=NULL || node->right!=NULL){
+        if(reader->count==0)
+            refillBits(reader);
+        node = peekBits(reader, 1) ? node->right : node->left;
+        consumeBits(reader, 1);
+        if(node==NULL)
+            decodeError("Incorrect bit value");
+    }
+    refillBits(reader);
+    return node->c;
+}
+
+/**
+ * \fn static inline void decodeLoop(FileBuffer bufferIn, FileBuffer* bufferOut, const DecodeEntry* decodeTable, int sizeOut)
+ * \brief Decoding loop, compiled in each version of decodeSymbols. After each refill DECODE_PER_REFILL characters are decoded without any test on the number of bits
+ */
+
+ALWAYS_INLINE void decodeLoop(FileBuffer bufferIn, FileBuffer* bufferOut, const DecodeEntry* decodeTable, int sizeOut)
+{
+    BitReader reader;
+    unsigned char* out = bufferOut->text;
+    int posOut=0;
+    initBitReader(&reader, bufferIn.text, bufferIn.size);
+
+    while(posOut+DECODE_PER_REFILL<=sizeOut){
+        refillBits(&reader);
+        for(int k=0; k<DECODE_PER_REFILL; k++){
+            DecodeEntry entry = decodeTable[peekBits(&reader, DECODE_TABLE_BITS)];
+            if(UNLIKELY(entry.node!=NULL || entry.length==0)){
+                out[posOut++] = decodeLongCode(&reader, entry);
+                continue;
+            }
+            out[posOut++] = entry.c;
+            consumeBits(&reader, entry.length);
+        }
+    }
+    while(posOut<sizeOut){
+        refillBits(&reader);
+        DecodeEntry entry = decodeTable[peekBits(&reader, DECODE_TABLE_BITS)];
+        if(entry.node!=NULL || entry.length==0){
+            out[posOut++] = decodeLongCode(&reader, entry);
+            continue;
+        }
+        out[posOut++] = entry.c;
+        consumeBits(&reader, entry.length);
+    }
+
+    if(bitsRead(&reader) > (long long) bufferIn.size*8)
+        decodeError("The compressed data is truncated");
+    bufferOut->size = sizeOut;
+}
+
+static void encodeBaseline(FileBuffer bufferIn, FileBuffer* bufferOut, const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII], const uint32_t* pairCodes)
+{
+    encodeLoop(bufferIn, bufferOut, codes, lengths, pairCodes);
+}
+
+static void decodeBaseline(FileBuffer bufferIn, FileBuffer* bufferOut, const DecodeEntry* decodeTable, int sizeOut)
+{
+    decodeLoop(bufferIn, bufferOut, decodeTable, sizeOut);
+}
+
+#if BIT_IO_DISPATCH
+__attribute__((target("bmi2")))
+static void encodeBmi2(FileBuffer bufferIn, FileBuffer* bufferOut, const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII], const uint32_t* pairCodes)
+{
+    encodeLoop(bufferIn, bufferOut, codes, lengths, pairCodes);
+}
+
+__attribute__((target("bmi2")))
+static void decodeBmi2(FileBuffer bufferIn, FileBuffer* bufferOut, const DecodeEntry* decodeTable, int sizeOut)
+{
+    decodeLoop(bufferIn, bufferOut, decodeTable, sizeOut);
+}
+#endif
+
+
+
+/**
+ * \fn void selectBitKernel(BitKernel kernel)
+ * \brief Chooses the version of the coding and decoding loops. A version that the processor doesn't support is replaced by the baseline one
+ * \param kernel Version wanted, BIT_KERNEL_AUTO for the fastest one
+ */
+
+void selectBitKernel(BitKernel kernel)
+{
+    int bmi2 = 0;
+    #if BIT_IO_DISPATCH
+    __builtin_cpu_init();
+    bmi2 = __builtin_cpu_supports("bmi2");
+    #endif
+    if(kernel!=BIT_KERNEL_BASELINE && bmi2){
+        #if BIT_IO_DISPATCH
+        encodeKernel = encodeBmi2;
+        decodeKernel = decodeBmi2;
+        currentKernel = BIT_KERNEL_BMI2;
+        #endif
+    }
+    else{
+        encodeKernel = encodeBaseline;
+        decodeKernel = decodeBaseline;
+        currentKernel = BIT_KERNEL_BASELINE;
+    }
+}
+
+/**
+ * \fn const char* bitKernelName()
+ * \brief Gives the name of the version of the coding and decoding loops used, used in the reports
+ * \return Name of the version
+ */
+
+const char* bitKernelName()
+{
+    if(encodeKernel==NULL)
+        selectBitKernel(BIT_KERNEL_AUTO);
+    return (currentKernel==BIT_KERNEL_BMI2) ? "bmi2" : "baseline";
+}
+
+/**
+ * \fn void createPairCodes(const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII], uint32_t* pairCodes)
+ * \brief Fills the table of the codes of the pairs of characters. Each cell contains the 2 codes one after the other (shifted by 5 bits) and their total length (5 least significant bits), or 0 if the pair is longer than PAIR_MAX_LENGTH bits or can't be coded
+ * \param codes Code of each character
+ * \param lengths Length of the code of each character, 0 if it can't be coded
+ * \param pairCodes Table filled, N_ASCII*N_ASCII cells indexed by (first character << 8) | second character
+ */
+
+void createPairCodes(const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII], uint32_t* pairCodes)
+{
+    int minLength = PAIR_MAX_LENGTH;
+    for(int c=0; c<N_ASCII; c++){
+        if(lengths[c]>0 && lengths[c]<minLength)
+            minLength = lengths[c];
+    }
+    for(int first=0; first<N_ASCII; first++){
+        uint32_t* row = pairCodes+first*N_ASCII;
+        if(lengths[first]==0 || lengths[first]+minLength>PAIR_MAX_LENGTH){
+            memset(row, 0, N_ASCII*sizeof(uint32_t));
+            continue;
+        }
+        for(int second=0; second<N_ASCII; second++){
+            int length = lengths[first]+lengths[second];
+            if(lengths[second]==0 || length>PAIR_MAX_LENGTH)
+                row[second] = 0;
+            else
+                row[second] = (uint32_t) (((codes[first] << lengths[second]) | codes[second]) << 5) | length;
+        }
+    }
+}
+
+/**
+ * \fn void encodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII], const uint32_t* pairCodes)
+ * \brief Writes the code of each character of bufferIn
+ * \param bufferIn Characters coded
+ * \param bufferOut Buffer in which the codes are added (from bufferOut->size), BIT_IO_SLACK bytes must be writable after the end of the codes
+ * \param codes Code of each character, its first bit is the most significant one
+ * \param lengths Length of the code of each character, 0 if it can't be coded
+ * \param pairCodes Table filled by createPairCodes, or NULL to code one character at a time
+ */
+
+void encodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const uint64_t codes[N_ASCII], const unsigned char lengths[N_ASCII], const uint32_t* pairCodes)
+{
+    if(encodeKernel==NULL)
+        selectBitKernel(BIT_KERNEL_AUTO);
+    encodeKernel(bufferIn, bufferOut, codes, lengths, pairCodes);
+}
+
+/**
+ * \fn static void fillDecodeTable(HuffmanTreePtr huffmanNode, unsigned int code, int length, DecodeEntry* decodeTable)
+ * \brief Recursive function filling the cells of the table whose bits begin with the code of a node
+ */
+
+static void fillDecodeTable(HuffmanTreePtr huffmanNode, unsigned int code, int length, DecodeEntry* decodeTable)
+{
+    if(huffmanNode==NULL)
+        return;
+    if(huffmanNode->left==NULL && huffmanNode->right==NULL){ // we are at the end of a branch
+        if(length==0) // Only one node, no code
+            return;
+        for(unsigned int i=code << (DECODE_TABLE_BITS-length); i<(code+1) << (DECODE_TABLE_BITS-length); i++){
+            decodeTable[i].node = NULL;
+            decodeTable[i].c = huffmanNode->c;
+            decodeTable[i].length = length;
+        }
+    }
+    else if(length==DECODE_TABLE_BITS){
+        decodeTable[code].node = huffmanNode;
+        decodeTable[code].length = DECODE_TABLE_BITS;
+    }
+    else{
+        fillDecodeTable(huffmanNode->left, code << 1, length+1, decodeTable);
+        fillDecodeTable(huffmanNode->right, (code << 1) | 1, length+1, decodeTable);
+    }
+}
+
+/**
+ * \fn void createDecodeTable(HuffmanTreePtr huffmanTree, DecodeEntry decodeTable[1 << DECODE_TABLE_BITS])
+ * \brief Fills the table used by decodeSymbols from a Huffman tree (left = 0, right = 1)
+ * \param huffmanTree Root of the tree
+ * \param decodeTable Table filled
+ */
+
+void createDecodeTable(HuffmanTreePtr huffmanTree, DecodeEntry decodeTable[1 << DECODE_TABLE_BITS])
+{
+    memset(decodeTable, 0, sizeof(DecodeEntry) << DECODE_TABLE_BITS);
+    fillDecodeTable(huffmanTree, 0, 0, decodeTable);
+}
+
+/**
+ * \fn void decodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const DecodeEntry* decodeTable, int sizeOut)
+ * \brief Decodes sizeOut characters. The program is stopped if the data is incorrect or truncated
+ * \param bufferIn Coded data
+ * \param bufferOut Buffer filled, its field text must be allocated by the caller
+ * \param decodeTable Table created by createDecodeTable
+ * \param sizeOut Number of characters decoded
+ */
+
+void decodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const DecodeEntry* decodeTable, int sizeOut)
+{
+    if(decodeKernel==NULL)
+        selectBitKernel(BIT_KERNEL_AUTO);
+    decodeKernel(bufferIn, bufferOut, decodeTable, sizeOut);
+}
+
+/**
+ * \fn void encodeBigramSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const uint16_t* pairSymbols, const uint16_t codes[BIGRAM_SYMBOLS], const unsigned char lengths[BIGRAM_SYMBOLS])
+ * \brief Writes the codes of the bigram mode : at each position, the pair of the next 2 characters if it has a symbol, the next character otherwise
+ * \param bufferIn Characters coded
+ * \param bufferOut Buffer in which the codes are added (from bufferOut->size), BIT_IO_SLACK bytes must be writable after the end of the codes
+ * \param pairSymbols Symbol of each pair of characters, indexed by (first character << 8) | second character, 0 if the pair isn't coded as one symbol
+ * \param codes Code of each symbol, its first bit is the most significant one
+ * \param lengths Length of the code of each symbol (at most BIGRAM_TABLE_BITS), the symbols of the parsing of bufferIn must have one
+ */
+
+void encodeBigramSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const uint16_t* pairSymbols, const uint16_t codes[BIGRAM_SYMBOLS], const unsigned char lengths[BIGRAM_SYMBOLS])
+{
+    BitWriter writer;
+    const unsigned char* in = bufferIn.text;
+    int posIn=0;
+    initBitWriter(&writer, bufferOut->text, bufferOut->size);
+    while(posIn+1<bufferIn.size){
+        int symbol = pairSymbols[(in[posIn] << 8) | in[posIn+1]];
+        if(symbol==0)
+            symbol = in[posIn++];
+        else
+            posIn += 2;
+        putBits(&writer, codes[symbol], lengths[symbol]);
+        flushBits(&writer);
+    }
+    if(posIn<bufferIn.size){
+        putBits(&writer, codes[in[posIn]], lengths[in[posIn]]);
+        flushBits(&writer);
+    }
+    bufferOut->size = finishBitWriter(&writer);
+}
+
+/**
+ * \fn void decodeBigramSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const BigramEntry* decodeTable, int sizeOut)
+ * \brief Decodes sizeOut characters coded by encodeBigramSymbols. Each lookup gives 1 or 2 characters, which are both written at once far from the end. The program is stopped if the data is incorrect or truncated
+ * \param bufferIn Coded data
+ * \param bufferOut Buffer filled, its field text must be allocated by the caller
+ * \param decodeTable Table of 2^BIGRAM_TABLE_BITS cells indexed by the next bits
+ * \param sizeOut Number of characters decoded
+ */
+
+void decodeBigramSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const BigramEntry* decodeTable, int sizeOut)
+{
+    BitReader reader;
+    unsigned char* out = bufferOut->text;
+    int posOut=0;
+    initBitReader(&reader, bufferIn.text, bufferIn.size);
+
+    while(posOut+2*(BIT_IO_REFILL_BITS/BIGRAM_TABLE_BITS)<=sizeOut){
+        refillBits(&reader);
+        for(int k=0; k<BIT_IO_REFILL_BITS/BIGRAM_TABLE_BITS; k++){
+            BigramEntry entry = decodeTable[peekBits(&reader, BIGRAM_TABLE_BITS)];
+            if(UNLIKELY(entry.length==0))
+                decodeError("Incorrect bit value");
+            out[posOut] = entry.bytes[0];
+            out[posOut+1] = entry.bytes[1];
+            posOut += entry.nbBytes;
+            consumeBits(&reader, entry.length);
+        }
+    }
+    while(posOut<sizeOut){
+        refillBits(&reader);
+        BigramEntry entry = decodeTable[peekBits(&reader, BIGRAM_TABLE_BITS)];
+        if(entry.length==0 || posOut+entry.nbBytes>sizeOut)
+            decodeError("Incorrect bit value");
+        for(int k=0; k<entry.nbBytes; k++)
+            out[posOut++] = entry.bytes[k];
+        consumeBits(&reader, entry.length);
+    }
+
+    if(bitsRead(&reader) > (long long) bufferIn.size*8)
+        decodeError("The compressed data is truncated");
+    bufferOut->size = sizeOut;
+}
+
+/**
+ * \fn int tansEncodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const TansTable* table, uint16_t* bits, size_t sizeMax)
+ * \brief Codes the characters of bufferIn with the tANS coder. They are coded from the last one to the first one so that the decoder gets them in order : the bits of each character are kept in bits, then the final state and these bits are written from the first character to the last one
+ * \param bufferIn Characters coded, each of them must have a normalized occurrence
+ * \param bufferOut Buffer in which the data is added (from bufferOut->size), BIT_IO_SLACK bytes must be writable after the end of the data
+ * \param table Tables created by createTansTable
+ * \param bits Memory of at least bufferIn.size values used to keep the bits of each character
+ * \param sizeMax Largest size of bufferOut after the data
+ * \return 1 if the data was written, 0 if it's larger than sizeMax (nothing is written then)
+ */
+
+int tansEncodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const TansTable* table, uint16_t* bits, size_t sizeMax)
+{
+    BitWriter writer;
+    uint32_t state = TANS_TABLE_SIZE;
+    long long nbBitsTotal = TANS_TABLE_LOG;
+
+    for(int i=bufferIn.size-1; i>=0; i--){
+        TansSymbol symbol = table->symbols[bufferIn.text[i]];
+        uint32_t nbBits = (state+symbol.deltaNbBits) >> 16;
+        bits[i] = ((state & ((1u << nbBits)-1)) << 4) | nbBits;
+        nbBitsTotal += nbBits;
+        state = table->states[(state >> nbBits)+symbol.deltaFindState];
+    }
+    if(bufferOut->size+(size_t) (nbBitsTotal+7)/8 > sizeMax)
+        return 0;
+
+    initBitWriter(&writer, bufferOut->text, bufferOut->size);
+    writeBits(&writer, state-TANS_TABLE_SIZE, TANS_TABLE_LOG);
+    for(int i=0; i<bufferIn.size; i++){
+        uint64_t value = bits[i] >> 4;
+        int nbBits = bits[i] & 15;
+        writer.bits |= (value << 1) << (63-writer.count-nbBits); // Split in 2 shifts so that nbBits can be 0
+        writer.count += nbBits;
+        if((i&3)==3)
+            flushBits(&writer);
+    }
+    flushBits(&writer);
+    bufferOut->size = finishBitWriter(&writer);
+    return 1;
+}
+
+/**
+ * \fn void tansDecodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const TansTable* table, int sizeOut)
+ * \brief Decodes sizeOut characters coded by tansEncodeSymbols. The program is stopped if the data is truncated
+ * \param bufferIn Coded data (final state of the coder then the bits of each character)
+ * \param bufferOut Buffer filled, its field text must be allocated by the caller
+ * \param table Tables created by createTansTable
+ * \param sizeOut Number of characters decoded
+ */
+
+void tansDecodeSymbols(FileBuffer bufferIn, FileBuffer* bufferOut, const TansTable* table, int sizeOut)
+{
+    BitReader reader;
+    unsigned char* out = bufferOut->text;
+    initBitReader(&reader, bufferIn.text, bufferIn.size);
+    uint32_t state = readBits(&reader, TANS_TABLE_LOG);
+
+    for(int i=0; i<sizeOut; i++){
+        if((i&3)==0)
+            refillBits(&reader);
+        TansDecodeEntry entry = table->decode[state];
+        out[i] = entry.c;
+        state = entry.newState+((reader.bits >> (63-entry.nbBits)) >> 1);
+        consumeBits(&reader, entry.nbBits);
+    }
+
+    if(bitsRead(&reader) > (long long) bufferIn.size*8)
+        decodeError("The compressed data is truncated");
+    bufferOut->size = sizeOut;
+}
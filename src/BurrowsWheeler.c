@@ -10,92 +10,268 @@
 
 
 /**
- * \fn void rotationSort(unsigned char* tabChar, int* indexes, int size)
- * \brief Sorts the array of indexes to get the encoded text, it reads the array tabChar by reading from the indexes of the array indexes
- * \param tabChar Array containing a string whose cells will be sorted in the array indexes by this function
- * \param indexes Array of the tabChar indexes
- * \param size Size of the arrays tabChar and indexes
+ * \def BWT_THREAD_MIN_SIZE Smallest number of rotations given to each thread of the rotation sort, smaller blocks use less threads
  */
 
-void rotationSort(unsigned char* tabChar, int* indexes, int size)
+#define BWT_THREAD_MIN_SIZE (64*1024)
+
+
+/**
+ * \fn static void sortKeys(uint64_t* keys, int size)
+ * \brief Sorts the keys of a group in increasing order (quicksort, insertion sort for the small parts). The keys are all different since they contain the beginning of their rotation
+ * \param keys Keys sorted
+ * \param size Number of keys
+ */
+
+static void sortKeys(uint64_t* keys, int size)
 {
-    int progress=0;
-    for(int i=0; i<size-1; i++)
-    {
-        int j=i+1;
-        int min=i;
-        while(j<size)
-        {
-            int k=0;
-            while(tabChar[(indexes[j]+k)%size]==tabChar[(indexes[min]+k)%size] && k<size)
-                k++;
-            if(tabChar[(indexes[j]+k)%size]<tabChar[(indexes[min]+k)%size])
-            {
-                min=j;
+    while(size>16){
+        uint64_t a = keys[0], b = keys[size/2], c = keys[size-1];
+        uint64_t pivot = (a<b) ? ((b<c) ? b : ((a<c) ? c : a)) : ((a<c) ? a : ((b<c) ? c : b)); // Median of 3
+        int i=0;
+        int j=size-1;
+        while(i<=j){
+            while(keys[i]<pivot)
+                i++;
+            while(keys[j]>pivot)
+                j--;
+            if(i<=j){
+                uint64_t tmp = keys[i];
+                keys[i] = keys[j];
+                keys[j] = tmp;
+                i++;
+                j--;
             }
-            j++;
         }
-        int tmp = indexes[min];
-        indexes[min] = indexes[i];
-        indexes[i] = tmp;
-        
-        if(progress+5 < 100*(((double)i)/size))
-        {
-            progress+=5; 
-            printf("%d%%\n", progress); //Displays the progress of the current task
+        // Recursion on the smaller part so that the depth stays logarithmic
+        if(j+1<size-i){
+            sortKeys(keys, j+1);
+            keys += i;
+            size -= i;
+        }
+        else{
+            sortKeys(keys+i, size-i);
+            size = j+1;
+        }
+    }
+    for(int i=1; i<size; i++){
+        uint64_t key = keys[i];
+        int j=i;
+        while(j>0 && keys[j-1]>key){
+            keys[j] = keys[j-1];
+            j--;
+        }
+        keys[j] = key;
+    }
+}
+
+/**
+ * \fn static void* sortGroups(void* argument)
+ * \brief First half of a round : sorts each group of the range on the rank of its rotations depth characters later, and marks the beginnings of the new groups. The ranks are only read, so the threads can't see a group of another thread half sorted
+ * \param argument RotationSortTask of the thread
+ * \return NULL
+ */
+
+static void* sortGroups(void* argument)
+{
+    RotationSortTask* task = (RotationSortTask*) argument;
+    RotationSort* sort = task->sort;
+    int begin = task->begin;
+    while(begin<task->end){
+        int end = begin+1;
+        while(end<task->end && !sort->groups[end])
+            end++;
+        if(end-begin>1){
+            for(int i=begin; i<end; i++){
+                uint32_t next = sort->indexes[i]+sort->depth;
+                if(next>=(uint32_t) sort->size)
+                    next -= sort->size;
+                sort->keys[i] = ((uint64_t) sort->ranks[next]<<32) | sort->indexes[i];
+            }
+            sortKeys(sort->keys+begin, end-begin); // The beginnings of the rotations are in the keys, so that the equal rotations stay in increasing order
+            for(int i=begin; i<end; i++){
+                sort->indexes[i] = (uint32_t) sort->keys[i];
+                if(i>begin && (sort->keys[i]>>32)!=(sort->keys[i-1]>>32))
+                    sort->groups[i] = 1;
+            }
         }
+        begin = end;
     }
+    return NULL;
 }
 
+/**
+ * \fn static void* updateRanks(void* argument)
+ * \brief Second half of a round : gives to each rotation of the range the rank of its new group, once all the groups are sorted
+ * \param argument RotationSortTask of the thread
+ * \return NULL
+ */
+
+static void* updateRanks(void* argument)
+{
+    RotationSortTask* task = (RotationSortTask*) argument;
+    RotationSort* sort = task->sort;
+    uint32_t rank = task->begin;
+    task->unsorted = 0;
+    for(int i=task->begin; i<task->end; i++){
+        if(sort->groups[i])
+            rank = i;
+        else
+            task->unsorted = 1;
+        sort->ranks[sort->indexes[i]] = rank;
+    }
+    return NULL;
+}
 
 /**
- * \fn bubbleSortIndexes(unsigned char* tabChar, int* indexes, int size)
- * \brief Sorts the array of indexes by using a bubble sort
+ * \fn static void runTasks(void* (*function)(void*), RotationSortTask* tasks, int nbTasks)
+ * \brief Calls function on each task, each one in its own thread, and waits for all of them. The first task is done by the calling thread, and a task whose thread can't be created is done by it too
+ * \param function Function called
+ * \param tasks Tasks given to the function
+ * \param nbTasks Number of tasks
+ */
+
+static void runTasks(void* (*function)(void*), RotationSortTask* tasks, int nbTasks)
+{
+    pthread_t threads[nbTasks];
+    int created[nbTasks];
+    for(int t=1; t<nbTasks; t++)
+        created[t] = pthread_create(&threads[t], NULL, function, &tasks[t])==0;
+    function(&tasks[0]);
+    for(int t=1; t<nbTasks; t++){
+        if(created[t])
+            pthread_join(threads[t], NULL);
+        else
+            function(&tasks[t]);
+    }
+}
+
+/**
+ * \fn int rotationSort(unsigned char* tabChar, uint32_t* indexes, int size, ScratchPool* scratch, int nbThreads, long long deadlineNs)
+ * \brief Sorts the array of indexes to get the encoded text, it reads the array tabChar by reading from the indexes of the array indexes. The rotations are first put in buckets by their first 2 characters, then the rounds double the number of characters sorted (O(n log n) per round, log n rounds at most). The groups of a round are independent, so they are shared between the threads. The equal rotations (periodic text) stay in increasing order
  * \param tabChar Array containing a string whose cells will be sorted in the array indexes by this function
- * \param indexes Array of the tabChar indexes
+ * \param indexes Array filled with the sorted indexes of tabChar
  * \param size Size of the arrays tabChar and indexes
+ * \param scratch Pool in which the ranks, keys and groups of the sort are taken
+ * \param nbThreads Largest number of threads used
+ * \param deadlineNs Time (getTimeNs) after which the sort is stopped between 2 rounds, 0 if there isn't any limit
+ * \return 1 if the indexes are sorted, 0 if the sort was stopped
  */
 
-void bubbleSortIndexes(unsigned char* tabChar, int* indexes, int size)
+int rotationSort(unsigned char* tabChar, uint32_t* indexes, int size, ScratchPool* scratch, int nbThreads, long long deadlineNs)
 {
-    int progress=0;
-    int i=size-1;
-    int temp=0;
-    int messy=0;
-
-    do{
-        messy = 0;
-        for (int j=0; j<i; j++){
-            if(tabChar[indexes[j]]>tabChar[indexes[j+1]]){
-                messy = 1;
-                temp = indexes[j];
-                indexes[j] = indexes[j+1];
-                indexes[j+1] = temp;
-            }
+    RotationSort sort;
+    Progress progress;
+    int unsorted=1;
+
+    if(size<=2){ // The first 2 characters are the whole rotations
+        for(int i=0; i<size; i++)
+            indexes[i] = i;
+        if(size==2 && tabChar[1]<tabChar[0]){
+            indexes[0] = 1;
+            indexes[1] = 0;
         }
-        i--;
-    }while(messy && i>0);
+        return 1;
+    }
+    if(nbThreads>size/BWT_THREAD_MIN_SIZE)
+        nbThreads = size/BWT_THREAD_MIN_SIZE;
+    if(nbThreads<1)
+        nbThreads = 1;
+
+    sort.indexes = indexes;
+    sort.ranks = (uint32_t*) scratchGet(scratch, SCRATCH_BWT_RANKS, sizeof(uint32_t)*size);
+    sort.keys = (uint64_t*) scratchGet(scratch, SCRATCH_BWT_KEYS, sizeof(uint64_t)*size);
+    sort.groups = (unsigned char*) scratchGet(scratch, SCRATCH_BWT_GROUPS, size);
+    sort.size = size;
+    sort.depth = 2;
+
+    // Buckets of the first 2 characters (stable counting sort), each bucket is a group
+    uint32_t* starts = (uint32_t*) calloc(N_ASCII*N_ASCII+1, sizeof(uint32_t));
+    TESTALLOC(starts);
+    for(int i=0; i<size; i++)
+        starts[(tabChar[i]<<8 | tabChar[(i+1<size) ? i+1 : 0])+1]++;
+    for(int b=1; b<=N_ASCII*N_ASCII; b++)
+        starts[b] += starts[b-1];
+    for(int i=0; i<size; i++)
+        indexes[starts[tabChar[i]<<8 | tabChar[(i+1<size) ? i+1 : 0]]++] = i;
+    memset(sort.groups, 0, size);
+    for(int i=0; i<size; i++){
+        int bucket = tabChar[i]<<8 | tabChar[(i+1<size) ? i+1 : 0];
+        sort.ranks[i] = (bucket>0) ? starts[bucket-1] : 0; // starts now contains the end of each bucket
+        sort.groups[sort.ranks[i]] = 1;
+    }
+    free(starts);
+
+    RotationSortTask tasks[nbThreads];
+    progressStart(&progress, "burrows wheeler", size);
+    while(unsorted && sort.depth<size){
+        if(deadlineNs>0 && getTimeNs()>deadlineNs)
+            return 0;
+        for(int t=0; t<nbThreads; t++){
+            int begin = (int) (((long long) size*t)/nbThreads);
+            while(begin<size && !sort.groups[begin])
+                begin++;
+            tasks[t].sort = &sort;
+            tasks[t].begin = begin;
+        }
+        for(int t=0; t<nbThreads; t++)
+            tasks[t].end = (t+1<nbThreads) ? tasks[t+1].begin : size;
+
+        runTasks(sortGroups, tasks, nbThreads);
+        runTasks(updateRanks, tasks, nbThreads);
+        unsorted = 0;
+        for(int t=0; t<nbThreads; t++)
+            unsorted |= tasks[t].unsorted;
+        sort.depth *= 2;
+        if(sort.depth>=progress.next)
+            progressReport(&progress, sort.depth);
+    }
+    return 1;
 }
 
 
 /**
- * \fn int burrowsWheeler(FileBuffer* bufferIn)
+ * \fn void countingSortIndexes(unsigned char* tabChar, uint32_t* indexes, int size)
+ * \brief Sorts the indexes of tabChar by their character with a counting sort. The sort is stable : the indexes of the same character stay in increasing order
+ * \param tabChar Array containing a string whose cells will be sorted in the array indexes by this function
+ * \param indexes Array filled with the sorted indexes of tabChar
+ * \param size Size of the arrays tabChar and indexes
+ */
+
+void countingSortIndexes(unsigned char* tabChar, uint32_t* indexes, int size)
+{
+    long counts[N_ASCII];
+    int start[N_ASCII];
+    FileBuffer buffer;
+    buffer.text = tabChar;
+    buffer.size = size;
+    countOccurrences(buffer, counts);
+    start[0] = 0;
+    for(int c=1; c<N_ASCII; c++)
+        start[c] = start[c-1]+counts[c-1];
+    for(int i=0; i<size; i++)
+        indexes[start[tabChar[i]]++] = i;
+}
+
+
+/**
+ * \fn int burrowsWheeler(FileBuffer* bufferIn, ScratchPool* scratch, int nbThreads, long long deadlineNs)
  * \brief Applies Burrows Wheeler to bufferIn
  * \param bufferIn Buffer on which is applied Burrows Wheeler
- * \return Index used to decode the text encoded with Burrows Wheeler
+ * \param scratch Pool in which the copy of the text and the arrays of the sort are taken
+ * \param nbThreads Largest number of threads used by the sort of the rotations
+ * \param deadlineNs Time (getTimeNs) after which the sort of the rotations is stopped, 0 if there isn't any limit
+ * \return Index used to decode the text encoded with Burrows Wheeler, -1 if the sort was stopped (bufferIn isn't modified)
  */
 
-int burrowsWheeler(FileBuffer* bufferIn)
+int burrowsWheeler(FileBuffer* bufferIn, ScratchPool* scratch, int nbThreads, long long deadlineNs)
 {
     int size = bufferIn->size;
-    unsigned char* tabChar=malloc(sizeof(unsigned char)*size);
-    int* indexes=malloc(sizeof(int)*size);
-    for(int i=0; i<size; i++)
-    {
-        tabChar[i]=bufferIn->text[i];
-        indexes[i]=i;
-    }
-    rotationSort(tabChar, indexes, size);
+    unsigned char* tabChar = (unsigned char*) scratchGet(scratch, SCRATCH_BWT_TEXT, sizeof(unsigned char)*size);
+    uint32_t* indexes = (uint32_t*) scratchGet(scratch, SCRATCH_BWT_INDEXES, sizeof(uint32_t)*size);
+    memcpy(tabChar, bufferIn->text, size);
+    if(!rotationSort(tabChar, indexes, size, scratch, nbThreads, deadlineNs))
+        return -1;
     int i=0;
     int beginning=0;
     while(i<size)
@@ -110,55 +286,54 @@ int burrowsWheeler(FileBuffer* bufferIn)
 
     for(int j=0; j<size; j++)
     {
-        int id = indexes[j]-1;
+        int id = (int) indexes[j]-1;
         if(id==-1)
             id=size-1;
         bufferIn->text[j]=tabChar[id];
     }
-    free(tabChar);
-    free(indexes);
 
     return beginning;
 }
 
 /**
- * \fn void burrowsWheelerDecode(FileBuffer bufferIn, FILE* fileBWDecode)
- * \brief Applies the inverse of Burrows-Wheeler to bufferIn and save it in fileBWDecode
+ * \fn void burrowsWheelerDecode(int indexBW, FileBuffer bufferIn, AsyncFile* fileBWDecode, ScratchPool* scratch)
+ * \brief Applies the inverse of Burrows-Wheeler to bufferIn and save it in fileBWDecode. Only 4 bytes per character are allocated (the sorted indexes), the result is written by chunks of BUFFER_SIZE bytes
  * \param indexBW Index used to decode the text encoded with Burrows Wheeler
- * \param bufferInBuffer Buffer on which is applied the inverse of Burrows Wheeler Buffer
- * \param fileBWDecode File in which is saved the result
+ * \param bufferIn Buffer on which is applied the inverse of Burrows Wheeler Buffer
+ * \param fileBWDecode File in which is saved the result, from its current position
+ * \param scratch Pool in which the array of indexes is taken
  */
 
-void burrowsWheelerDecode(int indexBW, FileBuffer bufferIn, FILE* fileBWDecode)
+void burrowsWheelerDecode(int indexBW, FileBuffer bufferIn, AsyncFile* fileBWDecode, ScratchPool* scratch)
 {
-    int progress=0;
-    int* indexes= (int*) malloc(sizeof(int*)*bufferIn.size); // Will contained sorted indexes
-    int i=0;
+    Progress progress;
+    uint32_t* indexes = (uint32_t*) scratchGet(scratch, SCRATCH_BWT_INDEXES, sizeof(uint32_t)*bufferIn.size); // Will contained sorted indexes
+    unsigned char chunk[BUFFER_SIZE];
+    FileBuffer bufferChunk;
+    uint32_t i=0;
     int nbW=0; // Number of written characters
+    int endChunk=0;
 
-    for(int i=0; i<bufferIn.size; i++)
-    {
-        indexes[i]=i;
+    if(indexBW<0 || indexBW>=bufferIn.size){
+        fprintf(stderr, "\nERROR : Incorrect index of Burrows Wheeler\n");
+        exit(EXIT_FAILURE);
     }
+    countingSortIndexes(bufferIn.text, indexes, bufferIn.size);
 
-    printf("\nSorting indexes for Burrows Wheeler...\n");
-    bubbleSortIndexes(bufferIn.text, indexes, bufferIn.size);
-    
-    rewind(fileBWDecode);
     i = indexes[indexBW];
-    printf("\nThe output file is being filled...\n");
+    progressStart(&progress, "burrows wheeler decoding", bufferIn.size);
+    bufferChunk.text = chunk;
     while(nbW<bufferIn.size){
-        fputc(bufferIn.text[i], fileBWDecode);
-        i=indexes[i];
-        nbW++;
-
-        if(progress+5 < 100*(((double)nbW)/bufferIn.size))
-        {
-            progress+=5; 
-            printf("%d%%\n", progress); //Displays the progress of the current task
+        endChunk = progressChunkEnd(&progress);
+        if(endChunk>nbW+BUFFER_SIZE)
+            endChunk = nbW+BUFFER_SIZE;
+        bufferChunk.size = endChunk-nbW;
+        for(int k=0; k<bufferChunk.size; k++){
+            chunk[k] = bufferIn.text[i];
+            i = indexes[i];
         }
-
+        writeOutput(bufferChunk, fileBWDecode);
+        nbW = endChunk;
+        progressReport(&progress, nbW);
     }
-
-    free(indexes);
 }
@@ -0,0 +1,281 @@
+/**
+ * \file Chunking.c
+ * \brief Content-defined chunking : the files are cut where a rolling hash of the last bytes has a given value, so that a change in a file only changes the chunks around it. A chunk is then split in several blocks when the statistics of its parts are different. The hash of each block is saved in an index at the end of the compressed file, and a new version of the file can then be compressed by copying the compressed data of the blocks that didn't change (--update)
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+#include <math.h>
+
+
+static uint64_t gearTable[N_ASCII]; // Random value added to the rolling hash for each character
+static pthread_once_t gearTableOnce = PTHREAD_ONCE_INIT;
+static float logTable[1 << SPLIT_LOG_BITS]; // log2 of the values up to 2^SPLIT_LOG_BITS, used to estimate the size of the blocks
+static pthread_once_t logTableOnce = PTHREAD_ONCE_INIT;
+
+
+/**
+ * \fn static void initGearTable()
+ * \brief Fills the table of the rolling hash with pseudo-random values (always the same ones, so that a file is always cut at the same places)
+ */
+
+static void initGearTable()
+{
+    uint64_t state = 0;
+    for(int i=0; i<N_ASCII; i++){ // splitmix64
+        state += 0x9E3779B97F4A7C15ULL;
+        uint64_t value = state;
+        value = (value ^ (value >> 30))*0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27))*0x94D049BB133111EBULL;
+        gearTable[i] = value ^ (value >> 31);
+    }
+}
+
+/**
+ * \fn int findChunkEnd(const unsigned char* data, int size, const ChunkSettings* settings)
+ * \brief Gives the size of the next chunk : the chunk ends after the first byte (from settings->minSize) where the settings->maskBits high bits of the rolling hash are 0. The hash is shifted by one bit for each byte, so it only depends on the last 64 bytes and the same content is cut at the same place wherever it is in the file
+ * \param data Data that follows the previous chunk
+ * \param size Size of the data, at most BLOCK_SIZE. If the end of the chunk isn't found, it's the size of the chunk (or settings->maxSize if it's smaller)
+ * \param settings Sizes of the chunks (set by the compression level)
+ * \return Size of the chunk
+ */
+
+int findChunkEnd(const unsigned char* data, int size, const ChunkSettings* settings)
+{
+    uint64_t hash = 0;
+
+    pthread_once(&gearTableOnce, initGearTable);
+    if(size>settings->maxSize)
+        size = settings->maxSize;
+    if(size<=settings->minSize)
+        return size;
+    for(int i=(settings->minSize>=64) ? settings->minSize-64 : 0; i<size; i++){
+        hash = (hash << 1) + gearTable[data[i]];
+        if(i>=settings->minSize && (hash >> (64-settings->maskBits))==0)
+            return i+1;
+    }
+    return size;
+}
+
+/**
+ * \fn static void initLogTable()
+ * \brief Fills the table of the logarithms used by estimateBlockSize
+ */
+
+static void initLogTable()
+{
+    logTable[0] = 0;
+    for(int i=1; i<(1 << SPLIT_LOG_BITS); i++)
+        logTable[i] = log2(i);
+}
+
+/**
+ * \fn static inline float fastLog2(uint32_t value)
+ * \brief Approximates log2 of a positive number : its SPLIT_LOG_BITS high bits are read in logTable, which is precise enough to compare the sizes of blocks
+ * \param value Number, at least 1
+ * \return log2 of value
+ */
+
+static inline float fastLog2(uint32_t value)
+{
+    int shift=0;
+    while((value >> shift)>=(1u << SPLIT_LOG_BITS))
+        shift++;
+    return logTable[value >> shift]+shift;
+}
+
+/**
+ * \fn static double estimateBlockSize(const uint32_t* prefix, int start, int end)
+ * \brief Estimates the size in bytes of a block made of the parts start to end-1 of a chunk once coded with Huffman : the entropy of its characters, its tree and its header
+ * \param prefix Occurrences of each character in the first parts of the chunk (N_ASCII values for 0 parts, then for 1 part...)
+ * \param start First part of the block
+ * \param end Part after the last one of the block
+ * \return Estimated size of the block
+ */
+
+static double estimateBlockSize(const uint32_t* prefix, int start, int end)
+{
+    const uint32_t* countsStart = prefix+(size_t) start*N_ASCII;
+    const uint32_t* countsEnd = prefix+(size_t) end*N_ASCII;
+    uint32_t total=0;
+    int nbSymbols=0;
+    double bits=0; // total*log2(total) - sum of count*log2(count), that is the sum of count*log2(total/count)
+
+    for(int c=0; c<N_ASCII; c++){
+        uint32_t count = countsEnd[c]-countsStart[c];
+        if(count>0){
+            total += count;
+            nbSymbols++;
+            bits -= count*fastLog2(count);
+        }
+    }
+    if(total>0)
+        bits += total*fastLog2(total);
+    return bits/8 + BLOCK_HEADER_SIZE+BLOCK_MAP_SIZE + 4+nbSymbols+(4*nbSymbols+4)/8;
+}
+
+/**
+ * \fn static int splitParts(const uint32_t* prefix, int start, int end, int minParts, int lastCut, int* cuts, int nbCuts)
+ * \brief Splits the parts start to end-1 of a chunk in 2 blocks where the sum of their estimated sizes is the smallest, if it's smaller enough than a single block, then splits each of these blocks in the same way
+ * \param prefix Occurrences of each character in the first parts of the chunk
+ * \param start First part of the block
+ * \param end Part after the last one of the block
+ * \param minParts Smallest number of parts of a block
+ * \param lastCut Last part at which a block can begin, so that the last block of the chunk is large enough
+ * \param cuts First part of each block after the first one, filled in order
+ * \param nbCuts Number of cuts already in cuts
+ * \return Number of cuts in cuts
+ */
+
+static int splitParts(const uint32_t* prefix, int start, int end, int minParts, int lastCut, int* cuts, int nbCuts)
+{
+    if(end-start<2*minParts)
+        return nbCuts;
+    double merged = estimateBlockSize(prefix, start, end);
+    double best = merged;
+    int bestCut = -1;
+    for(int cut=start+minParts; cut<=end-minParts && cut<=lastCut; cut++){
+        double size = estimateBlockSize(prefix, start, cut)+estimateBlockSize(prefix, cut, end);
+        if(size<best){
+            best = size;
+            bestCut = cut;
+        }
+    }
+    if(bestCut<0 || merged-best<=merged/SPLIT_MIN_GAIN)
+        return nbCuts;
+    nbCuts = splitParts(prefix, start, bestCut, minParts, lastCut, cuts, nbCuts);
+    cuts[nbCuts++] = bestCut;
+    return splitParts(prefix, bestCut, end, minParts, lastCut, cuts, nbCuts);
+}
+
+/**
+ * \fn int splitChunk(const unsigned char* data, int size, const ChunkSettings* settings, int sizes[SPLIT_MAX_BLOCKS], ScratchPool* scratch)
+ * \brief Cuts a chunk in blocks whose characters have different statistics (e.g. a binary header followed by text), so that each one gets its own codes. The occurrences of the characters are counted once for each part of SPLIT_STEP bytes and added to the ones of the previous parts, so the occurrences of any group of parts are a difference. The chunk is split where the estimated size of the 2 blocks (entropy, trees and headers) is the smallest if it's smaller than the one of the chunk by more than 1/SPLIT_MIN_GAIN, and each block is split again in the same way. The blocks only depend on the content of the chunk, so an unchanged chunk is split in the same way (--update)
+ * \param data Data of the chunk
+ * \param size Size of the chunk
+ * \param settings Sizes of the blocks, the chunk isn't split if settings->splitMinSize is 0
+ * \param sizes Size of each block, filled in order
+ * \param scratch Pool in which the occurrences are counted, the chunk isn't split if they don't fit in its limit
+ * \return Number of blocks
+ */
+
+int splitChunk(const unsigned char* data, int size, const ChunkSettings* settings, int sizes[SPLIT_MAX_BLOCKS], ScratchPool* scratch)
+{
+    int cuts[SPLIT_MAX_BLOCKS];
+    int previous=0;
+
+    sizes[0] = size;
+    if(settings->splitMinSize<=0 || size<2*settings->splitMinSize)
+        return 1;
+    pthread_once(&logTableOnce, initLogTable);
+    int nbParts = (size+SPLIT_STEP-1)/SPLIT_STEP;
+    if(!scratchFits(scratch, SCRATCH_SPLIT, (size_t) (nbParts+1)*N_ASCII*sizeof(uint32_t))) // Not split rather than going over --max-memory
+        return 1;
+    uint32_t* prefix = (uint32_t*) scratchGet(scratch, SCRATCH_SPLIT, (size_t) (nbParts+1)*N_ASCII*sizeof(uint32_t));
+    memset(prefix, 0, N_ASCII*sizeof(uint32_t));
+    for(int part=0; part<nbParts; part++){
+        uint32_t* counts = prefix+(size_t) (part+1)*N_ASCII;
+        int end = (part<nbParts-1) ? (part+1)*SPLIT_STEP : size;
+        memcpy(counts, counts-N_ASCII, N_ASCII*sizeof(uint32_t));
+        for(int i=part*SPLIT_STEP; i<end; i++)
+            counts[data[i]]++;
+    }
+
+    int minParts = (settings->splitMinSize+SPLIT_STEP-1)/SPLIT_STEP;
+    int nbCuts = splitParts(prefix, 0, nbParts, minParts, (size-settings->splitMinSize)/SPLIT_STEP, cuts, 0);
+    for(int i=0; i<nbCuts; i++){
+        sizes[i] = cuts[i]*SPLIT_STEP-previous;
+        previous = cuts[i]*SPLIT_STEP;
+    }
+    sizes[nbCuts] = size-previous;
+    return nbCuts+1;
+}
+
+/**
+ * \fn void writeChunkIndex(AsyncFile* fileOut, const uint64_t* hashes, int nbChunks)
+ * \brief Writes the index of the chunks after the last block of a compressed file : the hash of each block (a chunk or a part of a split chunk), their number and CHUNK_INDEX_MAGIC. It's ignored by the decompression, and it's only written when CONTAINER_INDEX_FLAG is set in the version of the file
+ * \param fileOut Compressed file
+ * \param hashes Hash of each block, in their order
+ * \param nbChunks Number of blocks
+ */
+
+void writeChunkIndex(AsyncFile* fileOut, const uint64_t* hashes, int nbChunks)
+{
+    unsigned char number[8];
+    for(int i=0; i<nbChunks; i++){
+        writeNumber(number, hashes[i], 8);
+        asyncWrite(fileOut, number, 8);
+    }
+    writeNumber(number, nbChunks, 4);
+    memcpy(number+4, CHUNK_INDEX_MAGIC, 4);
+    asyncWrite(fileOut, number, 8);
+}
+
+/**
+ * \fn FILE* openPreviousFile(const char* fileName, DedupTable* chunks)
+ * \brief Opens the previous compressed file of a file and reads the index of its chunks, with the position of each chunk found from the headers of the blocks. A file of the version 3 without CONTAINER_INDEX_FLAG (smaller than CHUNK_INDEX_MIN_SIZE) has no index, so no chunk is added
+ * \param fileName Name of the previous compressed file
+ * \param chunks Table filled with the hash, size and position of each chunk (initialized by the caller)
+ * \return Previous compressed file, opened for reading
+ */
+
+FILE* openPreviousFile(const char* fileName, DedupTable* chunks)
+{
+    unsigned char header[BLOCK_HEADER_SIZE];
+    FILE* fileIn = fopen(fileName, "rb");
+    if(fileIn==NULL){
+        fprintf(stderr, "\nERROR : Cannot open %s\n", fileName);
+        exit(EXIT_FAILURE);
+    }
+
+    long long sizeFile = seekSizeOfFile(fileIn);
+    if(!isCompressedStream(fileIn) || sizeFile<5+9 || fread(header, sizeof(unsigned char), 5, fileIn)!=5){
+        fprintf(stderr, "\nERROR : %s wasn't compressed by this program\n", fileName);
+        exit(EXIT_FAILURE);
+    }
+    if((header[4] & ~CONTAINER_INDEX_FLAG)>=3 && !(header[4] & CONTAINER_INDEX_FLAG)) // Small file compressed without index, none of its chunks is copied
+        return fileIn;
+    if(sizeFile<5+9+8){
+        fprintf(stderr, "\nERROR : %s has no index of its chunks\n", fileName);
+        exit(EXIT_FAILURE);
+    }
+    fileSeek(fileIn, sizeFile-8, SEEK_SET);
+    if(fread(header, sizeof(unsigned char), 8, fileIn)!=8 || memcmp(header+4, CHUNK_INDEX_MAGIC, 4)){
+        fprintf(stderr, "\nERROR : %s has no index of its chunks (it was compressed by a previous version or it's an archive)\n", fileName);
+        exit(EXIT_FAILURE);
+    }
+    int nbChunks = readNumber(header, 4);
+    if(nbChunks<0 || 8LL*nbChunks>sizeFile-5-9-8){
+        fprintf(stderr, "\nERROR : Incorrect index of the chunks of %s\n", fileName);
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t* hashes = (uint64_t*) malloc((nbChunks>0 ? nbChunks : 1)*sizeof(uint64_t));
+    TESTALLOC(hashes);
+    fileSeek(fileIn, sizeFile-8-8LL*nbChunks, SEEK_SET);
+    for(int i=0; i<nbChunks; i++){
+        unsigned char number[8];
+        if(fread(number, sizeof(unsigned char), 8, fileIn)!=8){
+            fprintf(stderr, "\nERROR : Cannot read %s\n", fileName);
+            exit(EXIT_FAILURE);
+        }
+        hashes[i] = readNumber(number, 8);
+    }
+
+    long long offset = 5;
+    for(int i=0; i<nbChunks; i++){
+        fileSeek(fileIn, offset, SEEK_SET);
+        if(fread(header, sizeof(unsigned char), BLOCK_HEADER_SIZE, fileIn)!=BLOCK_HEADER_SIZE || header[0]==BLOCK_END || (header[0] & ~BLOCK_MAP_FLAG)>=N_BLOCK_MODES){
+            fprintf(stderr, "\nERROR : Incorrect index of the chunks of %s\n", fileName);
+            exit(EXIT_FAILURE);
+        }
+        int sizeCoded = BLOCK_HEADER_SIZE+readNumber(header+5, 4);
+        addBlockOffset(chunks, hashes[i], readNumber(header+1, 4), offset, sizeCoded);
+        offset += sizeCoded;
+    }
+    free(hashes);
+    return fileIn;
+}
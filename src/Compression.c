@@ -1,6 +1,7 @@
 /**
  * \file Compression.c
- * \brief Compresses the file given by the user by using the previously created coding table table.txt
+ * \brief Compresses the file given by the user block by block
+ * \details Each block is stored, coded with Huffman, tANS or the bigram mode, coded with Huffman or tANS after a chain of transforms (run length encoding, Burrows Wheeler and Move To Front by default), or coded with LZ77
  * \author Robin Meneust
  * \date 2021
  */
@@ -8,164 +9,610 @@
 #include "../include/Structures_Define.h"
 #include "../include/HuffmanFunctions.h"
 
+#include <limits.h>
+
 
 /**
- * \fn void freeHuffmanTable(HuffmanTableCell* huffmanTable, int sizeHuffmanTable)
- * \brief Frees the memory used by huffmanTable and its linked lists (of the field code)
+ * \fn void compress(FileBuffer bufferBW, FileBuffer* bufferOut, HuffmanTableCell* huffmanTable, int sizeHuffmanTable, ScratchPool* scratch)
+ * \brief Compresses bufferBW by using the Huffman table. The large buffers are coded 2 characters at a time when the scratch pool is given
+ * \param bufferBW Buffer that is being compressed
+ * \param bufferOut Buffer in which the coded bits are added (from bufferOut->size), it must be large enough (see huffmanTableBits) with BIT_IO_SLACK more bytes
  * \param huffmanTable Array of structures HuffmanTableCell containing all the characters associated to a sequence of 0 or 1 depending of their number of occurrences in the initial file
- * \param sizeHuffmanTable Size of huffmanTable
+ * \param sizeHuffmanTable Number of unique elements in the initial file (after the application of the extensions). Size of the array huffmanTable
+ * \param scratch Pool in which the table of the pairs of characters is allocated, NULL to code one character at a time
  */
 
-
-void freeHuffmanTable(HuffmanTableCell* huffmanTable, int sizeHuffmanTable)
+void compress(FileBuffer bufferBW, FileBuffer* bufferOut, HuffmanTableCell* huffmanTable, int sizeHuffmanTable, ScratchPool* scratch)
 {
-    PtrlistCode p = NULL;
+    uint32_t* pairCodes=NULL;
+    uint64_t codes[N_ASCII]; // Code of each character, so that it's found without searching the table
+    unsigned char lengths[N_ASCII]={0};
     for(int i=0; i<sizeHuffmanTable; i++){
-        while(huffmanTable[i].code!=NULL){
-            p = huffmanTable[i].code;
-            huffmanTable[i].code = huffmanTable[i].code->next;
-            free(p);
+        codes[huffmanTable[i].c] = huffmanTable[i].bits;
+        lengths[huffmanTable[i].c] = huffmanTable[i].length;
+    }
+    if(scratch!=NULL && bufferBW.size>=PAIR_TABLE_MIN_SIZE && scratchFits(scratch, SCRATCH_PAIR_CODES, N_ASCII*N_ASCII*sizeof(uint32_t))){
+        pairCodes = (uint32_t*) scratchGet(scratch, SCRATCH_PAIR_CODES, N_ASCII*N_ASCII*sizeof(uint32_t));
+        createPairCodes(codes, lengths, pairCodes);
+    }
+    encodeSymbols(bufferBW, bufferOut, codes, lengths, pairCodes);
+}
+
+
+/**
+ * \fn static BlockMode fitDeadline(BlockMode mode, int size, DeadlineBudget* deadline, long long* endBlockNs)
+ * \brief Chooses a cheaper mode than the one of the analysis if the block can't be compressed with it in time
+ * \details The time needed to code the bytes left after the block is kept, the rest can be used by the block : the transforms or LZ77 are skipped if they don't fit in it, and the block is stored if even the coding doesn't fit
+ * \param mode Mode chosen by the analysis
+ * \param size Size of the block
+ * \param deadline Time allowed and measured costs
+ * \param endBlockNs Time after which the transforms are stopped, so that the block can still be coded in time
+ * \return Mode used
+ */
+
+static BlockMode fitDeadline(BlockMode mode, int size, DeadlineBudget* deadline, long long* endBlockNs)
+{
+    long long now = getTimeNs();
+    double available = (double) (deadline->endNs-now);
+    if(deadline->bytesLeft>size)
+        available -= deadline->codingNsPerByte*(deadline->bytesLeft-size);
+    double coding = deadline->codingNsPerByte*size;
+
+    if(mode==BLOCK_CHAIN_HUFFMAN && deadline->bwtNsPerByte*size+coding>available){
+        mode = BLOCK_HUFFMAN;
+        deadline->bwtNsPerByte *= 0.9; // Lowered a little each time so that it's tried again if it was overestimated
+    }
+    if(mode==BLOCK_LZ77 && deadline->lz77NsPerByte*size>available){ // LZ77 codes its sequences itself
+        mode = BLOCK_HUFFMAN;
+        deadline->lz77NsPerByte *= 0.9;
+    }
+    if(coding>available)
+        mode = BLOCK_STORED;
+    *endBlockNs = now+(long long) (available-coding);
+    return mode;
+}
+
+/**
+ * \fn static void measureCost(double* nsPerByte, long long startNs, int size)
+ * \brief Updates the time per byte of a part of the compression with the time it took for a block (average with the previous value, so that it follows the changes of the data)
+ * \param nsPerByte Time per byte updated
+ * \param startNs Time at which this part of the compression of the block started
+ * \param size Size of the block
+ */
+
+static void measureCost(double* nsPerByte, long long startNs, int size)
+{
+    *nsPerByte = (*nsPerByte+(double) (getTimeNs()-startNs)/size)/2;
+}
+
+/**
+ * \fn static int readPreviousChunk(FileBuffer block, uint64_t hash, PipelineContext* context, unsigned char** coded)
+ * \brief Reads the compressed data of the chunk of the previous compressed file (--update) that is the same as a block
+ * \details The chunk with the same hash and size is decoded to check that it's the same as the block. A chunk compressed with another dictionary isn't used, and the block is compressed again if the buffers of the decoding don't fit in --max-memory
+ * \param block Block compressed
+ * \param hash Hash of the block
+ * \param context Context, with the previous compressed file and its chunks. The chunk is read in SCRATCH_CODED and decoded in SCRATCH_PREVIOUS_CHUNK
+ * \param coded Header and data of the compressed chunk if it's found
+ * \return Size of the compressed chunk (header included), 0 if there isn't such a chunk
+ */
+
+static int readPreviousChunk(FileBuffer block, uint64_t hash, PipelineContext* context, unsigned char** coded)
+{
+    int sizeCoded;
+    size_t sizes[N_SCRATCH_SLOTS]={0};
+    long long offset = findBlockOffset(context->chunks, hash, block.size, &sizeCoded);
+    if(offset<0)
+        return 0;
+    // Buffers of the chunk and of its decoding, whatever its mode. The block is compressed again if they go over --max-memory
+    lz77ScratchSizes(block.size, sizes);
+    sizes[SCRATCH_CODED] = sizeCoded;
+    sizes[SCRATCH_PREVIOUS_CHUNK] = block.size;
+    sizes[SCRATCH_OUTPUT] = block.size;
+    sizes[SCRATCH_TRANSFORM_A] = block.size;
+    sizes[SCRATCH_TRANSFORM_B] = block.size;
+    sizes[SCRATCH_BWT_INDEXES] = (size_t) block.size*sizeof(uint32_t);
+    if(!scratchFitsAll(&(context->scratch), sizes))
+        return 0;
+
+    *coded = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_CODED, sizeCoded);
+    fileSeek(context->previous, offset, SEEK_SET);
+    if(fread(*coded, sizeof(unsigned char), sizeCoded, context->previous)!=(size_t) sizeCoded){
+        fprintf(stderr, "\nERROR : Cannot read the previous compressed file\n");
+        exit(EXIT_FAILURE);
+    }
+    int start = BLOCK_HEADER_SIZE+(((*coded)[0] & BLOCK_MAP_FLAG) ? BLOCK_MAP_SIZE : 0);
+    if(((*coded)[0] & ~BLOCK_MAP_FLAG)==BLOCK_DICTIONARY && (context->dictionary==NULL || sizeCoded<start+4 || readNumber(*coded+start, 4)!=context->dictionary->id))
+        return 0;
+
+    // The hash isn't enough to be sure that the chunk is the same as the block
+    PipelineStats* stats = context->stats;
+    FileBuffer bufferIn = {*coded+BLOCK_HEADER_SIZE, sizeCoded-BLOCK_HEADER_SIZE};
+    FileBuffer decoded;
+    AsyncFile output;
+    decoded.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_PREVIOUS_CHUNK, block.size);
+    asyncOpenMemory(&output, &decoded, block.size);
+    context->stats = NULL; // The decoding isn't counted in the measures of the compression
+    decompressBlock((*coded)[0], bufferIn, block.size, &output, context);
+    context->stats = stats;
+    if(!asyncClose(&output) || decoded.size!=block.size || memcmp(decoded.text, block.text, block.size))
+        return 0;
+    return sizeCoded;
+}
+
+/**
+ * \fn static BlockMode fitMemory(BlockMode mode, int size, size_t sizeCoded, PipelineContext* context, int* tables)
+ * \brief Chooses a cheaper mode than the one of the analysis if the scratch buffers of the block go over the limit of the pool (--max-memory)
+ * \details The buffers of the mode (chain of transforms or LZ77), of the coded block and of the tables of the coders (pairs of characters, tANS and bigrams) are checked together. When they don't fit, the transforms or LZ77 are dropped first, then the tables, and the block is stored if even the buffer of the coded block doesn't fit. Each step is counted in the degraded blocks
+ * \param mode Mode chosen by the analysis
+ * \param size Size of the block
+ * \param sizeCoded Size of the buffer of the coded block (SCRATCH_CODED)
+ * \param context Context, with the pool and the measures
+ * \param tables Set to 1 if the tables of the coders can be used, 0 otherwise
+ * \return Mode used, the block is written without SCRATCH_CODED if it's BLOCK_STORED and this buffer doesn't fit
+ */
+
+static BlockMode fitMemory(BlockMode mode, int size, size_t sizeCoded, PipelineContext* context, int* tables)
+{
+    size_t sizes[N_SCRATCH_SLOTS];
+    *tables = 1;
+    if(context->scratch.limit==0)
+        return mode;
+    while(1){
+        memset(sizes, 0, sizeof(sizes));
+        if(mode==BLOCK_CHAIN_HUFFMAN){
+            transformsScratchSizes(&(context->transforms), size, sizes);
+            sizes[SCRATCH_OUTPUT] = size; // Copy of the block before its transforms
+        }
+        else if(mode==BLOCK_LZ77)
+            lz77ScratchSizes(size, sizes);
+        if(mode!=BLOCK_STORED)
+            sizes[SCRATCH_CODED] = sizeCoded;
+        if(*tables && mode!=BLOCK_STORED && mode!=BLOCK_FILL){ // Only the tables that the coders of the block can use
+            if(size>=PAIR_TABLE_MIN_SIZE)
+                sizes[SCRATCH_PAIR_CODES] = N_ASCII*N_ASCII*sizeof(uint32_t);
+            if(mode!=BLOCK_DICTIONARY && (context->coder==CODER_AUTO || context->coder==CODER_TANS))
+                sizes[SCRATCH_TANS_BITS] = (size_t) size*sizeof(uint16_t);
+            if(mode!=BLOCK_DICTIONARY && (context->coder==CODER_AUTO || context->coder==CODER_BIGRAM) && size>=BIGRAM_MIN_BLOCK)
+                sizes[SCRATCH_BIGRAMS] = N_ASCII*N_ASCII*(sizeof(uint32_t)+sizeof(uint16_t));
         }
+        if(scratchFitsAll(&(context->scratch), sizes) || mode==BLOCK_STORED)
+            return mode;
+        if(mode==BLOCK_CHAIN_HUFFMAN || mode==BLOCK_LZ77)
+            mode = BLOCK_HUFFMAN;
+        else if(*tables)
+            *tables = 0;
+        else
+            mode = BLOCK_STORED;
+        if(context->stats!=NULL)
+            context->stats->degraded++;
     }
-    free(huffmanTable);
 }
 
+/**
+ * \fn static BlockMode writeStoredBlock(FileBuffer block, const long* counts, AsyncFile* fileOut, PipelineContext* context)
+ * \brief Writes a stored block directly from its data, without copying it in SCRATCH_CODED, when this buffer would go over the limit of the pool (--max-memory)
+ * \param block Block written
+ * \param counts Occurrences of the characters of the block, NULL if they weren't counted
+ * \param fileOut File in which the block is written
+ * \param context Context, with the measures
+ * \return BLOCK_STORED
+ */
 
+static BlockMode writeStoredBlock(FileBuffer block, const long* counts, AsyncFile* fileOut, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    unsigned char header[BLOCK_HEADER_SIZE+BLOCK_MAP_SIZE];
+    int sizeMap=0;
+
+    stageStart(stats, STAGE_WRITE);
+    if(block.size>=BLOCK_MAP_MIN_SIZE){
+        fillCharacterMap(block, counts, header+BLOCK_HEADER_SIZE);
+        sizeMap = BLOCK_MAP_SIZE;
+    }
+    header[0] = BLOCK_STORED | ((sizeMap>0) ? BLOCK_MAP_FLAG : 0);
+    writeNumber(header+1, block.size, 4);
+    writeNumber(header+5, sizeMap+block.size, 4);
+    if(asyncWrite(fileOut, header, BLOCK_HEADER_SIZE+sizeMap)!=(size_t) (BLOCK_HEADER_SIZE+sizeMap) || asyncWrite(fileOut, block.text, block.size)!=(size_t) block.size){
+        fprintf(stderr, "\nERROR : Cannot write the compressed file\n");
+        exit(EXIT_FAILURE);
+    }
+    stageStop(stats, STAGE_WRITE, block.size, BLOCK_HEADER_SIZE+sizeMap+block.size);
+    if(stats!=NULL)
+        stats->blocks[BLOCK_STORED]++;
+    return BLOCK_STORED;
+}
 
 /**
- * \fn void compress(FileBuffer bufferBW, FILE* fileOut, FileBuffer bufferTable)
- * \brief Compresses bufferBW by using the Huffman table
- * \param bufferBW Buffer that is being compressed
- * \param fileOut File compressed filled in this function by using the Huffman coding
- * \param huffmanTable Array of structures HuffmanTableCell containing all the characters associated to a sequence of 0 or 1 depending of their number of occurrences in the initial file
- * \param sizeHuffmanTable Number of unique elements in the initial file (after the application of the extensions). Size of the array huffmanTable
+ * \fn BlockMode compressBlock(FileBuffer block, uint64_t hash, AsyncFile* fileOut, PipelineContext* context)
+ * \brief Analyses a block, compresses it with the chosen mode and writes it (header and data) in fileOut
+ * \details The blocks for which the analysis chooses Burrows Wheeler go through the chain of transforms of the context, or through LZ77 with context->lz.window, which is kept only if it's smaller than the Huffman coding. The block is then coded with Huffman or tANS, whichever gives the smallest estimated size, or with the bigram mode (Huffman codes of the characters and of the frequent pairs of characters) when the block is large enough and it's even smaller. If the coded block isn't smaller than the block itself, it's stored. The header of the blocks of BLOCK_MAP_MIN_SIZE bytes or more (except the ones coded with the dictionary) is followed by the map of their characters
+ * \param block Block compressed, it's modified (by the transforms that work in place)
+ * \param hash Hash of the block (hashBlock), used to find it in the table of the blocks already compressed and in the chunks of the previous compressed file (--update), whose compressed data is then written again
+ * \param fileOut File in which the block is written
+ * \param context Memory and measures of the compression. The small blocks are coded with its dictionary if there is one, without being analysed, and one of the coders can be forced (context->coder). With a time budget (context->deadline) the transforms are skipped (or stopped) and then the coding too when the block can't be compressed in its share of the time left, and with a limit of memory (--max-memory) the block is degraded in the same way when its buffers don't fit (fitMemory)
+ * \return Mode with which the block was written
  */
 
-void compress(FileBuffer bufferBW, FILE* fileOut, HuffmanTableCell* huffmanTable, int sizeHuffmanTable)
+BlockMode compressBlock(FileBuffer block, uint64_t hash, AsyncFile* fileOut, PipelineContext* context)
 {
-    uint8_t buffer=0;   // Byte used to contain the binary code before being inserted in the file fileOut
-    FileBuffer bufferOut; // Used to write in fileOut
-    bufferOut.text = (unsigned char*) malloc(sizeof(unsigned char)*BUFFER_SIZE);
-    bufferOut.size=0;
-    int filling=0;
-    int progress=0;
-    unsigned char c, c_table;
-    rewind(fileOut);
-    int posIn=0;
-    int posTable=0;
-    PtrlistCode l=NULL;
-    while(posIn<bufferBW.size){
-        c = bufferBW.text[posIn];
-        c_table = huffmanTable[posTable].c;
-        while(c_table!=c && posTable<sizeHuffmanTable){
-            posTable++;
-            c_table = huffmanTable[posTable].c;
+    PipelineStats* stats = context->stats;
+    BlockAnalysis analysis;
+    FileBuffer original = block; // Copy of the block kept if it's modified, so that it can still be stored
+    FileBuffer bufferOut;
+    TransformChain applied; // Transforms applied to the block
+    int indexBW=-1;
+    int sizeOccurrencesArray=0;
+    int sizeHuffmanTable=0;
+    HuffmanTreePtr huffmanTree=NULL;
+    int dedup = context->dedup!=NULL && block.size>=DEDUP_MIN_BLOCK;
+    int counted=0; // 1 if the occurrences of the characters of the whole block are in analysis.counts
+    int sizeMap=0;
+    int tables=1; // 0 if the tables of the coders go over --max-memory
+
+    if(dedup || context->chunks!=NULL){
+        unsigned char* coded;
+        int sizeCoded = 0;
+        int* counter = NULL;
+        stageStart(stats, STAGE_DEDUP);
+        if(context->chunks!=NULL && (sizeCoded=readPreviousChunk(block, hash, context, &coded))>0)
+            counter = (stats!=NULL) ? &(stats->reused) : NULL;
+        else if(dedup && (sizeCoded=findCodedBlock(context->dedup, block, hash, &(context->scratch), &coded))>0)
+            counter = (stats!=NULL) ? &(stats->duplicates) : NULL;
+        stageStop(stats, STAGE_DEDUP, block.size, sizeCoded);
+        if(sizeCoded>0){
+            stageStart(stats, STAGE_WRITE);
+            if(asyncWrite(fileOut, coded, sizeCoded)!=(size_t) sizeCoded){
+                fprintf(stderr, "\nERROR : Cannot write the compressed file\n");
+                exit(EXIT_FAILURE);
+            }
+            stageStop(stats, STAGE_WRITE, sizeCoded-BLOCK_HEADER_SIZE, sizeCoded);
+            BlockMode mode = coded[0] & ~BLOCK_MAP_FLAG;
+            if(stats!=NULL){
+                stats->blocks[mode]++;
+                (*counter)++;
+            }
+            return mode;
         }
-        if(c_table!=c){
-            printf("ERROR : Character not found in the table : %c|%d", c, c);
-            exit(EXIT_FAILURE);
+    }
+
+    size_t sizeOut = BLOCK_HEADER_SIZE+TRANSFORM_CHAIN_MAX_SIZE+TREE_MAX_SIZE+TANS_COUNTS_MAX_SIZE+block.size+BIT_IO_SLACK;
+    if(context->dictionary!=NULL && block.size<DICTIONARY_MAX_BLOCK){
+        analysis.mode = BLOCK_DICTIONARY;
+        if(BLOCK_HEADER_SIZE+4+((size_t) block.size*context->dictionary->maxCodeLength+7)/8+BIT_IO_SLACK > sizeOut)
+            sizeOut = BLOCK_HEADER_SIZE+4+((size_t) block.size*context->dictionary->maxCodeLength+7)/8+BIT_IO_SLACK;
+    }
+    else if(context->deadline.budgetNs>0 && getTimeNs()>=context->deadline.endNs){ // No time left, the block is stored without being analysed
+        analysis.mode = BLOCK_STORED;
+        if(stats!=NULL)
+            stats->degraded++;
+    }
+    else{
+        stageStart(stats, STAGE_ANALYSIS);
+        analyseBlock(&(context->arena), block, context->transforms.nbTransforms>0 || context->lz.window>0, context->lz.window, &analysis); // Burrows Wheeler is only estimated if a mode can use its gain
+        resetArena(&(context->arena));
+        stageStop(stats, STAGE_ANALYSIS, block.size, 0);
+        counted = !analysis.sampled;
+        if(analysis.mode==BLOCK_BWT_HUFFMAN) // The transforms of the context are applied
+            analysis.mode = BLOCK_CHAIN_HUFFMAN;
+    }
+
+    BlockMode fitted = fitMemory(analysis.mode, block.size, sizeOut+BLOCK_MAP_SIZE, context, &tables);
+    if(fitted==BLOCK_STORED && !scratchFits(&(context->scratch), SCRATCH_CODED, sizeOut+BLOCK_MAP_SIZE))
+        return writeStoredBlock(block, counted ? analysis.counts : NULL, fileOut, context);
+    analysis.mode = fitted;
+
+    unsigned char* out = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_CODED, sizeOut+BLOCK_MAP_SIZE);
+    if(block.size>=BLOCK_MAP_MIN_SIZE && analysis.mode!=BLOCK_DICTIONARY){ // Map of the characters of the block, before it's modified by Burrows Wheeler
+        fillCharacterMap(block, counted ? analysis.counts : NULL, out+BLOCK_HEADER_SIZE);
+        sizeMap = BLOCK_MAP_SIZE;
+    }
+    bufferOut.text = out+BLOCK_HEADER_SIZE+sizeMap;
+    bufferOut.size = 0;
+    BlockMode mode = analysis.mode;
+    long long endBlockNs=0; // Time after which Burrows Wheeler is stopped (--deadline)
+    long long startNs=0;
+    if(context->deadline.budgetNs>0 && mode!=BLOCK_STORED && mode!=BLOCK_FILL){
+        mode = fitDeadline(mode, block.size, &(context->deadline), &endBlockNs);
+        if(mode!=analysis.mode && stats!=NULL)
+            stats->degraded++;
+    }
+
+    if(mode==BLOCK_DICTIONARY){
+        writeNumber(bufferOut.text, context->dictionary->id, 4);
+        bufferOut.size = 4;
+        stageStart(stats, STAGE_HUFFMAN_ENCODE);
+        compress(block, &bufferOut, context->dictionary->huffmanTable, context->dictionary->sizeHuffmanTable, tables ? &(context->scratch) : NULL);
+        stageStop(stats, STAGE_HUFFMAN_ENCODE, block.size, bufferOut.size);
+        if(bufferOut.size>=block.size)
+            mode = BLOCK_STORED;
+    }
+
+    if(mode==BLOCK_CHAIN_HUFFMAN){
+        original.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_OUTPUT, block.size);
+        memcpy(original.text, block.text, block.size);
+
+        startNs = getTimeNs();
+        if(!applyTransforms(&block, &(context->transforms), &applied, endBlockNs, context)){ // The time of the block was over before the end of Burrows Wheeler, the block is coded without its transforms
+            mode = BLOCK_HUFFMAN;
+            block = original;
+            if(stats!=NULL)
+                stats->degraded++;
+            double measured = (double) (getTimeNs()-startNs)/block.size;
+            if(context->deadline.bwtNsPerByte<2*measured) // The sort would have taken longer
+                context->deadline.bwtNsPerByte = 2*measured;
         }
+        else{
+            stageStart(stats, STAGE_HISTOGRAM);
+            countOccurrences(block, analysis.counts);
+            stageStop(stats, STAGE_HISTOGRAM, block.size, 0);
+
+            if(applied.nbTransforms==0) // None was worth it
+                mode = BLOCK_HUFFMAN;
+            else
+                bufferOut.size += saveTransforms(&applied, bufferOut.text);
+            for(int i=0; i<applied.nbTransforms; i++){
+                if(applied.ids[i]==TRANSFORM_BWT)
+                    indexBW = readNumber(applied.params[i], 4);
+            }
+            if(context->deadline.budgetNs>0)
+                measureCost(&(context->deadline.bwtNsPerByte), startNs, original.size);
+        }
+    }
+
+    if(mode==BLOCK_LZ77){
+        startNs = getTimeNs();
+        long long sizeHuffman = 4+analysis.symbols+(4*analysis.symbols+4)/8 + (analysis.huffmanBits+7)/8; // LZ77 is kept only if it's smaller than the Huffman coding
+        int sizeMax = (sizeHuffman<original.size) ? sizeHuffman-1 : original.size-1;
+        bufferOut.size = lz77Encode(block, bufferOut.text, sizeMax, context);
+        if(bufferOut.size==0)
+            mode = BLOCK_HUFFMAN;
+        if(context->deadline.budgetNs>0)
+            measureCost(&(context->deadline.lz77NsPerByte), startNs, block.size);
+    }
+
+    if(context->deadline.budgetNs>0)
+        startNs = getTimeNs();
+    if(mode==BLOCK_HUFFMAN || mode==BLOCK_CHAIN_HUFFMAN){
+        HuffmanTableCell* huffmanTable=NULL;
+        uint16_t normalized[N_ASCII];
+        long long sizeCoded=LLONG_MAX;
+        int sizeTable=0;
 
-        l = huffmanTable[posTable].code;
-        while(l!=NULL){
-            switch(l->value){
-                case '0': buffer <<= 1; break;  //We shift bits to the left, then we add the bit (0 here) to the right
-                case '1': buffer <<= 1; buffer|=0b1; break; //We shift bits to the left, then we add the bit (1 here) to the right, we use a mask to do so
-                default : fprintf(stderr, "\nERROR : Binary code not found in table\n"); exit(EXIT_FAILURE);
+        stageStart(stats, STAGE_TREE);
+        OccurrencesArrayCell* occurrencesArray = createOccurrencesArray(&(context->arena), analysis.counts, &sizeOccurrencesArray);
+        if(sizeOccurrencesArray>=2){ // Huffman can't code only one character, it's possible after Move To Front
+            huffmanTable = createHuffmanTable(&(context->arena), occurrencesArray, sizeOccurrencesArray, &sizeHuffmanTable, &huffmanTree);
+            sizeCoded = bufferOut.size + 4+sizeHuffmanTable+(4*sizeHuffmanTable+4)/8 + (huffmanTableBits(huffmanTable, sizeHuffmanTable, analysis.counts)+7)/8;
+        }
+        if(tables && (context->coder==CODER_AUTO || context->coder==CODER_TANS) && scratchFits(&(context->scratch), SCRATCH_TANS_BITS, block.size*sizeof(uint16_t))){ // The coder whose estimated size is the smallest is used (--coder)
+            normalizeCounts(analysis.counts, normalized);
+            long long sizeTans = bufferOut.size + N_ASCII/8+2*sizeOccurrencesArray + (TANS_TABLE_LOG+tansSizeBits(analysis.counts, normalized)+7)/8;
+            if(sizeTans<sizeCoded || (context->coder==CODER_TANS && sizeTans<original.size)){
+                mode = (mode==BLOCK_CHAIN_HUFFMAN) ? BLOCK_CHAIN_TANS : BLOCK_TANS;
+                sizeCoded = sizeTans;
             }
-            filling++;
-            if(filling==8){ //The buffer is filled, we can insert it in bufferOut
-                bufferOut.text[bufferOut.size]=buffer;
-                bufferOut.size++;
-                buffer=0;
-                filling=0;
-
-                if(bufferOut.size==BUFFER_SIZE){ // The buffer is full
-                    fwrite(bufferOut.text, sizeof(unsigned char), bufferOut.size, fileOut);
-                    bufferOut.size=0;
-                }
+        }
+
+        if(tables && (mode==BLOCK_HUFFMAN || mode==BLOCK_TANS) && (context->coder==CODER_AUTO || context->coder==CODER_BIGRAM) && block.size>=BIGRAM_MIN_BLOCK
+            && scratchFits(&(context->scratch), SCRATCH_BIGRAMS, N_ASCII*N_ASCII*(sizeof(uint32_t)+sizeof(uint16_t)))){ // Frequent pairs of characters coded as one symbol, kept if it's smaller than the other coders
+            stageStop(stats, STAGE_TREE, 0, 0);
+            long long sizeMax = (context->coder==CODER_BIGRAM || sizeCoded>original.size) ? original.size-1 : sizeCoded-1;
+            int sizeBigrams = bigramEncode(block, bufferOut.text+bufferOut.size, sizeMax-bufferOut.size, context);
+            if(sizeBigrams>0){
+                mode = BLOCK_BIGRAM_HUFFMAN;
+                bufferOut.size += sizeBigrams;
             }
+            else
+                stageStart(stats, STAGE_TREE);
+        }
+
+        if(mode==BLOCK_BIGRAM_HUFFMAN) // Already coded, its header is counted in the statistics by bigramEncode
+            sizeTable = 0;
+        else if(sizeCoded>=original.size){
+            mode = BLOCK_STORED;
+            stageStop(stats, STAGE_TREE, 0, 0);
+        }
+        else if(mode==BLOCK_TANS || mode==BLOCK_CHAIN_TANS){
+            TansTable* tansTable = (TansTable*) arenaAlloc(&(context->arena), sizeof(TansTable));
+            createTansTable(normalized, tansTable);
+            sizeTable = saveTansCounts(normalized, bufferOut.text+bufferOut.size);
+            bufferOut.size += sizeTable;
+            stageStop(stats, STAGE_TREE, 0, sizeTable);
 
-            l = l->next;
+            stageStart(stats, STAGE_TANS_ENCODE);
+            uint16_t* bits = (uint16_t*) scratchGet(&(context->scratch), SCRATCH_TANS_BITS, block.size*sizeof(uint16_t));
+            if(!tansEncodeSymbols(block, &bufferOut, tansTable, bits, original.size-1)) // The estimation was slightly too small
+                mode = BLOCK_STORED;
+            stageStop(stats, STAGE_TANS_ENCODE, block.size, bufferOut.size-sizeTable);
         }
-        posIn++;
-        posTable=0;
+        else{
+            sizeTable = saveTree(huffmanTree, sizeHuffmanTable, bufferOut.text+bufferOut.size);
+            bufferOut.size += sizeTable;
+            stageStop(stats, STAGE_TREE, 0, sizeTable);
 
-        if(progress+5 < 100*(((double)posIn)/bufferBW.size))
-        {
-            progress+=5; 
-            printf("%d%%\n", progress); //Displays the progress of the current task
+            stageStart(stats, STAGE_HUFFMAN_ENCODE);
+            compress(block, &bufferOut, huffmanTable, sizeHuffmanTable, tables ? &(context->scratch) : NULL);
+            stageStop(stats, STAGE_HUFFMAN_ENCODE, block.size, bufferOut.size-sizeTable);
+        }
+        if(stats!=NULL && mode!=BLOCK_STORED){
+            stats->tableSize += sizeTable;
+            if(sizeOccurrencesArray>stats->symbols)
+                stats->symbols = sizeOccurrencesArray;
+            if(stats->indexBW<0)
+                stats->indexBW = indexBW;
         }
+        resetArena(&(context->arena)); // The tree and the tables are freed
+        if(context->deadline.budgetNs>0 && mode!=BLOCK_STORED)
+            measureCost(&(context->deadline.codingNsPerByte), startNs, block.size);
+    }
+
+    if(mode==BLOCK_STORED){
+        memcpy(bufferOut.text, original.text, original.size);
+        bufferOut.size = original.size;
+    }
+    else if(mode==BLOCK_FILL){
+        bufferOut.text[0] = block.text[0];
+        bufferOut.size = 1;
+    }
+
+    stageStart(stats, STAGE_WRITE);
+    out[0] = mode | ((sizeMap>0) ? BLOCK_MAP_FLAG : 0);
+    writeNumber(out+1, original.size, 4);
+    writeNumber(out+5, sizeMap+bufferOut.size, 4);
+    int sizeCoded = BLOCK_HEADER_SIZE+sizeMap+bufferOut.size;
+    if(asyncWrite(fileOut, out, sizeCoded)!=(size_t) sizeCoded){
+        fprintf(stderr, "\nERROR : Cannot write the compressed file\n");
+        exit(EXIT_FAILURE);
     }
+    stageStop(stats, STAGE_WRITE, bufferOut.size, sizeCoded);
+    if(dedup)
+        addCodedBlock(context->dedup, original, hash, out, sizeCoded);
 
-    if(filling!=0){
-        while(filling<8 && buffer!=0){
-            buffer <<= 1;
-            filling++;
+    if(stats!=NULL)
+        stats->blocks[mode]++;
+    return mode;
+}
+
+
+/**
+ * \fn void compressStream(FILE* fileIn, long long sizeFileIn, FILE* fileOut, PipelineContext* context)
+ * \brief Compresses fileIn block by block in fileOut
+ * \details The blocks are the chunks cut by their content (findChunkEnd), split in several blocks when the statistics of their parts are different (splitChunk). The compressed file begins with CONTAINER_MAGIC and CONTAINER_VERSION, then each block has its own header, and a block BLOCK_END followed by the size of the data ends it. The index of the blocks (the hash of each one) is written after it, unless the size of the data is known and smaller than CHUNK_INDEX_MIN_SIZE (CONTAINER_INDEX_FLAG is set in the version when it's written)
+ * \param fileIn File compressed, read from its current position
+ * \param sizeFileIn Size of the data read, used to report the progress, to choose if the index is written and to share the time budget between the blocks (-1 if it's not known)
+ * \param fileOut File in which the compressed data is written from its current position
+ * \param context Memory reused between the blocks and measures of each stage (if context->stats isn't NULL). Its sizes of the chunks (context->chunking) are used to cut them. With a time budget (context->deadline.budgetNs), the file has to be compressed within it and cheaper modes are used for the blocks when it's short. With several threads, the files are read and written by their own threads while the blocks are compressed
+ */
+
+void compressStream(FILE* fileIn, long long sizeFileIn, FILE* fileOut, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    unsigned char header[8];
+    FileBuffer block;
+    int sizes[SPLIT_MAX_BLOCKS]; // Sizes of the blocks of a chunk
+    long long sizeRead=0;
+    int sizeBuffered=0; // Data read after the last chunk
+    int end=0;
+    uint64_t* hashes=NULL; // Hash of each chunk, written in the index
+    int nbChunks=0;
+    int capacity=0;
+    int hasIndex = sizeFileIn<0 || sizeFileIn>=CHUNK_INDEX_MIN_SIZE;
+    Progress progress;
+    AsyncFile asyncIn;
+    AsyncFile asyncOut;
+
+    asyncOpen(&asyncIn, fileIn, 0, context->nbThreads>1, &(context->scratch));
+    asyncOpen(&asyncOut, fileOut, 1, context->nbThreads>1, &(context->scratch));
+    memcpy(header, CONTAINER_MAGIC, 4);
+    header[4] = CONTAINER_VERSION | (hasIndex ? CONTAINER_INDEX_FLAG : 0);
+    asyncWrite(&asyncOut, header, 5);
+    if(context->deadline.budgetNs>0)
+        context->deadline.endNs = getTimeNs()+context->deadline.budgetNs;
+
+    progressStart(&progress, "compression", sizeFileIn);
+    while(1){
+        stageStart(stats, STAGE_READ);
+        block.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_INPUT, BLOCK_SIZE);
+        size_t sizeNew = end ? 0 : asyncRead(&asyncIn, block.text+sizeBuffered, BLOCK_SIZE-sizeBuffered);
+        end = sizeNew<(size_t) (BLOCK_SIZE-sizeBuffered);
+        sizeBuffered += sizeNew;
+        stageStop(stats, STAGE_READ, sizeNew, sizeNew);
+        if(sizeBuffered==0)
+            break;
+
+        stageStart(stats, STAGE_CHUNKING);
+        int sizeChunk = findChunkEnd(block.text, sizeBuffered, &(context->chunking));
+        int nbBlocks = splitChunk(block.text, sizeChunk, &(context->chunking), sizes, &(context->scratch));
+        while(nbChunks+nbBlocks>capacity){
+            capacity = (capacity>0) ? 2*capacity : 64;
+            hashes = (uint64_t*) realloc(hashes, capacity*sizeof(uint64_t));
+            TESTALLOC(hashes);
         }
-        bufferOut.text[bufferOut.size]=buffer;
-        bufferOut.size++;
-        buffer=0;
-        filling=0;
+        for(int i=0, start=0; i<nbBlocks; start+=sizes[i++]) // Each block of the chunk has its own hash in the index
+            hashes[nbChunks+i] = hashBlock(block.text+start, sizes[i]);
+        if(stats!=NULL && nbBlocks>1)
+            stats->splits++;
+        stageStop(stats, STAGE_CHUNKING, sizeChunk, sizeChunk);
+
+        unsigned char* chunk = block.text;
+        for(int i=0; i<nbBlocks; i++){
+            block.size = sizes[i];
+            context->deadline.bytesLeft = (sizeFileIn>0) ? sizeFileIn-sizeRead : -1;
+            compressBlock(block, hashes[nbChunks++], &asyncOut, context);
+            block.text += block.size; // The next block of the chunk (the block compressed was only modified before it)
+            sizeRead += block.size;
+        }
+        block.text = chunk;
+        sizeBuffered -= sizeChunk;
+        memmove(block.text, block.text+sizeChunk, sizeBuffered); // The beginning of the next chunk
+        if(sizeRead>=progress.next)
+            progressReport(&progress, sizeRead);
+    }
+    if(!asyncClose(&asyncIn)){
+        fprintf(stderr, "\nERROR : Cannot read the file\n");
+        exit(EXIT_FAILURE);
     }
-    if(bufferOut.size>0){ // The buffer isn't empty
-        fwrite(bufferOut.text, sizeof(unsigned char), bufferOut.size, fileOut);
-        bufferOut.size=0;
+
+    header[0] = BLOCK_END;
+    asyncWrite(&asyncOut, header, 1);
+    writeNumber(header, sizeRead, 8);
+    asyncWrite(&asyncOut, header, 8);
+    if(hasIndex)
+        writeChunkIndex(&asyncOut, hashes, nbChunks);
+    free(hashes);
+    if(!asyncClose(&asyncOut)){
+        fprintf(stderr, "\nERROR : Cannot write the compressed file\n");
+        exit(EXIT_FAILURE);
     }
-    free(bufferOut.text);
 }
 
 
 /**
- * \fn void compressMain(char* fileNameIn)
+ * \fn void compressMain(char* fileNameIn, PipelineContext* context)
  * \brief Main function for compression : calls required functions to the decompression of the file whose name is given to the function
  * \param fileNameIn Name of the file that is being compressed
+ * \param context Memory reused between the files and measures of each stage (if context->stats isn't NULL). If it has a previous compressed file (--update), it's closed at the end, since the new compressed file replaces it when they have the same name
  */
 
-void compressMain(char* fileNameIn)
+void compressMain(char* fileNameIn, PipelineContext* context)
 {
+    PipelineStats* stats = context->stats;
     FILE* fileIn;
     FILE* fileOut;
-    long sizeFileIn;
-    long sizeFileOut;
-    int sizeHuffmanTable=0;
-    int indexBW=-1; // if the value is still -1 when we write it in the table then we won't apply BW and MTF to decompress the file
+    char fileNameTemp[FILENAME_MAX+8];
+    long long sizeFileIn;
+    long long sizeFileOut;
 
     fileIn = fopen(fileNameIn, "rb");
     TESTFOPEN(fileIn);
     sizeFileIn = seekSizeOfFile(fileIn);
 
-    FileBuffer bufferText=fileToBuffer(fileIn);
-    FCLOSE(fileIn);
-
-
-
-    if(sizeFileIn<30000)
-    {
-        //BURROWS WHEELER
-        printf("\nBurrows Wheeler...\n");
-        indexBW = burrowsWheeler(&bufferText);
-
-        // MTF
-        printf("\nMove To Front...\n");
-        moveToFrontEncode(&bufferText);
-    } 
-
-    //TABLE CREATION
-    printf("\nTable creation...\n");
-    HuffmanTableCell* huffmanTable = createHuffmanTable(indexBW, bufferText, &sizeHuffmanTable);
-
-    //COMPRESSION
-    fileOut = fopen(strcat(fileNameIn, ".bin"), "wb+"); // We add a .bin at the end of the name so that the initial file isn't replaced
+    strcat(fileNameIn, ".bin"); // We add a .bin at the end of the name so that the initial file isn't replaced
+    if(context->previous!=NULL) // The previous compressed file may be the one replaced, it's read until the end
+        sprintf(fileNameTemp, "%s.tmp", fileNameIn);
+    fileOut = fopen((context->previous!=NULL) ? fileNameTemp : fileNameIn, "wb+");
     TESTFOPEN(fileOut);
-    printf("\nCompression...\n");
-
-    compress(bufferText, fileOut, huffmanTable, sizeHuffmanTable);
-    printf("\nEnd of compression\n");
-    
-    free(bufferText.text);
-    freeHuffmanTable(huffmanTable, sizeHuffmanTable);
-    sizeFileOut = seekSizeOfFile(fileOut);
+    setPartialOutput((context->previous!=NULL) ? fileNameTemp : fileNameIn, fileOut);
+    printStatus("\nCompression...\n");
+    compressStream(fileIn, sizeFileIn, fileOut, context);
+    sizeFileOut = fileTell(fileOut);
+    printStatus("\nEnd of compression\n");
+
+    FCLOSE(fileIn);
+    setPartialOutput(NULL, NULL);
     FCLOSE(fileOut);
-    printf("\nSpace saving : %.2f %%\n\n", (1-(((float)sizeFileOut)/sizeFileIn))*100);
+    if(context->previous!=NULL){
+        FCLOSE(context->previous);
+        context->previous = NULL;
+        remove(fileNameIn);
+        if(rename(fileNameTemp, fileNameIn)!=0){
+            fprintf(stderr, "\nERROR : Cannot rename %s in %s\n", fileNameTemp, fileNameIn);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(sizeFileIn>0)
+        printStatus("\nSpace saving : %.2f %%\n\n", (1-(((double)sizeFileOut)/sizeFileIn))*100);
+
+    if(stats!=NULL)
+        finishStats(stats, sizeFileIn, sizeFileOut);
 }
@@ -0,0 +1,374 @@
+/**
+ * \file Daemon.c
+ * \brief Daemon compressing and decompressing files for its clients through a Unix domain socket. Its workers are processes started once, whose scratch buffers stay allocated between the requests, and the files are given by the client as file descriptors so that their data never goes through the socket. Only available on Linux
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+#if __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
+
+
+#if __linux__
+static volatile sig_atomic_t daemonStopped = 0; // 1 once the daemon received SIGINT or SIGTERM
+
+
+/**
+ * \fn static void stopDaemon(int signalNumber)
+ * \brief Signal handler of the daemon : its workers are stopped and its socket is removed by runDaemon
+ * \param signalNumber Signal received
+ */
+
+static void stopDaemon(int signalNumber)
+{
+    (void) signalNumber;
+    daemonStopped = 1;
+}
+
+/**
+ * \fn static int openDaemonSocket(const char* socketName, struct sockaddr_un* address)
+ * \brief Creates a Unix domain socket and fills the address of the daemon. The program is stopped if the name is too long or if the socket can't be created
+ * \param socketName Name of the socket file of the daemon
+ * \param address Address filled
+ * \return File descriptor of the socket
+ */
+
+static int openDaemonSocket(const char* socketName, struct sockaddr_un* address)
+{
+    if(strlen(socketName)>=sizeof(address->sun_path)){
+        fprintf(stderr, "\nERROR : The name of the socket %s is too long (at most %d characters)\n", socketName, (int) sizeof(address->sun_path)-1);
+        exit(EXIT_FAILURE);
+    }
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, socketName);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd<0){
+        fprintf(stderr, "\nERROR : Cannot create a socket : %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+/**
+ * \fn static int receiveRequest(int connection, DaemonOperation* operation, int fds[3])
+ * \brief Reads a request of a client : DAEMON_MAGIC, the operation, and the input file, the output file and the error output of the client given with SCM_RIGHTS
+ * \param connection Socket connected to the client
+ * \param operation Operation asked, filled here
+ * \param fds File descriptors received (input, output, error output), filled here
+ * \return 1 if the request is correct, 0 otherwise (the file descriptors received are then closed)
+ */
+
+static int receiveRequest(int connection, DaemonOperation* operation, int fds[3])
+{
+    unsigned char request[DAEMON_REQUEST_SIZE];
+    union{ // Aligned buffer of the control message
+        struct cmsghdr header;
+        char data[CMSG_SPACE(3*sizeof(int))];
+    }control;
+    struct iovec data = {request, DAEMON_REQUEST_SIZE};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data;
+    message.msg_controllen = sizeof(control.data);
+
+    fds[0] = fds[1] = fds[2] = -1;
+    ssize_t sizeRead = recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if(header!=NULL && header->cmsg_level==SOL_SOCKET && header->cmsg_type==SCM_RIGHTS){
+        int nbFds = (header->cmsg_len-CMSG_LEN(0))/sizeof(int);
+        for(int i=0; i<nbFds && i<3; i++)
+            memcpy(&(fds[i]), CMSG_DATA(header)+i*sizeof(int), sizeof(int));
+    }
+    if(sizeRead==DAEMON_REQUEST_SIZE && !memcmp(request, DAEMON_MAGIC, 4) && request[4]<N_DAEMON_OPERATIONS && fds[0]>=0 && fds[1]>=0 && fds[2]>=0){
+        *operation = request[4];
+        return 1;
+    }
+    for(int i=0; i<3; i++){
+        if(fds[i]>=0)
+            close(fds[i]);
+    }
+    return 0;
+}
+
+/**
+ * \fn static void serveRequest(int connection, PipelineContext* context)
+ * \brief Compresses or decompresses the files of a request with the context of the worker, then sends the reply. The errors are written in the error output of the client, and they stop the worker like they stop the program (the daemon starts another one, and the client sees the connection closed without reply)
+ * \param connection Socket connected to the client
+ * \param context Context of the worker
+ */
+
+static void serveRequest(int connection, PipelineContext* context)
+{
+    DaemonOperation operation;
+    int fds[3];
+    unsigned char reply[DAEMON_REPLY_SIZE];
+    struct stat status;
+    long long sizeIn;
+    long long sizeOut;
+
+    if(!receiveRequest(connection, &operation, fds))
+        return;
+
+    fflush(stderr);
+    int savedError = dup(STDERR_FILENO);
+    dup2(fds[2], STDERR_FILENO); // The messages of the errors are written for the client
+    close(fds[2]);
+    FILE* fileIn = fdopen(fds[0], "rb");
+    TESTFOPEN(fileIn);
+    FILE* fileOut = fdopen(fds[1], "wb");
+    TESTFOPEN(fileOut);
+    sizeIn = (fstat(fds[0], &status)==0 && S_ISREG(status.st_mode)) ? status.st_size : -1;
+
+    context->scratch.peak = context->scratch.used;
+    if(operation==DAEMON_COMPRESS){
+        compressStream(fileIn, sizeIn, fileOut, context);
+        fflush(fileOut);
+        sizeOut = fileTell(fileOut);
+    }
+    else{
+        if(!isCompressedStream(fileIn)){ // The previous format needs table.txt, in the folder of the client
+            fprintf(stderr, "\nERROR : The daemon only decompresses the files compressed block by block\n");
+            exit(EXIT_FAILURE);
+        }
+        sizeOut = decompressStream(fileIn, sizeIn, fileOut, context);
+    }
+    FCLOSE(fileIn);
+    FCLOSE(fileOut);
+    fflush(stderr);
+    dup2(savedError, STDERR_FILENO);
+    close(savedError);
+
+    reply[0] = 0;
+    writeNumber(reply+1, (sizeIn>0) ? sizeIn : 0, 8);
+    writeNumber(reply+9, sizeOut, 8);
+    send(connection, reply, DAEMON_REPLY_SIZE, MSG_NOSIGNAL); // The client may be gone, the worker keeps waiting for the next one
+}
+
+/**
+ * \fn static pid_t startWorker(int listener, PipelineContext* context)
+ * \brief Starts a worker process of the daemon. It gets a copy of the context (with the dictionary already loaded), allocates the buffers of the largest blocks once, then serves the requests one by one until it's stopped
+ * \param listener Socket of the daemon, the workers accept its connections
+ * \param context Context of the daemon, the one of the worker has its settings and a memory limit already divided between the workers
+ * \return Process ID of the worker
+ */
+
+static pid_t startWorker(int listener, PipelineContext* context)
+{
+    fflush(stdout); // Otherwise the messages not written yet would be written again by the worker
+    pid_t pid = fork();
+    if(pid<0){
+        fprintf(stderr, "\nERROR : Cannot start a worker of the daemon : %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if(pid>0)
+        return pid;
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGPIPE, SIG_IGN);
+    setVerbose(0);
+    scratchGet(&(context->scratch), SCRATCH_INPUT, BLOCK_SIZE);
+    if(context->lz.window==0)
+        reserveTransforms(&(context->transforms), context->chunking.maxSize, &(context->scratch));
+    while(1){
+        int connection = accept(listener, NULL, NULL);
+        if(connection<0){
+            if(errno==EINTR || errno==ECONNABORTED)
+                continue;
+            fprintf(stderr, "\nERROR : A worker of the daemon cannot accept a connection : %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        serveRequest(connection, context);
+        close(connection);
+    }
+}
+#endif
+
+
+/**
+ * \fn void runDaemon(const char* socketName, PipelineContext* context, int nbWorkers)
+ * \brief Runs the daemon until it receives SIGINT or SIGTERM : it listens on the Unix domain socket socketName and starts nbWorkers processes that compress or decompress the files of its clients with the settings of context (each one with a part of its memory limit). A worker stopped by an error is replaced
+ * \param socketName Name of the socket file, replaced if no daemon is listening on it
+ * \param context Context whose settings (and dictionary) are used by the workers
+ * \param nbWorkers Number of workers, so of requests served at the same time
+ */
+
+void runDaemon(const char* socketName, PipelineContext* context, int nbWorkers)
+{
+    #if __linux__
+    struct sockaddr_un address;
+    struct sigaction action;
+    pid_t* workers;
+    int listener = openDaemonSocket(socketName, &address);
+
+    if(connect(listener, (struct sockaddr*) &address, sizeof(address))==0){
+        fprintf(stderr, "\nERROR : A daemon is already listening on %s\n", socketName);
+        exit(EXIT_FAILURE);
+    }
+    close(listener);
+    struct stat status;
+    if(lstat(socketName, &status)==0 && S_ISSOCK(status.st_mode)) // Socket left by a daemon that didn't stop correctly
+        unlink(socketName);
+    listener = openDaemonSocket(socketName, &address);
+    if(bind(listener, (struct sockaddr*) &address, sizeof(address))<0 || listen(listener, DAEMON_BACKLOG)<0){
+        fprintf(stderr, "\nERROR : Cannot listen on %s : %s\n", socketName, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopDaemon;
+    sigemptyset(&(action.sa_mask));
+    action.sa_flags = 0; // waitpid is interrupted by the signal
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    PipelineContext workerContext = *context;
+    workerContext.stats = NULL;
+    workerContext.dedup = NULL;
+    workerContext.nbThreads = 1;
+    setScratchLimit(&(workerContext.scratch), context->scratch.limit/nbWorkers);
+    workers = (pid_t*) malloc(nbWorkers*sizeof(pid_t));
+    TESTALLOC(workers);
+    for(int i=0; i<nbWorkers; i++)
+        workers[i] = startWorker(listener, &workerContext);
+    printStatus("Daemon listening on %s with %d workers\n", socketName, nbWorkers);
+    fflush(stdout);
+
+    while(!daemonStopped){
+        int exitStatus;
+        pid_t pid = waitpid(-1, &exitStatus, 0);
+        if(pid<0){
+            if(errno==EINTR)
+                continue;
+            break;
+        }
+        for(int i=0; i<nbWorkers; i++){
+            if(workers[i]==pid && !daemonStopped){
+                printStatus("Worker %d stopped, it's replaced\n", (int) pid);
+                workers[i] = startWorker(listener, &workerContext);
+            }
+        }
+    }
+
+    for(int i=0; i<nbWorkers; i++)
+        kill(workers[i], SIGTERM);
+    while(waitpid(-1, NULL, 0)>0 || errno==EINTR){
+    }
+    close(listener);
+    unlink(socketName);
+    free(workers);
+    printStatus("Daemon stopped\n");
+    #else
+    (void) socketName;
+    (void) context;
+    (void) nbWorkers;
+    fprintf(stderr, "\nERROR : The daemon is only available on Linux\n");
+    exit(EXIT_FAILURE);
+    #endif
+}
+
+/**
+ * \fn void requestDaemon(const char* socketName, DaemonOperation operation, const char* fileName)
+ * \brief Asks the daemon listening on socketName to compress a file in fileName.bin, or to decompress it in the file without .bin, like compressMain and decompressMain. The files are opened here and given to the daemon as file descriptors. The program is stopped if the daemon can't be reached or if the request failed (its error is written by the daemon)
+ * \param socketName Name of the socket file of the daemon
+ * \param operation Operation asked
+ * \param fileName Name of the input file
+ */
+
+void requestDaemon(const char* socketName, DaemonOperation operation, const char* fileName)
+{
+    #if __linux__
+    struct sockaddr_un address;
+    unsigned char request[DAEMON_REQUEST_SIZE];
+    unsigned char reply[DAEMON_REPLY_SIZE];
+    char fileNameOut[FILENAME_MAX+4];
+    int fds[3];
+    union{ // Aligned buffer of the control message
+        struct cmsghdr header;
+        char data[CMSG_SPACE(3*sizeof(int))];
+    }control;
+
+    sprintf(fileNameOut, "%s", fileName);
+    int sizeName = strlen(fileNameOut);
+    if(operation==DAEMON_COMPRESS)
+        strcat(fileNameOut, ".bin");
+    else if(sizeName>4 && !strcmp(fileNameOut+sizeName-4, ".bin"))
+        fileNameOut[sizeName-4] = '\0';
+    if(operation==DAEMON_DECOMPRESS && access(fileNameOut, F_OK)==0){
+        printf("The file \"%s\" already exists\n", fileNameOut);
+        printf("Enter a name for the decompressed file : \n");
+        getFileName(fileNameOut);
+    }
+
+    int connection = openDaemonSocket(socketName, &address);
+    if(connect(connection, (struct sockaddr*) &address, sizeof(address))<0){
+        fprintf(stderr, "\nERROR : No daemon is listening on %s : %s\n", socketName, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    FILE* fileIn = fopen(fileName, "rb");
+    TESTFOPEN(fileIn);
+    FILE* fileOut = fopen(fileNameOut, "wb+");
+    TESTFOPEN(fileOut);
+    fds[0] = fileno(fileIn);
+    fds[1] = fileno(fileOut);
+    fds[2] = STDERR_FILENO;
+
+    memcpy(request, DAEMON_MAGIC, 4);
+    request[4] = operation;
+    struct iovec data = {request, DAEMON_REQUEST_SIZE};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    memset(&control, 0, sizeof(control));
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data;
+    message.msg_controllen = sizeof(control.data);
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(3*sizeof(int));
+    memcpy(CMSG_DATA(header), fds, 3*sizeof(int));
+
+    printStatus("\n%s of %s by the daemon...\n", (operation==DAEMON_COMPRESS) ? "Compression" : "Decompression", fileName);
+    int sizeRead = 0;
+    if(sendmsg(connection, &message, MSG_NOSIGNAL)==DAEMON_REQUEST_SIZE){
+        ssize_t size;
+        while(sizeRead<DAEMON_REPLY_SIZE && ((size=recv(connection, reply+sizeRead, DAEMON_REPLY_SIZE-sizeRead, 0))>0 || (size<0 && errno==EINTR)))
+            sizeRead += (size>0) ? size : 0;
+    }
+    close(connection);
+    FCLOSE(fileIn);
+    FCLOSE(fileOut);
+    if(sizeRead<DAEMON_REPLY_SIZE || reply[0]!=0){
+        remove(fileNameOut);
+        fprintf(stderr, "\nERROR : The daemon couldn't %s %s\n", (operation==DAEMON_COMPRESS) ? "compress" : "decompress", fileName);
+        exit(EXIT_FAILURE);
+    }
+
+    long long sizeIn = readNumber(reply+1, 8);
+    long long sizeOut = readNumber(reply+9, 8);
+    printStatus("\nEnd of %s : %s\n", (operation==DAEMON_COMPRESS) ? "compression" : "decompression", fileNameOut);
+    if(operation==DAEMON_COMPRESS && sizeIn>0)
+        printStatus("\nSpace saving : %.2f %%\n\n", (1-(((double)sizeOut)/sizeIn))*100);
+    #else
+    (void) socketName;
+    (void) operation;
+    (void) fileName;
+    fprintf(stderr, "\nERROR : The daemon is only available on Linux\n");
+    exit(EXIT_FAILURE);
+    #endif
+}
@@ -1,6 +1,6 @@
 /**
  * \file Decompression.c
- * \brief Decompresses the file given by the user by using the previously created coding table table.txt
+ * \brief Decompresses the file given by the user block by block, or by using the coding table table.txt if it was compressed by a previous version
  * \author Robin Meneust
  * \date 2021
 */
@@ -8,86 +8,82 @@
 #include "../include/Structures_Define.h"
 #include "../include/HuffmanFunctions.h"
 
+#include <limits.h>
+
 
 /**
- * \fn HuffmanTreePtr createTreeFromBuffers(FileBuffer bufferPos, FileBuffer bufferChar)
+ * \fn HuffmanTreePtr createTreeFromBuffers(Arena* arena, FileBuffer bufferPos, FileBuffer bufferChar)
  * \brief Rebuild a Huffman tree from 2 buffers
+ * \param arena Arena in which the nodes of the tree are allocated
  * \param bufferPos Buffer containing the instructions to navigate in the tree and create its nodes
  * \param bufferChar Buffer containing the characters that have to be written in the end of the branches of the tree
  * \return Huffman tree builded from the 2 buffers
  */
 
 
-HuffmanTreePtr createTreeFromBuffers(FileBuffer bufferPos, FileBuffer bufferChar)
+HuffmanTreePtr createTreeFromBuffers(Arena* arena, FileBuffer bufferPos, FileBuffer bufferChar)
 {
-    int posBufferPos=0;
     int posBufferChar=0;
     HuffmanTreePtr currentNode = NULL;
     HuffmanTreePtr previousNode=NULL;
     HuffmanTreePtr nextNode=NULL;
     HuffmanTreePtr head = NULL;
-    uint8_t buffer=0;
-    int sizeBuffer=0;
+    BitReader readerPos;
     int stop=0;
     uint8_t bit=0;
     uint8_t prevBit=1;
 
-    //createNodeHuff(c, left, right, parent);
-    head = createNodeHuff('\0', NULL, NULL, NULL);
+    //createNodeHuff(arena, c, left, right, parent);
+    head = createNodeHuff(arena, '\0', NULL, NULL, NULL);
     currentNode = head;
-    while(posBufferPos<bufferPos.size && !stop){
-        buffer=bufferPos.text[posBufferPos];
-        posBufferPos++;
-        //printf("\nBUFFER    %d|%c\n", buffer, buffer);
-        sizeBuffer=8;
-        while(sizeBuffer!=0 && !stop){
-            bit = buffer & (1<<(sizeBuffer-1));  // We use a mask to get the bit at the position sizebuffer-1 (between 2^0 and 2^7)
-            if(sizeBuffer>1){
-                bit >>= sizeBuffer-1;  // We shift to the right to get the value wanted completely to the right (and so we get a value equals to 0 or 1)
-            }
-            if(bit==0 && currentNode==head){ // We are at the end of the buffer
-                stop=1;
-            }
-            switch (bit)
-            {
-                case 0 : // We go back to the parent
-                    //We go back
-                    if(prevBit==1){
-                        currentNode->parent=previousNode;
-                        currentNode->left=NULL;
-                        currentNode->right=NULL;
-                        currentNode->c=bufferChar.text[posBufferChar];
-                        posBufferChar++;
-                    }
-                    previousNode=currentNode;
-                    currentNode=currentNode->parent;
-                    break;
-
-                case 1 : // We continue to the left (or right if we got back to the parent)
-                    if(prevBit==0){ // = We got back to the parent
-                        //We go to the right
-                        nextNode = createNodeHuff('\0', NULL, NULL, currentNode);
-                        currentNode->right = nextNode;
-                        previousNode = currentNode;
-                        currentNode = currentNode->right;
-                    }
-                    else{
-                        //We go to the left
-                        nextNode = createNodeHuff('\0', NULL, NULL, currentNode);
-                        currentNode->left = nextNode;
-                        previousNode = currentNode;
-                        currentNode = currentNode->left;
-                    }
-                    break;
-
-                default :
-                    fprintf(stderr, "\nERROR : Huffman tree creation issue\n");
-                    exit(EXIT_FAILURE);
-                    break;
-            }
-            prevBit=bit;
-            sizeBuffer--;
+    initBitReader(&readerPos, bufferPos.text, bufferPos.size);
+    while(bitsRead(&readerPos)<(long long) bufferPos.size*8 && !stop){
+        bit = readBits(&readerPos, 1);
+        if(bit==0 && currentNode==head){ // We are at the end of the buffer
+            stop=1;
         }
+        if(bit==0 && posBufferChar>=bufferChar.size && prevBit==1){
+            fprintf(stderr, "\nERROR : Huffman tree creation issue\n");
+            exit(EXIT_FAILURE);
+        }
+        switch (bit)
+        {
+            case 0 : // We go back to the parent
+                //We go back
+                if(prevBit==1){
+                    currentNode->parent=previousNode;
+                    currentNode->left=NULL;
+                    currentNode->right=NULL;
+                    currentNode->c=bufferChar.text[posBufferChar];
+                    posBufferChar++;
+                }
+                previousNode=currentNode;
+                currentNode=currentNode->parent;
+                break;
+
+            case 1 : // We continue to the left (or right if we got back to the parent)
+                if(prevBit==0){ // = We got back to the parent
+                    //We go to the right
+                    nextNode = createNodeHuff(arena, '\0', NULL, NULL, currentNode);
+                    currentNode->right = nextNode;
+                    previousNode = currentNode;
+                    currentNode = currentNode->right;
+                }
+                else{
+                    //We go to the left
+                    nextNode = createNodeHuff(arena, '\0', NULL, NULL, currentNode);
+                    currentNode->left = nextNode;
+                    previousNode = currentNode;
+                    currentNode = currentNode->left;
+                }
+                break;
+
+            default :
+                fprintf(stderr, "\nERROR : Huffman tree creation issue\n");
+                exit(EXIT_FAILURE);
+                break;
+        }
+        prevBit=bit;
     }
     return head;
 }
@@ -95,170 +91,540 @@ HuffmanTreePtr createTreeFromBuffers(FileBuffer bufferPos, FileBuffer bufferChar
 
 
 /**
- * \fn int readTreeFromPos(HuffmanTreePtr* huffmanTreePos, uint8_t bit)
- * \brief Navigates in the tree by following the instructions of the bit
- * \param huffmanTreePos Pointer to the current position in the tree
- * \param bit Binary value used to navigate in the tree. If bit = 0 then we go to the left node, else if bit = 1, we go to the right node
- * \return Character read from the tree if the current node is the end of a branch, or else we return -1
+ * \fn void decompress(FileBuffer bufferIn, FileBuffer* bufferOut, HuffmanTreePtr huffmanTreeHead, int sizeOut)
+ * \brief Decompresses bufferIn in bufferOut by using huffmanTreeHead and sizeOut
+ * \param bufferIn Coded data that is being decompressed
+ * \param bufferOut Decompressed buffer filled in this function, its field text must be allocated by the caller
+ * \param huffmanTreeHead Huffman tree used to unzip bufferIn
+ * \param sizeOut Number of characters that has to be put in bufferOut
  */
 
 
-int readTreeFromPos(HuffmanTreePtr* huffmanTreePos, uint8_t bit)
+void decompress(FileBuffer bufferIn, FileBuffer* bufferOut, HuffmanTreePtr huffmanTreeHead, int sizeOut)
 {
-    switch (bit)
-    {
-        case 0 : // Go left
-            if((*huffmanTreePos)->left != NULL){
-                (*huffmanTreePos) = (*huffmanTreePos)->left;
-                if(((*huffmanTreePos)->left == NULL) && ((*huffmanTreePos)->right == NULL)) // We are at the end of a branch
-                    return (*huffmanTreePos)->c;
-                else
-                    return -1;
+    DecodeEntry decodeTable[1 << DECODE_TABLE_BITS];
+    createDecodeTable(huffmanTreeHead, decodeTable);
+    decodeSymbols(bufferIn, bufferOut, decodeTable, sizeOut);
+}
+
+
+/**
+ * \fn HuffmanTreePtr loadTree(Arena* arena, FileBuffer bufferIn, int* sizeTree)
+ * \brief Rebuilds the Huffman tree saved by saveTree at the beginning of bufferIn
+ * \param arena Arena in which the tree is allocated
+ * \param bufferIn Data of the block, beginning with the tree
+ * \param sizeTree Number of bytes used by the tree in bufferIn
+ * \return Huffman tree
+ */
+
+
+HuffmanTreePtr loadTree(Arena* arena, FileBuffer bufferIn, int* sizeTree)
+{
+    FileBuffer bufferChar;
+    FileBuffer bufferPos;
+    if(bufferIn.size<4){
+        fprintf(stderr, "\nERROR : Incorrect Huffman tree\n");
+        exit(EXIT_FAILURE);
+    }
+    bufferChar.size = readNumber(bufferIn.text, 2);
+    bufferPos.size = readNumber(bufferIn.text+2, 2);
+    *sizeTree = 4+bufferChar.size+bufferPos.size;
+    if(bufferChar.size<2 || bufferChar.size>N_ASCII || *sizeTree>bufferIn.size){
+        fprintf(stderr, "\nERROR : Incorrect Huffman tree\n");
+        exit(EXIT_FAILURE);
+    }
+    bufferChar.text = bufferIn.text+4;
+    bufferPos.text = bufferIn.text+4+bufferChar.size;
+    return createTreeFromBuffers(arena, bufferPos, bufferChar);
+}
+
+
+/**
+ * \fn HuffmanTreePtr loadTreeFromTable(Arena* arena, FILE* fileTable, int* indexBW, int* sizeFileIn)
+ * \brief Reads the table file written by saveTree and rebuilds the Huffman tree and the parameters saved with it
+ * \param arena Arena in which the tree is allocated
+ * \param fileTable Table file (table.txt) opened in read mode
+ * \param indexBW Index used to decode Burrows Wheeler, or -1 if the extensions weren't applied
+ * \param sizeFileIn Number of characters that has to be decompressed
+ * \return Huffman tree rebuilt from the table
+ */
+
+
+HuffmanTreePtr loadTreeFromTable(Arena* arena, FILE* fileTable, int* indexBW, int* sizeFileIn)
+{
+    FileBuffer bufferChar;
+    FileBuffer bufferPos;
+    long long sizeChar = readNumberLine(fileTable, 2);
+    long long sizePos = readNumberLine(fileTable, 3);
+    if(sizeChar<0 || sizeChar>N_ASCII || sizePos<0 || sizePos>TREE_MAX_SIZE){
+        fprintf(stderr, "\nERROR : The table is corrupted\n");
+        exit(EXIT_FAILURE);
+    }
+    bufferChar.size = sizeChar;
+    bufferPos.size = sizePos;
+    rewind(fileTable);
+    wordWrapFile(fileTable); wordWrapFile(fileTable); wordWrapFile(fileTable); wordWrapFile(fileTable);
+    printStatus("\nFilling buffers from the table...\n");
+    bufferChar = getPortionOfFileToBuffer(fileTable, bufferChar.size);
+    bufferPos = getPortionOfFileToBuffer(fileTable, bufferPos.size);
+
+    printStatus("\nGenerating the huffman tree from the table...\n");
+    HuffmanTreePtr huffmanTree = createTreeFromBuffers(arena, bufferPos, bufferChar);
+
+    printStatus("\nGetting parameters from the table...\n");
+    long long index = readNumberLine(fileTable, 0);
+    long long size = readNumberLine(fileTable, 1);
+    if(index>INT_MAX || size<0 || size>INT_MAX){ // The previous format kept the whole file in one buffer, so it can't be larger than 2 GB
+        fprintf(stderr, "\nERROR : The table is corrupted\n");
+        exit(EXIT_FAILURE);
+    }
+    *indexBW=index;
+    *sizeFileIn=size;
+
+    free(bufferPos.text);
+    free(bufferChar.text);
+    return huffmanTree;
+}
+
+
+/**
+ * \fn void writeOutput(FileBuffer buffer, AsyncFile* fileOut)
+ * \brief Writes a decompressed buffer at the current position of fileOut
+ * \param buffer Buffer written
+ * \param fileOut File in which it's written
+ */
+
+
+void writeOutput(FileBuffer buffer, AsyncFile* fileOut)
+{
+    if(asyncWrite(fileOut, buffer.text, buffer.size)!=(size_t) buffer.size){
+        fprintf(stderr, "\nERROR : Cannot write the decompressed file\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+/**
+ * \fn void decompressBlock(BlockMode mode, FileBuffer bufferIn, int sizeOut, AsyncFile* fileOut, PipelineContext* context)
+ * \brief Decompresses the data of a block and writes it in fileOut
+ * \param mode Mode of the block, read in its header (with BLOCK_MAP_FLAG if the data begins with the map of the characters)
+ * \param bufferIn Data of the block (after its header)
+ * \param sizeOut Size of the block once decompressed
+ * \param fileOut File in which the block is written
+ * \param context Memory and measures of the decompression
+ */
+
+
+void decompressBlock(BlockMode mode, FileBuffer bufferIn, int sizeOut, AsyncFile* fileOut, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    FileBuffer bufferOut;
+    TransformChain chain; // Transforms applied to the block
+    int sizeTree=0;
+    int sizeCoded=sizeOut; // Size of the block before the inverses of its transforms
+
+    if(mode & BLOCK_MAP_FLAG){ // The map of the characters is only read by the search
+        if(bufferIn.size<BLOCK_MAP_SIZE){
+            fprintf(stderr, "\nERROR : Incorrect block\n");
+            exit(EXIT_FAILURE);
+        }
+        mode &= ~BLOCK_MAP_FLAG;
+        bufferIn.text += BLOCK_MAP_SIZE;
+        bufferIn.size -= BLOCK_MAP_SIZE;
+    }
+
+    switch(mode){
+        case BLOCK_STORED :
+            if(bufferIn.size!=sizeOut){
+                fprintf(stderr, "\nERROR : Incorrect size of a stored block\n");
+                exit(EXIT_FAILURE);
             }
-            else{
-                // It's an error because we aren't at the end of a branch and the instruction is impossible (going left without having a branch at the left)
-                fprintf(stderr, "\nERROR : Incorrect bit value\n");
+            stageStart(stats, STAGE_WRITE);
+            writeOutput(bufferIn, fileOut);
+            stageStop(stats, STAGE_WRITE, sizeOut, sizeOut);
+            break;
+
+        case BLOCK_FILL :
+            if(bufferIn.size!=1){
+                fprintf(stderr, "\nERROR : Incorrect size of a filled block\n");
                 exit(EXIT_FAILURE);
             }
+            stageStart(stats, STAGE_WRITE);
+            bufferOut.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_OUTPUT, sizeOut);
+            bufferOut.size = sizeOut;
+            memset(bufferOut.text, bufferIn.text[0], sizeOut);
+            writeOutput(bufferOut, fileOut);
+            stageStop(stats, STAGE_WRITE, 1, sizeOut);
             break;
-        case 1 : // Go right
-            if((*huffmanTreePos)->right != NULL){
-                (*huffmanTreePos) = (*huffmanTreePos)->right;
-                if(((*huffmanTreePos)->left == NULL) && ((*huffmanTreePos)->right == NULL)) // We are at the end of a branch
-                    return (*huffmanTreePos)->c;
-                else
-                    return -1;
+
+        case BLOCK_HUFFMAN :
+        case BLOCK_BWT_HUFFMAN :
+        case BLOCK_TANS :
+        case BLOCK_BWT_TANS :
+        case BLOCK_CHAIN_HUFFMAN :
+        case BLOCK_CHAIN_TANS :
+            chain.nbTransforms = 0;
+            if(mode==BLOCK_BWT_HUFFMAN || mode==BLOCK_BWT_TANS){ // Chain of the files compressed before the transforms were chosen : Burrows Wheeler (its index) then Move To Front
+                if(bufferIn.size<4){
+                    fprintf(stderr, "\nERROR : Incorrect block\n");
+                    exit(EXIT_FAILURE);
+                }
+                chain.nbTransforms = 2;
+                chain.ids[0] = TRANSFORM_BWT;
+                chain.ids[1] = TRANSFORM_MTF;
+                memcpy(chain.params[0], bufferIn.text, 4);
+                chain.sizeParams[0] = 4;
+                chain.sizeParams[1] = 0;
+                chain.sizes[0] = chain.sizes[1] = sizeOut;
+                bufferIn.text += 4;
+                bufferIn.size -= 4;
+            }
+            else if(mode==BLOCK_CHAIN_HUFFMAN || mode==BLOCK_CHAIN_TANS){
+                int sizeChain = loadTransforms(bufferIn, &chain);
+                bufferIn.text += sizeChain;
+                bufferIn.size -= sizeChain;
+            }
+            if(chain.nbTransforms>0)
+                sizeCoded = chain.sizes[chain.nbTransforms-1];
+
+            bufferOut.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_OUTPUT, sizeCoded);
+            if(mode==BLOCK_HUFFMAN || mode==BLOCK_BWT_HUFFMAN || mode==BLOCK_CHAIN_HUFFMAN){
+                stageStart(stats, STAGE_TABLE_READ);
+                HuffmanTreePtr huffmanTree = loadTree(&(context->arena), bufferIn, &sizeTree);
+                bufferIn.text += sizeTree;
+                bufferIn.size -= sizeTree;
+                stageStop(stats, STAGE_TABLE_READ, sizeTree, 0);
+
+                stageStart(stats, STAGE_HUFFMAN_DECODE);
+                decompress(bufferIn, &bufferOut, huffmanTree, sizeCoded);
+                stageStop(stats, STAGE_HUFFMAN_DECODE, bufferIn.size, bufferOut.size);
             }
             else{
-                // It's an error because we aren't at the end of a branch and the instruction is impossible (going right without having a branch at the right)
-                fprintf(stderr, "\nERROR : Incorrect bit value\n");
+                uint16_t normalized[N_ASCII];
+                stageStart(stats, STAGE_TABLE_READ);
+                sizeTree = loadTansCounts(bufferIn, normalized);
+                TansTable* tansTable = (TansTable*) arenaAlloc(&(context->arena), sizeof(TansTable));
+                createTansTable(normalized, tansTable);
+                bufferIn.text += sizeTree;
+                bufferIn.size -= sizeTree;
+                stageStop(stats, STAGE_TABLE_READ, sizeTree, 0);
+
+                stageStart(stats, STAGE_TANS_DECODE);
+                tansDecodeSymbols(bufferIn, &bufferOut, tansTable, sizeCoded);
+                stageStop(stats, STAGE_TANS_DECODE, bufferIn.size, bufferOut.size);
+            }
+            if(stats!=NULL)
+                stats->tableSize += sizeTree;
+            resetArena(&(context->arena)); // The tree or the tables are freed
+
+            decodeTransforms(&chain, bufferOut, sizeOut, fileOut, context);
+            break;
+
+        case BLOCK_LZ77 :
+            bufferOut.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_OUTPUT, sizeOut);
+            lz77Decode(bufferIn, &bufferOut, sizeOut, context);
+            stageStart(stats, STAGE_WRITE);
+            writeOutput(bufferOut, fileOut);
+            stageStop(stats, STAGE_WRITE, bufferOut.size, bufferOut.size);
+            break;
+
+        case BLOCK_BIGRAM_HUFFMAN :
+            bufferOut.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_OUTPUT, sizeOut);
+            bigramDecode(bufferIn, &bufferOut, sizeOut, context);
+            stageStart(stats, STAGE_WRITE);
+            writeOutput(bufferOut, fileOut);
+            stageStop(stats, STAGE_WRITE, bufferOut.size, bufferOut.size);
+            break;
+
+        case BLOCK_DICTIONARY :
+            if(bufferIn.size<4){
+                fprintf(stderr, "\nERROR : Incorrect block\n");
+                exit(EXIT_FAILURE);
+            }
+            if(context->dictionary==NULL || context->dictionary->id!=readNumber(bufferIn.text, 4)){
+                fprintf(stderr, "\nERROR : The file was compressed with the dictionary %08X, it has to be given with --dict\n", (unsigned int) readNumber(bufferIn.text, 4));
                 exit(EXIT_FAILURE);
             }
+            bufferIn.text += 4;
+            bufferIn.size -= 4;
+            stageStart(stats, STAGE_HUFFMAN_DECODE);
+            bufferOut.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_OUTPUT, sizeOut);
+            decompress(bufferIn, &bufferOut, context->dictionary->huffmanTree, sizeOut);
+            stageStop(stats, STAGE_HUFFMAN_DECODE, bufferIn.size, bufferOut.size);
+
+            stageStart(stats, STAGE_WRITE);
+            writeOutput(bufferOut, fileOut);
+            stageStop(stats, STAGE_WRITE, bufferOut.size, bufferOut.size);
             break;
-        default:
-            fprintf(stderr, "\nERROR : Incorrect bit value\n");
+
+        case BLOCK_ADAPTIVE :
+            if(context->adaptive==NULL){
+                fprintf(stderr, "\nERROR : Incorrect block\n");
+                exit(EXIT_FAILURE);
+            }
+            stageStart(stats, STAGE_HUFFMAN_DECODE);
+            bufferOut.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_OUTPUT, sizeOut);
+            adaptiveDecode(context->adaptive, bufferIn, &bufferOut, sizeOut);
+            stageStop(stats, STAGE_HUFFMAN_DECODE, bufferIn.size, bufferOut.size);
+
+            stageStart(stats, STAGE_WRITE);
+            writeOutput(bufferOut, fileOut);
+            stageStop(stats, STAGE_WRITE, bufferOut.size, bufferOut.size);
+            break;
+
+        case BLOCK_REFERENCE : // The block it refers to is read in the archive and decoded instead
+            if(context->archive==NULL || bufferIn.size!=8){
+                fprintf(stderr, "\nERROR : Incorrect reference to a block of an archive\n");
+                exit(EXIT_FAILURE);
+            }
+            stageStart(stats, STAGE_READ);
+            unsigned char header[BLOCK_HEADER_SIZE];
+            FileBuffer referenced;
+            fileSeek(context->archive, readNumber(bufferIn.text, 8), SEEK_SET);
+            BlockMode referencedMode = (fread(header, sizeof(unsigned char), BLOCK_HEADER_SIZE, context->archive)==BLOCK_HEADER_SIZE) ? (header[0] & ~BLOCK_MAP_FLAG) : BLOCK_END;
+            if(referencedMode==BLOCK_END || referencedMode==BLOCK_ADAPTIVE || referencedMode==BLOCK_REFERENCE
+                || referencedMode>=N_BLOCK_MODES || (int) readNumber(header+1, 4)!=sizeOut || readNumber(header+5, 4)>4+N_ASCII*BLOCK_SIZE/8){
+                fprintf(stderr, "\nERROR : Incorrect reference to a block of an archive\n");
+                exit(EXIT_FAILURE);
+            }
+            referenced.size = readNumber(header+5, 4);
+            referenced.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_CODED, referenced.size); // The reference was read, its buffer is reused
+            if(fread(referenced.text, sizeof(unsigned char), referenced.size, context->archive)!=(size_t) referenced.size){
+                fprintf(stderr, "\nERROR : The archive is truncated\n");
+                exit(EXIT_FAILURE);
+            }
+            stageStop(stats, STAGE_READ, BLOCK_HEADER_SIZE+referenced.size, referenced.size);
+            decompressBlock(header[0], referenced, sizeOut, fileOut, context);
+            if(stats!=NULL) // The block is counted as a reference only
+                stats->blocks[referencedMode]--;
+            break;
+
+        default :
+            fprintf(stderr, "\nERROR : Unknown mode of block %d\n", mode);
             exit(EXIT_FAILURE);
     }
+    if(stats!=NULL)
+        stats->blocks[mode]++;
 }
 
 
-
 /**
- * \fn void decompress(FILE* fileIn, FileBuffer* bufferOut, HuffmanTreePtr huffmanTreeHead, int sizeFileIn)
- * \brief Decompresses fileIn in bufferOut by using huffmanTreeHead and sizeFileIn
- * \param fileIn File that is being decompressed
- * \param bufferOut Decompressed buffer filled in this function
- * \param huffmanTreeHead Huffman tree used to unzip fileIn
- * \param sizeFileIn Size of fileIn. Number of characters that has to be put in bufferOut
+ * \fn int isCompressedStream(FILE* fileIn)
+ * \brief Checks if a file begins with CONTAINER_MAGIC, which means that it was compressed block by block (otherwise it was compressed with its table in table.txt)
+ * \param fileIn File read from its beginning, the position is put back at the beginning
+ * \return 1 if the file was compressed block by block, 0 otherwise
  */
 
 
-void decompress(FILE* fileIn, FileBuffer* bufferOut, HuffmanTreePtr huffmanTreeHead, int sizeFileIn)
+int isCompressedStream(FILE* fileIn)
 {
-    HuffmanTreePtr huffmanTreePos = huffmanTreeHead;
-    uint8_t buffer=0;
-    uint8_t bit;
-    int progress=0;
-    int c=-1;
-    int sizeBuffer;
-    int posBuffOut=0;
-    bufferOut->text = (unsigned char*) malloc(sizeof(unsigned char)*sizeFileIn);
-    bufferOut->size=sizeFileIn;
+    unsigned char header[4];
+    int isStream = fread(header, sizeof(unsigned char), 4, fileIn)==4 && !memcmp(header, CONTAINER_MAGIC, 4);
     rewind(fileIn);
-    buffer=fgetc(fileIn);
-    sizeBuffer=8;
-
-    while(posBuffOut<sizeFileIn){
-        while(sizeBuffer!=0 && posBuffOut<sizeFileIn){
-            bit = buffer & (1<<(sizeBuffer-1));  // We use a mask to get the bit at the position sizebuffer-1 (between 2^0 and 2^7)
-            if(sizeBuffer>1){
-                bit >>= sizeBuffer-1;  // We shift to the right to get the value wanted completely to the right (and so we get a value equals to 0 or 1)
-            }
-            c = readTreeFromPos(&huffmanTreePos, bit);
-            
-            if(c!=-1){ // readTreeFromPos returned a character, we put it in bufferOut
-
-                bufferOut->text[posBuffOut]=c;
-                posBuffOut++;
-                huffmanTreePos=huffmanTreeHead;
-                c=-1;
+    return isStream;
+}
+
+
+/**
+ * \fn long long decompressStream(FILE* fileIn, long long sizeFileIn, FILE* fileOut, PipelineContext* context)
+ * \brief Decompresses a file written by compressStream (or by compressLive) block by block. If the context has several threads, the files are read and written by their own threads while the blocks are decompressed, unless the data comes from a live stream
+ * \param fileIn Compressed file, read from its current position
+ * \param sizeFileIn Size of the compressed data, only used to report the progress
+ * \param fileOut File in which the decompressed data is written from its current position
+ * \param context Memory reused between the blocks and measures of each stage (if context->stats isn't NULL)
+ * \return Size of the decompressed data
+ */
+
+
+long long decompressStream(FILE* fileIn, long long sizeFileIn, FILE* fileOut, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    unsigned char header[BLOCK_HEADER_SIZE];
+    FileBuffer bufferIn;
+    long long sizeRead=5;
+    long long sizeWritten=0;
+    Progress progress;
+    AsyncFile asyncIn;
+    AsyncFile asyncOut;
+    AdaptiveModel adaptive; // Codes of the blocks of a live stream
+
+    asyncOpen(&asyncIn, fileIn, 0, context->nbThreads>1 && !context->live, &(context->scratch));
+    asyncOpen(&asyncOut, fileOut, 1, context->nbThreads>1 && !context->live, &(context->scratch));
+    initAdaptiveModel(&adaptive);
+    context->adaptive = &adaptive;
+
+    if(asyncRead(&asyncIn, header, 5)!=5 || memcmp(header, CONTAINER_MAGIC, 4)){
+        fprintf(stderr, "\nERROR : The file wasn't compressed by this program\n");
+        exit(EXIT_FAILURE);
+    }
+    int version = header[4] & ~CONTAINER_INDEX_FLAG; // The index of the chunks isn't read
+    if(version<1 || version>CONTAINER_VERSION){ // The blocks of the version 1 have no map of their characters
+        fprintf(stderr, "\nERROR : Version %d of the format isn't supported\n", version);
+        exit(EXIT_FAILURE);
+    }
+
+    progressStart(&progress, "decompression", sizeFileIn);
+    while(1){
+        stageStart(stats, STAGE_READ);
+        if(asyncRead(&asyncIn, header, 1)!=1){
+            fprintf(stderr, "\nERROR : The compressed file is truncated\n");
+            exit(EXIT_FAILURE);
+        }
+        if(header[0]==BLOCK_END){
+            if(asyncRead(&asyncIn, header, 8)!=8 || (long long) readNumber(header, 8)!=sizeWritten){
+                fprintf(stderr, "\nERROR : The compressed file is corrupted\n");
+                exit(EXIT_FAILURE);
             }
-            sizeBuffer--;
+            stageStop(stats, STAGE_READ, 9, 0);
+            break;
         }
-
-        if(progress+5 < 100*(((double)posBuffOut)/sizeFileIn))
-        {
-            progress+=5; 
-            printf("%d%%\n", progress); //Displays the progress of the current task
+        if(asyncRead(&asyncIn, header+1, BLOCK_HEADER_SIZE-1)!=BLOCK_HEADER_SIZE-1){
+            fprintf(stderr, "\nERROR : The compressed file is truncated\n");
+            exit(EXIT_FAILURE);
         }
+        int sizeOut = readNumber(header+1, 4);
+        bufferIn.size = readNumber(header+5, 4);
+        if(sizeOut>BLOCK_SIZE || bufferIn.size>4+N_ASCII*BLOCK_SIZE/8){
+            fprintf(stderr, "\nERROR : The compressed file is corrupted\n");
+            exit(EXIT_FAILURE);
+        }
+        bufferIn.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_CODED, bufferIn.size);
+        if(asyncRead(&asyncIn, bufferIn.text, bufferIn.size)!=(size_t) bufferIn.size){
+            fprintf(stderr, "\nERROR : The compressed file is truncated\n");
+            exit(EXIT_FAILURE);
+        }
+        stageStop(stats, STAGE_READ, BLOCK_HEADER_SIZE+bufferIn.size, bufferIn.size);
 
-        buffer=fgetc(fileIn);
-        sizeBuffer=8;
+        decompressBlock(header[0], bufferIn, sizeOut, &asyncOut, context);
+        if(context->live && fflush(fileOut)!=0){ // Not written by a thread, the block is sent at once
+            fprintf(stderr, "\nERROR : Cannot write the decompressed file\n");
+            exit(EXIT_FAILURE);
+        }
+        sizeWritten += sizeOut;
+        sizeRead += BLOCK_HEADER_SIZE+bufferIn.size;
+        if(sizeRead>=progress.next)
+            progressReport(&progress, sizeRead);
+    }
+    asyncClose(&asyncIn);
+    if(!asyncClose(&asyncOut)){
+        fprintf(stderr, "\nERROR : Cannot write the decompressed file\n");
+        exit(EXIT_FAILURE);
     }
+    freeAdaptiveModel(&adaptive);
+    context->adaptive = NULL;
+    return sizeWritten;
 }
 
 
 /**
- * \fn void decompressMain(char* fileNameIn)
- * \brief Main function for decompression : calls required functions to the decompression of the file whose name is given to the function
- * \param fileNameIn Name of the file that is being decompressed
+ * \fn long long decompressLegacy(FILE* fileIn, FILE* fileOut, PipelineContext* context)
+ * \brief Decompresses a file compressed by the previous versions of the program, whose tree is saved in table.txt
+ * \param fileIn Compressed file
+ * \param fileOut File in which the decompressed data is written
+ * \param context Memory and measures of the decompression
+ * \return Size of the decompressed data
  */
 
 
-void decompressMain(char* fileNameIn)
+long long decompressLegacy(FILE* fileIn, FILE* fileOut, PipelineContext* context)
 {
-    FILE* fileIn;
-    FILE* fileOut;
+    PipelineStats* stats = context->stats;
     FILE* fileTable;
+    FileBuffer bufferIn;
     FileBuffer bufferText;
-    FileBuffer bufferChar;
-    FileBuffer bufferPos;
     int indexBW=-1;
     int sizeFileIn=0;
-    fileIn = fopen(fileNameIn, "rb");
-    TESTFOPEN(fileIn);
+    AsyncFile asyncOut;
+
+    stageStart(stats, STAGE_TABLE_READ);
     fileTable = fopen("table.txt", "rb");
     TESTFOPEN(fileTable);
+    HuffmanTreePtr huffmanTree = loadTreeFromTable(&(context->arena), fileTable, &indexBW, &sizeFileIn);
+    if(stats!=NULL){
+        stats->symbols = readNumberLine(fileTable, 2);
+        stats->tableSize = seekSizeOfFile(fileTable);
+    }
+    FCLOSE(fileTable);
+    stageStop(stats, STAGE_TABLE_READ, 0, 0);
 
-    bufferChar.size = readNumberLine(fileTable, 2);
-    bufferPos.size = readNumberLine(fileTable, 3);
-    readNumberLine(fileTable, 3);
-    rewind(fileTable);
-    wordWrapFile(fileTable); wordWrapFile(fileTable); wordWrapFile(fileTable); wordWrapFile(fileTable);
-    printf("\nFilling buffers from the table...\n");
-    bufferChar = getPortionOfFileToBuffer(fileTable, bufferChar.size);
-    bufferPos = getPortionOfFileToBuffer(fileTable, bufferPos.size);
-
-    printf("\nGenerating the huffman tree from the table...\n");
-    HuffmanTreePtr huffmanTree = createTreeFromBuffers(bufferPos, bufferChar);
+    stageStart(stats, STAGE_READ);
+    long long sizeCompressed = seekSizeOfFile(fileIn);
+    if(sizeCompressed>INT_MAX){ // The previous format kept the whole file in one buffer
+        fprintf(stderr, "\nERROR : The compressed file is corrupted\n");
+        exit(EXIT_FAILURE);
+    }
+    bufferIn.size = sizeCompressed;
+    bufferIn.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_CODED, bufferIn.size);
+    if(fread(bufferIn.text, sizeof(unsigned char), bufferIn.size, fileIn)!=(size_t) bufferIn.size){
+        fprintf(stderr, "\nERROR : Cannot read the file\n");
+        exit(EXIT_FAILURE);
+    }
+    stageStop(stats, STAGE_READ, bufferIn.size, bufferIn.size);
 
-    printf("\nGetting parameters from the table...\n");
-    indexBW=readNumberLine(fileTable, 0);
-    sizeFileIn=readNumberLine(fileTable, 1);
-    FCLOSE(fileTable);
-    printf("\nDecompression...\n");
-    decompress(fileIn, &bufferText, huffmanTree, sizeFileIn);
-    FCLOSE(fileIn);
-    freeHuffmanTree(huffmanTree);
+    asyncOpen(&asyncOut, fileOut, 1, context->nbThreads>1, &(context->scratch));
+    printStatus("\nDecompression...\n");
+    stageStart(stats, STAGE_HUFFMAN_DECODE);
+    bufferText.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_OUTPUT, sizeFileIn);
+    decompress(bufferIn, &bufferText, huffmanTree, sizeFileIn);
+    stageStop(stats, STAGE_HUFFMAN_DECODE, bufferIn.size, bufferText.size);
+    resetArena(&(context->arena)); // The tree is freed
 
+    if(indexBW>=0)
+    {
+        printStatus("\nDecoding Move To Front...\n");
+        stageStart(stats, STAGE_MTF_DECODE);
+        moveToFrontDecode(&bufferText);
+        stageStop(stats, STAGE_MTF_DECODE, bufferText.size, bufferText.size);
 
-/*
-    printf("\nBUFFER_TEXT\n");
-    for(int i=0; i<bufferText.size; i++){
-        printf("%c", bufferText.text[i]);
+        printStatus("\nDecoding Burrows Wheeler...\n");
+        stageStart(stats, STAGE_BWT_DECODE);
+        burrowsWheelerDecode(indexBW, bufferText, &asyncOut, &(context->scratch));
+        stageStop(stats, STAGE_BWT_DECODE, bufferText.size, bufferText.size);
     }
-    printf("\n");
-*/
+    else
+    {
+        printStatus("\nThe output file is being filled...\n");
+        stageStart(stats, STAGE_WRITE);
+        writeOutput(bufferText, &asyncOut);
+        stageStop(stats, STAGE_WRITE, bufferText.size, bufferText.size);
+    }
+    if(!asyncClose(&asyncOut)){
+        fprintf(stderr, "\nERROR : Cannot write the decompressed file\n");
+        exit(EXIT_FAILURE);
+    }
+    if(stats!=NULL)
+        stats->indexBW = indexBW;
+    return bufferText.size;
+}
+
+
+/**
+ * \fn void decompressMain(char* fileNameIn, PipelineContext* context)
+ * \brief Main function for decompression : calls required functions to the decompression of the file whose name is given to the function
+ * \param fileNameIn Name of the file that is being decompressed
+ * \param context Memory reused between the files and measures of each stage (if context->stats isn't NULL)
+ */
+
+
+void decompressMain(char* fileNameIn, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    FILE* fileIn;
+    FILE* fileOut;
+    long long sizeCompressed=0;
+    long long sizeFileOut=0;
+    fileIn = fopen(fileNameIn, "rb");
+    TESTFOPEN(fileIn);
+    sizeCompressed = seekSizeOfFile(fileIn);
 
-    
     int sizeNameFileIn = strlen(fileNameIn);
-    if(fileNameIn[sizeNameFileIn-4]=='.' && fileNameIn[sizeNameFileIn-3]=='b' && fileNameIn[sizeNameFileIn-2]=='i' && fileNameIn[sizeNameFileIn-1]=='n'){
+    if(sizeNameFileIn>4 && fileNameIn[sizeNameFileIn-4]=='.' && fileNameIn[sizeNameFileIn-3]=='b' && fileNameIn[sizeNameFileIn-2]=='i' && fileNameIn[sizeNameFileIn-1]=='n'){
         fileNameIn[sizeNameFileIn-4]='\0';  //The .bin is removed
     }
 
     //If the file already exists
     #if __linux__
-    if(access(fileNameIn, F_OK)!=0){
+    if(access(fileNameIn, F_OK)==0){
         printf("The file \"%s\" already exists\n", fileNameIn);
         printf("Enter a name for the decompressed file : \n");
         getFileName(fileNameIn);
@@ -274,23 +640,20 @@ void decompressMain(char* fileNameIn)
 
     fileOut = fopen(fileNameIn, "wb+"); 
     TESTFOPEN(fileOut);
-    if(indexBW>=0)
-    {
-        printf("\nDecoding Move To Front...\n");
-        moveToFrontDecode(&bufferText);
-
-        printf("\nDecoding Burrows Wheeler...\n");
-        burrowsWheelerDecode(indexBW, bufferText, fileOut);
+    setPartialOutput(fileNameIn, fileOut);
+    if(isCompressedStream(fileIn)){
+        printStatus("\nDecompression...\n");
+        sizeFileOut = decompressStream(fileIn, sizeCompressed, fileOut, context);
     }
-    else
-    {
-        printf("\nThe output file is being filled...\n");
-        bufferToFile(bufferText, fileOut);
+    else{
+        sizeFileOut = decompressLegacy(fileIn, fileOut, context);
     }
 
+    FCLOSE(fileIn);
+    setPartialOutput(NULL, NULL);
     FCLOSE(fileOut);
-    free(bufferText.text);
-    free(bufferPos.text);
-    free(bufferChar.text);
-    printf("\nEnd of decompression\n");
+    printStatus("\nEnd of decompression\n");
+
+    if(stats!=NULL)
+        finishStats(stats, sizeCompressed, sizeFileOut);
 }
@@ -0,0 +1,311 @@
+/**
+ * \file Dedup.c
+ * \brief Deduplication of the blocks : hash of a block, and hash table of the blocks already compressed
+ * \details A block found again is written without being compressed, or replaced by a reference in an archive. The data of a block found is compared with the one of the block already compressed, so two blocks with the same hash are never mixed up. The chunks of a previous compressed file (--update) are found by their hash and size, then decoded and compared by the compression
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME_3 0x165667B19E3779F9ULL
+
+
+/**
+ * \fn uint64_t hashBlock(const unsigned char* data, size_t size)
+ * \brief Computes a 64-bit hash of some data (not cryptographic), 8 bytes are mixed at a time
+ * \param data Data hashed
+ * \param size Size of the data
+ * \return Hash of the data
+ */
+
+uint64_t hashBlock(const unsigned char* data, size_t size)
+{
+    uint64_t hash = HASH_PRIME_3 ^ (size*HASH_PRIME_1);
+    uint64_t word;
+    size_t i=0;
+
+    for(; i+8<=size; i+=8){
+        memcpy(&word, data+i, 8);
+        hash ^= word*HASH_PRIME_2;
+        hash = ((hash << 31) | (hash >> 33))*HASH_PRIME_1;
+    }
+    for(; i<size; i++){
+        hash ^= data[i]*HASH_PRIME_3;
+        hash = ((hash << 11) | (hash >> 53))*HASH_PRIME_1;
+    }
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * \fn void initDedupTable(DedupTable* table, size_t limit)
+ * \brief Initializes an empty table
+ * \param table Table initialized
+ * \param limit Largest size of the copies of the blocks and of their compressed data kept in the table, 0 if only the positions of the blocks in an archive are kept
+ */
+
+void initDedupTable(DedupTable* table, size_t limit)
+{
+    table->entries = NULL;
+    table->capacity = 0;
+    table->nbEntries = 0;
+    table->memory = 0;
+    table->limit = limit;
+    table->hits = 0;
+    pthread_mutex_init(&(table->mutex), NULL);
+}
+
+/**
+ * \fn void freeDedupTable(DedupTable* table)
+ * \brief Frees the entries of a table and the copies of the blocks
+ * \param table Table freed
+ */
+
+void freeDedupTable(DedupTable* table)
+{
+    for(int i=0; i<table->capacity; i++){
+        free(table->entries[i].block);
+        free(table->entries[i].coded);
+    }
+    free(table->entries);
+    table->entries = NULL;
+    table->capacity = 0;
+    table->nbEntries = 0;
+    table->memory = 0;
+    pthread_mutex_destroy(&(table->mutex));
+}
+
+/**
+ * \fn static DedupEntry* addDedupEntry(DedupTable* table, uint64_t hash, int size)
+ * \brief Adds an empty entry to the table, whose size is doubled when it's half full. The mutex of the table has to be locked
+ * \param table Table
+ * \param hash Hash of the data
+ * \param size Size of the data
+ * \return Entry added (its block and coded data are NULL and its offset is -1)
+ */
+
+static DedupEntry* addDedupEntry(DedupTable* table, uint64_t hash, int size)
+{
+    if(2*(table->nbEntries+1)>table->capacity){
+        int capacity = (table->capacity>0) ? 2*table->capacity : 1024;
+        DedupEntry* entries = (DedupEntry*) calloc(capacity, sizeof(DedupEntry));
+        TESTALLOC(entries);
+        for(int i=0; i<table->capacity; i++){
+            if(table->entries[i].size>0){
+                int j = table->entries[i].hash & (capacity-1);
+                while(entries[j].size>0)
+                    j = (j+1) & (capacity-1);
+                entries[j] = table->entries[i];
+            }
+        }
+        free(table->entries);
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+
+    int i = hash & (table->capacity-1);
+    while(table->entries[i].size>0)
+        i = (i+1) & (table->capacity-1);
+    table->entries[i].hash = hash;
+    table->entries[i].size = size;
+    table->entries[i].block = NULL;
+    table->entries[i].coded = NULL;
+    table->entries[i].sizeCoded = 0;
+    table->entries[i].offset = -1;
+    table->nbEntries++;
+    return &(table->entries[i]);
+}
+
+/**
+ * \fn static DedupEntry* nextDedupEntry(DedupTable* table, uint64_t hash, int size, int* position)
+ * \brief Gives the next entry having the same hash and size as a block, several entries can have them if different blocks have the same hash. The mutex of the table has to be locked
+ * \param table Table
+ * \param hash Hash of the block
+ * \param size Size of the block
+ * \param position Position of the search, -1 to begin it, updated
+ * \return Next entry found, NULL if there isn't any other one
+ */
+
+static DedupEntry* nextDedupEntry(DedupTable* table, uint64_t hash, int size, int* position)
+{
+    if(table->capacity==0)
+        return NULL;
+    int i = (*position<0) ? (int) (hash & (table->capacity-1)) : ((*position+1) & (table->capacity-1));
+    while(table->entries[i].size>0){
+        if(table->entries[i].hash==hash && table->entries[i].size==size){
+            *position = i;
+            return &(table->entries[i]);
+        }
+        i = (i+1) & (table->capacity-1);
+    }
+    return NULL;
+}
+
+/**
+ * \fn int findCodedBlock(DedupTable* table, FileBuffer block, uint64_t hash, ScratchPool* scratch, unsigned char** coded)
+ * \brief Looks for a block among the blocks already compressed whose copy was kept
+ * \param table Table of the blocks
+ * \param block Block looked for
+ * \param hash Hash of the block
+ * \param scratch Scratch buffers, the compressed block is copied in SCRATCH_CODED
+ * \param coded Header and data of the compressed block if it's found
+ * \return Size of the compressed block (header included), 0 if the block wasn't found
+ */
+
+int findCodedBlock(DedupTable* table, FileBuffer block, uint64_t hash, ScratchPool* scratch, unsigned char** coded)
+{
+    int sizeCoded = 0;
+    int position = -1;
+    DedupEntry* entry;
+
+    pthread_mutex_lock(&(table->mutex));
+    while(sizeCoded==0 && (entry=nextDedupEntry(table, hash, block.size, &position))!=NULL){
+        if(entry->block!=NULL && !memcmp(entry->block, block.text, block.size)){
+            *coded = (unsigned char*) scratchGet(scratch, SCRATCH_CODED, entry->sizeCoded);
+            memcpy(*coded, entry->coded, entry->sizeCoded);
+            sizeCoded = entry->sizeCoded;
+            table->hits++;
+        }
+    }
+    pthread_mutex_unlock(&(table->mutex));
+    return sizeCoded;
+}
+
+/**
+ * \fn void addCodedBlock(DedupTable* table, FileBuffer block, uint64_t hash, const unsigned char* coded, int sizeCoded)
+ * \brief Keeps a copy of a block and of its compressed data, unless the copies would go over the limit of the table or the block is already in it
+ * \param table Table of the blocks
+ * \param block Block compressed (before Burrows Wheeler)
+ * \param hash Hash of the block
+ * \param coded Header and data of the compressed block
+ * \param sizeCoded Size of coded
+ */
+
+void addCodedBlock(DedupTable* table, FileBuffer block, uint64_t hash, const unsigned char* coded, int sizeCoded)
+{
+    int position = -1;
+    DedupEntry* entry;
+
+    pthread_mutex_lock(&(table->mutex));
+    if(table->memory+block.size+sizeCoded<=table->limit){
+        while((entry=nextDedupEntry(table, hash, block.size, &position))!=NULL && memcmp(entry->block, block.text, block.size));
+        if(entry==NULL){ // Another thread may have compressed the same block at the same time
+            entry = addDedupEntry(table, hash, block.size);
+            entry->block = (unsigned char*) malloc(block.size);
+            TESTALLOC(entry->block);
+            memcpy(entry->block, block.text, block.size);
+            entry->coded = (unsigned char*) malloc(sizeCoded);
+            TESTALLOC(entry->coded);
+            memcpy(entry->coded, coded, sizeCoded);
+            entry->sizeCoded = sizeCoded;
+            table->memory += block.size+sizeCoded;
+        }
+    }
+    pthread_mutex_unlock(&(table->mutex));
+}
+
+/**
+ * \fn long long findArchiveBlock(DedupTable* table, const unsigned char* coded, int sizeCoded, uint64_t hash, FILE* fileArchive, unsigned char* buffer)
+ * \brief Looks for a compressed block among the ones already written in an archive. The blocks of the same hash are read again in the archive to be compared, then the archive is put back at its end
+ * \param table Table of the blocks of the archive
+ * \param coded Header and data of the compressed block
+ * \param sizeCoded Size of coded
+ * \param hash Hash of coded
+ * \param fileArchive Archive being written, opened for reading too
+ * \param buffer Buffer of sizeCoded bytes in which the blocks are read
+ * \return Position of the same block in the archive, -1 if it wasn't found
+ */
+
+long long findArchiveBlock(DedupTable* table, const unsigned char* coded, int sizeCoded, uint64_t hash, FILE* fileArchive, unsigned char* buffer)
+{
+    long long offset = -1;
+    int position = -1;
+    DedupEntry* entry;
+
+    pthread_mutex_lock(&(table->mutex));
+    while(offset<0 && (entry=nextDedupEntry(table, hash, sizeCoded, &position))!=NULL){
+        fileSeek(fileArchive, entry->offset, SEEK_SET);
+        if(fread(buffer, sizeof(unsigned char), sizeCoded, fileArchive)!=(size_t) sizeCoded){
+            fprintf(stderr, "\nERROR : Cannot read the archive\n");
+            exit(EXIT_FAILURE);
+        }
+        if(!memcmp(buffer, coded, sizeCoded)){
+            offset = entry->offset;
+            table->hits++;
+        }
+    }
+    pthread_mutex_unlock(&(table->mutex));
+    if(position>=0)
+        fileSeek(fileArchive, 0, SEEK_END);
+    return offset;
+}
+
+/**
+ * \fn void addArchiveBlock(DedupTable* table, uint64_t hash, int sizeCoded, long long offset)
+ * \brief Keeps the position of a compressed block written in an archive
+ * \param table Table of the blocks of the archive
+ * \param hash Hash of the header and of the data of the compressed block
+ * \param sizeCoded Size of the compressed block (header included)
+ * \param offset Position of the block in the archive
+ */
+
+void addArchiveBlock(DedupTable* table, uint64_t hash, int sizeCoded, long long offset)
+{
+    pthread_mutex_lock(&(table->mutex));
+    addDedupEntry(table, hash, sizeCoded)->offset = offset;
+    pthread_mutex_unlock(&(table->mutex));
+}
+
+/**
+ * \fn void addBlockOffset(DedupTable* table, uint64_t hash, int size, long long offset, int sizeCoded)
+ * \brief Keeps the position of a compressed block in a file, found by the hash and the size of the block before compression
+ * \param table Table of the blocks of the file
+ * \param hash Hash of the block
+ * \param size Size of the block
+ * \param offset Position of the compressed block in the file
+ * \param sizeCoded Size of the compressed block (header included)
+ */
+
+void addBlockOffset(DedupTable* table, uint64_t hash, int size, long long offset, int sizeCoded)
+{
+    pthread_mutex_lock(&(table->mutex));
+    DedupEntry* entry = addDedupEntry(table, hash, size);
+    entry->offset = offset;
+    entry->sizeCoded = sizeCoded;
+    pthread_mutex_unlock(&(table->mutex));
+}
+
+/**
+ * \fn long long findBlockOffset(DedupTable* table, uint64_t hash, int size, int* sizeCoded)
+ * \brief Looks for the position of a compressed block from the hash and the size of the block, the caller has to check that its data is the same
+ * \param table Table of the blocks of the file
+ * \param hash Hash of the block
+ * \param size Size of the block
+ * \param sizeCoded Size of the compressed block (header included) if it's found
+ * \return Position of the compressed block, -1 if it wasn't found
+ */
+
+long long findBlockOffset(DedupTable* table, uint64_t hash, int size, int* sizeCoded)
+{
+    int position = -1;
+    long long offset = -1;
+
+    pthread_mutex_lock(&(table->mutex));
+    DedupEntry* entry = nextDedupEntry(table, hash, size, &position);
+    if(entry!=NULL){
+        offset = entry->offset;
+        *sizeCoded = entry->sizeCoded;
+        table->hits++;
+    }
+    pthread_mutex_unlock(&(table->mutex));
+    return offset;
+}
@@ -0,0 +1,126 @@
+/**
+ * \file Dictionary.c
+ * \brief Dictionaries : Huffman tables trained on sample files and saved with an ID, so that the small blocks are coded without counting their characters and without saving their own tree
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+
+/**
+ * \fn static uint32_t hashBytes(const unsigned char* data, int size)
+ * \brief Computes the FNV-1a hash of some bytes, used as the ID of a dictionary so that the same training gives the same ID
+ * \param data Bytes hashed
+ * \param size Number of bytes
+ * \return Hash
+ */
+
+static uint32_t hashBytes(const unsigned char* data, int size)
+{
+    uint32_t hash = 2166136261u;
+    for(int i=0; i<size; i++){
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * \fn uint32_t trainDictionary(char** sampleNames, int nbSamples, char* dictionaryName)
+ * \brief Counts the characters of sample files and saves the Huffman tree of these occurrences as a dictionary. Every character gets at least one occurrence so that any file can be coded with the dictionary
+ * \param sampleNames Names of the sample files
+ * \param nbSamples Number of sample files
+ * \param dictionaryName Name of the dictionary file created
+ * \return ID of the dictionary
+ */
+
+uint32_t trainDictionary(char** sampleNames, int nbSamples, char* dictionaryName)
+{
+    long counts[N_ASCII];
+    long fileCounts[N_ASCII];
+    unsigned char header[9+TREE_MAX_SIZE];
+    FileBuffer buffer;
+    Arena arena;
+    int sizeOccurrencesArray=0;
+    int sizeHuffmanTable=0;
+    HuffmanTreePtr huffmanTree=NULL;
+
+    for(int c=0; c<N_ASCII; c++)
+        counts[c] = 1;
+    buffer.text = (unsigned char*) malloc(BLOCK_SIZE);
+    TESTALLOC(buffer.text);
+    for(int i=0; i<nbSamples; i++){
+        FILE* file = fopen(sampleNames[i], "rb");
+        TESTFOPEN(file);
+        while((buffer.size = fread(buffer.text, sizeof(unsigned char), BLOCK_SIZE, file))>0){
+            countOccurrences(buffer, fileCounts);
+            for(int c=0; c<N_ASCII; c++)
+                counts[c] += fileCounts[c];
+        }
+        FCLOSE(file);
+    }
+    free(buffer.text);
+
+    initArena(&arena, ARENA_CHUNK_SIZE);
+    OccurrencesArrayCell* occurrencesArray = createOccurrencesArray(&arena, counts, &sizeOccurrencesArray);
+    createHuffmanTable(&arena, occurrencesArray, sizeOccurrencesArray, &sizeHuffmanTable, &huffmanTree);
+    int sizeTree = saveTree(huffmanTree, sizeHuffmanTable, header+9);
+    uint32_t id = hashBytes(header+9, sizeTree);
+    memcpy(header, DICTIONARY_MAGIC, 4);
+    header[4] = DICTIONARY_VERSION;
+    writeNumber(header+5, id, 4);
+
+    FILE* fileDictionary = fopen(dictionaryName, "wb");
+    TESTFOPEN(fileDictionary);
+    fwrite(header, sizeof(unsigned char), 9+sizeTree, fileDictionary);
+    FCLOSE(fileDictionary);
+    freeArena(&arena);
+    return id;
+}
+
+/**
+ * \fn void loadDictionary(char* dictionaryName, Dictionary* dictionary)
+ * \brief Reads a dictionary file and rebuilds its table and its tree, once for all the files that use it
+ * \param dictionaryName Name of the dictionary file
+ * \param dictionary Dictionary filled, it has to be freed with freeDictionary
+ */
+
+void loadDictionary(char* dictionaryName, Dictionary* dictionary)
+{
+    unsigned char content[9+TREE_MAX_SIZE];
+    FileBuffer bufferTree;
+    int sizeTree=0;
+
+    FILE* fileDictionary = fopen(dictionaryName, "rb");
+    TESTFOPEN(fileDictionary);
+    int size = fread(content, sizeof(unsigned char), sizeof(content), fileDictionary);
+    FCLOSE(fileDictionary);
+    if(size<9 || memcmp(content, DICTIONARY_MAGIC, 4) || content[4]!=DICTIONARY_VERSION){
+        fprintf(stderr, "\nERROR : %s isn't a dictionary\n", dictionaryName);
+        exit(EXIT_FAILURE);
+    }
+
+    initArena(&(dictionary->arena), ARENA_CHUNK_SIZE);
+    dictionary->id = readNumber(content+5, 4);
+    bufferTree.text = content+9;
+    bufferTree.size = size-9;
+    dictionary->huffmanTree = loadTree(&(dictionary->arena), bufferTree, &sizeTree);
+    if(sizeTree!=bufferTree.size || hashBytes(bufferTree.text, sizeTree)!=dictionary->id){
+        fprintf(stderr, "\nERROR : The dictionary %s is corrupted\n", dictionaryName);
+        exit(EXIT_FAILURE);
+    }
+    dictionary->huffmanTable = createTableFromTree(&(dictionary->arena), dictionary->huffmanTree, &(dictionary->sizeHuffmanTable), &(dictionary->maxCodeLength));
+}
+
+/**
+ * \fn void freeDictionary(Dictionary* dictionary)
+ * \brief Frees the table and the tree of a dictionary
+ * \param dictionary Dictionary freed
+ */
+
+void freeDictionary(Dictionary* dictionary)
+{
+    freeArena(&(dictionary->arena));
+}
@@ -7,6 +7,12 @@
 
 #include "../include/Structures_Define.h"
 #include "../include/HuffmanFunctions.h"
+
+#include <limits.h>
+
+#if __WIN32__
+#include <windows.h>
+#endif
  
 
 
@@ -89,7 +95,12 @@ FileBuffer getPortionOfFileToBuffer(FILE* file, int sizeBuff)
 FileBuffer fileToBuffer(FILE* file)
 {
     FileBuffer buffer;
-    buffer.size=seekSizeOfFile(file);
+    long long size=seekSizeOfFile(file);
+    if(size>INT_MAX){
+        fprintf(stderr, "\nERROR : The file is too large to be loaded in memory at once\n");
+        exit(EXIT_FAILURE);
+    }
+    buffer.size=size;
     buffer.text=malloc(buffer.size*sizeof(unsigned char));
     TESTALLOC(buffer.text);
     rewind(file);
@@ -101,17 +112,17 @@ FileBuffer fileToBuffer(FILE* file)
 }
 
 /**
- * \fn long readNumberLine(FILE* file, long line)
+ * \fn long long readNumberLine(FILE* file, long line)
  * \brief Gives the number contained in the given line of the file read (integer value)
  * \param file file read
  * \param line Line of the file that is read
  * \return Value contained in the line read or -1 by default if we can't read a number
  */
 
-long readNumberLine(FILE* file, long line)
+long long readNumberLine(FILE* file, long line)
 {
     int c;
-    long valeur=0;
+    long long valeur=0;
     long nbReadLines=0;
 
     rewind(file);
@@ -122,7 +133,7 @@ long readNumberLine(FILE* file, long line)
     }
 
     while(((c=fgetc(file))!=EOF) && c!='\n'){
-        if(c<48 || c>57) // if c isn't a number
+        if(c<48 || c>57 || valeur>(LLONG_MAX-9)/10) // if c isn't a number or if the number doesn't fit in a long long
             return -1;
         else
             valeur=(valeur*10)+c-'0';
@@ -161,24 +172,131 @@ void wordWrapFile(FILE* file)
 }
 
 /**
- * \fn long seekSizeOfFile(FILE* file)
+ * \fn int fileSeek(FILE* file, long long offset, int origin)
+ * \brief Moves the position of a file like fseek, with a 64-bit offset so that files larger than 2 GB can be used
+ * \param file File
+ * \param offset Offset from origin
+ * \param origin SEEK_SET, SEEK_CUR or SEEK_END
+ * \return 0 on success, -1 otherwise
+ */
+
+int fileSeek(FILE* file, long long offset, int origin)
+{
+    #if __WIN32__
+    return _fseeki64(file, offset, origin);
+    #else
+    return fseeko(file, (off_t) offset, origin);
+    #endif
+}
+
+/**
+ * \fn long long fileTell(FILE* file)
+ * \brief Gives the position of a file like ftell, with a 64-bit result so that files larger than 2 GB can be used
+ * \param file File
+ * \return Position in the file, -1 on error
+ */
+
+long long fileTell(FILE* file)
+{
+    #if __WIN32__
+    return _ftelli64(file);
+    #else
+    return (long long) ftello(file);
+    #endif
+}
+
+/**
+ * \fn long long seekSizeOfFile(FILE* file)
  * \brief Gives the number of characters contained in the read file (its size)
  * \param file File read
  * \return Size of the file read
  */
 
-int seekSizeOfFile(FILE* file)
+long long seekSizeOfFile(FILE* file)
 {
-    long size=0;
-    fseek(file, 0L, SEEK_END);
-    size = ftell(file);
+    long long size=0;
+    fileSeek(file, 0, SEEK_END);
+    size = fileTell(file);
     rewind(file);
     return size;
 }
 
 /**
- * \fn HuffmanTreeNode* createNodeHuff(unsigned char c, HuffmanTreeNode* leftNode, HuffmanTreeNode* rightNode, HuffmanTreeNode* parentNode)
+ * \var partialOutputName Name of the output file being written, removed if the program stops before it's complete (empty if there is none)
+ */
+
+static char partialOutputName[FILENAME_MAX+8] = "";
+
+/**
+ * \var partialOutputFile Output file being written, closed before it's removed on Windows since an open file can't be removed there
+ */
+
+static FILE* partialOutputFile = NULL;
+
+/**
+ * \fn static void removePartialOutput()
+ * \brief Removes the output file being written when the program exits before its end (error, --max-memory limit...), called by exit()
+ */
+
+static void removePartialOutput()
+{
+    if(partialOutputName[0]=='\0')
+        return;
+    #if __WIN32__
+    fclose(partialOutputFile);
+    #endif
+    remove(partialOutputName);
+    partialOutputName[0] = '\0';
+}
+
+/**
+ * \fn void setPartialOutput(const char* fileName, FILE* file)
+ * \brief Registers the output file being written so that it's removed if the program exits before it's complete, NULL once it's complete
+ * \param fileName Name of the output file, NULL when it's complete and must be kept
+ * \param file Output file opened
+ */
+
+void setPartialOutput(const char* fileName, FILE* file)
+{
+    static int registered = 0;
+    if(!registered){
+        atexit(removePartialOutput);
+        registered = 1;
+    }
+    if(fileName==NULL){
+        partialOutputName[0] = '\0';
+        partialOutputFile = NULL;
+    }
+    else{
+        snprintf(partialOutputName, sizeof(partialOutputName), "%s", fileName);
+        partialOutputFile = file;
+    }
+}
+
+/**
+ * \fn int numberOfProcessors()
+ * \brief Gives the number of processors available, used when the number of threads isn't given
+ * \return Number of processors (at least 1)
+ */
+
+int numberOfProcessors()
+{
+    long nbProcessors = 1;
+    #if __linux__
+    nbProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    #endif
+    #if __WIN32__
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    nbProcessors = info.dwNumberOfProcessors;
+    #endif
+    return (nbProcessors>0) ? (int) nbProcessors : 1;
+}
+
+/**
+ * \fn HuffmanTreeNode* createNodeHuff(Arena* arena, unsigned char c, HuffmanTreeNode* leftNode, HuffmanTreeNode* rightNode, HuffmanTreeNode* parentNode)
  * \brief Create a node of type HuffmanTreeNode for a binary tree
+ * \param arena Arena in which the node is allocated, the tree is freed with it
  * \param c Character that will be contained in the created node
  * \param leftNode Left node pointed by the created node
  * \param rightNode Right node pointed by the created node
@@ -186,10 +304,9 @@ int seekSizeOfFile(FILE* file)
  * \return Newly created node of type HuffmanTreeNode
  */
 
-HuffmanTreeNode* createNodeHuff(unsigned char c, HuffmanTreeNode* leftNode, HuffmanTreeNode* rightNode, HuffmanTreeNode* parentNode)
+HuffmanTreeNode* createNodeHuff(Arena* arena, unsigned char c, HuffmanTreeNode* leftNode, HuffmanTreeNode* rightNode, HuffmanTreeNode* parentNode)
 {
-    HuffmanTreeNode* new_node = (HuffmanTreeNode*) malloc(sizeof(HuffmanTreeNode));
-    TESTALLOC(new_node);
+    HuffmanTreeNode* new_node = (HuffmanTreeNode*) arenaAlloc(arena, sizeof(HuffmanTreeNode));
     new_node->c=c;
     new_node->left=leftNode;
     new_node->right=rightNode;
@@ -198,3 +315,36 @@ HuffmanTreeNode* createNodeHuff(unsigned char c, HuffmanTreeNode* leftNode, Huff
 }
 
 
+
+
+/**
+ * \fn void writeNumber(unsigned char* out, unsigned long long value, int nbBytes)
+ * \brief Writes a number in the header of a compressed file, in little endian so that it doesn't depend on the computer
+ * \param out Memory in which the number is written
+ * \param value Number written
+ * \param nbBytes Number of bytes used (at most 8)
+ */
+
+void writeNumber(unsigned char* out, unsigned long long value, int nbBytes)
+{
+    for(int i=0; i<nbBytes; i++){
+        out[i] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+/**
+ * \fn unsigned long long readNumber(const unsigned char* in, int nbBytes)
+ * \brief Reads a number written by writeNumber
+ * \param in Memory from which the number is read
+ * \param nbBytes Number of bytes used (at most 8)
+ * \return Number read
+ */
+
+unsigned long long readNumber(const unsigned char* in, int nbBytes)
+{
+    unsigned long long value=0;
+    for(int i=nbBytes-1; i>=0; i--)
+        value = (value<<8) | in[i];
+    return value;
+}
@@ -1,6 +1,6 @@
 /**
  * \file HuffmanTableCreation.c
- * \brief Used to create the Huffman table and the Huffman tree that will be saved in a file used to compress and decompress the associated file.
+ * \brief Used to create the Huffman table and the Huffman tree that will be saved in the header of the compressed blocks.
  * \author Robin Meneust
  * \date 2021
  */
@@ -11,17 +11,17 @@
 
 
 /**
- * \fn PtrlistCode createNode(unsigned char c)
+ * \fn PtrlistCode createNode(Arena* arena, unsigned char c)
  * \brief Creates a new node for a listCode type linked list
+ * \param arena Arena in which the node is allocated
  * \param c Character contained in the newly created node
  * \return Created node
  */
 
-PtrlistCode createNode(unsigned char c)
+PtrlistCode createNode(Arena* arena, unsigned char c)
 {
     listCode *node = NULL;
-    node= (listCode*) malloc(sizeof(listCode));
-    TESTALLOC(node);
+    node= (listCode*) arenaAlloc(arena, sizeof(listCode));
     node->value = c;
     node->next = NULL;
     return node;
@@ -60,47 +60,57 @@ void initializeCode(HuffmanTableCell* huffmanTable, int sizeHuffmanTable, Occurr
 {
     for(int i=0; i<sizeHuffmanTable; i++){
         huffmanTable[i].code=NULL;
+        huffmanTable[i].bits=0;
+        huffmanTable[i].length=0;
         huffmanTable[i].c=occurrencesArray[i].c[0];
     }
 }
 
 
 /**
- * \fn OccurrencesArrayCell* fillOccurrencesArray(FILE* file, int* sizeOccurrencesArray)
+ * \fn OccurrencesArrayCell* fillOccurrencesArray(Arena* arena, FileBuffer buffer, int* sizeOccurrencesArray)
  * \brief Allocates and initializes occurrencesArray that associate each character to its number of occurrences
+ * \param arena Arena in which the array and its strings are allocated
  * \param buffer Buffer used to fill the array occurrencesArray
- * \param sizeOccurrencesArray Size of the array occurrencesArray(array_return here), it's incremented while the array is created
+ * \param sizeOccurrencesArray Size of the array occurrencesArray
  * \return Array of structures containing each character associated to its number of occurrences in the initial file
  */
 
-OccurrencesArrayCell* fillOccurrencesArray(FileBuffer buffer, int* sizeOccurrencesArray)
+OccurrencesArrayCell* fillOccurrencesArray(Arena* arena, FileBuffer buffer, int* sizeOccurrencesArray)
+{
+    long counts[N_ASCII];
+    countOccurrences(buffer, counts);
+    return createOccurrencesArray(arena, counts, sizeOccurrencesArray);
+}
+
+/**
+ * \fn OccurrencesArrayCell* createOccurrencesArray(Arena* arena, long counts[N_ASCII], int* sizeOccurrencesArray)
+ * \brief Allocates and initializes occurrencesArray from the occurrences already counted (by countOccurrences)
+ * \param arena Arena in which the array and its strings are allocated
+ * \param counts Number of occurrences of each character
+ * \param sizeOccurrencesArray Size of the array occurrencesArray(array_return here), it's incremented while the array is created
+ * \return Array of structures containing each character associated to its number of occurrences
+ */
+
+OccurrencesArrayCell* createOccurrencesArray(Arena* arena, long counts[N_ASCII], int* sizeOccurrencesArray)
 {
-    int car[N_ASCII]={0};
-    unsigned char c;
     *sizeOccurrencesArray=0;
-    int pos=0;
-    while(pos<buffer.size)
-    {
-        c=buffer.text[pos];
-        if(car[c]==0)   // Used to increment the size of the return array, since it counts the number of unique elements in the buffer
+    for(int i=0; i<N_ASCII; i++){
+        if(counts[i]!=0)   // Used to increment the size of the return array, since it counts the number of unique elements in the buffer
             (*sizeOccurrencesArray)++;
-        car[c]++;
-        pos++;
     }
 
-    OccurrencesArrayCell* array_return = (OccurrencesArrayCell*) malloc((*sizeOccurrencesArray) * sizeof(OccurrencesArrayCell));
-    TESTALLOC(array_return);
+    OccurrencesArrayCell* array_return = (OccurrencesArrayCell*) arenaAlloc(arena, (*sizeOccurrencesArray) * sizeof(OccurrencesArrayCell));
 
     int i_return=0;
     for(int i=0; i<N_ASCII; i++)
     {
-        if(car[i]!=0)
+        if(counts[i]!=0)
         {
-            array_return[i_return].c = (unsigned char*) malloc((*sizeOccurrencesArray) * sizeof(unsigned char));
-            TESTALLOC(array_return[i_return].c);
+            array_return[i_return].c = (unsigned char*) arenaAlloc(arena, (*sizeOccurrencesArray) * sizeof(unsigned char));
             array_return[i_return].size=1;
             array_return[i_return].c[0]=i;
-            array_return[i_return].occurrences=car[i];
+            array_return[i_return].occurrences=counts[i];
             array_return[i_return].mergedHead=NULL;
             i_return++;
         }
@@ -159,8 +169,30 @@ void merge(int i_min1, int i_min2, OccurrencesArrayCell* occurrencesArray, int*
 
 
 /**
- * \fn void fillHuffmanTableCode(HuffmanTableCell* huffmanTable, int sizeHuffmanTable, OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2)
+ * \fn static void addBitToCode(Arena* arena, HuffmanTableCell* cell, unsigned char bit)
+ * \brief Adds a bit at the beginning of the code of a cell, in its list and in its integer
+ * \param arena Arena in which the node of the list is allocated
+ * \param cell Cell of the table
+ * \param bit '0' or '1'
+ */
+
+static void addBitToCode(Arena* arena, HuffmanTableCell* cell, unsigned char bit)
+{
+    if(cell->length==MAX_CODE_LENGTH){
+        fprintf(stderr, "\nERROR : Huffman code longer than %d bits\n", MAX_CODE_LENGTH);
+        exit(EXIT_FAILURE);
+    }
+    addStartList(&(cell->code), createNode(arena, bit));
+    if(bit=='1')
+        cell->bits |= (uint64_t) 1 << cell->length;
+    cell->length++;
+}
+
+
+/**
+ * \fn void fillHuffmanTableCode(Arena* arena, HuffmanTableCell* huffmanTable, int sizeHuffmanTable, OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2)
  * \brief Fills the cells of huffmanTable that correpond to the characters contained in the field c of tabOcurrences for the cells i_min1 and i_min2 with 0 or 1
+ * \param arena Arena in which the nodes of the codes are allocated
  * \param huffmanTable Array of structures HuffmanTableCell containing all the characters associated to a sequence of 0 or 1 depending of their number of occurrences in the initial file
  * \param sizeHuffmanTable Size of the array huffmanTable
  * \param occurrencesArray Array of structures containing each character associated to its number of occurrences in the initial file
@@ -169,7 +201,7 @@ void merge(int i_min1, int i_min2, OccurrencesArrayCell* occurrencesArray, int*
  */
 
 
-void fillHuffmanTableCode(HuffmanTableCell* huffmanTable, int sizeHuffmanTable, OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2)
+void fillHuffmanTableCode(Arena* arena, HuffmanTableCell* huffmanTable, int sizeHuffmanTable, OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2)
 {
     int j;
     for(int i=0; i<occurrencesArray[i_min1].size; i++){
@@ -178,7 +210,7 @@ void fillHuffmanTableCode(HuffmanTableCell* huffmanTable, int sizeHuffmanTable,
             j++;
         }
         if(occurrencesArray[i_min1].c[i]==huffmanTable[j].c)
-            addStartList(&(huffmanTable[j].code), createNode('0'));
+            addBitToCode(arena, &(huffmanTable[j]), '0');
     }
 
     for(int i=0; i<occurrencesArray[i_min2].size; i++){
@@ -187,40 +219,41 @@ void fillHuffmanTableCode(HuffmanTableCell* huffmanTable, int sizeHuffmanTable,
             j++;
         }
         if(occurrencesArray[i_min2].c[i]==huffmanTable[j].c)
-            addStartList(&(huffmanTable[j].code), createNode('1'));
+            addBitToCode(arena, &(huffmanTable[j]), '1');
     }
 }
 
 
 /**
- * \fn void fillHuffmanTree(OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2)
+ * \fn void fillHuffmanTree(Arena* arena, OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2)
  * \brief Fill the Huffman tree by creating nodes that are contained in occurrencesArray in the field mergeHead
+ * \param arena Arena in which the nodes are allocated
  * \param occurrencesArray Array of structures containing each character associated to its number of occurrences in the initial file
  * \param i_min1 Pointer to the index of the first minimum of the field occurrences
  * \param i_min2 Pointer to the index of the second minimum of the field occurrences
  */
 
 
-void fillHuffmanTree(OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2)
+void fillHuffmanTree(Arena* arena, OccurrencesArrayCell* occurrencesArray, int i_min1, int i_min2)
 {
     HuffmanTreeNode * leftNode=NULL;
     HuffmanTreeNode * rightNode=NULL;
     HuffmanTreeNode * mergedNode=NULL;
 
     if(occurrencesArray[i_min1].mergedHead==NULL){  // In this case it's a node that hasn't been merged with another one yet so we have to create it
-        leftNode = createNodeHuff(occurrencesArray[i_min1].c[0], NULL, NULL, NULL);
+        leftNode = createNodeHuff(arena, occurrencesArray[i_min1].c[0], NULL, NULL, NULL);
     }
     else{
         leftNode = occurrencesArray[i_min1].mergedHead;
     }
     if(occurrencesArray[i_min2].mergedHead==NULL){
-        rightNode = createNodeHuff(occurrencesArray[i_min2].c[0], NULL, NULL, NULL);
+        rightNode = createNodeHuff(arena, occurrencesArray[i_min2].c[0], NULL, NULL, NULL);
     }
     else{
         rightNode = occurrencesArray[i_min2].mergedHead;
     }
 
-    mergedNode=createNodeHuff('\0', leftNode, rightNode, NULL);
+    mergedNode=createNodeHuff(arena, '\0', leftNode, rightNode, NULL);
     leftNode->parent= mergedNode;
     rightNode->parent= mergedNode;
     occurrencesArray[i_min1].mergedHead = mergedNode;
@@ -228,51 +261,15 @@ void fillHuffmanTree(OccurrencesArrayCell* occurrencesArray, int i_min1, int i_m
 
 
 /**
- * \fn void freeHuffmanTree(HuffmanTreeNode* huffmanNode)
- * \brief Recursive function that free the binary tree huffmanNode
- * \param huffmanNode Huffman tree that is being freed
- */
-
-
-void freeHuffmanTree(HuffmanTreeNode* huffmanNode)
-{
-    if(huffmanNode!=NULL){
-        freeHuffmanTree(huffmanNode->left);
-        freeHuffmanTree(huffmanNode->right);
-        free(huffmanNode);
-    }
-}
-
-/**
- * \fn void freeOccurrencesArray(OccurrencesArrayCell* occurrencesArray, int sizeOccurrencesArray)
- * \brief Frees the memory used by occurrencesArray and its dynamic arrays (of the field c)
- * \param occurrencesArray Array of structures containing each character associated to its number of occurrences in the initial file
- * \param sizeOccurrencesArray Size of occurrencesArray
- */
-
-
-void freeOccurrencesArray(OccurrencesArrayCell* occurrencesArray, int sizeOccurrencesArray)
-{
-    for(int i=0; i<sizeOccurrencesArray; i++)
-        free(occurrencesArray[i].c);
-    free(occurrencesArray);
-}
-
-
-
-/**
- * \fn void readNodeHuffmanAndWrite(FILE* file, FileBuffer* bufferChar, FileBuffer* bufferPos, HuffmanTreePtr huffmanNode, int* posBufferChar, int* posBufferPos, uint8_t *buffer, int* filling)
+ * \fn void readNodeHuffmanAndWrite(FileBuffer* bufferChar, HuffmanTreePtr huffmanNode, int* posBufferChar, BitWriter* writerPos)
  * \brief Recursive function used to fill the buffers needed to save the huffman tree.
  * \param bufferChar Buffer in which are saved by reading order the characters that will be unzipped during the decompression
- * \param bufferPos Buffer in which are saved by reading order the the instructions to rebuild the Huffman tree
  * \param huffmanNode Pointer to a node of the Huffman tree, in the first call of this function it's the root of the tree
  * \param posBufferChar Position in the buffer bufferChar. Used to write into it
- * \param posBufferPos Position in the buffer bufferPos. Used to write into it
- * \param buffer Temporary buffer used to fill bufferPos character by character
- * \param filling Keep a trace of the state of the buffer "buffer", if its value is 0 then the buffer is empty and if it's 8, it's full
+ * \param writerPos Writer of the instructions to rebuild the Huffman tree (1 : go to a child, 0 : go back to the parent)
  */
 
-void readNodeHuffmanAndWrite(FileBuffer* bufferChar, FileBuffer* bufferPos, HuffmanTreePtr huffmanNode, int* posBufferChar, int* posBufferPos, uint8_t *buffer, int* filling)
+void readNodeHuffmanAndWrite(FileBuffer* bufferChar, HuffmanTreePtr huffmanNode, int* posBufferChar, BitWriter* writerPos)
 {
     if(*posBufferChar==bufferChar->size){
         fprintf(stderr, "\nERROR : Buffer full in the huffman table creation\n");
@@ -280,167 +277,69 @@ void readNodeHuffmanAndWrite(FileBuffer* bufferChar, FileBuffer* bufferPos, Huff
     }
     if(huffmanNode->left==NULL && huffmanNode->right==NULL){ // we are at the end of a branch
         bufferChar->text[*posBufferChar] = huffmanNode->c;
-        //printf("|%c|", bufferChar[*posBufferChar]);
         (*posBufferChar)++;
-
-        (*buffer)<<=1; // We add a '0' to the buffer
-        //printf("0a");
-        (*filling)++;
-        //printf("\n0FILLING %d\n", *filling);
-        if(*filling==8){
-            bufferPos->text[*posBufferPos]=*buffer;
-            (*posBufferPos)++;
-            //printf("\nBUFFER_INS %d|%c\n", *buffer, *buffer);
-            *filling=0;
-            //printf(" ");
-
-            if((*posBufferPos)>bufferPos->size-5){ // the buffer is full so we increase its size
-                bufferPos->size+=1000;
-                bufferPos->text = (unsigned char*) realloc(bufferPos->text, sizeof(unsigned char)*bufferPos->size);
-                TESTALLOC(bufferPos->text);
-            }
-
-        }
+        writeBits(writerPos, 0, 1);
     }
     else{
-        //printf("1a");
-        (*buffer)<<=1; // We add a '1' to the buffer
-        (*buffer)|=0b1;
-        (*filling)++;
-        //printf("\n1FILLING %d\n", *filling);
-        if(*filling==8){
-            bufferPos->text[*posBufferPos]=*buffer;
-            (*posBufferPos)++;
-            //printf("\nBUFFER_INS %d|%c\n", *buffer, *buffer);
-            *filling=0;
-            
-            if((*posBufferPos)>bufferPos->size-5){ // the buffer is full so we increase its size
-                bufferPos->size+=1000;
-                bufferPos->text = (unsigned char*) realloc(bufferPos->text, sizeof(unsigned char)*bufferPos->size);
-                TESTALLOC(bufferPos->text);
-            }
-
-            //printf(" ");
-        }
-        readNodeHuffmanAndWrite(bufferChar, bufferPos, huffmanNode->left, posBufferChar, posBufferPos, buffer, filling);
-        //printf("1b");
-        (*buffer)<<=1; // We add a '1' to the buffer
-        (*buffer)|=0b1;
-        (*filling)++;
-        //printf("\n2FILLING %d\n", *filling);
-        if(*filling==8){
-            bufferPos->text[*posBufferPos]=*buffer;
-            (*posBufferPos)++;
-            //printf("\nBUFFER_INS %d|%c\n", *buffer, *buffer);
-            *filling=0;
-
-            if((*posBufferPos)>bufferPos->size-5){ // the buffer is full so we increase its size
-                bufferPos->size+=1000;
-                bufferPos->text = (unsigned char*) realloc(bufferPos->text, sizeof(unsigned char)*bufferPos->size);
-                TESTALLOC(bufferPos->text);
-            }
-
-            //printf(" ");
-        }
-        readNodeHuffmanAndWrite(bufferChar, bufferPos, huffmanNode->right, posBufferChar, posBufferPos, buffer, filling);
-        //printf("0b");
-        (*buffer)<<=1; // We add a '1' to the buffer
-        (*filling)++;
-        //printf("\n3FILLING %d\n", *filling);
-        if(*filling==8){
-            bufferPos->text[*posBufferPos]=*buffer;
-            (*posBufferPos)++;
-            //printf("\nBUFFER_INS %d|%c\n", *buffer, *buffer);
-            *filling=0;
-
-            if((*posBufferPos)>bufferPos->size-5){ // the buffer is full so we increase its size
-                bufferPos->size+=1000;
-                bufferPos->text = (unsigned char*) realloc(bufferPos->text, sizeof(unsigned char)*bufferPos->size);
-                TESTALLOC(bufferPos->text);
-            }
-
-
-           //printf(" ");
-        }
+        writeBits(writerPos, 1, 1); // We go to the left
+        readNodeHuffmanAndWrite(bufferChar, huffmanNode->left, posBufferChar, writerPos);
+        writeBits(writerPos, 1, 1); // We go to the right
+        readNodeHuffmanAndWrite(bufferChar, huffmanNode->right, posBufferChar, writerPos);
+        writeBits(writerPos, 0, 1); // We go back to the parent
     }
-    //printf("\nFILLING RETURN%d\n", *filling);
 }
 
 
 /**
- * \fn void saveTree(int indexBW, HuffmanTreePtr huffmanTree, int sizeBufferChar, int fileSize)
- * \brief Save the Huffman tree in a file by using 2 buffers, and add at the beginning values used for the decompression
- * \param indexBW Indicates if the extensions should be used (if > -1) and if it does then it's used to apply the inverse of Burrows Wheeler
+ * \fn int saveTree(HuffmanTreePtr huffmanTree, int sizeBufferChar, unsigned char* out)
+ * \brief Saves the Huffman tree in the header of a block by using 2 buffers : their sizes (2 bytes each), the characters of the leaves and the instructions to go through the tree
  * \param huffmanTree Pointer to the root of the Huffman tree
- * \param sizeBufferChar Number of unique elements in the initial file (after the application of the extensions). Size of the buffer bufferChar
- * \param fileSize Size of the initial file. Used in the decompression
+ * \param sizeBufferChar Number of unique elements in the block (after the application of the extensions). Size of the buffer bufferChar
+ * \param out Memory in which the tree is written, at least TREE_MAX_SIZE bytes
+ * \return Number of bytes written in out
  */
 
-void saveTree(int indexBW, HuffmanTreePtr huffmanTree, int sizeBufferChar, int fileSize)
+int saveTree(HuffmanTreePtr huffmanTree, int sizeBufferChar, unsigned char* out)
 {
     int posBufferChar=0; // Used to write in the buffer bufferChar
-    int posBufferPos=0; // // Used to write in the buffer bufferPos
-    int filling=0; // between 0 and 8 : 8=filled
-    uint8_t buffer=0; // Used to fill bufferPos
-    FileBuffer bufferPos; // Buffer containing position instructions (go ro the parent, continue...)
+    unsigned char bufferPos[TREE_MAX_SIZE+BIT_IO_SLACK]; // Buffer containing position instructions (go ro the parent, continue...)
     FileBuffer bufferChar;// Buffer containing characters read from tree in order (list of unique characters)
-    bufferPos.size=1000;
-    bufferPos.text = (unsigned char*) malloc(bufferPos.size*sizeof(unsigned char));
-    TESTALLOC(bufferPos.text);
+    BitWriter writerPos;
     bufferChar.size=sizeBufferChar;
-    bufferChar.text = (unsigned char*) malloc(bufferChar.size*sizeof(unsigned char));
-    TESTALLOC(bufferChar.text);
-
-    FILE* fileTable = fopen("table.txt", "wb+");
-    TESTFOPEN(fileTable);
+    bufferChar.text = out+4;
 
     // Filling the buffer by reading the tree
-    readNodeHuffmanAndWrite(&bufferChar, &bufferPos, huffmanTree, &posBufferChar, &posBufferPos, &buffer, &filling);
-    if(filling>0){
-        buffer<<=(8-filling);
-        bufferPos.text[posBufferPos]=buffer;
-        posBufferPos++;
-    }
-    bufferPos.size=posBufferPos;
-    bufferPos.text = (unsigned char*) realloc(bufferPos.text, sizeof(unsigned char)*bufferPos.size);
-    TESTALLOC(bufferPos.text);
-
-    // Saving in the file
-    rewind(fileTable);
-    fprintf(fileTable, "%d\n%d\n%d\n%d\n", indexBW, fileSize, sizeBufferChar, bufferPos.size);
-    fwrite(bufferChar.text, 1, bufferChar.size, fileTable);
-    fputc('\n', fileTable);
-    fwrite(bufferPos.text, 1, bufferPos.size, fileTable);
-    fputc('\n', fileTable);
-
-    free(bufferChar.text);
-    free(bufferPos.text);
-    
-    FCLOSE(fileTable);
+    initBitWriter(&writerPos, bufferPos, 0);
+    readNodeHuffmanAndWrite(&bufferChar, huffmanTree, &posBufferChar, &writerPos);
+    int posBufferPos = finishBitWriter(&writerPos);
+
+    writeNumber(out, sizeBufferChar, 2);
+    writeNumber(out+2, posBufferPos, 2);
+    memcpy(out+4+sizeBufferChar, bufferPos, posBufferPos);
+    return 4+sizeBufferChar+posBufferPos;
 }
 
 
 /**
- * \fn HuffmanTableCell* createHuffmanTable(int indexBW, FileBuffer bufferIn, int* sizeHuffmanTable)
- * \brief Creates, fills and saves huffmanTable that associate each character of bufferIn to a binary code
- * \param indexBW Index used to know if BW was used (if >=0) and to decode a file on which Burrows Wheeler was used
- * \param bufferIn Buffer from which we create the table associated
- * \param sizeHuffmanTable Size of the returned table, used for compression and to free the table
+ * \fn HuffmanTableCell* createHuffmanTable(Arena* arena, OccurrencesArrayCell* occurrencesArray, int sizeOccurrencesArray, int* sizeHuffmanTable, HuffmanTreePtr* huffmanTree)
+ * \brief Creates and fills huffmanTable that associate each character of the buffer to a binary code. The table, its codes and the tree are allocated in the arena
+ * \param arena Arena in which the table and the tree are allocated, they are freed with it
+ * \param occurrencesArray Array returned by fillOccurrencesArray for the buffer from which we create the table. It's modified by this function
+ * \param sizeOccurrencesArray Size of occurrencesArray, at least 2 so that each code has at least 1 bit
+ * \param sizeHuffmanTable Size of the returned table, used for compression
+ * \param huffmanTree Root of the Huffman tree, used to save it with saveTree
+ * \return Huffman table
  */
 
-HuffmanTableCell* createHuffmanTable(int indexBW, FileBuffer bufferIn, int* sizeHuffmanTable)
+HuffmanTableCell* createHuffmanTable(Arena* arena, OccurrencesArrayCell* occurrencesArray, int sizeOccurrencesArray, int* sizeHuffmanTable, HuffmanTreePtr* huffmanTree)
 {
-    int sizeOccurrencesArray;
-    OccurrencesArrayCell* occurrencesArray = fillOccurrencesArray(bufferIn, &sizeOccurrencesArray);
     *sizeHuffmanTable=sizeOccurrencesArray;
     HuffmanTableCell* huffmanTable = NULL;
-    huffmanTable = (HuffmanTableCell*) malloc((*sizeHuffmanTable)*sizeof(HuffmanTableCell));
-    TESTALLOC(huffmanTable);
+    huffmanTable = (HuffmanTableCell*) arenaAlloc(arena, (*sizeHuffmanTable)*sizeof(HuffmanTableCell));
     initializeCode(huffmanTable, *sizeHuffmanTable, occurrencesArray);
 
-    int i_min1;
-    int i_min2;
-    printf("\nHuffman tree and table are being generated...\n");
+    int i_min1=0;
+    int i_min2=1;
     while(sizeOccurrencesArray>1){  // Until there is only one element left
         i_min1 = 0;
         i_min2 = 1;
@@ -450,14 +349,94 @@ HuffmanTableCell* createHuffmanTable(int indexBW, FileBuffer bufferIn, int* size
             i_min1 = tmp;
         }
         seek2Min(&i_min1, &i_min2, occurrencesArray,sizeOccurrencesArray);
-        fillHuffmanTree(occurrencesArray, i_min1, i_min2);
-        fillHuffmanTableCode(huffmanTable, *sizeHuffmanTable, occurrencesArray, i_min1, i_min2);
+        fillHuffmanTree(arena, occurrencesArray, i_min1, i_min2);
+        fillHuffmanTableCode(arena, huffmanTable, *sizeHuffmanTable, occurrencesArray, i_min1, i_min2);
         merge(i_min1, i_min2, occurrencesArray, &sizeOccurrencesArray);
     }
-    printf("\nSaving table and tree...\n");
-    saveTree(indexBW, occurrencesArray[i_min1].mergedHead, *sizeHuffmanTable, bufferIn.size);
-    freeHuffmanTree(occurrencesArray[i_min1].mergedHead);
-    freeOccurrencesArray(occurrencesArray, sizeOccurrencesArray);
+    *huffmanTree = occurrencesArray[i_min1].mergedHead;
+
+    return huffmanTable;
+}
 
+/**
+ * \fn long long huffmanTableBits(HuffmanTableCell* huffmanTable, int sizeHuffmanTable, long counts[N_ASCII])
+ * \brief Computes the size of the coding of a buffer with a Huffman table
+ * \param huffmanTable Huffman table
+ * \param sizeHuffmanTable Size of huffmanTable
+ * \param counts Number of occurrences of each character in the buffer
+ * \return Size of the coded buffer in bits
+ */
+
+long long huffmanTableBits(HuffmanTableCell* huffmanTable, int sizeHuffmanTable, long counts[N_ASCII])
+{
+    long long bits=0;
+    for(int i=0; i<sizeHuffmanTable; i++)
+        bits += (long long) counts[huffmanTable[i].c]*huffmanTable[i].length;
+    return bits;
+}
+
+
+/**
+ * \fn static void fillTableFromNode(Arena* arena, HuffmanTreePtr huffmanNode, PtrlistCode code, int length, HuffmanTableCell* huffmanTable, int* sizeHuffmanTable, int* maxCodeLength)
+ * \brief Recursive function adding to the table the leaves under a node of the tree. The codes of the leaves under the same node share the end of their lists
+ * \param arena Arena in which the codes are allocated
+ * \param huffmanNode Node of the tree
+ * \param code Code of the node (list beginning with its last bit), NULL for the root
+ * \param length Length of the code of the node
+ * \param huffmanTable Table filled
+ * \param sizeHuffmanTable Number of cells of the table already filled
+ * \param maxCodeLength Length of the longest code found
+ */
+
+static void fillTableFromNode(Arena* arena, HuffmanTreePtr huffmanNode, PtrlistCode code, int length, HuffmanTableCell* huffmanTable, int* sizeHuffmanTable, int* maxCodeLength)
+{
+    if(huffmanNode->left==NULL && huffmanNode->right==NULL){ // we are at the end of a branch
+        // The lists of the table begin with the first bit, so the code is reversed
+        PtrlistCode reversed=NULL;
+        uint64_t bits=0;
+        if(length>MAX_CODE_LENGTH){
+            fprintf(stderr, "\nERROR : Huffman code longer than %d bits\n", MAX_CODE_LENGTH);
+            exit(EXIT_FAILURE);
+        }
+        int position=0; // The list begins with the last bit, which is the least significant one
+        for(PtrlistCode l=code; l!=NULL; l=l->next){
+            addStartList(&reversed, createNode(arena, l->value));
+            if(l->value=='1')
+                bits |= (uint64_t) 1 << position;
+            position++;
+        }
+        huffmanTable[*sizeHuffmanTable].c = huffmanNode->c;
+        huffmanTable[*sizeHuffmanTable].code = reversed;
+        huffmanTable[*sizeHuffmanTable].bits = bits;
+        huffmanTable[*sizeHuffmanTable].length = length;
+        (*sizeHuffmanTable)++;
+        if(length>*maxCodeLength)
+            *maxCodeLength = length;
+        return;
+    }
+    PtrlistCode codeLeft = createNode(arena, '0');
+    codeLeft->next = code;
+    fillTableFromNode(arena, huffmanNode->left, codeLeft, length+1, huffmanTable, sizeHuffmanTable, maxCodeLength);
+    PtrlistCode codeRight = createNode(arena, '1');
+    codeRight->next = code;
+    fillTableFromNode(arena, huffmanNode->right, codeRight, length+1, huffmanTable, sizeHuffmanTable, maxCodeLength);
+}
+
+/**
+ * \fn HuffmanTableCell* createTableFromTree(Arena* arena, HuffmanTreePtr huffmanTree, int* sizeHuffmanTable, int* maxCodeLength)
+ * \brief Creates the Huffman table of a tree that was saved, so that the coding uses exactly the codes of this tree
+ * \param arena Arena in which the table is allocated
+ * \param huffmanTree Root of the tree
+ * \param sizeHuffmanTable Size of the returned table
+ * \param maxCodeLength Length of the longest code of the table
+ * \return Huffman table
+ */
+
+HuffmanTableCell* createTableFromTree(Arena* arena, HuffmanTreePtr huffmanTree, int* sizeHuffmanTable, int* maxCodeLength)
+{
+    HuffmanTableCell* huffmanTable = (HuffmanTableCell*) arenaAlloc(arena, N_ASCII*sizeof(HuffmanTableCell));
+    *sizeHuffmanTable = 0;
+    *maxCodeLength = 0;
+    fillTableFromNode(arena, huffmanTree, NULL, 0, huffmanTable, sizeHuffmanTable, maxCodeLength);
     return huffmanTable;
 }
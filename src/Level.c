@@ -0,0 +1,129 @@
+/**
+ * \file Level.c
+ * \brief Compression levels (--level) : each one is a documented combination of the size of the blocks, the transforms, LZ77 and the coder, and --explain displays the settings actually used
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+
+/**
+ * \var levels Settings of the levels 1 to LEVEL_MAX. The blocks are larger and the transforms slower from one level to the next, the level LEVEL_DEFAULT is the compression of the previous versions
+ */
+
+static const CompressionLevel levels[LEVEL_MAX] = {
+    {"Huffman only, small blocks : as fast as the data is read", {64*1024, 16, 256*1024, 0}, "none", 0, LZ77_DEFAULT_DEPTH, CODER_HUFFMAN},
+    {"Huffman, tANS or bigrams, small blocks", {64*1024, 16, 256*1024, SPLIT_MIN_SIZE}, "none", 0, LZ77_DEFAULT_DEPTH, CODER_AUTO},
+    {"fast LZ77 : small window, few positions compared", {128*1024, 18, 512*1024, SPLIT_MIN_SIZE}, "none", 64*1024, 4, CODER_AUTO},
+    {"LZ77 with the parameters of --lz77", {CHUNK_MIN_SIZE, CHUNK_MASK_BITS, BLOCK_SIZE, SPLIT_MIN_SIZE}, "none", LZ77_DEFAULT_WINDOW, LZ77_DEFAULT_DEPTH, CODER_AUTO},
+    {"LZ77 with 4 times more positions compared", {CHUNK_MIN_SIZE, CHUNK_MASK_BITS, BLOCK_SIZE, SPLIT_MIN_SIZE}, "none", LZ77_DEFAULT_WINDOW, 4*LZ77_DEFAULT_DEPTH, CODER_AUTO},
+    {"Burrows Wheeler on blocks of about 640 KiB, the default", {CHUNK_MIN_SIZE, CHUNK_MASK_BITS, BLOCK_SIZE, SPLIT_MIN_SIZE}, "rle,bwt,mtf", 0, LZ77_DEFAULT_DEPTH, CODER_AUTO},
+    {"Burrows Wheeler on blocks of about 768 KiB", {256*1024, 19, BLOCK_SIZE, SPLIT_MIN_SIZE}, "rle,bwt,mtf", 0, LZ77_DEFAULT_DEPTH, CODER_AUTO},
+    {"Burrows Wheeler on blocks of about 896 KiB", {640*1024, 18, BLOCK_SIZE, SPLIT_MIN_SIZE}, "rle,bwt,mtf", 0, LZ77_DEFAULT_DEPTH, CODER_AUTO},
+    {"Burrows Wheeler on the largest blocks", {896*1024, 17, BLOCK_SIZE, SPLIT_MIN_SIZE}, "rle,bwt,mtf", 0, LZ77_DEFAULT_DEPTH, CODER_AUTO}
+};
+
+
+/**
+ * \fn void applyLevel(int level, ProgramOptions* options)
+ * \brief Sets the options from the settings of a level, before the other options are read
+ * \param level Level, between 1 and LEVEL_MAX
+ * \param options Options set
+ */
+
+void applyLevel(int level, ProgramOptions* options)
+{
+    const CompressionLevel* settings = &(levels[level-1]);
+    options->level = level;
+    options->chunking = settings->chunks;
+    parseTransforms(settings->transforms, &(options->transforms));
+    options->lzWindow = settings->lzWindow;
+    options->lzDepth = settings->lzDepth;
+    options->coder = settings->coder;
+}
+
+/**
+ * \fn static void printSize(FILE* file, long long size)
+ * \brief Displays a size in KiB or MiB when it's a multiple of them
+ * \param file File in which the size is written
+ * \param size Size in bytes
+ */
+
+static void printSize(FILE* file, long long size)
+{
+    if(size>=1024*1024 && size%(1024*1024)==0)
+        fprintf(file, "%lld MiB", size/(1024*1024));
+    else if(size>=1024 && size%1024==0)
+        fprintf(file, "%lld KiB", size/1024);
+    else
+        fprintf(file, "%lld bytes", size);
+}
+
+/**
+ * \fn void explainSettings(const ProgramOptions* options, FILE* file)
+ * \brief Displays the settings used by the compression once all the options are read (--explain)
+ * \param options Options read
+ * \param file File in which the settings are written
+ */
+
+void explainSettings(const ProgramOptions* options, FILE* file)
+{
+    static const char* coderNames[] = {"Huffman, tANS or bigrams, the smallest one", "Huffman", "tANS", "Huffman codes of the characters and of the frequent pairs of characters"};
+
+    fprintf(file, "level : %d (%s)\n", options->level, levels[options->level-1].description);
+    if(options->stream){
+        fprintf(file, "blocks : live blocks of at most ");
+        printSize(file, STREAM_BLOCK_SIZE);
+        fprintf(file, ", coded with adaptive Huffman codes (--stream), the level isn't used\n");
+    }
+    else{
+        fprintf(file, "blocks : cut by their content, from ");
+        printSize(file, options->chunking.minSize);
+        fprintf(file, " to ");
+        printSize(file, options->chunking.maxSize);
+        fprintf(file, ", about ");
+        long long average = options->chunking.minSize+(1LL << options->chunking.maskBits);
+        printSize(file, (average<options->chunking.maxSize) ? average : options->chunking.maxSize);
+        fprintf(file, " on average\n");
+        fprintf(file, "split : ");
+        if(options->chunking.splitMinSize>0){
+            fprintf(file, "chunks split in blocks of at least ");
+            printSize(file, options->chunking.splitMinSize);
+            fprintf(file, " when the statistics of their parts are different\n");
+        }
+        else
+            fprintf(file, "no\n");
+        if(options->lzWindow>0){
+            fprintf(file, "lz77 : window of ");
+            printSize(file, options->lzWindow);
+            fprintf(file, ", %d positions compared, on the blocks with repetitions\n", options->lzDepth);
+        }
+        fprintf(file, "transforms : ");
+        if(options->lzWindow>0 || options->transforms.nbTransforms==0)
+            fprintf(file, "none%s\n", (options->transforms.nbTransforms>0) ? " (replaced by LZ77)" : "");
+        else{
+            for(int i=0; i<options->transforms.nbTransforms; i++)
+                fprintf(file, "%s%s", (i>0) ? "," : "", getTransformStage(options->transforms.ids[i])->name);
+            fprintf(file, ", on the blocks for which Burrows Wheeler is estimated to save 10%%\n");
+        }
+        fprintf(file, "coder : %s\n", coderNames[options->coder]);
+        fprintf(file, "dictionary : %s\n", (options->dictionary!=NULL) ? options->dictionary : "none");
+        fprintf(file, "deadline : ");
+        if(options->deadline>0)
+            fprintf(file, "%d ms per file\n", options->deadline);
+        else
+            fprintf(file, "none\n");
+    }
+    if(options->nbThreads>0)
+        fprintf(file, "threads : %d\n", options->nbThreads);
+    else
+        fprintf(file, "threads : %d (one per processor)\n", numberOfProcessors());
+    fprintf(file, "max memory : ");
+    if(options->maxMemory>0)
+        printSize(file, options->maxMemory);
+    else
+        fprintf(file, "no limit");
+    fprintf(file, "\n");
+}
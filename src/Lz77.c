@@ -0,0 +1,481 @@
+/**
+ * \file Lz77.c
+ * \brief LZ77 coding of a block : the repeated parts are replaced by their length and their distance to a previous occurrence, found with hash chains and lazy matching. The literals, the lengths and the distances are then coded with Huffman, each with its own tree
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+
+/**
+ * \def LZ77_STREAM_STORED The symbols of a stream are copied
+ */
+
+#define LZ77_STREAM_STORED 0
+
+/**
+ * \def LZ77_STREAM_FILL The stream contains only one symbol, repeated, which is saved once
+ */
+
+#define LZ77_STREAM_FILL 1
+
+/**
+ * \def LZ77_STREAM_HUFFMAN Huffman tree, size of the coding (4 bytes) and Huffman coding of the symbols of the stream
+ */
+
+#define LZ77_STREAM_HUFFMAN 2
+
+/**
+ * \def LZ77_MAX_SYMBOL Largest symbol of a length or of a distance (values lower than 2^20, larger than a block)
+ */
+
+#define LZ77_MAX_SYMBOL (LZ77_DIRECT_VALUES+2*(20-4)+1)
+
+
+
+/**
+ * \fn static unsigned char valueSymbol(uint32_t value, BitWriter* extra)
+ * \brief Gives the symbol of a length or a distance and writes its extra bits : the values lower than LZ77_DIRECT_VALUES are their own symbol, the symbol of the other ones gives the position of their most significant bit and the next bit
+ * \param value Value coded
+ * \param extra Writer of the extra bits (the bits of the value after the 2 most significant ones)
+ * \return Symbol of the value
+ */
+
+static unsigned char valueSymbol(uint32_t value, BitWriter* extra)
+{
+    if(value<LZ77_DIRECT_VALUES)
+        return value;
+    int high = highBit(value);
+    writeBits(extra, value, high-1);
+    return LZ77_DIRECT_VALUES+2*(high-4)+((value >> (high-1)) & 1);
+}
+
+/**
+ * \fn static uint32_t symbolValue(unsigned char symbol, BitReader* extra)
+ * \brief Gives the length or distance coded by valueSymbol
+ * \param symbol Symbol of the value
+ * \param extra Reader of the extra bits
+ * \return Value
+ */
+
+static uint32_t symbolValue(unsigned char symbol, BitReader* extra)
+{
+    if(symbol<LZ77_DIRECT_VALUES)
+        return symbol;
+    if(symbol>LZ77_MAX_SYMBOL){
+        fprintf(stderr, "\nERROR : Incorrect LZ77 block\n");
+        exit(EXIT_FAILURE);
+    }
+    int high = (symbol-LZ77_DIRECT_VALUES)/2+4;
+    return ((uint32_t) (2 | (symbol & 1)) << (high-1)) | (uint32_t) readBits(extra, high-1);
+}
+
+/**
+ * \fn static uint32_t hashPosition(const unsigned char* text)
+ * \brief Hash of the LZ77_MIN_MATCH characters beginning at a position
+ * \param text Characters hashed
+ * \return Hash, lower than 2^LZ77_HASH_BITS
+ */
+
+static uint32_t hashPosition(const unsigned char* text)
+{
+    uint32_t value;
+    memcpy(&value, text, sizeof(value));
+    return (value*2654435761U) >> (32-LZ77_HASH_BITS);
+}
+
+/**
+ * \fn static void insertPosition(const unsigned char* text, int pos, int* heads, int* chains)
+ * \brief Adds a position at the beginning of the chain of its hash
+ * \param text Block coded
+ * \param pos Position, at least LZ77_MIN_MATCH characters before the end of the block
+ * \param heads Last position of each hash
+ * \param chains Previous position with the same hash of each position
+ */
+
+static void insertPosition(const unsigned char* text, int pos, int* heads, int* chains)
+{
+    uint32_t hash = hashPosition(text+pos);
+    chains[pos] = heads[hash];
+    heads[hash] = pos;
+}
+
+/**
+ * \fn static int matchLength(const unsigned char* previous, const unsigned char* current, int maxLength)
+ * \brief Counts the characters that are the same at 2 positions, 8 at a time when the processor is little endian
+ * \param previous Previous position
+ * \param current Current position
+ * \param maxLength Largest length (characters left in the block after current)
+ * \return Length of the match
+ */
+
+static int matchLength(const unsigned char* previous, const unsigned char* current, int maxLength)
+{
+    int length=0;
+    #if defined(__GNUC__) && __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+    while(length+8<=maxLength){
+        uint64_t a, b;
+        memcpy(&a, previous+length, 8);
+        memcpy(&b, current+length, 8);
+        if(a!=b)
+            return length+__builtin_ctzll(a ^ b)/8; // The first different byte is the lowest one
+        length += 8;
+    }
+    #endif
+    while(length<maxLength && previous[length]==current[length])
+        length++;
+    return length;
+}
+
+/**
+ * \fn static int findMatch(FileBuffer block, int pos, int* heads, int* chains, LzSettings settings, int* distance)
+ * \brief Looks for the longest match of a position among the previous positions with the same hash (at most settings.depth of them, in the window), then adds the position to its chain
+ * \param block Block coded
+ * \param pos Position, at least LZ77_MIN_MATCH characters before the end of the block. The previous positions must already be in the chains
+ * \param heads Last position of each hash
+ * \param chains Previous position with the same hash of each position
+ * \param settings Window and depth of the search
+ * \param distance Distance of the match found
+ * \return Length of the match, lower than LZ77_MIN_MATCH if there isn't any
+ */
+
+static int findMatch(FileBuffer block, int pos, int* heads, int* chains, LzSettings settings, int* distance)
+{
+    int candidate = heads[hashPosition(block.text+pos)];
+    int maxLength = block.size-pos;
+    int best = LZ77_MIN_MATCH-1;
+    const unsigned char* current = block.text+pos;
+
+    for(int depth=settings.depth; candidate>=0 && pos-candidate<=settings.window && depth>0; depth--){
+        const unsigned char* previous = block.text+candidate;
+        if(previous[best]==current[best]){ // It can be longer than the best match only if this character is the same
+            int length = matchLength(previous, current, maxLength);
+            if(length>best){
+                best = length;
+                *distance = pos-candidate;
+                if(length>=LZ77_NICE_LENGTH || length==maxLength)
+                    break;
+            }
+        }
+        candidate = chains[candidate];
+    }
+    insertPosition(block.text, pos, heads, chains);
+    return best;
+}
+
+/**
+ * \fn static int saveStream(FileBuffer symbols, unsigned char* out, int sizeMax, PipelineContext* context)
+ * \brief Writes a stream of symbols (literals, lengths or distances) with its own Huffman tree, or copies it if the coding isn't smaller
+ * \param symbols Symbols of the stream, their number is saved elsewhere
+ * \param out Memory in which the stream is written, BIT_IO_SLACK bytes must be writable after sizeMax
+ * \param sizeMax Largest size that can be written
+ * \param context Memory and measures of the compression
+ * \return Size written, -1 if it would be larger than sizeMax (nothing is written then)
+ */
+
+static int saveStream(FileBuffer symbols, unsigned char* out, int sizeMax, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    long counts[N_ASCII];
+    int sizeOccurrencesArray=0;
+    int sizeHuffmanTable=0;
+    HuffmanTreePtr huffmanTree=NULL;
+    FileBuffer bufferOut;
+    int size;
+
+    stageStart(stats, STAGE_TREE);
+    countOccurrences(symbols, counts);
+    OccurrencesArrayCell* occurrencesArray = createOccurrencesArray(&(context->arena), counts, &sizeOccurrencesArray);
+    if(sizeOccurrencesArray==1){
+        size = 2;
+        if(size<=sizeMax){
+            out[0] = LZ77_STREAM_FILL;
+            out[1] = symbols.text[0];
+        }
+        stageStop(stats, STAGE_TREE, 0, size);
+        resetArena(&(context->arena));
+        return (size<=sizeMax) ? size : -1;
+    }
+
+    HuffmanTableCell* huffmanTable=NULL;
+    long long sizeCoded=-1;
+    if(sizeOccurrencesArray>=2){
+        huffmanTable = createHuffmanTable(&(context->arena), occurrencesArray, sizeOccurrencesArray, &sizeHuffmanTable, &huffmanTree);
+        sizeCoded = (huffmanTableBits(huffmanTable, sizeHuffmanTable, counts)+7)/8;
+    }
+    int sizeTree = 4+sizeHuffmanTable+(4*sizeHuffmanTable+4)/8; // Largest size of the saved tree
+    if(sizeCoded<0 || 1+sizeTree+4+sizeCoded>=1+symbols.size){ // The tree would cost more than the coding saves
+        size = 1+symbols.size;
+        if(size<=sizeMax){
+            out[0] = LZ77_STREAM_STORED;
+            memcpy(out+1, symbols.text, symbols.size);
+        }
+        stageStop(stats, STAGE_TREE, 0, 0);
+        resetArena(&(context->arena));
+        return (size<=sizeMax) ? size : -1;
+    }
+    if(1+sizeTree+4+sizeCoded>sizeMax){
+        stageStop(stats, STAGE_TREE, 0, 0);
+        resetArena(&(context->arena));
+        return -1;
+    }
+
+    out[0] = LZ77_STREAM_HUFFMAN;
+    sizeTree = saveTree(huffmanTree, sizeHuffmanTable, out+1);
+    stageStop(stats, STAGE_TREE, 0, sizeTree);
+
+    stageStart(stats, STAGE_HUFFMAN_ENCODE);
+    bufferOut.text = out+1+sizeTree+4;
+    bufferOut.size = 0;
+    compress(symbols, &bufferOut, huffmanTable, sizeHuffmanTable, &(context->scratch));
+    writeNumber(out+1+sizeTree, bufferOut.size, 4);
+    stageStop(stats, STAGE_HUFFMAN_ENCODE, symbols.size, bufferOut.size);
+    if(stats!=NULL)
+        stats->tableSize += sizeTree;
+    resetArena(&(context->arena));
+    return 1+sizeTree+4+bufferOut.size;
+}
+
+/**
+ * \fn static int loadStream(FileBuffer bufferIn, FileBuffer* symbols, int nbSymbols, PipelineContext* context)
+ * \brief Reads a stream of symbols written by saveStream
+ * \param bufferIn Data of the block from the beginning of the stream
+ * \param symbols Buffer filled with the symbols, its field text must be allocated by the caller
+ * \param nbSymbols Number of symbols of the stream
+ * \param context Memory and measures of the decompression
+ * \return Size of the stream in bufferIn
+ */
+
+static int loadStream(FileBuffer bufferIn, FileBuffer* symbols, int nbSymbols, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    int sizeTree=0;
+    FileBuffer bufferCoded;
+
+    symbols->size = nbSymbols;
+    if(bufferIn.size<1){
+        fprintf(stderr, "\nERROR : Incorrect LZ77 block\n");
+        exit(EXIT_FAILURE);
+    }
+    switch(bufferIn.text[0]){
+        case LZ77_STREAM_STORED :
+            if(bufferIn.size-1<nbSymbols){
+                fprintf(stderr, "\nERROR : Incorrect LZ77 block\n");
+                exit(EXIT_FAILURE);
+            }
+            memcpy(symbols->text, bufferIn.text+1, nbSymbols);
+            return 1+nbSymbols;
+
+        case LZ77_STREAM_FILL :
+            if(bufferIn.size<2){
+                fprintf(stderr, "\nERROR : Incorrect LZ77 block\n");
+                exit(EXIT_FAILURE);
+            }
+            memset(symbols->text, bufferIn.text[1], nbSymbols);
+            return 2;
+
+        case LZ77_STREAM_HUFFMAN :
+            bufferIn.text++;
+            bufferIn.size--;
+            stageStart(stats, STAGE_TABLE_READ);
+            HuffmanTreePtr huffmanTree = loadTree(&(context->arena), bufferIn, &sizeTree);
+            stageStop(stats, STAGE_TABLE_READ, sizeTree, 0);
+            if(bufferIn.size-sizeTree<4 || (long long) readNumber(bufferIn.text+sizeTree, 4)>bufferIn.size-sizeTree-4){
+                fprintf(stderr, "\nERROR : Incorrect LZ77 block\n");
+                exit(EXIT_FAILURE);
+            }
+            bufferCoded.text = bufferIn.text+sizeTree+4;
+            bufferCoded.size = readNumber(bufferIn.text+sizeTree, 4);
+
+            stageStart(stats, STAGE_HUFFMAN_DECODE);
+            decompress(bufferCoded, symbols, huffmanTree, nbSymbols);
+            stageStop(stats, STAGE_HUFFMAN_DECODE, bufferCoded.size, nbSymbols);
+            if(stats!=NULL)
+                stats->tableSize += sizeTree;
+            resetArena(&(context->arena));
+            return 1+sizeTree+4+bufferCoded.size;
+
+        default :
+            fprintf(stderr, "\nERROR : Incorrect LZ77 block\n");
+            exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+/**
+ * \fn void lz77ScratchSizes(int size, size_t sizes[N_SCRATCH_SLOTS])
+ * \brief Gives the sizes of the scratch buffers used by lz77Encode for a block
+ * \param size Size of the block
+ * \param sizes Number of bytes needed in each slot, the ones of LZ77 are set here (the other ones aren't modified)
+ */
+
+void lz77ScratchSizes(int size, size_t sizes[N_SCRATCH_SLOTS])
+{
+    sizes[SCRATCH_LZ77_HEADS] = sizeof(int) << LZ77_HASH_BITS;
+    sizes[SCRATCH_LZ77_CHAINS] = (size_t) size*sizeof(int);
+    sizes[SCRATCH_LZ77_SEQUENCES] = (size_t) size+11*(size_t) (size/LZ77_MIN_MATCH+1)+BIT_IO_SLACK;
+}
+
+/**
+ * \fn int lz77Encode(FileBuffer block, unsigned char* out, int sizeMax, PipelineContext* context)
+ * \brief Codes a block with LZ77. At each position the longest match is looked for in the hash chain of its first characters, and if the next position has a longer one the character is written as a literal instead (lazy matching). The block becomes a list of sequences (number of literals, length and distance of the match), followed by the last literals. The literals, the numbers of literals, the lengths and the distances are 4 streams of bytes coded with Huffman (each one with its own tree), the lengths and distances larger than LZ77_DIRECT_VALUES having extra bits, written at the end
+ * \param block Block coded, it isn't modified
+ * \param out Memory in which the data of the block is written, BIT_IO_SLACK bytes must be writable after sizeMax
+ * \param sizeMax Largest size of the data, the coding is stopped if it's larger
+ * \param context Memory and measures of the compression, and parameters of the search (context->lz)
+ * \return Size of the data written, 0 if it's larger than sizeMax
+ */
+
+int lz77Encode(FileBuffer block, unsigned char* out, int sizeMax, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    LzSettings settings = context->lz;
+    int maxSequences = block.size/LZ77_MIN_MATCH+1;
+    FileBuffer literals, runs, lengths, distances;
+    BitWriter extra;
+    int nbSequences=0;
+    int pos=0;
+    int literalStart=0; // Beginning of the literals of the current sequence
+    int nextInserted=0; // First position that isn't in the chains
+    size_t sizes[N_SCRATCH_SLOTS];
+
+    stageStart(stats, STAGE_LZ77);
+    lz77ScratchSizes(block.size, sizes);
+    int* heads = (int*) scratchGet(&(context->scratch), SCRATCH_LZ77_HEADS, sizes[SCRATCH_LZ77_HEADS]);
+    int* chains = (int*) scratchGet(&(context->scratch), SCRATCH_LZ77_CHAINS, sizes[SCRATCH_LZ77_CHAINS]);
+    unsigned char* sequences = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_LZ77_SEQUENCES, sizes[SCRATCH_LZ77_SEQUENCES]);
+    memset(heads, -1, sizeof(int) << LZ77_HASH_BITS);
+    literals.text = sequences;
+    literals.size = 0;
+    runs.text = sequences+block.size;
+    lengths.text = runs.text+maxSequences;
+    distances.text = lengths.text+maxSequences;
+    initBitWriter(&extra, distances.text+maxSequences, 0); // At most 3 values of 20 bits for each sequence
+
+    while(pos+LZ77_MIN_MATCH<=block.size){
+        int distance=0;
+        for(; nextInserted<pos; nextInserted++) // Positions inside the previous match
+            insertPosition(block.text, nextInserted, heads, chains);
+        int length = findMatch(block, pos, heads, chains, settings, &distance);
+        nextInserted = pos+1;
+        if(length<LZ77_MIN_MATCH){
+            pos++;
+            continue;
+        }
+        while(length<LZ77_NICE_LENGTH && pos+1+LZ77_MIN_MATCH<=block.size){ // Lazy matching : the match of the next position is taken if it's longer
+            int nextDistance=0;
+            int nextLength = findMatch(block, pos+1, heads, chains, settings, &nextDistance);
+            nextInserted = pos+2;
+            if(nextLength<=length)
+                break;
+            pos++;
+            length = nextLength;
+            distance = nextDistance;
+        }
+
+        memcpy(literals.text+literals.size, block.text+literalStart, pos-literalStart);
+        literals.size += pos-literalStart;
+        runs.text[nbSequences] = valueSymbol(pos-literalStart, &extra);
+        lengths.text[nbSequences] = valueSymbol(length-LZ77_MIN_MATCH, &extra);
+        distances.text[nbSequences] = valueSymbol(distance-1, &extra);
+        nbSequences++;
+        pos += length;
+        literalStart = pos;
+    }
+    memcpy(literals.text+literals.size, block.text+literalStart, block.size-literalStart);
+    literals.size += block.size-literalStart;
+    FileBuffer bufferExtra = {distances.text+maxSequences, finishBitWriter(&extra)};
+    runs.size = lengths.size = distances.size = nbSequences;
+    stageStop(stats, STAGE_LZ77, block.size, literals.size+3*nbSequences+bufferExtra.size);
+
+    if(8>sizeMax)
+        return 0;
+    writeNumber(out, nbSequences, 4);
+    writeNumber(out+4, literals.size, 4);
+    int size = 8;
+    FileBuffer streams[4] = {literals, runs, lengths, distances};
+    for(int i=0; i<4; i++){
+        int sizeStream = saveStream(streams[i], out+size, sizeMax-size, context);
+        if(sizeStream<0)
+            return 0;
+        size += sizeStream;
+    }
+    if(size+bufferExtra.size>sizeMax)
+        return 0;
+    memcpy(out+size, bufferExtra.text, bufferExtra.size);
+    return size+bufferExtra.size;
+}
+
+/**
+ * \fn void lz77Decode(FileBuffer bufferIn, FileBuffer* bufferOut, int sizeOut, PipelineContext* context)
+ * \brief Decodes a block coded by lz77Encode. The program is stopped if the data is incorrect
+ * \param bufferIn Data of the block
+ * \param bufferOut Buffer filled with the block, its field text must be allocated by the caller
+ * \param sizeOut Size of the block
+ * \param context Memory and measures of the decompression
+ */
+
+void lz77Decode(FileBuffer bufferIn, FileBuffer* bufferOut, int sizeOut, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    FileBuffer literals, runs, lengths, distances;
+    BitReader extra;
+
+    if(bufferIn.size<8){
+        fprintf(stderr, "\nERROR : Incorrect LZ77 block\n");
+        exit(EXIT_FAILURE);
+    }
+    long long nbSequences = readNumber(bufferIn.text, 4);
+    long long nbLiterals = readNumber(bufferIn.text+4, 4);
+    if(nbLiterals>sizeOut || nbSequences>sizeOut/LZ77_MIN_MATCH){
+        fprintf(stderr, "\nERROR : Incorrect LZ77 block\n");
+        exit(EXIT_FAILURE);
+    }
+    unsigned char* sequences = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_LZ77_SEQUENCES, nbLiterals+3*nbSequences+1);
+    literals.text = sequences;
+    runs.text = sequences+nbLiterals;
+    lengths.text = runs.text+nbSequences;
+    distances.text = lengths.text+nbSequences;
+
+    int pos = 8;
+    FileBuffer* streams[4] = {&literals, &runs, &lengths, &distances};
+    for(int i=0; i<4; i++){
+        FileBuffer bufferStream = {bufferIn.text+pos, bufferIn.size-pos};
+        pos += loadStream(bufferStream, streams[i], (i==0) ? nbLiterals : nbSequences, context);
+    }
+    initBitReader(&extra, bufferIn.text+pos, bufferIn.size-pos);
+
+    stageStart(stats, STAGE_LZ77_DECODE);
+    unsigned char* out = bufferOut->text;
+    long long posOut=0;
+    long long posLiterals=0;
+    for(int i=0; i<nbSequences; i++){
+        uint32_t run = symbolValue(runs.text[i], &extra);
+        uint32_t length = symbolValue(lengths.text[i], &extra)+LZ77_MIN_MATCH;
+        uint32_t distance = symbolValue(distances.text[i], &extra)+1;
+        if(run>nbLiterals-posLiterals || distance>posOut+run || length>sizeOut-posOut-run){
+            fprintf(stderr, "\nERROR : Incorrect LZ77 block\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(out+posOut, literals.text+posLiterals, run);
+        posOut += run;
+        posLiterals += run;
+        const unsigned char* match = out+posOut-distance;
+        if(distance>=length)
+            memcpy(out+posOut, match, length);
+        else{ // The match overlaps the characters it writes
+            for(uint32_t k=0; k<length; k++)
+                out[posOut+k] = match[k];
+        }
+        posOut += length;
+    }
+    if(posOut+nbLiterals-posLiterals!=sizeOut || bitsRead(&extra)>(long long) (bufferIn.size-pos)*8){
+        fprintf(stderr, "\nERROR : Incorrect LZ77 block\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(out+posOut, literals.text+posLiterals, nbLiterals-posLiterals);
+    bufferOut->size = sizeOut;
+    stageStop(stats, STAGE_LZ77_DECODE, bufferIn.size, sizeOut);
+}
@@ -0,0 +1,329 @@
+/**
+ * \file Memory.c
+ * \brief Arena used to allocate the Huffman trees and tables (freed all at once), and pool of scratch buffers reused between the blocks and the files
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+#if __linux__
+#include <sys/mman.h>
+#endif
+
+
+/**
+ * \def ARENA_ALIGNMENT Alignment of the pointers returned by arenaAlloc
+ */
+
+#define ARENA_ALIGNMENT 16
+
+/**
+ * \def HUGE_PAGE_SIZE Size of a huge page, the buffers at least this large can be backed by huge pages
+ */
+
+#define HUGE_PAGE_SIZE (2*1024*1024)
+
+
+
+/**
+ * \fn void initArena(Arena* arena, size_t chunkSize)
+ * \brief Initializes an empty arena, no memory is allocated before the first call of arenaAlloc
+ * \param arena Arena initialized
+ * \param chunkSize Size of the chunks allocated when the arena is full
+ */
+
+void initArena(Arena* arena, size_t chunkSize)
+{
+    arena->head = NULL;
+    arena->current = NULL;
+    arena->chunkSize = chunkSize;
+}
+
+/**
+ * \fn void* arenaAlloc(Arena* arena, size_t size)
+ * \brief Allocates memory in the arena. It can't be freed alone, it's freed by resetArena or freeArena
+ * \param arena Arena in which the memory is allocated
+ * \param size Number of bytes allocated
+ * \return Pointer to the allocated memory (aligned on ARENA_ALIGNMENT bytes)
+ */
+
+void* arenaAlloc(Arena* arena, size_t size)
+{
+    size = (size+ARENA_ALIGNMENT-1) & ~((size_t) ARENA_ALIGNMENT-1);
+
+    // The chunks after the current one were used before the last reset, they are reused before allocating a new one
+    while(arena->current!=NULL && arena->current->used+size > arena->current->size && arena->current->next!=NULL){
+        arena->current = arena->current->next;
+        arena->current->used = 0;
+    }
+
+    if(arena->current==NULL || arena->current->used+size > arena->current->size){
+        size_t sizeChunk = (size>arena->chunkSize) ? size : arena->chunkSize;
+        ArenaChunk* chunk = (ArenaChunk*) malloc(sizeof(ArenaChunk)+sizeChunk);
+        TESTALLOC(chunk);
+        chunk->size = sizeChunk;
+        chunk->used = 0;
+        chunk->next = NULL;
+        if(arena->current==NULL){
+            chunk->next = arena->head;
+            arena->head = chunk;
+        }
+        else{
+            chunk->next = arena->current->next;
+            arena->current->next = chunk;
+        }
+        arena->current = chunk;
+    }
+
+    void* p = arena->current->data + arena->current->used;
+    arena->current->used += size;
+    return p;
+}
+
+/**
+ * \fn void resetArena(Arena* arena)
+ * \brief Frees everything that was allocated in the arena in O(1). The chunks are kept and reused by the next allocations
+ * \param arena Arena reset
+ */
+
+void resetArena(Arena* arena)
+{
+    arena->current = arena->head;
+    if(arena->current!=NULL)
+        arena->current->used = 0;
+}
+
+/**
+ * \fn void freeArena(Arena* arena)
+ * \brief Gives back to the system the memory of the arena
+ * \param arena Arena freed
+ */
+
+void freeArena(Arena* arena)
+{
+    ArenaChunk* chunk = arena->head;
+    while(chunk!=NULL){
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->current = NULL;
+}
+
+
+
+/**
+ * \fn void initScratchPool(ScratchPool* pool, int hugePages)
+ * \brief Initializes a pool of scratch buffers, no memory is allocated before the first call of scratchGet
+ * \param pool Pool initialized
+ * \param hugePages If 1 then the large buffers are backed by huge pages when the system allows it
+ */
+
+void initScratchPool(ScratchPool* pool, int hugePages)
+{
+    for(int i=0; i<N_SCRATCH_SLOTS; i++){
+        pool->slots[i].data = NULL;
+        pool->slots[i].capacity = 0;
+        pool->slots[i].mapped = 0;
+    }
+    pool->hugePages = hugePages;
+    pool->used = 0;
+    pool->peak = 0;
+    pool->limit = 0;
+}
+
+/**
+ * \fn void setScratchLimit(ScratchPool* pool, size_t limit)
+ * \brief Limits the memory of the buffers of a pool, scratchGet stops the program if a buffer can't be allocated without going over the limit
+ * \param pool Pool
+ * \param limit Largest sum of the sizes of the buffers, 0 for no limit
+ */
+
+void setScratchLimit(ScratchPool* pool, size_t limit)
+{
+    pool->limit = limit;
+}
+
+/**
+ * \fn int scratchFits(ScratchPool* pool, ScratchSlot slot, size_t size)
+ * \brief Checks if the buffer of a slot can have size bytes without going over the limit of the pool, used before the optional buffers
+ * \param pool Pool containing the buffer
+ * \param slot Use of the buffer
+ * \param size Number of bytes needed
+ * \return 1 if scratchGet can give this buffer, 0 otherwise
+ */
+
+int scratchFits(ScratchPool* pool, ScratchSlot slot, size_t size)
+{
+    return pool->limit==0 || pool->slots[slot].capacity>=size || pool->used-pool->slots[slot].capacity+size<=pool->limit;
+}
+
+/**
+ * \fn int scratchFitsAll(ScratchPool* pool, const size_t sizes[N_SCRATCH_SLOTS])
+ * \brief Checks if several buffers of a pool can have the given sizes at the same time without going over its limit, used before the optional steps that need several buffers
+ * \param pool Pool containing the buffers
+ * \param sizes Number of bytes needed in each slot (0 for the slots that aren't used)
+ * \return 1 if scratchGet can give all these buffers, 0 otherwise
+ */
+
+int scratchFitsAll(ScratchPool* pool, const size_t sizes[N_SCRATCH_SLOTS])
+{
+    size_t used = pool->used;
+    if(pool->limit==0)
+        return 1;
+    for(int i=0; i<N_SCRATCH_SLOTS; i++){
+        if(pool->slots[i].capacity<sizes[i])
+            used += sizes[i]-pool->slots[i].capacity;
+    }
+    return used<=pool->limit;
+}
+
+/**
+ * \fn static void releaseScratchBuffer(ScratchPool* pool, ScratchBuffer* buffer)
+ * \brief Frees the memory of a scratch buffer
+ * \param pool Pool containing the buffer
+ * \param buffer Buffer freed
+ */
+
+static void releaseScratchBuffer(ScratchPool* pool, ScratchBuffer* buffer)
+{
+    #if __linux__
+    if(buffer->mapped){
+        munmap(buffer->data, buffer->capacity);
+    }
+    else
+    #endif
+    {
+        free(buffer->data);
+    }
+    pool->used -= buffer->capacity;
+    buffer->data = NULL;
+    buffer->capacity = 0;
+    buffer->mapped = 0;
+}
+
+/**
+ * \fn void* scratchGet(ScratchPool* pool, ScratchSlot slot, size_t size)
+ * \brief Gives the buffer of a slot with at least size bytes. It's only reallocated if it's too small, and its previous content isn't kept in this case
+ * \param pool Pool containing the buffer
+ * \param slot Use of the buffer (2 buffers used at the same time must have different slots)
+ * \param size Number of bytes needed
+ * \return Pointer to the buffer
+ */
+
+void* scratchGet(ScratchPool* pool, ScratchSlot slot, size_t size)
+{
+    ScratchBuffer* buffer = &(pool->slots[slot]);
+    if(size==0)
+        size = 1;
+    if(buffer->capacity>=size)
+        return buffer->data;
+
+    releaseScratchBuffer(pool, buffer);
+    if(pool->limit>0 && pool->used+size>pool->limit){
+        fprintf(stderr, "\nERROR : %llu bytes of memory are needed, the limit given with --max-memory is %llu bytes\n",
+            (unsigned long long) (pool->used+size), (unsigned long long) pool->limit);
+        exit(EXIT_FAILURE);
+    }
+    if(pool->limit==0 || pool->used+size+size/4<=pool->limit)
+        size += size/4; // Some space is added so that a slightly larger block doesn't reallocate the buffer
+
+    #if __linux__
+    if(pool->hugePages && size>=HUGE_PAGE_SIZE && (pool->limit==0 || pool->used+size+HUGE_PAGE_SIZE<=pool->limit)){
+        size = (size+HUGE_PAGE_SIZE-1) & ~((size_t) HUGE_PAGE_SIZE-1);
+        void* p = MAP_FAILED;
+        #ifdef MAP_HUGETLB
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        #endif
+        if(p==MAP_FAILED){ // No reserved huge pages, the kernel may still use transparent huge pages
+            p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            #ifdef MADV_HUGEPAGE
+            if(p!=MAP_FAILED)
+                madvise(p, size, MADV_HUGEPAGE);
+            #endif
+        }
+        if(p!=MAP_FAILED){
+            buffer->data = p;
+            buffer->capacity = size;
+            buffer->mapped = 1;
+            pool->used += size;
+            if(pool->used>pool->peak)
+                pool->peak = pool->used;
+            return buffer->data;
+        }
+    }
+    #endif
+
+    buffer->data = malloc(size);
+    TESTALLOC(buffer->data);
+    buffer->capacity = size;
+    pool->used += size;
+    if(pool->used>pool->peak)
+        pool->peak = pool->used;
+    return buffer->data;
+}
+
+/**
+ * \fn void freeScratchPool(ScratchPool* pool)
+ * \brief Frees all the buffers of a pool
+ * \param pool Pool freed
+ */
+
+void freeScratchPool(ScratchPool* pool)
+{
+    for(int i=0; i<N_SCRATCH_SLOTS; i++)
+        releaseScratchBuffer(pool, &(pool->slots[i]));
+}
+
+
+
+/**
+ * \fn void initPipelineContext(PipelineContext* context, int hugePages)
+ * \brief Initializes the context of the compressions and decompressions (with one thread). The same context can be used for several files so that its memory is reused
+ * \param context Context initialized
+ * \param hugePages If 1 then the large scratch buffers are backed by huge pages when possible
+ */
+
+void initPipelineContext(PipelineContext* context, int hugePages)
+{
+    context->stats = NULL;
+    context->dictionary = NULL;
+    context->nbThreads = 1;
+    context->live = 0;
+    context->adaptive = NULL;
+    context->dedup = NULL;
+    context->archive = NULL;
+    context->previous = NULL;
+    context->chunks = NULL;
+    context->deadline.budgetNs = 0;
+    context->deadline.endNs = 0;
+    context->deadline.bytesLeft = -1;
+    context->deadline.bwtNsPerByte = DEADLINE_BWT_NS_PER_BYTE;
+    context->deadline.codingNsPerByte = DEADLINE_CODING_NS_PER_BYTE;
+    context->deadline.lz77NsPerByte = DEADLINE_LZ77_NS_PER_BYTE;
+    context->lz.window = 0;
+    context->lz.depth = LZ77_DEFAULT_DEPTH;
+    setDefaultTransforms(&(context->transforms));
+    context->chunking.minSize = CHUNK_MIN_SIZE;
+    context->chunking.maskBits = CHUNK_MASK_BITS;
+    context->chunking.maxSize = BLOCK_SIZE;
+    context->chunking.splitMinSize = SPLIT_MIN_SIZE;
+    context->coder = CODER_AUTO;
+    initArena(&(context->arena), ARENA_CHUNK_SIZE);
+    initScratchPool(&(context->scratch), hugePages);
+}
+
+/**
+ * \fn void freePipelineContext(PipelineContext* context)
+ * \brief Frees the memory of a context
+ * \param context Context freed
+ */
+
+void freePipelineContext(PipelineContext* context)
+{
+    freeArena(&(context->arena));
+    freeScratchPool(&(context->scratch));
+}
@@ -45,6 +45,10 @@ int seekChar(unsigned char tab[], int size, unsigned char c)
 
 void shiftCharStart(unsigned char tab[],int size, int index)
 {
+    if(index<0 || index>=size){
+        fprintf(stderr, "ERROR : Incorrect index in shiftCharStart in the function MTF");
+        exit(EXIT_FAILURE);
+    }
     int i=index;
     unsigned char temp=tab[index];
     while(i>0){
@@ -62,22 +66,22 @@ void shiftCharStart(unsigned char tab[],int size, int index)
 
 void moveToFrontEncode(FileBuffer *buffer)
 {
-    int progress=0;
+    Progress progress;
     int index;
+    int endChunk;
     unsigned char tabAscii[N_ASCII];
     for(int i=0; i<N_ASCII; i++){   // int and not unsigned char because in the latter case i would never exceeds N_ASCII-1, so it would be an infinite loop
         tabAscii[i]=i;
     }
-    for(int i=0; i<buffer->size; i++){
-        index = seekChar(tabAscii, N_ASCII, buffer->text[i]);
-        buffer->text[i]=index;
-        shiftCharStart(tabAscii, N_ASCII, index);
-
-        if(progress+5 < 100*(((double)i)/buffer->size))
-        {
-            progress+=5; 
-            printf("%d%%\n", progress); //Displays the progress of the current task
+    progressStart(&progress, "move to front", buffer->size);
+    for(int i=0; i<buffer->size; i=endChunk){
+        endChunk = progressChunkEnd(&progress);
+        for(int j=i; j<endChunk; j++){
+            index = seekChar(tabAscii, N_ASCII, buffer->text[j]);
+            buffer->text[j]=index;
+            shiftCharStart(tabAscii, N_ASCII, index);
         }
+        progressReport(&progress, endChunk);
     }
 }
 
@@ -89,22 +93,22 @@ void moveToFrontEncode(FileBuffer *buffer)
 
 void moveToFrontDecode(FileBuffer *buffer)
 {
-    int progress=0;
+    Progress progress;
+    int endChunk;
     unsigned char c=0;
     unsigned char tabAscii[N_ASCII];
     for(int i=0; i<N_ASCII; i++){
         tabAscii[i]=i;
     }
 
-    for(int i=0; i<buffer->size; i++){
-        c=tabAscii[buffer->text[i]];
-        shiftCharStart(tabAscii, N_ASCII, buffer->text[i]);
-        buffer->text[i]=c;
-
-        if(progress+5 < 100*(((double)i)/buffer->size))
-        {
-            progress+=5; 
-            printf("%d%%\n", progress); //Displays the progress of the current task
+    progressStart(&progress, "move to front decoding", buffer->size);
+    for(int i=0; i<buffer->size; i=endChunk){
+        endChunk = progressChunkEnd(&progress);
+        for(int j=i; j<endChunk; j++){
+            c=tabAscii[buffer->text[j]];
+            shiftCharStart(tabAscii, N_ASCII, buffer->text[j]);
+            buffer->text[j]=c;
         }
+        progressReport(&progress, endChunk);
     }
 }
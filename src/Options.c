@@ -0,0 +1,317 @@
+/**
+ * \file Options.c
+ * \brief Reads the options given in the command line
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+
+/**
+ * \fn void printUsage()
+ * \brief Displays the commands and options that can be given to the program
+ */
+
+void printUsage()
+{
+    fprintf(stderr, "Usage : huffman [options] [compress|decompress] [file...]\n");
+    fprintf(stderr, "        huffman --stream [--latency=MS] compress|decompress\n");
+    fprintf(stderr, "        huffman train dictionary sample...\n");
+    fprintf(stderr, "        huffman archive archive.huf file|folder...\n");
+    fprintf(stderr, "        huffman list archive.huf\n");
+    fprintf(stderr, "        huffman extract archive.huf [file|folder...]\n");
+    fprintf(stderr, "        huffman search PATTERN file.bin|archive.huf...\n");
+    fprintf(stderr, "        huffman daemon SOCKET\n");
+    fprintf(stderr, "        huffman client SOCKET compress|decompress file...\n");
+    fprintf(stderr, "Without compress or decompress, the action is chosen in a menu\n");
+    fprintf(stderr, "train creates a dictionary from the sample files, it's used by compress and decompress with --dict\n");
+    fprintf(stderr, "archive compresses files and folders in parallel in one archive, list displays its files and extract extracts them (or the ones given) in the current folder\n");
+    fprintf(stderr, "search writes the lines of the compressed files containing PATTERN, only the blocks that can contain it are decompressed\n");
+    fprintf(stderr, "daemon compresses and decompresses the files of its clients with its options until it's stopped (Linux only), client asks it to compress or decompress files\n\n");
+    fprintf(stderr, "Options :\n");
+    fprintf(stderr, "  --stats=json   Writes the time, sizes and number of symbols of each stage as a JSON object (nothing else is displayed)\n");
+    fprintf(stderr, "  --stats=text   Displays the time, sizes and number of symbols of each stage at the end\n");
+    fprintf(stderr, "  --quiet        Doesn't display the status messages and the progress\n");
+    fprintf(stderr, "  --perf-counters  Adds the hardware counters of each stage to the measures (Linux only, implies --stats=text if no format is given)\n");
+    fprintf(stderr, "  --dict=FILE    Codes the small blocks with the dictionary FILE (created by train), the same dictionary is needed to decompress\n");
+    fprintf(stderr, "  --max-memory=SIZE  Stops instead of using more than SIZE bytes (K, M or G can be added) for the buffers of the blocks\n");
+    fprintf(stderr, "  --threads=N    Uses at most N threads, or N worker processes for daemon (default : one per processor)\n");
+    fprintf(stderr, "  --stream       Compresses or decompresses the standard input live in the standard output, in one pass\n");
+    fprintf(stderr, "  --latency=MS   Largest time between the reading of a byte of the stream and the writing of its code (default %d ms)\n", STREAM_DEFAULT_LATENCY);
+    fprintf(stderr, "  --update=FILE  Compresses a new version of a file by copying the chunks that didn't change from its previous compressed file FILE\n");
+    fprintf(stderr, "  --deadline=MS  Compresses each file in about MS milliseconds, the blocks use cheaper modes (without Burrows Wheeler, stored) when the time is short\n");
+    fprintf(stderr, "  --lz77         Codes the blocks with repetitions with LZ77 instead of Burrows Wheeler : much faster, a little larger\n");
+    fprintf(stderr, "  --lz-window=SIZE  Largest distance of a match of LZ77, at most the size of a block (default %dK, implies --lz77)\n", LZ77_DEFAULT_WINDOW/1024);
+    fprintf(stderr, "  --lz-depth=N   Number of positions compared by LZ77 to find a match, more is slower and smaller (default %d, implies --lz77)\n", LZ77_DEFAULT_DEPTH);
+    fprintf(stderr, "  --level=N      Compression level from 1 (fastest) to %d (smallest) : size of the blocks, transforms, LZ77 and coder (default %d)\n", LEVEL_MAX, LEVEL_DEFAULT);
+    fprintf(stderr, "  --explain      Displays the settings used (level and options) before compressing, or alone\n");
+    fprintf(stderr, "  --split-min=SIZE  Smallest size of the blocks a chunk is split into when the statistics of its parts are different, 0 to not split them (default : the one of the level)\n");
+    fprintf(stderr, "  --transforms=LIST  Transforms applied in this order to the blocks worth it, before their coding, among bwt, mtf and rle, or none (default : the ones of the level)\n");
+    fprintf(stderr, "  --coder=NAME   Coder of the blocks : auto (the smallest one), huffman (faster), tans or bigram (default : the one of the level)\n");
+    fprintf(stderr, "  --huge-pages   Backs the large buffers with huge pages when the system allows it (Linux only)\n");
+    fprintf(stderr, "  --help         Displays this message\n");
+}
+
+/**
+ * \fn static long long parseMemorySize(const char* text)
+ * \brief Reads a size of memory with an optional suffix K, M or G (powers of 1024)
+ * \param text Text read
+ * \return Size in bytes, -1 if the text is incorrect
+ */
+
+static long long parseMemorySize(const char* text)
+{
+    char* end=NULL;
+    long long size = strtoll(text, &end, 10);
+    if(end==text || size<0)
+        return -1;
+    switch(*end){
+        case 'K' : case 'k' : size *= 1024LL; end++; break;
+        case 'M' : case 'm' : size *= 1024LL*1024; end++; break;
+        case 'G' : case 'g' : size *= 1024LL*1024*1024; end++; break;
+        default : break;
+    }
+    return (*end=='\0') ? size : -1;
+}
+
+/**
+ * \fn void parseOptions(int argc, char* argv[], ProgramOptions* options)
+ * \brief Fills options from the command line. The program is stopped if an option is incorrect
+ * \param argc Number of arguments
+ * \param argv Arguments given to the program
+ * \param options Options filled
+ */
+
+void parseOptions(int argc, char* argv[], ProgramOptions* options)
+{
+    options->mode = MODE_MENU;
+    options->statsFormat = STATS_NONE;
+    options->quiet = 0;
+    options->perfCounters = 0;
+    options->hugePages = 0;
+    options->maxMemory = 0;
+    options->dictionary = NULL;
+    options->nbThreads = 0;
+    options->stream = 0;
+    options->latency = STREAM_DEFAULT_LATENCY;
+    options->update = NULL;
+    options->deadline = 0;
+    options->explain = 0;
+    options->fileNames = (char**) malloc(argc*sizeof(char*));
+    TESTALLOC(options->fileNames);
+    options->nbFiles = 0;
+
+    int level = LEVEL_DEFAULT;
+    for(int i=1; i<argc; i++){ // The level is read first, the other options change its settings
+        if(!strncmp(argv[i], "--level=", 8)){
+            char* end=NULL;
+            level = strtol(argv[i]+8, &end, 10);
+            if(end==argv[i]+8 || *end!='\0' || level<1 || level>LEVEL_MAX){
+                fprintf(stderr, "ERROR : Incorrect level %s (between 1 and %d)\n\n", argv[i]+8, LEVEL_MAX);
+                printUsage();
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    applyLevel(level, options);
+
+    for(int i=1; i<argc; i++){
+        if(!strcmp(argv[i], "--stats=json")){
+            options->statsFormat = STATS_JSON;
+        }
+        else if(!strcmp(argv[i], "--stats=text") || !strcmp(argv[i], "--stats")){
+            options->statsFormat = STATS_TEXT;
+        }
+        else if(!strcmp(argv[i], "--perf-counters")){
+            options->perfCounters = 1;
+        }
+        else if(!strncmp(argv[i], "--dict=", 7)){
+            options->dictionary = argv[i]+7;
+        }
+        else if(!strncmp(argv[i], "--max-memory=", 13)){
+            options->maxMemory = parseMemorySize(argv[i]+13);
+            if(options->maxMemory<=0){
+                fprintf(stderr, "ERROR : Incorrect size of memory %s\n\n", argv[i]+13);
+                printUsage();
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if(!strncmp(argv[i], "--threads=", 10)){
+            char* end=NULL;
+            options->nbThreads = strtol(argv[i]+10, &end, 10);
+            if(end==argv[i]+10 || *end!='\0' || options->nbThreads<1){
+                fprintf(stderr, "ERROR : Incorrect number of threads %s\n\n", argv[i]+10);
+                printUsage();
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if(!strncmp(argv[i], "--update=", 9)){
+            options->update = argv[i]+9;
+        }
+        else if(!strncmp(argv[i], "--deadline=", 11)){
+            char* end=NULL;
+            options->deadline = strtol(argv[i]+11, &end, 10);
+            if(end==argv[i]+11 || *end!='\0' || options->deadline<1){
+                fprintf(stderr, "ERROR : Incorrect deadline %s\n\n", argv[i]+11);
+                printUsage();
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if(!strcmp(argv[i], "--lz77")){
+            if(options->lzWindow==0)
+                options->lzWindow = LZ77_DEFAULT_WINDOW;
+        }
+        else if(!strncmp(argv[i], "--lz-window=", 12)){
+            long long window = parseMemorySize(argv[i]+12);
+            if(window<=0 || window>BLOCK_SIZE){
+                fprintf(stderr, "ERROR : Incorrect window %s (at most %dK)\n\n", argv[i]+12, BLOCK_SIZE/1024);
+                printUsage();
+                exit(EXIT_FAILURE);
+            }
+            options->lzWindow = window;
+        }
+        else if(!strncmp(argv[i], "--lz-depth=", 11)){
+            char* end=NULL;
+            options->lzDepth = strtol(argv[i]+11, &end, 10);
+            if(end==argv[i]+11 || *end!='\0' || options->lzDepth<1){
+                fprintf(stderr, "ERROR : Incorrect depth %s\n\n", argv[i]+11);
+                printUsage();
+                exit(EXIT_FAILURE);
+            }
+            if(options->lzWindow==0)
+                options->lzWindow = LZ77_DEFAULT_WINDOW;
+        }
+        else if(!strncmp(argv[i], "--split-min=", 12)){
+            long long size = parseMemorySize(argv[i]+12);
+            if(size<0 || (size>0 && size<SPLIT_STEP) || size>BLOCK_SIZE/2){
+                fprintf(stderr, "ERROR : Incorrect size %s (0, or from %dK to %dK)\n\n", argv[i]+12, SPLIT_STEP/1024, BLOCK_SIZE/2048);
+                printUsage();
+                exit(EXIT_FAILURE);
+            }
+            options->chunking.splitMinSize = size;
+        }
+        else if(!strncmp(argv[i], "--transforms=", 13)){
+            if(!parseTransforms(argv[i]+13, &(options->transforms))){
+                fprintf(stderr, "ERROR : Incorrect list of transforms %s (at most %d among bwt, mtf and rle, or none)\n\n", argv[i]+13, TRANSFORM_MAX_CHAIN);
+                printUsage();
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if(!strncmp(argv[i], "--level=", 8)){
+            // Already read
+        }
+        else if(!strcmp(argv[i], "--coder=auto")){
+            options->coder = CODER_AUTO;
+        }
+        else if(!strcmp(argv[i], "--coder=huffman")){
+            options->coder = CODER_HUFFMAN;
+        }
+        else if(!strcmp(argv[i], "--coder=tans")){
+            options->coder = CODER_TANS;
+        }
+        else if(!strcmp(argv[i], "--coder=bigram")){
+            options->coder = CODER_BIGRAM;
+        }
+        else if(!strcmp(argv[i], "--explain")){
+            options->explain = 1;
+        }
+        else if(!strcmp(argv[i], "--stream")){
+            options->stream = 1;
+        }
+        else if(!strncmp(argv[i], "--latency=", 10)){
+            char* end=NULL;
+            options->latency = strtol(argv[i]+10, &end, 10);
+            if(end==argv[i]+10 || *end!='\0' || options->latency<0){
+                fprintf(stderr, "ERROR : Incorrect latency %s\n\n", argv[i]+10);
+                printUsage();
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if(!strcmp(argv[i], "--huge-pages")){
+            options->hugePages = 1;
+        }
+        else if(!strcmp(argv[i], "--quiet") || !strcmp(argv[i], "-q")){
+            options->quiet = 1;
+        }
+        else if(!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")){
+            printUsage();
+            exit(EXIT_SUCCESS);
+        }
+        else if(!strncmp(argv[i], "--", 2)){
+            fprintf(stderr, "ERROR : Unknown option %s\n\n", argv[i]);
+            printUsage();
+            exit(EXIT_FAILURE);
+        }
+        else if(options->mode==MODE_MENU && options->nbFiles==0 && !strcmp(argv[i], "compress")){
+            options->mode = MODE_COMPRESS;
+        }
+        else if(options->mode==MODE_MENU && options->nbFiles==0 && !strcmp(argv[i], "decompress")){
+            options->mode = MODE_DECOMPRESS;
+        }
+        else if(options->mode==MODE_MENU && options->nbFiles==0 && !strcmp(argv[i], "train")){
+            options->mode = MODE_TRAIN;
+        }
+        else if(options->mode==MODE_MENU && options->nbFiles==0 && !strcmp(argv[i], "archive")){
+            options->mode = MODE_ARCHIVE;
+        }
+        else if(options->mode==MODE_MENU && options->nbFiles==0 && !strcmp(argv[i], "list")){
+            options->mode = MODE_LIST;
+        }
+        else if(options->mode==MODE_MENU && options->nbFiles==0 && !strcmp(argv[i], "extract")){
+            options->mode = MODE_EXTRACT;
+        }
+        else if(options->mode==MODE_MENU && options->nbFiles==0 && !strcmp(argv[i], "search")){
+            options->mode = MODE_SEARCH;
+        }
+        else if(options->mode==MODE_MENU && options->nbFiles==0 && !strcmp(argv[i], "daemon")){
+            options->mode = MODE_DAEMON;
+        }
+        else if(options->mode==MODE_MENU && options->nbFiles==0 && !strcmp(argv[i], "client")){
+            options->mode = MODE_CLIENT;
+        }
+        else if((options->mode!=MODE_MENU || options->nbFiles==0) && strlen(argv[i])<FILENAME_MAX){ // If the size of the string is correct to get copied in fileNameIn
+            options->fileNames[options->nbFiles++] = argv[i];
+        }
+        else{
+            fprintf(stderr, "ERROR : Unexpected argument %s\n\n", argv[i]);
+            printUsage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(options->mode==MODE_TRAIN && options->nbFiles<2){
+        fprintf(stderr, "ERROR : train needs the name of the dictionary and at least one sample file\n\n");
+        printUsage();
+        exit(EXIT_FAILURE);
+    }
+    if((options->mode==MODE_ARCHIVE && options->nbFiles<2) || (options->mode==MODE_LIST && options->nbFiles!=1) || (options->mode==MODE_EXTRACT && options->nbFiles<1)){
+        fprintf(stderr, "ERROR : archive needs the name of the archive and at least one file, list and extract need the name of the archive\n\n");
+        printUsage();
+        exit(EXIT_FAILURE);
+    }
+    if(options->mode==MODE_SEARCH && options->nbFiles<2){
+        fprintf(stderr, "ERROR : search needs the pattern and at least one compressed file\n\n");
+        printUsage();
+        exit(EXIT_FAILURE);
+    }
+    if((options->mode==MODE_DAEMON && options->nbFiles!=1) || (options->mode==MODE_CLIENT && (options->nbFiles<3 || (strcmp(options->fileNames[1], "compress") && strcmp(options->fileNames[1], "decompress"))))){
+        fprintf(stderr, "ERROR : daemon needs the name of its socket, client needs the name of the socket, compress or decompress and at least one file\n\n");
+        printUsage();
+        exit(EXIT_FAILURE);
+    }
+    if(options->stream && ((options->mode!=MODE_COMPRESS && options->mode!=MODE_DECOMPRESS) || options->nbFiles>0)){
+        fprintf(stderr, "ERROR : --stream needs compress or decompress and no file name\n\n");
+        printUsage();
+        exit(EXIT_FAILURE);
+    }
+    if(options->update!=NULL && (options->mode!=MODE_COMPRESS || options->nbFiles!=1 || options->stream)){
+        fprintf(stderr, "ERROR : --update needs compress and one file name\n\n");
+        printUsage();
+        exit(EXIT_FAILURE);
+    }
+    if(options->perfCounters && options->statsFormat==STATS_NONE)
+        options->statsFormat = STATS_TEXT;
+    if(options->statsFormat==STATS_JSON || options->stream || options->mode==MODE_SEARCH) // The standard output is used by the JSON object, by the data or by the lines found
+        options->quiet = 1;
+}
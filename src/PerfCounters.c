@@ -0,0 +1,174 @@
+/**
+ * \file PerfCounters.c
+ * \brief Reads the hardware performance counters (cycles, instructions, branch and cache misses) with perf_event_open. Only available on Linux, elsewhere the counters are reported as unavailable
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+#if __linux__
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+
+static int perfFds[N_PERF_EVENTS]; // File descriptors of the opened counters, -1 if the event can't be counted
+static int perfOpened = 0; // 1 if openPerfCounters was called
+static int perfAvailable = 0; // Number of events that can be counted
+static char perfError[128] = "not opened"; // Reason why the counters aren't available
+
+static const char* perfEventNames[N_PERF_EVENTS] = {"cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses", "dtlb_misses"};
+
+
+
+/**
+ * \fn const char* perfEventName(PerfEvent event)
+ * \brief Gives the name of a hardware event, used in the reports
+ * \param event Event
+ * \return Name of the event
+ */
+
+const char* perfEventName(PerfEvent event)
+{
+    return perfEventNames[event];
+}
+
+#if __linux__
+/**
+ * \fn static int openPerfEvent(unsigned int type, unsigned long long config)
+ * \brief Opens one counter for the current process (and the threads it creates), only the user space is counted so that it works without privileges
+ * \param type Type of the event (PERF_TYPE_HARDWARE or PERF_TYPE_HW_CACHE)
+ * \param config Event of this type
+ * \return File descriptor of the counter, -1 if it can't be opened
+ */
+
+static int openPerfEvent(unsigned int type, unsigned long long config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 0;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * \fn static unsigned long long cacheEvent(unsigned long long cache, unsigned long long op, unsigned long long result)
+ * \brief Builds the configuration of a cache event
+ * \return Configuration given to perf_event_open
+ */
+
+static unsigned long long cacheEvent(unsigned long long cache, unsigned long long op, unsigned long long result)
+{
+    return cache | (op << 8) | (result << 16);
+}
+#endif
+
+/**
+ * \fn int openPerfCounters()
+ * \brief Opens the counters of all the events. The events that can't be counted (because of the hardware, of the virtualization or of perf_event_paranoid) are ignored
+ * \return Number of events that can be counted
+ */
+
+int openPerfCounters()
+{
+    if(perfOpened)
+        return perfAvailable;
+    perfOpened = 1;
+    perfAvailable = 0;
+    for(int i=0; i<N_PERF_EVENTS; i++)
+        perfFds[i] = -1;
+
+    #if __linux__
+    int lastErrno = 0;
+    perfFds[PERF_CYCLES] = openPerfEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    if(perfFds[PERF_CYCLES]<0) lastErrno = errno;
+    perfFds[PERF_INSTRUCTIONS] = openPerfEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    if(perfFds[PERF_INSTRUCTIONS]<0) lastErrno = errno;
+    perfFds[PERF_BRANCH_MISSES] = openPerfEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    if(perfFds[PERF_BRANCH_MISSES]<0) lastErrno = errno;
+    perfFds[PERF_L1D_MISSES] = openPerfEvent(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    if(perfFds[PERF_L1D_MISSES]<0) lastErrno = errno;
+    perfFds[PERF_LLC_MISSES] = openPerfEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    if(perfFds[PERF_LLC_MISSES]<0) lastErrno = errno;
+    perfFds[PERF_DTLB_MISSES] = openPerfEvent(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+    if(perfFds[PERF_DTLB_MISSES]<0) lastErrno = errno;
+
+    for(int i=0; i<N_PERF_EVENTS; i++){
+        if(perfFds[i]>=0)
+            perfAvailable++;
+    }
+    if(perfAvailable==N_PERF_EVENTS)
+        perfError[0] = '\0';
+    else if(lastErrno==EACCES || lastErrno==EPERM)
+        snprintf(perfError, sizeof(perfError), "%s (see /proc/sys/kernel/perf_event_paranoid)", strerror(lastErrno));
+    else if(lastErrno==ENOENT || lastErrno==EOPNOTSUPP || lastErrno==ENODEV) // No such event on this processor, or no counters at all (virtual machines)
+        snprintf(perfError, sizeof(perfError), "hardware counters not available on this machine");
+    else
+        snprintf(perfError, sizeof(perfError), "%s", strerror(lastErrno));
+    #else
+    snprintf(perfError, sizeof(perfError), "perf_event_open is only available on Linux");
+    #endif
+
+    return perfAvailable;
+}
+
+/**
+ * \fn void closePerfCounters()
+ * \brief Closes the counters opened by openPerfCounters
+ */
+
+void closePerfCounters()
+{
+    #if __linux__
+    for(int i=0; i<N_PERF_EVENTS && perfOpened; i++){
+        if(perfFds[i]>=0)
+            close(perfFds[i]);
+        perfFds[i] = -1;
+    }
+    #endif
+    perfOpened = 0;
+    perfAvailable = 0;
+}
+
+/**
+ * \fn const char* perfCountersError()
+ * \brief Gives the reason why some counters aren't available
+ * \return Description of the error, empty if all the counters are available
+ */
+
+const char* perfCountersError()
+{
+    return perfError;
+}
+
+/**
+ * \fn void readPerfCounters(long long values[N_PERF_EVENTS])
+ * \brief Reads the current value of each counter. If the counters were multiplexed by the kernel the value is scaled to the whole time
+ * \param values Values read, -1 for the events that can't be counted
+ */
+
+void readPerfCounters(long long values[N_PERF_EVENTS])
+{
+    for(int i=0; i<N_PERF_EVENTS; i++){
+        values[i] = -1;
+        #if __linux__
+        unsigned long long data[3]; // value, time enabled, time running
+        if(perfFds[i]>=0 && read(perfFds[i], data, sizeof(data))==sizeof(data)){
+            if(data[2]>0 && data[2]<data[1])
+                values[i] = (long long) ((double) data[0]*data[1]/data[2]);
+            else
+                values[i] = data[0];
+        }
+        #endif
+    }
+}
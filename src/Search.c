@@ -0,0 +1,574 @@
+/**
+ * \file Search.c
+ * \brief Search of a pattern in compressed files and archives without decompressing all of them : the header of each block gives the map of its characters, so only the blocks that can contain the pattern (or a part of it at one of their ends) are decoded, in parallel, and the lines containing the pattern are written like grep
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+
+/**
+ * \fn static const unsigned char* findPattern(const unsigned char* text, size_t size, const unsigned char* pattern, int sizePattern)
+ * \brief Looks for the first occurrence of a pattern in a text
+ * \param text Text read
+ * \param size Size of the text
+ * \param pattern Pattern looked for
+ * \param sizePattern Size of the pattern (at least 1)
+ * \return Beginning of the first occurrence, NULL if there isn't any
+ */
+
+static const unsigned char* findPattern(const unsigned char* text, size_t size, const unsigned char* pattern, int sizePattern)
+{
+    const unsigned char* end = text+size;
+    while(end-text>=sizePattern && (text=(const unsigned char*) memchr(text, pattern[0], end-text-sizePattern+1))!=NULL){
+        if(!memcmp(text+1, pattern+1, sizePattern-1))
+            return text;
+        text++;
+    }
+    return NULL;
+}
+
+/**
+ * \fn static int mapContains(const SearchBlock* block, const unsigned char* pattern, int start, int end)
+ * \brief Checks if all the characters of a part of the pattern are in the map of a block
+ * \param block Block
+ * \param pattern Pattern
+ * \param start Beginning of the part of the pattern
+ * \param end End of the part of the pattern (excluded)
+ * \return 1 if they are all in the map or if the block has no map, 0 otherwise
+ */
+
+static int mapContains(const SearchBlock* block, const unsigned char* pattern, int start, int end)
+{
+    if(!block->hasMap)
+        return 1;
+    for(int i=start; i<end; i++){
+        if(!(block->map[pattern[i]/8] & (1 << (pattern[i]%8))))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * \fn static int readSearchBlocks(FILE* fileIn, long long offset, SearchBlock** blocks)
+ * \brief Reads the headers (and the maps) of all the blocks of a compressed file, without their data
+ * \param fileIn Compressed file or archive
+ * \param offset Position of the compressed file in fileIn
+ * \param blocks Array of the blocks, allocated here
+ * \return Number of blocks
+ */
+
+static int readSearchBlocks(FILE* fileIn, long long offset, SearchBlock** blocks)
+{
+    unsigned char header[BLOCK_HEADER_SIZE];
+    int nbBlocks=0;
+    int capacity=0;
+
+    *blocks = NULL;
+    fileSeek(fileIn, offset, SEEK_SET);
+    if(fread(header, sizeof(unsigned char), 5, fileIn)!=5 || memcmp(header, CONTAINER_MAGIC, 4)
+        || (header[4] & ~CONTAINER_INDEX_FLAG)<1 || (header[4] & ~CONTAINER_INDEX_FLAG)>CONTAINER_VERSION){
+        fprintf(stderr, "\nERROR : The file wasn't compressed by this version of the program\n");
+        exit(EXIT_FAILURE);
+    }
+    offset += 5;
+    while(1){
+        if(fread(header, sizeof(unsigned char), 1, fileIn)!=1){
+            fprintf(stderr, "\nERROR : The compressed file is truncated\n");
+            exit(EXIT_FAILURE);
+        }
+        if(header[0]==BLOCK_END)
+            return nbBlocks;
+        if(nbBlocks==capacity){
+            capacity = (capacity>0) ? 2*capacity : 64;
+            *blocks = (SearchBlock*) realloc(*blocks, capacity*sizeof(SearchBlock));
+            TESTALLOC(*blocks);
+        }
+
+        SearchBlock* block = &((*blocks)[nbBlocks++]);
+        if(fread(header+1, sizeof(unsigned char), BLOCK_HEADER_SIZE-1, fileIn)!=BLOCK_HEADER_SIZE-1){
+            fprintf(stderr, "\nERROR : The compressed file is truncated\n");
+            exit(EXIT_FAILURE);
+        }
+        block->offset = offset;
+        block->mode = header[0] & ~BLOCK_MAP_FLAG;
+        block->hasMap = (header[0] & BLOCK_MAP_FLAG)!=0;
+        block->sizeOut = readNumber(header+1, 4);
+        block->sizeCoded = readNumber(header+5, 4);
+        block->selected = 0;
+        block->text.text = NULL;
+        block->text.size = 0;
+        if(block->mode>=N_BLOCK_MODES || block->sizeOut>BLOCK_SIZE || block->sizeCoded>4+N_ASCII*BLOCK_SIZE/8 || (block->hasMap && block->sizeCoded<BLOCK_MAP_SIZE)){
+            fprintf(stderr, "\nERROR : The compressed file is corrupted\n");
+            exit(EXIT_FAILURE);
+        }
+        if(block->hasMap && fread(block->map, sizeof(unsigned char), BLOCK_MAP_SIZE, fileIn)!=BLOCK_MAP_SIZE){
+            fprintf(stderr, "\nERROR : The compressed file is truncated\n");
+            exit(EXIT_FAILURE);
+        }
+        offset += BLOCK_HEADER_SIZE+block->sizeCoded;
+        fileSeek(fileIn, offset, SEEK_SET);
+    }
+}
+
+/**
+ * \fn static void selectBlocks(SearchJob* job)
+ * \brief Selects the blocks that have to be decoded : the ones whose map contains all the characters of the pattern, and the pairs of consecutive blocks whose maps contain the beginning and the end of the pattern (an occurrence can be cut between them). All the blocks are decoded if there are blocks of a live stream (which depend on the previous ones) or if the pattern is longer than a block between two others
+ * \param job Search, with the blocks of the compressed file
+ */
+
+static void selectBlocks(SearchJob* job)
+{
+    const unsigned char* pattern = job->pattern;
+    int sizePattern = job->sizePattern;
+    int all=0;
+
+    for(int i=0; i<job->nbBlocks; i++){
+        SearchBlock* block = &(job->blocks[i]);
+        block->selected = mapContains(block, pattern, 0, sizePattern);
+        if(block->mode==BLOCK_ADAPTIVE || (i>0 && i<job->nbBlocks-1 && block->sizeOut<sizePattern))
+            all = 1;
+    }
+    for(int i=0; i+1<job->nbBlocks; i++){
+        // Longest beginning of the pattern in the first block, and earliest end of it in the second one
+        int prefix=0;
+        while(prefix<sizePattern-1 && mapContains(&(job->blocks[i]), pattern, prefix, prefix+1))
+            prefix++;
+        int suffix=sizePattern;
+        while(suffix>1 && mapContains(&(job->blocks[i+1]), pattern, suffix-1, suffix))
+            suffix--;
+        if(suffix<=prefix){
+            job->blocks[i].selected = 1;
+            job->blocks[i+1].selected = 1;
+        }
+    }
+    for(int i=0; i<job->nbBlocks && all; i++)
+        job->blocks[i].selected = 1;
+}
+
+/**
+ * \fn static void decodeSearchBlock(SearchJob* job, int index, int worker, FileBuffer* text)
+ * \brief Reads and decodes a block in memory
+ * \param job Search
+ * \param index Index of the block
+ * \param worker Thread decoding the block (index of its context and of its file)
+ * \param text Buffer in which the block is decoded, allocated here
+ */
+
+static void decodeSearchBlock(SearchJob* job, int index, int worker, FileBuffer* text)
+{
+    SearchBlock* block = &(job->blocks[index]);
+    PipelineContext* context = &(job->contexts[worker]);
+    FileBuffer bufferIn;
+    AsyncFile output;
+
+    bufferIn.size = block->sizeCoded;
+    bufferIn.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_CODED, bufferIn.size);
+    fileSeek(job->files[worker], block->offset+BLOCK_HEADER_SIZE, SEEK_SET);
+    if(fread(bufferIn.text, sizeof(unsigned char), bufferIn.size, job->files[worker])!=(size_t) bufferIn.size){
+        fprintf(stderr, "\nERROR : The compressed file is truncated\n");
+        exit(EXIT_FAILURE);
+    }
+    text->text = (unsigned char*) malloc((block->sizeOut>0) ? block->sizeOut : 1);
+    TESTALLOC(text->text);
+    asyncOpenMemory(&output, text, block->sizeOut);
+    decompressBlock(block->mode | (block->hasMap ? BLOCK_MAP_FLAG : 0), bufferIn, block->sizeOut, &output, context);
+    if(!asyncClose(&output) || text->size!=block->sizeOut){
+        fprintf(stderr, "\nERROR : The compressed file is corrupted\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * \fn static void* decodeWindow(void* argument)
+ * \brief Thread of the search : decodes the next selected blocks of the window until they are all taken
+ * \param argument SearchJob
+ * \return NULL
+ */
+
+static void* decodeWindow(void* argument)
+{
+    SearchJob* job = (SearchJob*) argument;
+    pthread_mutex_lock(&(job->mutex));
+    int worker = job->nextWorker++;
+    while(1){
+        while(job->next<job->end && !job->blocks[job->next].selected)
+            job->next++;
+        if(job->next==job->end)
+            break;
+        int index = job->next++;
+        pthread_mutex_unlock(&(job->mutex));
+        decodeSearchBlock(job, index, worker, &(job->blocks[index].text));
+        pthread_mutex_lock(&(job->mutex));
+    }
+    pthread_mutex_unlock(&(job->mutex));
+    return NULL;
+}
+
+/**
+ * \fn static int patternAcross(SearchJob* job, const unsigned char* first, size_t sizeFirst, const unsigned char* second, size_t sizeSecond)
+ * \brief Checks if an occurrence of the pattern begins at the end of a text and ends at the beginning of the text following it
+ * \param job Search
+ * \param first First text
+ * \param sizeFirst Size of the first text
+ * \param second Text following the first one
+ * \param sizeSecond Size of the second text
+ * \return 1 if there is such an occurrence, 0 otherwise
+ */
+
+static int patternAcross(SearchJob* job, const unsigned char* first, size_t sizeFirst, const unsigned char* second, size_t sizeSecond)
+{
+    int sizePattern = job->sizePattern;
+    for(int i=1; i<sizePattern; i++){ // i characters of the pattern in the first text
+        if((size_t) i<=sizeFirst && (size_t) (sizePattern-i)<=sizeSecond
+            && !memcmp(first+sizeFirst-i, job->pattern, i) && !memcmp(second, job->pattern+i, sizePattern-i))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * \fn static void resetLine(SearchJob* job)
+ * \brief Empties the current line, the next one begins
+ * \param job Search
+ */
+
+static void resetLine(SearchJob* job)
+{
+    job->line.size = 0;
+    job->lineTooLong = 0;
+    job->lineFound = 0;
+}
+
+/**
+ * \fn static void addToLine(SearchJob* job, const unsigned char* text, size_t size)
+ * \brief Adds a part at the end of the current line and looks for the pattern in it (and across the end of the line). Past SEARCH_MAX_LINE bytes, only the end of the line is kept, to find an occurrence cut between this part and the next one
+ * \param job Search
+ * \param text Part added
+ * \param size Size of the part
+ */
+
+static void addToLine(SearchJob* job, const unsigned char* text, size_t size)
+{
+    FileBuffer* line = &(job->line);
+    size_t overlap = job->sizePattern-1;
+
+    if(!job->lineFound)
+        job->lineFound = patternAcross(job, line->text, line->size, text, size) || findPattern(text, size, job->pattern, job->sizePattern)!=NULL;
+    if(!job->lineTooLong && line->size+size<=SEARCH_MAX_LINE){
+        memcpy(line->text+line->size, text, size);
+        line->size += size;
+        return;
+    }
+    job->lineTooLong = 1;
+    size_t added = (size<overlap) ? size : overlap;
+    size_t kept = ((size_t) line->size<overlap-added) ? (size_t) line->size : overlap-added;
+    memmove(line->text, line->text+line->size-kept, kept);
+    memcpy(line->text+kept, text+size-added, added);
+    line->size = kept+added;
+}
+
+/**
+ * \fn static void writeLine(SearchJob* job, const unsigned char* text, size_t size)
+ * \brief Writes a line containing the pattern, after the label of the file. A line longer than SEARCH_MAX_LINE bytes is replaced by a message
+ * \param job Search
+ * \param text Line (without its line break), NULL if it's longer than SEARCH_MAX_LINE bytes
+ * \param size Size of the line
+ */
+
+static void writeLine(SearchJob* job, const unsigned char* text, size_t size)
+{
+    if(job->label!=NULL)
+        printf("%s:", job->label);
+    if(text!=NULL && size<=SEARCH_MAX_LINE)
+        fwrite(text, sizeof(unsigned char), size, stdout);
+    else
+        printf("[line of more than %d bytes omitted]", SEARCH_MAX_LINE);
+    putchar('\n');
+    job->nbFound++;
+}
+
+/**
+ * \fn static void readLineBeginning(SearchJob* job, int index)
+ * \brief Puts in the current line (empty) its beginning, read in the blocks before a block that wasn't preceded by a decoded block. They are decoded by the main thread until a line break is found, or until the line is known to be longer than SEARCH_MAX_LINE bytes. Their parts are written from the end of the line buffer backwards, then moved once at its beginning
+ * \param job Search
+ * \param index Block whose first line contains the pattern
+ */
+
+static void readLineBeginning(SearchJob* job, int index)
+{
+    size_t sizeRead = 0;
+    for(int i=index-1; i>=0; i--){
+        FileBuffer text;
+        decodeSearchBlock(job, i, 0, &text);
+        const unsigned char* begin = text.text+text.size;
+        while(begin>text.text && begin[-1]!='\n')
+            begin--;
+        size_t sizePart = text.text+text.size-begin;
+        int lineBreak = begin>text.text;
+        if(sizeRead+sizePart>SEARCH_MAX_LINE){
+            free(text.text);
+            job->line.size = 0;
+            job->lineTooLong = 1;
+            return;
+        }
+        sizeRead += sizePart;
+        memcpy(job->line.text+SEARCH_MAX_LINE-sizeRead, begin, sizePart);
+        free(text.text);
+        if(lineBreak)
+            break;
+    }
+    memmove(job->line.text, job->line.text+SEARCH_MAX_LINE-sizeRead, sizeRead);
+    job->line.size = sizeRead;
+}
+
+/**
+ * \fn static void searchBlock(SearchJob* job, int index)
+ * \brief Looks for the pattern in a decoded block and writes the lines containing it. The end of the block after its last line break is kept as the beginning of the next line. A block that wasn't decoded ends the current line, unless it contains the pattern : then the block is decoded to find the end of the line
+ * \param job Search
+ * \param index Index of the block
+ */
+
+static void searchBlock(SearchJob* job, int index)
+{
+    SearchBlock* block = &(job->blocks[index]);
+    int sizePattern = job->sizePattern;
+
+    if(block->text.text==NULL){
+        if(!job->lineFound){ // The next line begins in a block that isn't decoded
+            resetLine(job);
+            job->lineKnown = 0;
+            return;
+        }
+        decodeSearchBlock(job, index, 0, &(block->text));
+    }
+    const unsigned char* text = block->text.text;
+    const unsigned char* end = text+block->text.size;
+    const unsigned char* firstBreak = (const unsigned char*) memchr(text, '\n', end-text);
+    const unsigned char* endFirst = (firstBreak!=NULL) ? firstBreak : end;
+
+    // End of the current line
+    if(job->lineKnown)
+        addToLine(job, text, endFirst-text);
+    else if(findPattern(text, endFirst-text, job->pattern, sizePattern)!=NULL){
+        resetLine(job);
+        readLineBeginning(job, index);
+        addToLine(job, text, endFirst-text);
+        job->lineKnown = 1;
+    }
+    if(firstBreak==NULL)
+        return;
+    if(job->lineFound)
+        writeLine(job, job->lineTooLong ? NULL : job->line.text, job->line.size);
+
+    // Complete lines of the block
+    const unsigned char* lastBreak = end;
+    while(lastBreak[-1]!='\n')
+        lastBreak--;
+    const unsigned char* position = firstBreak+1;
+    const unsigned char* found;
+    while(position<lastBreak && (found=findPattern(position, lastBreak-position, job->pattern, sizePattern))!=NULL){
+        const unsigned char* begin = found;
+        while(begin>position && begin[-1]!='\n')
+            begin--;
+        const unsigned char* endLine = (const unsigned char*) memchr(found, '\n', lastBreak-found);
+        writeLine(job, begin, endLine-begin);
+        position = endLine+1;
+    }
+
+    // Beginning of the next line
+    resetLine(job);
+    addToLine(job, lastBreak, end-lastBreak);
+    job->lineKnown = 1;
+}
+
+/**
+ * \fn static void searchCompressedFile(SearchJob* job, long long offset)
+ * \brief Searches the pattern in a compressed file, window by window : the selected blocks of a window are decoded by the threads, then searched in order by the main thread and freed
+ * \param job Search, whose files are opened
+ * \param offset Position of the compressed file in the files of the job
+ */
+
+static void searchCompressedFile(SearchJob* job, long long offset)
+{
+    AdaptiveModel adaptive; // Codes of the blocks of a live stream, which are all decoded in order by the main thread
+
+    job->nbBlocks = readSearchBlocks(job->files[0], offset, &(job->blocks));
+    selectBlocks(job);
+    resetLine(job);
+    job->lineKnown = 1;
+    initAdaptiveModel(&adaptive);
+    job->contexts[0].adaptive = &adaptive;
+    int nbWorkers = job->nbWorkers;
+    for(int i=0; i<job->nbBlocks; i++){
+        if(job->blocks[i].mode==BLOCK_ADAPTIVE)
+            nbWorkers = 1;
+    }
+
+    for(int first=0; first<job->nbBlocks; first=job->end){
+        job->next = first;
+        job->end = (job->nbBlocks-first>nbWorkers*SEARCH_BLOCKS_PER_THREAD) ? first+nbWorkers*SEARCH_BLOCKS_PER_THREAD : job->nbBlocks;
+        job->nextWorker = 0;
+        pthread_t threads[nbWorkers];
+        int created[nbWorkers];
+        for(int t=1; t<nbWorkers; t++)
+            created[t] = pthread_create(&threads[t], NULL, decodeWindow, job)==0;
+        decodeWindow(job);
+        for(int t=1; t<nbWorkers; t++){
+            if(created[t])
+                pthread_join(threads[t], NULL);
+        }
+
+        for(int i=first; i<job->end; i++){
+            SearchBlock* block = &(job->blocks[i]);
+            searchBlock(job, i);
+            if(job->stats!=NULL){
+                if(block->text.text!=NULL)
+                    job->stats->blocks[block->mode]++;
+                else
+                    job->stats->skipped++;
+            }
+            free(block->text.text);
+            block->text.text = NULL;
+        }
+    }
+    if(job->lineFound) // Last line, without a line break
+        writeLine(job, job->lineTooLong ? NULL : job->line.text, job->line.size);
+
+    freeAdaptiveModel(&adaptive);
+    job->contexts[0].adaptive = NULL;
+    free(job->blocks);
+    job->blocks = NULL;
+}
+
+/**
+ * \fn static void openSearchFiles(SearchJob* job, const char* fileName, int archive)
+ * \brief Opens a compressed file or an archive for each thread of the search (twice for an archive, to read the blocks referred to by the references)
+ * \param job Search
+ * \param fileName Name of the file
+ * \param archive 1 if it's an archive
+ */
+
+static void openSearchFiles(SearchJob* job, const char* fileName, int archive)
+{
+    for(int i=0; i<job->nbWorkers; i++){
+        job->files[i] = fopen(fileName, "rb");
+        TESTFOPEN(job->files[i]);
+        if(archive){
+            job->contexts[i].archive = fopen(fileName, "rb");
+            TESTFOPEN(job->contexts[i].archive);
+        }
+    }
+}
+
+/**
+ * \fn static void closeSearchFiles(SearchJob* job)
+ * \brief Closes the files opened by openSearchFiles
+ * \param job Search
+ */
+
+static void closeSearchFiles(SearchJob* job)
+{
+    for(int i=0; i<job->nbWorkers; i++){
+        FCLOSE(job->files[i]);
+        if(job->contexts[i].archive!=NULL){
+            FCLOSE(job->contexts[i].archive);
+            job->contexts[i].archive = NULL;
+        }
+    }
+}
+
+/**
+ * \fn long long searchFiles(const char* pattern, char** fileNames, int nbFiles, PipelineContext* context)
+ * \brief Writes the lines of compressed files (or of the files of archives) containing a pattern, like grep on the decompressed files. Only the blocks that can contain the pattern are decoded, by context->nbThreads threads. The lines are preceded by the name of their file if there are several files or if it's an archive
+ * \param pattern Pattern looked for (without line break)
+ * \param fileNames Names of the compressed files and archives
+ * \param nbFiles Number of names
+ * \param context Dictionary, number of threads and memory limit used, and measures (if context->stats isn't NULL)
+ * \return Number of lines found
+ */
+
+long long searchFiles(const char* pattern, char** fileNames, int nbFiles, PipelineContext* context)
+{
+    SearchJob job;
+    long long sizeIn=0;
+    long long sizeOut=0;
+
+    if(pattern[0]=='\0' || strchr(pattern, '\n')!=NULL){
+        fprintf(stderr, "\nERROR : The pattern must not be empty or contain a line break\n");
+        exit(EXIT_FAILURE);
+    }
+    if(strlen(pattern)>SEARCH_MAX_LINE){
+        fprintf(stderr, "\nERROR : The pattern must not be longer than %d bytes\n", SEARCH_MAX_LINE);
+        exit(EXIT_FAILURE);
+    }
+    job.pattern = (const unsigned char*) pattern;
+    job.sizePattern = strlen(pattern);
+    job.blocks = NULL;
+    job.nbWorkers = (context->nbThreads>0) ? context->nbThreads : 1;
+    job.contexts = (PipelineContext*) malloc(job.nbWorkers*sizeof(PipelineContext));
+    TESTALLOC(job.contexts);
+    job.files = (FILE**) malloc(job.nbWorkers*sizeof(FILE*));
+    TESTALLOC(job.files);
+    for(int i=0; i<job.nbWorkers; i++){
+        initPipelineContext(&(job.contexts[i]), context->scratch.hugePages);
+        setScratchLimit(&(job.contexts[i].scratch), context->scratch.limit/job.nbWorkers);
+        job.contexts[i].dictionary = context->dictionary;
+    }
+    job.line.text = (unsigned char*) scratchGet(&(job.contexts[0].scratch), SCRATCH_SEARCH_LINE, SEARCH_MAX_LINE);
+    job.line.size = 0;
+    job.nbFound = 0;
+    job.stats = context->stats;
+    pthread_mutex_init(&(job.mutex), NULL);
+
+    for(int f=0; f<nbFiles; f++){
+        unsigned char magic[4];
+        FILE* fileIn = fopen(fileNames[f], "rb");
+        TESTFOPEN(fileIn);
+        sizeIn += seekSizeOfFile(fileIn);
+        int isArchive = fread(magic, sizeof(unsigned char), 4, fileIn)==4 && !memcmp(magic, ARCHIVE_MAGIC, 4);
+        rewind(fileIn);
+        if(!isArchive && !isCompressedStream(fileIn)){
+            fprintf(stderr, "\nERROR : %s wasn't compressed block by block by this program, it can't be searched\n", fileNames[f]);
+            exit(EXIT_FAILURE);
+        }
+        openSearchFiles(&job, fileNames[f], isArchive);
+
+        if(isArchive){
+            Archive archive;
+            readArchive(fileIn, &archive);
+            for(int i=0; i<archive.nbEntries; i++){
+                char label[2*FILENAME_MAX+2];
+                if(nbFiles>1)
+                    snprintf(label, sizeof(label), "%s:%s", fileNames[f], archive.entries[i].name);
+                else
+                    snprintf(label, sizeof(label), "%s", archive.entries[i].name);
+                job.label = label;
+                searchCompressedFile(&job, archive.entries[i].offset);
+                sizeOut += archive.entries[i].size;
+            }
+            freeArchive(&archive);
+        }
+        else{
+            job.label = (nbFiles>1) ? fileNames[f] : NULL;
+            searchCompressedFile(&job, 0);
+        }
+        closeSearchFiles(&job);
+        FCLOSE(fileIn);
+    }
+    if(fflush(stdout)!=0){
+        fprintf(stderr, "\nERROR : Cannot write the lines found\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_destroy(&(job.mutex));
+    for(int i=0; i<job.nbWorkers; i++)
+        freePipelineContext(&(job.contexts[i]));
+    free(job.contexts);
+    free(job.files);
+    if(context->stats!=NULL)
+        finishStats(context->stats, sizeIn, sizeOut);
+    return job.nbFound;
+}
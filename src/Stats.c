@@ -0,0 +1,375 @@
+/**
+ * \file Stats.c
+ * \brief Reports the progress of the long tasks, displays the status messages and measures the stages of the compression and of the decompression
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+#include <stdarg.h>
+#include <time.h>
+#include <limits.h>
+
+#if __WIN32__
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+
+static ProgressCallback progressCallback = NULL; // Function called to report the progress, nothing is reported if it's NULL
+static void* progressUserData = NULL; // Given to progressCallback
+static int verbose = 1; // If 0 then the status messages aren't displayed
+
+static const char* stageNames[N_STAGES] = {"read", "chunking", "dedup", "analysis", "burrows_wheeler", "move_to_front", "rle", "lz77", "bigrams", "histogram", "tree", "huffman_encode", "tans_encode",
+    "table_read", "huffman_decode", "tans_decode", "move_to_front_decode", "burrows_wheeler_decode", "rle_decode", "lz77_decode", "write"};
+
+static const char* blockModeNames[N_BLOCK_MODES] = {"end", "stored", "huffman", "bwt_huffman", "fill", "dictionary", "tans", "bwt_tans", "adaptive", "reference", "lz77", "chain_huffman", "chain_tans", "bigram_huffman"};
+
+
+
+/**
+ * \fn long long getTimeNs()
+ * \brief Gives the value of a monotonic clock (clock_gettime, or QueryPerformanceCounter on Windows)
+ * \return Time in nanoseconds
+ */
+
+long long getTimeNs()
+{
+    #if __WIN32__
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (counter.QuadPart/frequency.QuadPart)*1000000000LL + (counter.QuadPart%frequency.QuadPart)*1000000000LL/frequency.QuadPart;
+    #elif defined(_POSIX_TIMERS) || defined(CLOCK_MONOTONIC) // CLOCK_MONOTONIC alone on the systems that have it without _POSIX_TIMERS (macOS)
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000000000LL + t.tv_nsec;
+    #else
+    return (long long) clock()*(1000000000LL/CLOCKS_PER_SEC); // Time of the processor, the only clock of standard C
+    #endif
+}
+
+/**
+ * \fn void setVerbose(int value)
+ * \brief Enables (1) or disables (0) the status messages
+ * \param value New value
+ */
+
+void setVerbose(int value)
+{
+    verbose = value;
+}
+
+/**
+ * \fn void printStatus(const char* format, ...)
+ * \brief Displays a status message (same parameters as printf), unless they were disabled by setVerbose
+ * \param format Format of the message
+ */
+
+void printStatus(const char* format, ...)
+{
+    va_list args;
+    if(verbose){
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+    }
+}
+
+/**
+ * \fn void setProgressCallback(ProgressCallback callback, void* userData)
+ * \brief Chooses the function called to report the progress of the long tasks. If it's NULL the progress isn't reported and the tasks don't sample it
+ * \param callback Function called
+ * \param userData Pointer given to the function at each call
+ */
+
+void setProgressCallback(ProgressCallback callback, void* userData)
+{
+    progressCallback = callback;
+    progressUserData = userData;
+}
+
+/**
+ * \fn void printProgress(const char* task, long long done, long long total, void* userData)
+ * \brief Callback displaying the progress in percent, as it's done in the interactive mode
+ * \param task Name of the task
+ * \param done Number of elements processed
+ * \param total Number of elements that have to be processed
+ * \param userData Not used
+ */
+
+void printProgress(const char* task, long long done, long long total, void* userData)
+{
+    (void) task;
+    (void) userData;
+    if(done<total)
+        printf("%d%%\n", (int) ((100LL*done)/total));
+}
+
+/**
+ * \fn void progressStart(Progress* progress, const char* task, long long total)
+ * \brief Initializes the progress of a task, it's reported 20 times (every 5%)
+ * \param progress Progress initialized
+ * \param task Name of the task
+ * \param total Number of elements processed by the task
+ */
+
+void progressStart(Progress* progress, const char* task, long long total)
+{
+    progress->task = task;
+    progress->total = total;
+    progress->step = total/20;
+    if(progress->step<1)
+        progress->step=1;
+    progress->next = (progressCallback!=NULL) ? progress->step : LLONG_MAX;
+}
+
+/**
+ * \fn void progressReport(Progress* progress, long long done)
+ * \brief Reports the progress of a task and computes the next position at which it will be reported. It's called by the tasks only when done reaches progress->next
+ * \param progress Progress of the task
+ * \param done Number of elements processed
+ */
+
+void progressReport(Progress* progress, long long done)
+{
+    if(progressCallback==NULL || done<progress->next)
+        return;
+    progressCallback(progress->task, done, progress->total, progressUserData);
+    progress->next = (done/progress->step+1)*progress->step;
+}
+
+/**
+ * \fn long long progressChunkEnd(Progress* progress)
+ * \brief Gives the position until which a task can work without reporting its progress
+ * \param progress Progress of the task
+ * \return End of the current chunk (excluded)
+ */
+
+long long progressChunkEnd(Progress* progress)
+{
+    return (progress->next<progress->total) ? progress->next : progress->total;
+}
+
+
+
+/**
+ * \fn void initStats(PipelineStats* stats, const char* operation)
+ * \brief Initializes the measures of a compression or of a decompression
+ * \param stats Measures initialized
+ * \param operation Name of the operation
+ */
+
+void initStats(PipelineStats* stats, const char* operation)
+{
+    memset(stats, 0, sizeof(PipelineStats));
+    stats->operation = operation;
+    stats->indexBW = -1;
+    stats->startNs = getTimeNs();
+}
+
+/**
+ * \fn void stageStart(PipelineStats* stats, PipelineStage stage)
+ * \brief Starts measuring a stage
+ * \param stats Measures of the operation, can be NULL (then nothing is measured)
+ * \param stage Stage starting
+ */
+
+void stageStart(PipelineStats* stats, PipelineStage stage)
+{
+    if(stats!=NULL){
+        if(stats->perfCounters)
+            readPerfCounters(stats->stages[stage].perfStart);
+        stats->stages[stage].startNs = getTimeNs();
+    }
+}
+
+/**
+ * \fn void stageStop(PipelineStats* stats, PipelineStage stage, long long bytesIn, long long bytesOut)
+ * \brief Stops measuring a stage and adds its time and sizes to the measures
+ * \param stats Measures of the operation, can be NULL
+ * \param stage Stage ending
+ * \param bytesIn Number of bytes given to the stage
+ * \param bytesOut Number of bytes produced by the stage
+ */
+
+void stageStop(PipelineStats* stats, PipelineStage stage, long long bytesIn, long long bytesOut)
+{
+    long long values[N_PERF_EVENTS];
+    if(stats!=NULL){
+        stats->stages[stage].timeNs += getTimeNs()-stats->stages[stage].startNs;
+        if(stats->perfCounters){
+            readPerfCounters(values);
+            for(int i=0; i<N_PERF_EVENTS; i++){
+                if(values[i]<0 || stats->stages[stage].perfStart[i]<0)
+                    stats->stages[stage].perf[i] = -1;
+                else if(stats->stages[stage].perf[i]>=0)
+                    stats->stages[stage].perf[i] += values[i]-stats->stages[stage].perfStart[i];
+            }
+        }
+        stats->stages[stage].bytesIn += bytesIn;
+        stats->stages[stage].bytesOut += bytesOut;
+        stats->stages[stage].calls++;
+    }
+}
+
+/**
+ * \fn void finishStats(PipelineStats* stats, long long bytesIn, long long bytesOut)
+ * \brief Ends the measures of an operation
+ * \param stats Measures of the operation, can be NULL
+ * \param bytesIn Size of the input file
+ * \param bytesOut Size of the output file
+ */
+
+void finishStats(PipelineStats* stats, long long bytesIn, long long bytesOut)
+{
+    if(stats!=NULL){
+        stats->totalNs = getTimeNs()-stats->startNs;
+        stats->bytesIn = bytesIn;
+        stats->bytesOut = bytesOut;
+    }
+}
+
+/**
+ * \fn const char* blockModeName(BlockMode mode)
+ * \brief Gives the name of a mode of block, used in the reports
+ * \param mode Mode
+ * \return Name of the mode
+ */
+
+const char* blockModeName(BlockMode mode)
+{
+    return blockModeNames[mode];
+}
+
+/**
+ * \fn void printStats(const PipelineStats* stats, StatsFormat format, FILE* file)
+ * \brief Writes the measures of an operation in the format chosen with --stats. With several files, there is one JSON object for each file, on its own line (JSON Lines)
+ * \param stats Measures written
+ * \param format Format of the measures, nothing is written with STATS_NONE
+ * \param file File in which they are written
+ */
+
+void printStats(const PipelineStats* stats, StatsFormat format, FILE* file)
+{
+    switch(format){
+        case STATS_JSON : printStatsJson(stats, file); break;
+        case STATS_TEXT : printStatsText(stats, file); break;
+        default : break;
+    }
+}
+
+/**
+ * \fn void printStatsJson(const PipelineStats* stats, FILE* file)
+ * \brief Writes the measures of an operation in JSON (one object), only the stages that were run are written
+ * \param stats Measures written
+ * \param file File in which they are written
+ */
+
+void printStatsJson(const PipelineStats* stats, FILE* file)
+{
+    int first=1;
+    fprintf(file, "{\"operation\":\"%s\",\"total_ns\":%lld,\"bytes_in\":%lld,\"bytes_out\":%lld,", stats->operation, stats->totalNs, stats->bytesIn, stats->bytesOut);
+    fprintf(file, "\"symbols\":%d,\"table_bytes\":%lld,\"index_bw\":%d,\"huffman_loops\":\"%s\",", stats->symbols, stats->tableSize, stats->indexBW, bitKernelName());
+    fprintf(file, "\"memory_peak\":%lld,\"memory_limit\":%lld,\"duplicates\":%d,\"reused\":%d,\"degraded\":%d,\"splits\":%d,\"skipped\":%d,", stats->memoryPeak, stats->memoryLimit, stats->duplicates, stats->reused, stats->degraded, stats->splits, stats->skipped);
+    if(stats->flushes>0)
+        fprintf(file, "\"flushes\":%d,\"latency_max_ns\":%lld,\"latency_mean_ns\":%lld,", stats->flushes, stats->latencyMaxNs, stats->latencyTotalNs/stats->flushes);
+    fprintf(file, "\"blocks\":{");
+    for(int i=BLOCK_STORED; i<N_BLOCK_MODES; i++)
+        fprintf(file, "%s\"%s\":%d", (i==BLOCK_STORED) ? "" : ",", blockModeNames[i], stats->blocks[i]);
+    fprintf(file, "},");
+    if(stats->perfCounters){
+        fprintf(file, "\"perf_counters\":{\"available\":%s,\"error\":\"%s\"},", openPerfCounters()>0 ? "true" : "false", perfCountersError());
+    }
+    fprintf(file, "\"stages\":{");
+    for(int i=0; i<N_STAGES; i++){
+        if(stats->stages[i].calls>0){
+            fprintf(file, "%s\"%s\":{\"ns\":%lld,\"bytes_in\":%lld,\"bytes_out\":%lld,\"calls\":%d", first ? "" : ",", stageNames[i],
+                stats->stages[i].timeNs, stats->stages[i].bytesIn, stats->stages[i].bytesOut, stats->stages[i].calls);
+            if(stats->perfCounters){
+                fprintf(file, ",\"perf\":{");
+                for(int j=0; j<N_PERF_EVENTS; j++){
+                    if(stats->stages[i].perf[j]>=0)
+                        fprintf(file, "%s\"%s\":%lld", j ? "," : "", perfEventName(j), stats->stages[i].perf[j]);
+                    else
+                        fprintf(file, "%s\"%s\":null", j ? "," : "", perfEventName(j));
+                }
+                fprintf(file, "}");
+            }
+            fprintf(file, "}");
+            first=0;
+        }
+    }
+    fprintf(file, "}}\n");
+}
+
+/**
+ * \fn void printStatsText(const PipelineStats* stats, FILE* file)
+ * \brief Writes the measures of an operation as a table that can be read by the user
+ * \param stats Measures written
+ * \param file File in which they are written
+ */
+
+void printStatsText(const PipelineStats* stats, FILE* file)
+{
+    fprintf(file, "\n%-24s %12s %14s %14s %10s\n", "stage", "time (ms)", "bytes in", "bytes out", "MB/s");
+    for(int i=0; i<N_STAGES; i++){
+        if(stats->stages[i].calls>0){
+            double ms = stats->stages[i].timeNs/1e6;
+            fprintf(file, "%-24s %12.3f %14lld %14lld %10.2f\n", stageNames[i], ms, stats->stages[i].bytesIn, stats->stages[i].bytesOut,
+                (ms>0) ? stats->stages[i].bytesIn/(ms*1e3) : 0);
+        }
+    }
+    fprintf(file, "%-24s %12.3f %14lld %14lld\n", "total", stats->totalNs/1e6, stats->bytesIn, stats->bytesOut);
+    fprintf(file, "symbols : %d, table : %lld bytes, Huffman loops : %s\n", stats->symbols, stats->tableSize, bitKernelName());
+    if(stats->memoryLimit>0)
+        fprintf(file, "memory of the buffers : %lld bytes (limit %lld bytes)\n", stats->memoryPeak, stats->memoryLimit);
+    else
+        fprintf(file, "memory of the buffers : %lld bytes\n", stats->memoryPeak);
+    if(stats->flushes>0)
+        fprintf(file, "latency of the stream : %.3f ms on average, %.3f ms at most (%d blocks written)\n", stats->latencyTotalNs/1e6/stats->flushes, stats->latencyMaxNs/1e6, stats->flushes);
+    if(stats->duplicates>0)
+        fprintf(file, "blocks already compressed : %d\n", stats->duplicates);
+    if(stats->reused>0)
+        fprintf(file, "chunks copied from the previous compressed file : %d\n", stats->reused);
+    if(stats->degraded>0)
+        fprintf(file, "blocks compressed with a cheaper mode to meet the deadline : %d\n", stats->degraded);
+    if(stats->splits>0)
+        fprintf(file, "chunks split in several blocks : %d\n", stats->splits);
+    if(stats->skipped>0)
+        fprintf(file, "blocks skipped by the search : %d\n", stats->skipped);
+    fprintf(file, "blocks :");
+    for(int i=BLOCK_STORED; i<N_BLOCK_MODES; i++)
+        fprintf(file, " %d %s%s", stats->blocks[i], blockModeNames[i], (i<N_BLOCK_MODES-1) ? "," : "\n");
+
+    if(stats->perfCounters){
+        if(openPerfCounters()==0){
+            fprintf(file, "\nHardware counters unavailable : %s\n", perfCountersError());
+            return;
+        }
+        fprintf(file, "\n%-24s", "stage");
+        for(int j=0; j<N_PERF_EVENTS; j++)
+            fprintf(file, " %14s", perfEventName(j));
+        fprintf(file, " %6s\n", "IPC");
+        for(int i=0; i<N_STAGES; i++){
+            if(stats->stages[i].calls>0){
+                fprintf(file, "%-24s", stageNames[i]);
+                for(int j=0; j<N_PERF_EVENTS; j++){
+                    if(stats->stages[i].perf[j]>=0)
+                        fprintf(file, " %14lld", stats->stages[i].perf[j]);
+                    else
+                        fprintf(file, " %14s", "n/a");
+                }
+                if(stats->stages[i].perf[PERF_CYCLES]>0 && stats->stages[i].perf[PERF_INSTRUCTIONS]>=0)
+                    fprintf(file, " %6.2f\n", ((double) stats->stages[i].perf[PERF_INSTRUCTIONS])/stats->stages[i].perf[PERF_CYCLES]);
+                else
+                    fprintf(file, " %6s\n", "n/a");
+            }
+        }
+        if(perfCountersError()[0]!='\0')
+            fprintf(file, "Some counters are unavailable : %s\n", perfCountersError());
+    }
+}
@@ -0,0 +1,361 @@
+/**
+ * \file Stream.c
+ * \brief Live compression of a stream (standard input to standard output) in one pass : the characters are coded with Huffman codes rebuilt regularly from the occurrences of the characters already coded, in the same way by the decoder, and the coded blocks are written as soon as the latency bound is reached
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+#include <errno.h>
+
+#if __linux__
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#if __WIN32__
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+
+/**
+ * \fn void initAdaptiveModel(AdaptiveModel* model)
+ * \brief Initializes the codes of a live stream : all the characters have the same occurrence. The codes are built when the first character is coded
+ * \param model Model initialized, it has to be freed with freeAdaptiveModel
+ */
+
+void initAdaptiveModel(AdaptiveModel* model)
+{
+    for(int c=0; c<N_ASCII; c++)
+        model->counts[c] = 1;
+    model->maxLength = 0;
+    model->untilRebuild = 0;
+    model->interval = ADAPTIVE_FIRST_REBUILD;
+    model->huffmanTree = NULL;
+    initArena(&(model->arena), ARENA_CHUNK_SIZE);
+}
+
+/**
+ * \fn void freeAdaptiveModel(AdaptiveModel* model)
+ * \brief Frees the memory of the codes of a live stream
+ * \param model Model freed
+ */
+
+void freeAdaptiveModel(AdaptiveModel* model)
+{
+    freeArena(&(model->arena));
+    model->huffmanTree = NULL;
+}
+
+/**
+ * \fn static void rebuildAdaptiveModel(AdaptiveModel* model)
+ * \brief Builds the codes from the current occurrences, then halves the occurrences so that the next codes depend more on the recent characters
+ * \param model Model rebuilt
+ */
+
+static void rebuildAdaptiveModel(AdaptiveModel* model)
+{
+    int sizeOccurrencesArray=0;
+    int sizeHuffmanTable=0;
+    do{
+        resetArena(&(model->arena)); // The previous tree is freed
+        OccurrencesArrayCell* occurrencesArray = createOccurrencesArray(&(model->arena), model->counts, &sizeOccurrencesArray);
+        HuffmanTableCell* huffmanTable = createHuffmanTable(&(model->arena), occurrencesArray, sizeOccurrencesArray, &sizeHuffmanTable, &(model->huffmanTree));
+        model->maxLength = 0;
+        for(int i=0; i<sizeHuffmanTable; i++){
+            model->codes[huffmanTable[i].c] = huffmanTable[i].bits;
+            model->lengths[huffmanTable[i].c] = huffmanTable[i].length;
+            if(huffmanTable[i].length>model->maxLength)
+                model->maxLength = huffmanTable[i].length;
+        }
+        if(model->maxLength>ADAPTIVE_MAX_CODE_LENGTH){ // Some characters are much rarer than the others, their difference is reduced
+            for(int c=0; c<N_ASCII; c++)
+                model->counts[c] -= model->counts[c] >> 1;
+        }
+    }while(model->maxLength>ADAPTIVE_MAX_CODE_LENGTH);
+    createDecodeTable(model->huffmanTree, model->decodeTable);
+
+    for(int c=0; c<N_ASCII; c++)
+        model->counts[c] -= model->counts[c] >> 1; // Stays at least 1
+    model->untilRebuild = model->interval;
+    if(model->interval<ADAPTIVE_REBUILD_INTERVAL)
+        model->interval *= 2;
+}
+
+/**
+ * \fn static int nextAdaptiveChunk(AdaptiveModel* model, int size)
+ * \brief Gives the number of characters that can be coded with the current codes, the codes are rebuilt first if needed
+ * \param model Model
+ * \param size Number of characters left in the block
+ * \return Number of characters of the next chunk
+ */
+
+static int nextAdaptiveChunk(AdaptiveModel* model, int size)
+{
+    if(model->untilRebuild==0)
+        rebuildAdaptiveModel(model);
+    return (size<model->untilRebuild) ? size : model->untilRebuild;
+}
+
+/**
+ * \fn static void updateAdaptiveModel(AdaptiveModel* model, FileBuffer chunk)
+ * \brief Adds the characters of a chunk coded (or decoded) to the occurrences
+ * \param model Model updated
+ * \param chunk Characters coded, at most model->untilRebuild
+ */
+
+static void updateAdaptiveModel(AdaptiveModel* model, FileBuffer chunk)
+{
+    for(int i=0; i<chunk.size; i++)
+        model->counts[chunk.text[i]]++;
+    model->untilRebuild -= chunk.size;
+}
+
+/**
+ * \fn int adaptiveEncode(AdaptiveModel* model, FileBuffer block, unsigned char* out)
+ * \brief Codes a block of a live stream with the adaptive codes. Each chunk coded with the same codes is completed to a whole byte. If the coded block isn't smaller, it's written as it is (the codes are updated in both cases)
+ * \param model Codes of the stream, updated
+ * \param block Block coded
+ * \param out Memory in which the data of the block is written (at least 2+(block.size*ADAPTIVE_MAX_CODE_LENGTH+7)/8+block.size/ADAPTIVE_FIRST_REBUILD+BIT_IO_SLACK bytes)
+ * \return Size of the data written
+ */
+
+int adaptiveEncode(AdaptiveModel* model, FileBuffer block, unsigned char* out)
+{
+    FileBuffer bufferOut;
+    FileBuffer chunk;
+    bufferOut.text = out;
+    bufferOut.size = 1;
+    out[0] = 0;
+
+    for(int pos=0; pos<block.size; pos+=chunk.size){
+        chunk.size = nextAdaptiveChunk(model, block.size-pos);
+        chunk.text = block.text+pos;
+        encodeSymbols(chunk, &bufferOut, model->codes, model->lengths, NULL);
+        updateAdaptiveModel(model, chunk);
+    }
+    if(bufferOut.size>block.size){ // Not smaller than the block itself
+        out[0] = 1;
+        memcpy(out+1, block.text, block.size);
+        bufferOut.size = block.size+1;
+    }
+    return bufferOut.size;
+}
+
+/**
+ * \fn void adaptiveDecode(AdaptiveModel* model, FileBuffer bufferIn, FileBuffer* bufferOut, int sizeOut)
+ * \brief Decodes a block written by adaptiveEncode and updates the codes in the same way. The program is stopped if the data is incorrect
+ * \param model Codes of the stream, updated
+ * \param bufferIn Data of the block
+ * \param bufferOut Buffer filled, its field text must be allocated by the caller
+ * \param sizeOut Size of the block once decoded
+ */
+
+void adaptiveDecode(AdaptiveModel* model, FileBuffer bufferIn, FileBuffer* bufferOut, int sizeOut)
+{
+    FileBuffer chunk;
+    FileBuffer chunkIn;
+    int posIn=1;
+    if(bufferIn.size<1 || bufferIn.text[0]>1 || (bufferIn.text[0]==1 && bufferIn.size!=sizeOut+1)){
+        fprintf(stderr, "\nERROR : Incorrect block of a stream\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for(int pos=0; pos<sizeOut; pos+=chunk.size){
+        chunk.size = nextAdaptiveChunk(model, sizeOut-pos);
+        chunk.text = bufferOut->text+pos;
+        if(bufferIn.text[0]==1){
+            memcpy(chunk.text, bufferIn.text+1+pos, chunk.size);
+        }
+        else{
+            long long nbBits=0;
+            chunkIn.text = bufferIn.text+posIn;
+            chunkIn.size = bufferIn.size-posIn;
+            decodeSymbols(chunkIn, &chunk, model->decodeTable, chunk.size);
+            for(int i=0; i<chunk.size; i++)
+                nbBits += model->lengths[chunk.text[i]];
+            posIn += (nbBits+7)/8;
+        }
+        updateAdaptiveModel(model, chunk);
+    }
+    if(bufferIn.text[0]==0 && posIn!=bufferIn.size){
+        fprintf(stderr, "\nERROR : Incorrect block of a stream\n");
+        exit(EXIT_FAILURE);
+    }
+    bufferOut->size = sizeOut;
+}
+
+/**
+ * \fn static void setBinaryMode(FILE* file)
+ * \brief Prevents the conversion of the line ends of the standard input or output (Windows only)
+ * \param file File
+ */
+
+static void setBinaryMode(FILE* file)
+{
+    #if __WIN32__
+    _setmode(_fileno(file), _O_BINARY);
+    #else
+    (void) file;
+    #endif
+}
+
+/**
+ * \fn static int readLive(FILE* fileIn, unsigned char* data, int size, int timeout)
+ * \brief Reads the bytes available in a stream without waiting for more. On Linux it waits at most timeout milliseconds for the first one, elsewhere it reads until the end of a line
+ * \param fileIn Stream read (its buffer isn't used on Linux)
+ * \param data Buffer filled
+ * \param size Largest number of bytes read
+ * \param timeout Largest time waited in milliseconds, -1 to wait until something is read
+ * \return Number of bytes read (0 if the time is over), -1 at the end of the stream
+ */
+
+static int readLive(FILE* fileIn, unsigned char* data, int size, int timeout)
+{
+    #if __linux__
+    struct pollfd input = {fileno(fileIn), POLLIN, 0};
+    int ready = poll(&input, 1, timeout);
+    if(ready==0 || (ready<0 && errno==EINTR))
+        return 0;
+    ssize_t sizeRead = (ready>0) ? read(fileno(fileIn), data, size) : -1;
+    if(sizeRead<0 && errno==EINTR)
+        return 0;
+    if(sizeRead<0){
+        fprintf(stderr, "\nERROR : Cannot read the stream\n");
+        exit(EXIT_FAILURE);
+    }
+    return (sizeRead>0) ? (int) sizeRead : -1;
+    #else
+    int sizeRead=0;
+    int c;
+    (void) timeout;
+    while(sizeRead<size && (c=getc(fileIn))!=EOF){
+        data[sizeRead++] = c;
+        if(c=='\n')
+            break;
+    }
+    return (sizeRead>0) ? sizeRead : -1;
+    #endif
+}
+
+/**
+ * \fn static void writeLive(FILE* fileOut, const unsigned char* data, int size)
+ * \brief Writes data in a stream and sends it at once. The program is stopped if it can't be written
+ * \param fileOut Stream written
+ * \param data Data written
+ * \param size Size of the data
+ */
+
+static void writeLive(FILE* fileOut, const unsigned char* data, int size)
+{
+    if(fwrite(data, sizeof(unsigned char), size, fileOut)!=(size_t) size || fflush(fileOut)!=0){
+        fprintf(stderr, "\nERROR : Cannot write the compressed stream\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * \fn void compressLive(FILE* fileIn, FILE* fileOut, int latency, PipelineContext* context)
+ * \brief Compresses a live stream in one pass. The bytes are gathered in a block until latency milliseconds have passed since the oldest one was read (or the block is full), then the block is coded with the adaptive codes and written at once. The result is a compressed file like the ones of compressStream, whose blocks have the mode BLOCK_ADAPTIVE
+ * \param fileIn Stream compressed, read until its end
+ * \param fileOut Stream in which the compressed data is written
+ * \param latency Largest time in milliseconds between the reading of a byte and the writing of its code (on Linux), 0 to write each read at once
+ * \param context Memory and measures of the compression (the latencies are added to the measures)
+ */
+
+void compressLive(FILE* fileIn, FILE* fileOut, int latency, PipelineContext* context)
+{
+    PipelineStats* stats = context->stats;
+    AdaptiveModel adaptive;
+    unsigned char header[9];
+    FileBuffer block;
+    long long sizeRead=0;
+    long long sizeWritten=0;
+    long long firstNs=0;
+    int end=0;
+
+    setBinaryMode(fileIn);
+    setBinaryMode(fileOut);
+    initAdaptiveModel(&adaptive);
+    block.text = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_INPUT, STREAM_BLOCK_SIZE);
+    block.size = 0;
+    unsigned char* out = (unsigned char*) scratchGet(&(context->scratch), SCRATCH_CODED,
+        BLOCK_HEADER_SIZE+2+((size_t) STREAM_BLOCK_SIZE*ADAPTIVE_MAX_CODE_LENGTH+7)/8+STREAM_BLOCK_SIZE/ADAPTIVE_FIRST_REBUILD+BIT_IO_SLACK);
+
+    memcpy(header, CONTAINER_MAGIC, 4);
+    header[4] = CONTAINER_VERSION;
+    writeLive(fileOut, header, 5);
+    sizeWritten = 5;
+
+    while(!end){
+        int timeout=-1; // Nothing to write, the next bytes are waited for
+        if(block.size>0){
+            long long left = firstNs+latency*1000000LL-getTimeNs();
+            timeout = (left>0) ? (int) ((left+999999)/1000000) : 0;
+        }
+        int sizeChunk = (timeout==0) ? 0 : readLive(fileIn, block.text+block.size, STREAM_BLOCK_SIZE-block.size, timeout);
+        if(sizeChunk<0){
+            end = 1;
+        }
+        else if(sizeChunk>0){
+            if(block.size==0)
+                firstNs = getTimeNs();
+            block.size += sizeChunk;
+            sizeRead += sizeChunk;
+        }
+        if(block.size==0 || (!end && block.size<STREAM_BLOCK_SIZE && getTimeNs()-firstNs<latency*1000000LL))
+            continue;
+
+        stageStart(stats, STAGE_HUFFMAN_ENCODE);
+        int sizeCoded = adaptiveEncode(&adaptive, block, out+BLOCK_HEADER_SIZE);
+        stageStop(stats, STAGE_HUFFMAN_ENCODE, block.size, sizeCoded);
+
+        stageStart(stats, STAGE_WRITE);
+        out[0] = BLOCK_ADAPTIVE;
+        writeNumber(out+1, block.size, 4);
+        writeNumber(out+5, sizeCoded, 4);
+        writeLive(fileOut, out, BLOCK_HEADER_SIZE+sizeCoded);
+        stageStop(stats, STAGE_WRITE, sizeCoded, BLOCK_HEADER_SIZE+sizeCoded);
+        sizeWritten += BLOCK_HEADER_SIZE+sizeCoded;
+
+        if(stats!=NULL){
+            long long latencyNs = getTimeNs()-firstNs;
+            stats->blocks[BLOCK_ADAPTIVE]++;
+            stats->flushes++;
+            stats->latencyTotalNs += latencyNs;
+            if(latencyNs>stats->latencyMaxNs)
+                stats->latencyMaxNs = latencyNs;
+        }
+        block.size = 0;
+    }
+
+    header[0] = BLOCK_END;
+    writeNumber(header+1, sizeRead, 8);
+    writeLive(fileOut, header, 9);
+    sizeWritten += 9;
+    freeAdaptiveModel(&adaptive);
+    if(stats!=NULL)
+        finishStats(stats, sizeRead, sizeWritten);
+}
+
+/**
+ * \fn void decompressLive(FILE* fileIn, FILE* fileOut, PipelineContext* context)
+ * \brief Decompresses a live stream : the blocks are read only when they are complete and each one is written as soon as it's decoded
+ * \param fileIn Compressed stream
+ * \param fileOut Stream in which the decompressed data is written
+ * \param context Memory and measures of the decompression
+ */
+
+void decompressLive(FILE* fileIn, FILE* fileOut, PipelineContext* context)
+{
+    setBinaryMode(fileIn);
+    setBinaryMode(fileOut);
+    context->live = 1;
+    long long sizeOut = decompressStream(fileIn, 0, fileOut, context);
+    context->live = 0;
+    if(context->stats!=NULL) // The size of the stream is the magic number, the version and what was read by the blocks
+        finishStats(context->stats, 5+context->stats->stages[STAGE_READ].bytesIn, sizeOut);
+}
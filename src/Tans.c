@@ -0,0 +1,191 @@
+/**
+ * \file Tans.c
+ * \brief Tables of the tANS coder (table-based asymmetric numeral systems) : normalization of the occurrences, saving and reading of the normalized occurrences, creation of the tables of the coder and of the decoder. The coding loops are in BitIO.c
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+#include <math.h>
+
+
+/**
+ * \fn void normalizeCounts(const long counts[N_ASCII], uint16_t normalized[N_ASCII])
+ * \brief Scales the occurrences so that their sum is TANS_TABLE_SIZE. Each character that appears keeps at least 1, the rounding errors are given to (or taken from) the most frequent characters
+ * \param counts Occurrences of each character, at least one isn't 0
+ * \param normalized Normalized occurrences filled
+ */
+
+void normalizeCounts(const long counts[N_ASCII], uint16_t normalized[N_ASCII])
+{
+    long long total=0;
+    int sum=0;
+    int largest=0;
+
+    for(int c=0; c<N_ASCII; c++)
+        total += counts[c];
+    for(int c=0; c<N_ASCII; c++){
+        normalized[c] = 0;
+        if(counts[c]==0)
+            continue;
+        long long value = (counts[c]*(long long) TANS_TABLE_SIZE)/total;
+        normalized[c] = (value>0) ? value : 1;
+        sum += normalized[c];
+        if(counts[c]>counts[largest])
+            largest = c;
+    }
+    if(sum<=TANS_TABLE_SIZE){
+        normalized[largest] += TANS_TABLE_SIZE-sum;
+        return;
+    }
+    while(sum>TANS_TABLE_SIZE){ // Too many characters were raised to 1, one is taken from the largest ones
+        int max=0;
+        for(int c=1; c<N_ASCII; c++){
+            if(normalized[c]>normalized[max])
+                max = c;
+        }
+        normalized[max]--;
+        sum--;
+    }
+}
+
+/**
+ * \fn long long tansSizeBits(const long counts[N_ASCII], const uint16_t normalized[N_ASCII])
+ * \brief Estimates the number of bits written by the tANS coder : each character costs log2(TANS_TABLE_SIZE/normalized) bits
+ * \param counts Occurrences of each character
+ * \param normalized Normalized occurrences
+ * \return Estimated number of bits (without the normalized occurrences and the final state)
+ */
+
+long long tansSizeBits(const long counts[N_ASCII], const uint16_t normalized[N_ASCII])
+{
+    double bits=0;
+    for(int c=0; c<N_ASCII; c++){
+        if(counts[c]>0)
+            bits += counts[c]*(TANS_TABLE_LOG-log2(normalized[c]));
+    }
+    return (long long) ceil(bits);
+}
+
+/**
+ * \fn int saveTansCounts(const uint16_t normalized[N_ASCII], unsigned char* out)
+ * \brief Saves the normalized occurrences : a bitmap of the characters used (32 bytes) then the normalized occurrence of each one (2 bytes)
+ * \param normalized Normalized occurrences
+ * \param out Memory in which they are written (at least TANS_COUNTS_MAX_SIZE bytes)
+ * \return Number of bytes written
+ */
+
+int saveTansCounts(const uint16_t normalized[N_ASCII], unsigned char* out)
+{
+    int size = N_ASCII/8;
+    memset(out, 0, N_ASCII/8);
+    for(int c=0; c<N_ASCII; c++){
+        if(normalized[c]>0){
+            out[c>>3] |= 1 << (c&7);
+            writeNumber(out+size, normalized[c], 2);
+            size += 2;
+        }
+    }
+    return size;
+}
+
+/**
+ * \fn int loadTansCounts(FileBuffer bufferIn, uint16_t normalized[N_ASCII])
+ * \brief Reads the normalized occurrences saved by saveTansCounts. The program is stopped if they are incorrect
+ * \param bufferIn Data of the block, beginning with the normalized occurrences
+ * \param normalized Normalized occurrences filled
+ * \return Number of bytes read
+ */
+
+int loadTansCounts(FileBuffer bufferIn, uint16_t normalized[N_ASCII])
+{
+    int size = N_ASCII/8;
+    int sum = 0;
+    if(bufferIn.size<size){
+        fprintf(stderr, "\nERROR : Incorrect block\n");
+        exit(EXIT_FAILURE);
+    }
+    for(int c=0; c<N_ASCII; c++){
+        normalized[c] = 0;
+        if(!(bufferIn.text[c>>3] & (1 << (c&7))))
+            continue;
+        if(size+2>bufferIn.size){
+            fprintf(stderr, "\nERROR : Incorrect block\n");
+            exit(EXIT_FAILURE);
+        }
+        normalized[c] = readNumber(bufferIn.text+size, 2);
+        size += 2;
+        sum += normalized[c];
+        if(normalized[c]==0){
+            sum = -1;
+            break;
+        }
+    }
+    if(sum!=TANS_TABLE_SIZE){
+        fprintf(stderr, "\nERROR : Incorrect occurrences of the tANS coding\n");
+        exit(EXIT_FAILURE);
+    }
+    return size;
+}
+
+/**
+ * \fn void createTansTable(const uint16_t normalized[N_ASCII], TansTable* table)
+ * \brief Creates the tables of the tANS coder and decoder. The states of each character are spread over the table with a step prime with its size, then each state gets the number of bits that brings it back in [TANS_TABLE_SIZE, 2*TANS_TABLE_SIZE)
+ * \param normalized Normalized occurrences, their sum is TANS_TABLE_SIZE
+ * \param table Tables filled
+ */
+
+void createTansTable(const uint16_t normalized[N_ASCII], TansTable* table)
+{
+    unsigned char spread[TANS_TABLE_SIZE];
+    int cumulated[N_ASCII];
+    int next[N_ASCII];
+    int step = (TANS_TABLE_SIZE>>1)+(TANS_TABLE_SIZE>>3)+3;
+    int position = 0;
+    int total = 0;
+
+    memcpy(table->counts, normalized, sizeof(table->counts));
+    for(int c=0; c<N_ASCII; c++){
+        for(int i=0; i<normalized[c]; i++){
+            spread[position] = c;
+            position = (position+step) & (TANS_TABLE_SIZE-1);
+        }
+        cumulated[c] = total;
+        next[c] = total;
+        total += normalized[c];
+    }
+
+    // Coder : states[cumulated[c]+k] is the (k+1)th state of c in the spread table
+    for(int u=0; u<TANS_TABLE_SIZE; u++)
+        table->states[next[spread[u]]++] = TANS_TABLE_SIZE+u;
+    for(int c=0; c<N_ASCII; c++){
+        if(normalized[c]==0){
+            table->symbols[c].deltaFindState = 0;
+            table->symbols[c].deltaNbBits = 0;
+        }
+        else if(normalized[c]==1){
+            table->symbols[c].deltaFindState = cumulated[c]-1;
+            table->symbols[c].deltaNbBits = ((uint32_t) TANS_TABLE_LOG << 16)-TANS_TABLE_SIZE;
+        }
+        else{
+            uint32_t maxBitsOut = TANS_TABLE_LOG-highBit(normalized[c]-1);
+            uint32_t minStatePlus = (uint32_t) normalized[c] << maxBitsOut;
+            table->symbols[c].deltaFindState = cumulated[c]-normalized[c];
+            table->symbols[c].deltaNbBits = (maxBitsOut << 16)-minStatePlus;
+        }
+    }
+
+    // Decoder
+    for(int c=0; c<N_ASCII; c++)
+        next[c] = normalized[c];
+    for(int u=0; u<TANS_TABLE_SIZE; u++){
+        unsigned char c = spread[u];
+        uint32_t nextState = next[c]++;
+        int nbBits = TANS_TABLE_LOG-highBit(nextState);
+        table->decode[u].c = c;
+        table->decode[u].nbBits = nbBits;
+        table->decode[u].newState = (nextState << nbBits)-TANS_TABLE_SIZE;
+    }
+}
@@ -0,0 +1,455 @@
+/**
+ * \file Transform.c
+ * \brief Registry of the transforms applied to a block before its coding (Burrows Wheeler, Move To Front, run length encoding) and driver chaining them. The chain applied to a block is saved in it, so that its inverse is applied when it's decompressed
+ * \author Robin Meneust
+ * \date 2021
+ */
+
+#include "../include/Structures_Define.h"
+#include "../include/HuffmanFunctions.h"
+
+
+/**
+ * \fn static int encodeBwt(FileBuffer* buffer, unsigned char* params, ScratchSlot spare, long long deadlineNs, PipelineContext* context)
+ * \brief Applies Burrows Wheeler to the buffer, its index is saved in the parameters (4 bytes)
+ * \return Size of the parameters, TRANSFORM_STOPPED if the sort was stopped by the time budget
+ */
+
+static int encodeBwt(FileBuffer* buffer, unsigned char* params, ScratchSlot spare, long long deadlineNs, PipelineContext* context)
+{
+    (void) spare;
+    int indexBW = burrowsWheeler(buffer, &(context->scratch), context->nbThreads, deadlineNs);
+    if(indexBW<0)
+        return TRANSFORM_STOPPED;
+    writeNumber(params, indexBW, 4);
+    return 4;
+}
+
+/**
+ * \fn static int decodeBwt(FileBuffer* buffer, int sizeOut, const unsigned char* params, int sizeParams, ScratchSlot spare, AsyncFile* fileOut, PipelineContext* context)
+ * \brief Applies the inverse of Burrows Wheeler to the buffer. If it's the last inverse of the chain, the result is directly written in fileOut by chunks, otherwise it's written in the spare slot
+ * \return 1 if the result was written in fileOut, 0 if it's in buffer
+ */
+
+static int decodeBwt(FileBuffer* buffer, int sizeOut, const unsigned char* params, int sizeParams, ScratchSlot spare, AsyncFile* fileOut, PipelineContext* context)
+{
+    if(sizeParams!=4 || buffer->size!=sizeOut){
+        fprintf(stderr, "\nERROR : Incorrect parameters of Burrows Wheeler\n");
+        exit(EXIT_FAILURE);
+    }
+    int indexBW = readNumber((unsigned char*) params, 4);
+    if(context->stats!=NULL && context->stats->indexBW<0)
+        context->stats->indexBW = indexBW;
+    if(fileOut!=NULL){
+        burrowsWheelerDecode(indexBW, *buffer, fileOut, &(context->scratch));
+        return 1;
+    }
+
+    AsyncFile output;
+    FileBuffer decoded;
+    decoded.text = (unsigned char*) scratchGet(&(context->scratch), spare, sizeOut);
+    asyncOpenMemory(&output, &decoded, sizeOut);
+    burrowsWheelerDecode(indexBW, *buffer, &output, &(context->scratch));
+    asyncClose(&output);
+    *buffer = decoded;
+    return 0;
+}
+
+/**
+ * \fn static void scratchSizesBwt(int size, ScratchSlot spare, size_t sizes[N_SCRATCH_SLOTS])
+ * \brief Adds the buffers of Burrows Wheeler (copy of the text and arrays of the sort)
+ */
+
+static void scratchSizesBwt(int size, ScratchSlot spare, size_t sizes[N_SCRATCH_SLOTS])
+{
+    (void) spare;
+    sizes[SCRATCH_BWT_TEXT] = size;
+    sizes[SCRATCH_BWT_INDEXES] = sizeof(uint32_t)*size;
+    sizes[SCRATCH_BWT_RANKS] = sizeof(uint32_t)*size;
+    sizes[SCRATCH_BWT_KEYS] = sizeof(uint64_t)*size;
+    sizes[SCRATCH_BWT_GROUPS] = size;
+}
+
+/**
+ * \fn static int encodeMtf(FileBuffer* buffer, unsigned char* params, ScratchSlot spare, long long deadlineNs, PipelineContext* context)
+ * \brief Applies Move To Front to the buffer, it doesn't have any parameter
+ * \return 0
+ */
+
+static int encodeMtf(FileBuffer* buffer, unsigned char* params, ScratchSlot spare, long long deadlineNs, PipelineContext* context)
+{
+    (void) params; (void) spare; (void) deadlineNs; (void) context;
+    moveToFrontEncode(buffer);
+    return 0;
+}
+
+/**
+ * \fn static int decodeMtf(FileBuffer* buffer, int sizeOut, const unsigned char* params, int sizeParams, ScratchSlot spare, AsyncFile* fileOut, PipelineContext* context)
+ * \brief Applies the inverse of Move To Front to the buffer
+ * \return 0, the result is in buffer
+ */
+
+static int decodeMtf(FileBuffer* buffer, int sizeOut, const unsigned char* params, int sizeParams, ScratchSlot spare, AsyncFile* fileOut, PipelineContext* context)
+{
+    (void) params; (void) spare; (void) fileOut; (void) context;
+    if(sizeParams!=0 || buffer->size!=sizeOut){
+        fprintf(stderr, "\nERROR : Incorrect parameters of Move To Front\n");
+        exit(EXIT_FAILURE);
+    }
+    moveToFrontDecode(buffer);
+    return 0;
+}
+
+/**
+ * \fn static void scratchSizesNone(int size, ScratchSlot spare, size_t sizes[N_SCRATCH_SLOTS])
+ * \brief Used by the transforms that don't need any scratch buffer
+ */
+
+static void scratchSizesNone(int size, ScratchSlot spare, size_t sizes[N_SCRATCH_SLOTS])
+{
+    (void) size; (void) spare; (void) sizes;
+}
+
+/**
+ * \fn static int encodeRle(FileBuffer* buffer, unsigned char* params, ScratchSlot spare, long long deadlineNs, PipelineContext* context)
+ * \brief Applies the run length encoding to the buffer, written in the spare slot : after RLE_MIN_RUN identical characters, the number of other repetitions is written (1 byte). It's skipped as soon as the result can't save 1/RLE_MIN_GAIN_DIVISOR of the buffer
+ * \return 0 (no parameter), TRANSFORM_SKIPPED if it isn't worth it
+ */
+
+static int encodeRle(FileBuffer* buffer, unsigned char* params, ScratchSlot spare, long long deadlineNs, PipelineContext* context)
+{
+    (void) params; (void) deadlineNs;
+    int sizeMax = buffer->size-buffer->size/RLE_MIN_GAIN_DIVISOR-1;
+    int sizeEncoded=0;
+    if(sizeMax<=0)
+        return TRANSFORM_SKIPPED;
+
+    unsigned char* out = (unsigned char*) scratchGet(&(context->scratch), spare, buffer->size);
+    for(int pos=0; pos<buffer->size;){
+        unsigned char c = buffer->text[pos];
+        int run=1;
+        while(pos+run<buffer->size && run<RLE_MIN_RUN+255 && buffer->text[pos+run]==c)
+            run++;
+        int sizeRun = (run>=RLE_MIN_RUN) ? RLE_MIN_RUN+1 : run;
+        if(sizeEncoded+sizeRun>sizeMax)
+            return TRANSFORM_SKIPPED;
+        memset(out+sizeEncoded, c, sizeRun);
+        if(run>=RLE_MIN_RUN)
+            out[sizeEncoded+RLE_MIN_RUN] = run-RLE_MIN_RUN;
+        sizeEncoded += sizeRun;
+        pos += run;
+    }
+    buffer->text = out;
+    buffer->size = sizeEncoded;
+    return 0;
+}
+
+/**
+ * \fn static int decodeRle(FileBuffer* buffer, int sizeOut, const unsigned char* params, int sizeParams, ScratchSlot spare, AsyncFile* fileOut, PipelineContext* context)
+ * \brief Applies the inverse of the run length encoding to the buffer, written in the spare slot
+ * \return 0, the result is in buffer
+ */
+
+static int decodeRle(FileBuffer* buffer, int sizeOut, const unsigned char* params, int sizeParams, ScratchSlot spare, AsyncFile* fileOut, PipelineContext* context)
+{
+    (void) params; (void) fileOut;
+    unsigned char* out = (unsigned char*) scratchGet(&(context->scratch), spare, sizeOut);
+    int nbW=0;
+    int run=0;
+    int previous=-1;
+    int correct = sizeParams==0;
+
+    for(int pos=0; pos<buffer->size && correct; pos++){
+        unsigned char c = buffer->text[pos];
+        if(nbW>=sizeOut){
+            correct = 0;
+            break;
+        }
+        out[nbW++] = c;
+        run = (c==previous) ? run+1 : 1;
+        previous = c;
+        if(run==RLE_MIN_RUN){ // Followed by the number of other repetitions
+            pos++;
+            if(pos>=buffer->size || nbW+buffer->text[pos]>sizeOut){
+                correct = 0;
+                break;
+            }
+            memset(out+nbW, c, buffer->text[pos]);
+            nbW += buffer->text[pos];
+            run = 0;
+            previous = -1;
+        }
+    }
+    if(!correct || nbW!=sizeOut){
+        fprintf(stderr, "\nERROR : Incorrect run length encoding\n");
+        exit(EXIT_FAILURE);
+    }
+    buffer->text = out;
+    buffer->size = sizeOut;
+    return 0;
+}
+
+/**
+ * \fn static void scratchSizesRle(int size, ScratchSlot spare, size_t sizes[N_SCRATCH_SLOTS])
+ * \brief Adds the buffer in which the run length encoding is written
+ */
+
+static void scratchSizesRle(int size, ScratchSlot spare, size_t sizes[N_SCRATCH_SLOTS])
+{
+    sizes[spare] = size;
+}
+
+
+/**
+ * \var transformStages Registry of the transforms, indexed by their ID. A new transform is added to TransformId and here
+ */
+
+static const TransformStage transformStages[N_TRANSFORMS] = {
+    {"bwt", 1, STAGE_BWT, STAGE_BWT_DECODE, encodeBwt, decodeBwt, scratchSizesBwt},
+    {"mtf", 1, STAGE_MTF, STAGE_MTF_DECODE, encodeMtf, decodeMtf, scratchSizesNone},
+    {"rle", 0, STAGE_RLE, STAGE_RLE_DECODE, encodeRle, decodeRle, scratchSizesRle}
+};
+
+
+/**
+ * \fn const TransformStage* getTransformStage(TransformId id)
+ * \brief Gives the functions of a transform
+ * \param id ID of the transform
+ * \return Transform in the registry
+ */
+
+const TransformStage* getTransformStage(TransformId id)
+{
+    return &(transformStages[id]);
+}
+
+/**
+ * \fn void setDefaultTransforms(TransformChain* chain)
+ * \brief Sets the chain of the default level (LEVEL_DEFAULT), used by a context when no other one is given : run length encoding (skipped if the block doesn't have long runs), which shortens the sort of the rotations of the blocks that do, then Burrows Wheeler and Move To Front
+ * \param chain Chain set
+ */
+
+void setDefaultTransforms(TransformChain* chain)
+{
+    chain->nbTransforms = 3;
+    chain->ids[0] = TRANSFORM_RLE;
+    chain->ids[1] = TRANSFORM_BWT;
+    chain->ids[2] = TRANSFORM_MTF;
+}
+
+/**
+ * \fn int parseTransforms(const char* list, TransformChain* chain)
+ * \brief Reads a list of names of transforms separated by commas (--transforms=rle,bwt,mtf), or none for an empty chain
+ * \param list List read
+ * \param chain Chain filled with the IDs of the transforms, in the order of the list
+ * \return 1 if the list is correct, 0 otherwise (unknown name, empty name or too many transforms)
+ */
+
+int parseTransforms(const char* list, TransformChain* chain)
+{
+    chain->nbTransforms = 0;
+    if(!strcmp(list, "none"))
+        return 1;
+    while(1){
+        size_t length = strcspn(list, ",");
+        int id=0;
+        while(id<N_TRANSFORMS && (strlen(transformStages[id].name)!=length || strncmp(transformStages[id].name, list, length)!=0))
+            id++;
+        if(id==N_TRANSFORMS || chain->nbTransforms==TRANSFORM_MAX_CHAIN)
+            return 0;
+        chain->ids[chain->nbTransforms++] = id;
+        if(list[length]=='\0')
+            return 1;
+        list += length+1;
+    }
+}
+
+/**
+ * \fn static ScratchSlot spareSlot(ScratchSlot slot)
+ * \brief Gives the slot in which a transform that doesn't work in place writes its result
+ * \param slot Slot containing the input of the transform
+ * \return SCRATCH_TRANSFORM_B if the input is in SCRATCH_TRANSFORM_A, SCRATCH_TRANSFORM_A otherwise
+ */
+
+static ScratchSlot spareSlot(ScratchSlot slot)
+{
+    return (slot==SCRATCH_TRANSFORM_A) ? SCRATCH_TRANSFORM_B : SCRATCH_TRANSFORM_A;
+}
+
+/**
+ * \fn void transformsScratchSizes(const TransformChain* chain, int size, size_t sizes[N_SCRATCH_SLOTS])
+ * \brief Gives the sizes of the scratch buffers used by a chain of transforms, supposing that each transform is applied and keeps the size of the block
+ * \param chain Chain of transforms
+ * \param size Size of the block
+ * \param sizes Number of bytes needed in each slot, filled here (0 for the slots that aren't used)
+ */
+
+void transformsScratchSizes(const TransformChain* chain, int size, size_t sizes[N_SCRATCH_SLOTS])
+{
+    ScratchSlot slot=SCRATCH_INPUT;
+    memset(sizes, 0, N_SCRATCH_SLOTS*sizeof(size_t));
+    for(int i=0; i<chain->nbTransforms; i++){
+        const TransformStage* transform = &(transformStages[chain->ids[i]]);
+        size_t transformSizes[N_SCRATCH_SLOTS]={0};
+        transform->scratchSizes(size, spareSlot(slot), transformSizes);
+        for(int s=0; s<N_SCRATCH_SLOTS; s++){
+            if(transformSizes[s]>sizes[s])
+                sizes[s] = transformSizes[s];
+        }
+        if(!transform->inPlace)
+            slot = spareSlot(slot);
+    }
+}
+
+/**
+ * \fn void reserveTransforms(const TransformChain* chain, int size, ScratchPool* scratch)
+ * \brief Allocates and touches the scratch buffers of a chain of transforms before the first block, so that a process that waits for its work (the workers of the daemon) doesn't allocate them during it. Nothing is allocated if they don't fit in the limit of the pool
+ * \param chain Chain of transforms
+ * \param size Size of the largest block
+ * \param scratch Pool in which the buffers are taken
+ */
+
+void reserveTransforms(const TransformChain* chain, int size, ScratchPool* scratch)
+{
+    size_t sizes[N_SCRATCH_SLOTS];
+    transformsScratchSizes(chain, size, sizes);
+    if(!scratchFitsAll(scratch, sizes))
+        return;
+    for(int s=0; s<N_SCRATCH_SLOTS; s++){
+        if(sizes[s]>0)
+            memset(scratchGet(scratch, s, sizes[s]), 0, sizes[s]); // The pages are mapped now rather than by the first block
+    }
+}
+
+/**
+ * \fn int applyTransforms(FileBuffer* buffer, const TransformChain* chain, TransformChain* applied, long long deadlineNs, PipelineContext* context)
+ * \brief Applies a chain of transforms to a block. The transforms that aren't worth it are skipped, the other ones are saved in applied with their parameters
+ * \param buffer Block, in SCRATCH_INPUT or in a slot that isn't used by the transforms. It points to the result after the call
+ * \param chain Transforms applied, in this order (only their IDs are read)
+ * \param applied Transforms actually applied, filled here
+ * \param deadlineNs Time (getTimeNs) after which the transforms are stopped, 0 if there isn't any limit
+ * \param context Memory and measures of the compression
+ * \return 1 if the chain was applied, 0 if it was stopped by the time budget (the block must then be coded from a copy made before)
+ */
+
+int applyTransforms(FileBuffer* buffer, const TransformChain* chain, TransformChain* applied, long long deadlineNs, PipelineContext* context)
+{
+    ScratchSlot slot=SCRATCH_INPUT;
+    applied->nbTransforms = 0;
+    for(int i=0; i<chain->nbTransforms; i++){
+        const TransformStage* transform = &(transformStages[chain->ids[i]]);
+        int n = applied->nbTransforms;
+        unsigned char* before = buffer->text;
+        int sizeBefore = buffer->size;
+
+        stageStart(context->stats, transform->stage);
+        int sizeParams = transform->encode(buffer, applied->params[n], spareSlot(slot), deadlineNs, context);
+        stageStop(context->stats, transform->stage, sizeBefore, (sizeParams>=0) ? buffer->size : sizeBefore);
+        if(sizeParams==TRANSFORM_STOPPED)
+            return 0;
+        if(sizeParams==TRANSFORM_SKIPPED)
+            continue;
+        if(buffer->text!=before)
+            slot = spareSlot(slot);
+        applied->ids[n] = chain->ids[i];
+        applied->sizeParams[n] = sizeParams;
+        applied->sizes[n] = buffer->size;
+        applied->nbTransforms++;
+    }
+    return 1;
+}
+
+/**
+ * \fn int saveTransforms(const TransformChain* chain, unsigned char* out)
+ * \brief Saves a chain of transforms applied to a block : their number (1 byte), then for each one its ID and the size of its parameters (1 byte each), its parameters and the size of the block after it (4 bytes)
+ * \param chain Chain saved
+ * \param out Buffer in which the chain is written, it must contain TRANSFORM_CHAIN_MAX_SIZE bytes
+ * \return Number of bytes written
+ */
+
+int saveTransforms(const TransformChain* chain, unsigned char* out)
+{
+    int size=0;
+    out[size++] = chain->nbTransforms;
+    for(int i=0; i<chain->nbTransforms; i++){
+        out[size++] = chain->ids[i];
+        out[size++] = chain->sizeParams[i];
+        memcpy(out+size, chain->params[i], chain->sizeParams[i]);
+        size += chain->sizeParams[i];
+        writeNumber(out+size, chain->sizes[i], 4);
+        size += 4;
+    }
+    return size;
+}
+
+/**
+ * \fn int loadTransforms(FileBuffer bufferIn, TransformChain* chain)
+ * \brief Reads a chain of transforms saved by saveTransforms. The program is stopped if it's incorrect
+ * \param bufferIn Data of the block, beginning with the chain
+ * \param chain Chain filled
+ * \return Number of bytes read
+ */
+
+int loadTransforms(FileBuffer bufferIn, TransformChain* chain)
+{
+    int size=1;
+    int correct = bufferIn.size>=1 && bufferIn.text[0]<=TRANSFORM_MAX_CHAIN;
+    if(correct)
+        chain->nbTransforms = bufferIn.text[0];
+    for(int i=0; correct && i<chain->nbTransforms; i++){
+        if(size+2>bufferIn.size){
+            correct = 0;
+            break;
+        }
+        chain->ids[i] = bufferIn.text[size];
+        chain->sizeParams[i] = bufferIn.text[size+1];
+        size += 2;
+        if(chain->ids[i]>=N_TRANSFORMS || chain->sizeParams[i]>TRANSFORM_MAX_PARAMS || size+chain->sizeParams[i]+4>bufferIn.size){
+            correct = 0;
+            break;
+        }
+        memcpy(chain->params[i], bufferIn.text+size, chain->sizeParams[i]);
+        size += chain->sizeParams[i];
+        chain->sizes[i] = readNumber(bufferIn.text+size, 4);
+        size += 4;
+        if(chain->sizes[i]<0 || chain->sizes[i]>BLOCK_SIZE)
+            correct = 0;
+    }
+    if(!correct){
+        fprintf(stderr, "\nERROR : Incorrect chain of transforms\n");
+        exit(EXIT_FAILURE);
+    }
+    return size;
+}
+
+/**
+ * \fn void decodeTransforms(const TransformChain* chain, FileBuffer buffer, int sizeOut, AsyncFile* fileOut, PipelineContext* context)
+ * \brief Applies the inverses of a chain of transforms, from the last one to the first one, and writes the result in fileOut
+ * \param chain Chain applied to the block, its size after the last transform is the size of buffer
+ * \param buffer Decoded data of the block, in SCRATCH_OUTPUT. It can be modified
+ * \param sizeOut Size of the block once decompressed
+ * \param fileOut File in which the block is written
+ * \param context Memory and measures of the decompression
+ */
+
+void decodeTransforms(const TransformChain* chain, FileBuffer buffer, int sizeOut, AsyncFile* fileOut, PipelineContext* context)
+{
+    ScratchSlot slot=SCRATCH_OUTPUT;
+    for(int i=chain->nbTransforms-1; i>=0; i--){
+        const TransformStage* transform = &(transformStages[chain->ids[i]]);
+        int size = (i>0) ? chain->sizes[i-1] : sizeOut;
+        unsigned char* before = buffer.text;
+        int sizeBefore = buffer.size;
+
+        stageStart(context->stats, transform->decodeStage);
+        int written = transform->decode(&buffer, size, chain->params[i], chain->sizeParams[i], spareSlot(slot), (i==0) ? fileOut : NULL, context);
+        stageStop(context->stats, transform->decodeStage, sizeBefore, size);
+        if(written)
+            return;
+        if(buffer.text!=before)
+            slot = spareSlot(slot);
+    }
+    stageStart(context->stats, STAGE_WRITE);
+    writeOutput(buffer, fileOut);
+    stageStop(context->stats, STAGE_WRITE, buffer.size, buffer.size);
+}
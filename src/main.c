@@ -11,62 +11,191 @@
 
 /**
  * \fn int main(int argc, char *argv[])
- * \brief Main function used to compress or decompress a file given in parameter, and if there isn't one then we ask the user to enter its name
+ * \brief Main function used to compress or decompress the files given in parameter (or to train a dictionary, or to search them), and if there isn't one then we ask the user to enter its name
+ * \return 0, or 1 if the search found nothing (like grep)
  */
 
 int main(int argc, char *argv[])
 {
     char fileNameIn[FILENAME_MAX];
     int choice=0;
+    int status=0;
+    ProgramOptions options;
+    PipelineStats stats;
+    PipelineContext context;
+    Dictionary dictionary;
+    DedupTable dedup;
+    DedupTable chunks;
 
-    //Choice between compression, decompression and stoping the program
-    printf("MENU\n\n");
-    printf("0 : Exit\n");
-    printf("1 : Compress a file\n");
-    printf("2 : Decompress a file\n\n");
-    printf("Give a number between 0 and 2 that correponds to your choice : ");
-    choice = fgetc(stdin)-'0';
-    while(choice<0 || choice>2){
-        printf("\nIncorrect choice\nGive a number between 0 and 2 only : ");
+    parseOptions(argc, argv, &options);
+    if(options.perfCounters && openPerfCounters()==0 && !options.quiet)
+        fprintf(stderr, "WARNING : Hardware counters unavailable : %s\n", perfCountersError());
+    if(options.quiet){
+        setVerbose(0);
+    }
+    else if(options.mode<MODE_ARCHIVE){ // The files of an archive are compressed by several threads at the same time, their progress isn't displayed
+        setProgressCallback(printProgress, NULL);
+    }
+
+    if(options.explain){
+        explainSettings(&options, stderr);
+        if(options.mode==MODE_MENU && options.nbFiles==0){ // Only the settings are asked
+            free(options.fileNames);
+            closePerfCounters();
+            return 0;
+        }
+    }
+
+    if(options.mode==MODE_TRAIN){
+        uint32_t id = trainDictionary(options.fileNames+1, options.nbFiles-1, options.fileNames[0]);
+        printStatus("Dictionary %s created (ID %08X)\n", options.fileNames[0], (unsigned int) id);
+        free(options.fileNames);
+        closePerfCounters();
+        return 0;
+    }
+
+    if(options.mode==MODE_LIST){
+        listArchive(options.fileNames[0]);
+        free(options.fileNames);
+        closePerfCounters();
+        return 0;
+    }
+
+    if(options.mode==MODE_CLIENT){ // The files are compressed by the daemon, the client doesn't need any memory
+        for(int i=2; i<options.nbFiles; i++)
+            requestDaemon(options.fileNames[0], strcmp(options.fileNames[1], "compress") ? DAEMON_DECOMPRESS : DAEMON_COMPRESS, options.fileNames[i]);
+        free(options.fileNames);
+        closePerfCounters();
+        return 0;
+    }
+
+    if(options.mode==MODE_MENU){
+        //Choice between compression, decompression and stoping the program
+        printf("MENU\n\n");
+        printf("0 : Exit\n");
+        printf("1 : Compress a file\n");
+        printf("2 : Decompress a file\n\n");
+        printf("Give a number between 0 and 2 that correponds to your choice : ");
         choice = fgetc(stdin)-'0';
+        while(choice<0 || choice>2){
+            printf("\nIncorrect choice\nGive a number between 0 and 2 only : ");
+            choice = fgetc(stdin)-'0';
+        }
+        getchar();
+    }
+    else{
+        choice = (options.mode==MODE_COMPRESS || options.mode==MODE_ARCHIVE) ? 1 : 2;
     }
-    getchar();
 
     if(choice!=0){
-        //Application of the chosen function
-        switch(choice){
-            case 1 :
-                // Getting the name of the file that we will open
-                if(argc==2 && (strlen(argv[1])<FILENAME_MAX))// If the size of the string is correct to get copied in fileNameIn and if there are only 2 arguments (the executable and the name of the file dropped or given)
-                    sprintf(fileNameIn, "%s", argv[1]);
-                else{
-                    getFileName(fileNameIn);
-                }
-
-                if(!strcmp(fileNameIn, "table.txt")){ // The input file can't have the same name of other files used in this program
-                    fprintf(stderr, "ERROR : Le nom du file doit etre different de table.txt");
-                    exit(EXIT_FAILURE);
-                }
-                compressMain(fileNameIn);
-                break;
-            case 2 :
-                // Getting the name of the file that we will open
-                if(argc==2 && (strlen(argv[1])<FILENAME_MAX))// If the size of the string is correct to get copied in fileNameIn and if there are only 2 arguments (the executable and the name of the file dropped or given)
-                    sprintf(fileNameIn, "%s", argv[1]);
-                else{
-                    getFileName(fileNameIn);
-                }
-
-                if(!strcmp(fileNameIn, "table.txt")){ // The input file can't have the same name of other files used in this program
-                    fprintf(stderr, "ERROR : Le nom du file doit etre different de table.txt");
-                    exit(EXIT_FAILURE);
-                }
-                decompressMain(fileNameIn);
-                break;
-            default :
-                fprintf(stderr, "ERROR : Incorrect choice");
+        // The context (and the dictionary) is shared by all the files so that its memory is reused
+        initPipelineContext(&context, options.hugePages);
+        setScratchLimit(&(context.scratch), options.maxMemory);
+        context.nbThreads = (options.nbThreads>0) ? options.nbThreads : numberOfProcessors();
+        context.stats = &stats;
+        context.deadline.budgetNs = options.deadline*1000000LL;
+        context.lz.window = options.lzWindow;
+        context.lz.depth = options.lzDepth;
+        context.transforms = options.transforms;
+        context.chunking = options.chunking;
+        context.coder = options.coder;
+        if(options.dictionary!=NULL){
+            loadDictionary(options.dictionary, &dictionary);
+            context.dictionary = &dictionary;
+        }
+        if(choice==1 && !options.stream && options.maxMemory==0){ // The blocks found again in the files are written without being compressed again
+            initDedupTable(&dedup, DEDUP_CACHE_SIZE);
+            context.dedup = &dedup;
+        }
+        if(options.update!=NULL){ // The chunks of the previous compressed file are copied when they didn't change
+            initDedupTable(&chunks, 0);
+            context.previous = openPreviousFile(options.update, &chunks);
+            context.chunks = &chunks;
+        }
+
+        if(options.stream){ // Standard input to standard output, the measures are written in the error output
+            initStats(&stats, (choice==1) ? "compress" : "decompress");
+            stats.perfCounters = options.perfCounters;
+            if(choice==1)
+                compressLive(stdin, stdout, options.latency, &context);
+            else
+                decompressLive(stdin, stdout, &context);
+            stats.memoryPeak = context.scratch.peak;
+            stats.memoryLimit = options.maxMemory;
+            printStats(&stats, options.statsFormat, stderr);
+        }
+
+        else if(options.mode==MODE_SEARCH){ // The first name is the pattern, the measures are written in the error output like grep's messages
+            initStats(&stats, "search");
+            stats.perfCounters = options.perfCounters;
+            if(searchFiles(options.fileNames[0], options.fileNames+1, options.nbFiles-1, &context)==0)
+                status = 1;
+            stats.memoryPeak = context.scratch.peak;
+            stats.memoryLimit = options.maxMemory;
+            printStats(&stats, options.statsFormat, stderr);
+        }
+
+        else if(options.mode==MODE_DAEMON){ // One worker per thread, they share the dictionary and the memory limit
+            runDaemon(options.fileNames[0], &context, context.nbThreads);
+        }
+
+        else if(options.mode==MODE_ARCHIVE || options.mode==MODE_EXTRACT){ // The first name is the archive
+            initStats(&stats, (choice==1) ? "archive" : "extract");
+            stats.perfCounters = options.perfCounters;
+            if(choice==1)
+                createArchive(options.fileNames[0], options.fileNames+1, options.nbFiles-1, &context);
+            else
+                extractArchive(options.fileNames[0], options.fileNames+1, options.nbFiles-1, &context);
+            stats.memoryPeak = context.scratch.peak;
+            stats.memoryLimit = options.maxMemory;
+            printStats(&stats, options.statsFormat, stdout);
+        }
+
+        for(int i=0; options.mode<MODE_ARCHIVE && !options.stream && (i==0 || i<options.nbFiles); i++){
+            // Getting the name of the file that we will open
+            if(options.nbFiles>0) // The name of the file was dropped or given
+                sprintf(fileNameIn, "%s", options.fileNames[i]);
+            else{
+                getFileName(fileNameIn);
+            }
+
+            if(!strcmp(fileNameIn, "table.txt")){ // The input file can't have the same name of other files used in this program
+                fprintf(stderr, "ERROR : Le nom du file doit etre different de table.txt");
                 exit(EXIT_FAILURE);
+            }
+
+            //Application of the chosen function
+            context.scratch.peak = context.scratch.used; // The peak is measured for each file
+            switch(choice){
+                case 1 :
+                    initStats(&stats, "compress");
+                    stats.perfCounters = options.perfCounters;
+                    compressMain(fileNameIn, &context);
+                    break;
+                case 2 :
+                    initStats(&stats, "decompress");
+                    stats.perfCounters = options.perfCounters;
+                    decompressMain(fileNameIn, &context);
+                    break;
+                default :
+                    fprintf(stderr, "ERROR : Incorrect choice");
+                    exit(EXIT_FAILURE);
+            }
+
+            stats.memoryPeak = context.scratch.peak;
+            stats.memoryLimit = options.maxMemory;
+            printStats(&stats, options.statsFormat, stdout);
         }
+
+        if(context.dictionary!=NULL)
+            freeDictionary(&dictionary);
+        if(context.dedup!=NULL)
+            freeDedupTable(&dedup);
+        if(context.chunks!=NULL)
+            freeDedupTable(&chunks);
+        freePipelineContext(&context);
     }
-    return 0;
+    free(options.fileNames);
+    closePerfCounters();
+    return status;
 }